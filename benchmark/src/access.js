@@ -23,6 +23,15 @@ module.exports = () => new Promise(resolve => {
                 }
             }
         })
+        .add("node-libpng (readRGBA)", () => {
+            let r = 0, g = 0, b = 0;
+            const rgba = nodeLibpngInstance.readRGBA();
+            for (let i = 0; i < rgba.length; i += 4) {
+                r += rgba[i + 0];
+                g += rgba[i + 1];
+                b += rgba[i + 2];
+            }
+        })
         .add("pngjs", () => {
             let r = 0, g = 0, b = 0;
             const { width, height } = pngjsInstance;
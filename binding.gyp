@@ -24,6 +24,28 @@
                 "./native/resize.cpp",
                 "./native/copy.cpp",
                 "./native/fill.cpp",
+                "./native/convert.cpp",
+                "./native/decode-options.cpp",
+                "./native/png-reader.cpp",
+                "./native/decode-tensor.cpp",
+                "./native/analyze.cpp",
+                "./native/diff.cpp",
+                "./native/xxhash.cpp",
+                "./native/hash.cpp",
+                "./native/verify.cpp",
+                "./native/read-file.cpp",
+                "./native/file-writer.cpp",
+                "./native/file-reader.cpp",
+                "./native/write-file.cpp",
+                "./native/scheduler.cpp",
+                "./native/chunks.cpp",
+                "./native/recompress.cpp",
+                "./native/atlas.cpp",
+                "./native/pyramid.cpp",
+                "./native/mipmaps.cpp",
+                "./native/progressive.cpp",
+                "./native/apng.cpp",
+                "./native/encoder-session.cpp",
             ]
         }
     ]
@@ -34,6 +34,36 @@
                 "libpng/pngwrite.c",
                 "libpng/pngwtran.c",
                 "libpng/pngwutil.c"
+            ],
+            "conditions": [
+                # libpng's SSE2 row unfiltering. SSE2 is part of every x86-64 CPU. On ia32 the sources compile
+                # to nothing unless the compiler targets SSE2, leaving the generic C implementation in place.
+                ["target_arch=='x64' or target_arch=='ia32'", {
+                    "defines": [
+                        "PNG_INTEL_SSE"
+                    ],
+                    "sources": [
+                        "libpng/intel/intel_init.c",
+                        "libpng/intel/filter_sse2_intrinsics.c"
+                    ]
+                }],
+                # libpng's NEON row unfiltering, using the intrinsics implementation. NEON is part of every ARMv8 CPU.
+                ["target_arch=='arm64'", {
+                    "defines": [
+                        "PNG_ARM_NEON_OPT=2",
+                        "PNG_ARM_NEON_IMPLEMENTATION=1"
+                    ],
+                    "sources": [
+                        "libpng/arm/arm_init.c",
+                        "libpng/arm/filter_neon_intrinsics.c"
+                    ]
+                }],
+                # 32 bit ARM CPUs don't necessarily support NEON. libpng would otherwise enable it based on the compiler.
+                ["target_arch=='arm'", {
+                    "defines": [
+                        "PNG_ARM_NEON_OPT=0"
+                    ]
+                }]
             ]
         }
     ]
@@ -0,0 +1,464 @@
+#include <png.h>
+#include <node_buffer.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "analyze.hpp"
+#include "convert.hpp"
+#include "bands.hpp"
+
+using namespace node;
+using namespace v8;
+using namespace std;
+
+/**
+ * A rectangular region of a decoded image which should be analyzed.
+ */
+struct Region {
+    const uint8_t *data;
+    PixelFormat format;
+    uint32_t channels;
+    size_t rowBytes;
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+    // The RGBA entries of the palette, always 256 entries.
+    vector<uint8_t> palette;
+};
+
+/**
+ * Parses the arguments `(data, width, height, colorType, bitDepth, x, y, regionWidth, regionHeight, palette)`
+ * shared by all analysis functions. Throws a JS error and returns `false` if they are invalid.
+ */
+static bool parseRegion(const Nan::FunctionCallbackInfo<Value> &info, Region &region) {
+    // 1st Parameter: The buffer with the decoded image.
+    Local<Object> buffer = Local<Object>::Cast(info[0]);
+    const auto length = Buffer::Length(buffer);
+    region.data = reinterpret_cast<uint8_t*>(Buffer::Data(buffer));
+    // 2nd and 3rd Parameter: The dimensions of the image.
+    const auto imageWidth = static_cast<uint32_t>(Nan::To<uint32_t>(info[1]).ToChecked());
+    const auto imageHeight = static_cast<uint32_t>(Nan::To<uint32_t>(info[2]).ToChecked());
+    // 4th Parameter: The color type of the image.
+    const string colorTypeName = *Nan::Utf8String(info[3]);
+    // 5th Parameter: The bit depth of the image.
+    const auto bitDepth = static_cast<uint32_t>(Nan::To<uint32_t>(info[4]).ToChecked());
+    // 6th to 9th Parameter: The region to analyze.
+    region.x = static_cast<uint32_t>(Nan::To<uint32_t>(info[5]).ToChecked());
+    region.y = static_cast<uint32_t>(Nan::To<uint32_t>(info[6]).ToChecked());
+    region.width = static_cast<uint32_t>(Nan::To<uint32_t>(info[7]).ToChecked());
+    region.height = static_cast<uint32_t>(Nan::To<uint32_t>(info[8]).ToChecked());
+
+    if (!parseColorType(colorTypeName, region.format.colorType)) {
+        Nan::ThrowError("Unsupported color type.");
+        return false;
+    }
+    if (bitDepth != 1 && bitDepth != 2 && bitDepth != 4 && bitDepth != 8 && bitDepth != 16) {
+        Nan::ThrowError("Unsupported bit depth.");
+        return false;
+    }
+    region.format.bitDepth = static_cast<png_byte>(bitDepth);
+    region.channels = channelCount(region.format.colorType);
+    region.rowBytes = rowBytesFor(region.format, imageWidth);
+    if (length < region.rowBytes * imageHeight) {
+        Nan::ThrowError("Width and height do not match buffer size.");
+        return false;
+    }
+    const auto outside = static_cast<uint64_t>(region.x) + region.width > imageWidth ||
+        static_cast<uint64_t>(region.y) + region.height > imageHeight;
+    if (region.width == 0 || region.height == 0 || outside) {
+        Nan::ThrowError("Region is out of range for this image.");
+        return false;
+    }
+
+    // 10th Parameter: An optional buffer with the RGBA entries of the palette. Missing entries are opaque black.
+    region.palette.resize(256 * 4);
+    for (size_t entry = 0; entry < 256; ++entry) {
+        region.palette[entry * 4 + 3] = 0xff;
+    }
+    if (Buffer::HasInstance(info[9])) {
+        const auto paletteBytes = min<size_t>(Buffer::Length(info[9]), region.palette.size());
+        memcpy(region.palette.data(), Buffer::Data(info[9]), paletteBytes);
+    }
+    return true;
+}
+
+/**
+ * Splits the rows of `region` into bands, see `inBands` in `bands.hpp`.
+ */
+template<typename Partial, typename Work>
+static vector<Partial> inBands(const Region &region, const Partial &initial, Work work) {
+    return inBands(region.y, region.height, rowBytesFor(region.format, region.width) * region.height, initial, work);
+}
+
+/**
+ * Calls `visit(samples, y)` for the rows `first` to `end` of the region. `samples` points to the interleaved
+ * samples of the region's part of the row: The raw bytes for 8 bit images and unpacked `uint16_t` values for
+ * all other bit depths. Stops early if `visit` returns `false`.
+ */
+template<typename Visit>
+static void forEachRow(const Region &region, uint32_t first, uint32_t end, Visit visit) {
+    const size_t count = static_cast<size_t>(region.width) * region.channels;
+    const size_t firstSample = static_cast<size_t>(region.x) * region.channels;
+    if (region.format.bitDepth == 8) {
+        for (auto y = first; y < end; ++y) {
+            if (!visit(region.data + y * region.rowBytes + firstSample, y)) {
+                return;
+            }
+        }
+        return;
+    }
+    vector<uint16_t> samples(count);
+    for (auto y = first; y < end; ++y) {
+        unpackSamples(region.data + y * region.rowBytes, firstSample, count, region.format.bitDepth, samples.data());
+        if (!visit(static_cast<const uint16_t*>(samples.data()), y)) {
+            return;
+        }
+    }
+}
+
+/**
+ * Returns the amount of histogram bins per channel. Samples of 16 bit are binned by their high byte.
+ */
+static uint32_t binCount(const Region &region) {
+    return 1u << min<uint32_t>(region.format.bitDepth, 8);
+}
+
+/**
+ * Counts the occurences of every sample value, one histogram of `binCount` entries per channel.
+ */
+static vector<uint32_t> histogramOf(const Region &region) {
+    const auto bins = binCount(region);
+    const auto shift = region.format.bitDepth == 16 ? 8 : 0;
+    const auto channels = region.channels;
+    const auto width = region.width;
+    auto partials = inBands(region, vector<uint32_t>(channels * bins, 0), [&](uint32_t first, uint32_t end, vector<uint32_t> &histogram) {
+        forEachRow(region, first, end, [&](const auto *samples, uint32_t y) {
+            for (uint32_t channel = 0; channel < channels; ++channel) {
+                auto *counts = &histogram[channel * bins];
+                for (uint32_t x = 0; x < width; ++x) {
+                    ++counts[samples[x * channels + channel] >> shift];
+                }
+            }
+            return true;
+        });
+    });
+    auto &result = partials[0];
+    for (size_t band = 1; band < partials.size(); ++band) {
+        for (size_t bin = 0; bin < result.size(); ++bin) {
+            result[bin] += partials[band][bin];
+        }
+    }
+    return result;
+}
+
+/**
+ * Returns whether the palette entry has been used according to the histogram of a palette image.
+ */
+static inline bool isUsed(const vector<uint32_t> &histogram, size_t entry) {
+    return entry < histogram.size() && histogram[entry] != 0;
+}
+
+NAN_METHOD(histogram) {
+    Region region;
+    if (!parseRegion(info, region)) {
+        return;
+    }
+    const auto result = histogramOf(region);
+    Local<Array> channels = Nan::New<Array>(region.channels);
+    const auto bins = binCount(region);
+    for (uint32_t channel = 0; channel < region.channels; ++channel) {
+        const auto *counts = reinterpret_cast<const char*>(&result[channel * bins]);
+        Nan::Set(channels, channel, Nan::CopyBuffer(counts, bins * sizeof(uint32_t)).ToLocalChecked());
+    }
+    info.GetReturnValue().Set(channels);
+}
+
+/**
+ * Minimum, maximum and sum of every channel.
+ */
+struct ChannelStats {
+    vector<uint32_t> min;
+    vector<uint32_t> max;
+    vector<uint64_t> sum;
+};
+
+NAN_METHOD(stats) {
+    Region region;
+    if (!parseRegion(info, region)) {
+        return;
+    }
+    const auto channels = region.channels;
+    const auto width = region.width;
+    ChannelStats result;
+    if (region.format.colorType == PNG_COLOR_TYPE_PALETTE) {
+        // Count the indices once, then weight the RGBA values of every used palette entry.
+        const auto histogram = histogramOf(region);
+        result = ChannelStats{ vector<uint32_t>(4, 0xff), vector<uint32_t>(4, 0), vector<uint64_t>(4, 0) };
+        for (size_t entry = 0; entry < 256; ++entry) {
+            if (!isUsed(histogram, entry)) {
+                continue;
+            }
+            for (size_t channel = 0; channel < 4; ++channel) {
+                const uint32_t value = region.palette[entry * 4 + channel];
+                result.min[channel] = min(result.min[channel], value);
+                result.max[channel] = max(result.max[channel], value);
+                result.sum[channel] += static_cast<uint64_t>(value) * histogram[entry];
+            }
+        }
+    } else {
+        const ChannelStats initial{
+            vector<uint32_t>(channels, numeric_limits<uint32_t>::max()),
+            vector<uint32_t>(channels, 0),
+            vector<uint64_t>(channels, 0),
+        };
+        auto partials = inBands(region, initial, [&](uint32_t first, uint32_t end, ChannelStats &partial) {
+            forEachRow(region, first, end, [&](const auto *samples, uint32_t y) {
+                for (uint32_t channel = 0; channel < channels; ++channel) {
+                    // Accumulate in locals so the compiler can keep them in registers.
+                    uint32_t low = partial.min[channel];
+                    uint32_t high = partial.max[channel];
+                    uint64_t sum = 0;
+                    for (uint32_t x = 0; x < width; ++x) {
+                        const uint32_t value = samples[x * channels + channel];
+                        low = min(low, value);
+                        high = max(high, value);
+                        sum += value;
+                    }
+                    partial.min[channel] = low;
+                    partial.max[channel] = high;
+                    partial.sum[channel] += sum;
+                }
+                return true;
+            });
+        });
+        result = partials[0];
+        for (size_t band = 1; band < partials.size(); ++band) {
+            for (uint32_t channel = 0; channel < channels; ++channel) {
+                result.min[channel] = min(result.min[channel], partials[band].min[channel]);
+                result.max[channel] = max(result.max[channel], partials[band].max[channel]);
+                result.sum[channel] += partials[band].sum[channel];
+            }
+        }
+    }
+
+    const auto pixels = static_cast<double>(region.width) * region.height;
+    const auto count = static_cast<uint32_t>(result.sum.size());
+    Local<Array> minimum = Nan::New<Array>(count);
+    Local<Array> maximum = Nan::New<Array>(count);
+    Local<Array> mean = Nan::New<Array>(count);
+    for (uint32_t channel = 0; channel < count; ++channel) {
+        Nan::Set(minimum, channel, Nan::New(static_cast<double>(result.min[channel])));
+        Nan::Set(maximum, channel, Nan::New(static_cast<double>(result.max[channel])));
+        Nan::Set(mean, channel, Nan::New(static_cast<double>(result.sum[channel]) / pixels));
+    }
+    Local<Object> statsObject = Nan::New<Object>();
+    Nan::Set(statsObject, Nan::New("min").ToLocalChecked(), minimum);
+    Nan::Set(statsObject, Nan::New("max").ToLocalChecked(), maximum);
+    Nan::Set(statsObject, Nan::New("mean").ToLocalChecked(), mean);
+    info.GetReturnValue().Set(statsObject);
+}
+
+/**
+ * Returns whether any pixel of the region satisfies `predicate(samples, x)`. All bands stop as soon as
+ * one of them found a matching pixel.
+ */
+template<typename Predicate>
+static bool anyPixel(const Region &region, Predicate predicate) {
+    atomic<bool> found(false);
+    inBands(region, static_cast<uint8_t>(0), [&](uint32_t first, uint32_t end, uint8_t &) {
+        forEachRow(region, first, end, [&](const auto *samples, uint32_t y) {
+            for (uint32_t x = 0; x < region.width; ++x) {
+                if (predicate(samples, x)) {
+                    found = true;
+                    return false;
+                }
+            }
+            return !found.load(memory_order_relaxed);
+        });
+    });
+    return found;
+}
+
+NAN_METHOD(isOpaque) {
+    Region region;
+    if (!parseRegion(info, region)) {
+        return;
+    }
+    const auto colorType = region.format.colorType;
+    if (colorType == PNG_COLOR_TYPE_PALETTE) {
+        const auto histogram = histogramOf(region);
+        for (size_t entry = 0; entry < 256; ++entry) {
+            if (isUsed(histogram, entry) && region.palette[entry * 4 + 3] != 0xff) {
+                info.GetReturnValue().Set(false);
+                return;
+            }
+        }
+        info.GetReturnValue().Set(true);
+        return;
+    }
+    if (colorType != PNG_COLOR_TYPE_RGB_ALPHA && colorType != PNG_COLOR_TYPE_GRAY_ALPHA) {
+        info.GetReturnValue().Set(true);
+        return;
+    }
+    const auto alpha = region.channels - 1;
+    const auto channels = region.channels;
+    const uint32_t opaque = (1u << region.format.bitDepth) - 1;
+    const auto transparent = anyPixel(region, [&](const auto *samples, uint32_t x) {
+        return samples[x * channels + alpha] != opaque;
+    });
+    info.GetReturnValue().Set(!transparent);
+}
+
+NAN_METHOD(isGrayscale) {
+    Region region;
+    if (!parseRegion(info, region)) {
+        return;
+    }
+    const auto colorType = region.format.colorType;
+    if (colorType == PNG_COLOR_TYPE_PALETTE) {
+        const auto histogram = histogramOf(region);
+        for (size_t entry = 0; entry < 256; ++entry) {
+            const auto *rgba = &region.palette[entry * 4];
+            if (isUsed(histogram, entry) && (rgba[0] != rgba[1] || rgba[1] != rgba[2])) {
+                info.GetReturnValue().Set(false);
+                return;
+            }
+        }
+        info.GetReturnValue().Set(true);
+        return;
+    }
+    if (colorType != PNG_COLOR_TYPE_RGB && colorType != PNG_COLOR_TYPE_RGB_ALPHA) {
+        info.GetReturnValue().Set(true);
+        return;
+    }
+    const auto channels = region.channels;
+    const auto colored = anyPixel(region, [&](const auto *samples, uint32_t x) {
+        const auto *pixel = samples + x * channels;
+        return pixel[0] != pixel[1] || pixel[1] != pixel[2];
+    });
+    info.GetReturnValue().Set(!colored);
+}
+
+/**
+ * The bounding box of all foreground pixels found in a band.
+ */
+struct Bounds {
+    uint32_t left;
+    uint32_t top;
+    uint32_t right;
+    uint32_t bottom;
+    bool found;
+};
+
+NAN_METHOD(trimBounds) {
+    Region region;
+    if (!parseRegion(info, region)) {
+        return;
+    }
+    const auto channels = region.channels;
+    const auto width = region.width;
+    // 11th Parameter: The background color in the image's color format or `undefined` to use the top left pixel.
+    vector<uint16_t> background(channels);
+    if (info[10]->IsArray()) {
+        Local<Array> color = Local<Array>::Cast(info[10]);
+        if (color->Length() != channels) {
+            Nan::ThrowError("Background color doesn't match expected color type.");
+            return;
+        }
+        for (uint32_t channel = 0; channel < channels; ++channel) {
+            background[channel] = static_cast<uint16_t>(Nan::To<uint32_t>(Nan::Get(color, channel).ToLocalChecked()).ToChecked());
+        }
+    } else {
+        const auto *row = region.data + region.y * region.rowBytes;
+        unpackSamples(row, static_cast<size_t>(region.x) * channels, channels, region.format.bitDepth, background.data());
+    }
+    // 12th Parameter: The maximum difference per sample for a pixel to still count as background.
+    const auto tolerance = static_cast<int32_t>(Nan::To<uint32_t>(info[11]).ToChecked());
+
+    // For palette images decide once per entry whether its color counts as background.
+    vector<uint8_t> foregroundEntries(256, 0);
+    const auto palette = region.format.colorType == PNG_COLOR_TYPE_PALETTE;
+    if (palette) {
+        const auto *backgroundRgba = &region.palette[(background[0] & 0xff) * 4];
+        for (size_t entry = 0; entry < 256; ++entry) {
+            for (size_t channel = 0; channel < 4; ++channel) {
+                if (abs(region.palette[entry * 4 + channel] - backgroundRgba[channel]) > tolerance) {
+                    foregroundEntries[entry] = 1;
+                }
+            }
+        }
+    }
+
+    const Bounds initial{ numeric_limits<uint32_t>::max(), numeric_limits<uint32_t>::max(), 0, 0, false };
+    auto partials = inBands(region, initial, [&](uint32_t first, uint32_t end, Bounds &bounds) {
+        forEachRow(region, first, end, [&](const auto *samples, uint32_t y) {
+            const auto isForeground = [&](uint32_t x) {
+                const auto *pixel = samples + x * channels;
+                if (palette) {
+                    return foregroundEntries[pixel[0] & 0xff] != 0;
+                }
+                for (uint32_t channel = 0; channel < channels; ++channel) {
+                    if (abs(static_cast<int32_t>(pixel[channel]) - static_cast<int32_t>(background[channel])) > tolerance) {
+                        return true;
+                    }
+                }
+                return false;
+            };
+            uint32_t left = 0;
+            while (left < width && !isForeground(left)) {
+                ++left;
+            }
+            if (left == width) {
+                return true;
+            }
+            // Only the part right of the already known bounds needs to be scanned from the right.
+            uint32_t right = width - 1;
+            const auto knownRight = bounds.found ? bounds.right : left;
+            while (right > knownRight && !isForeground(right)) {
+                --right;
+            }
+            bounds.left = min(bounds.left, left);
+            bounds.right = max(bounds.right, right);
+            bounds.top = min(bounds.top, y);
+            bounds.bottom = max(bounds.bottom, y);
+            bounds.found = true;
+            return true;
+        });
+    });
+
+    Bounds result = initial;
+    for (const auto &bounds : partials) {
+        if (!bounds.found) {
+            continue;
+        }
+        result.left = min(result.left, bounds.left);
+        result.right = max(result.right, bounds.right);
+        result.top = min(result.top, bounds.top);
+        result.bottom = max(result.bottom, bounds.bottom);
+        result.found = true;
+    }
+    if (!result.found) {
+        info.GetReturnValue().SetUndefined();
+        return;
+    }
+    Local<Array> rect = Nan::New<Array>(4);
+    Nan::Set(rect, 0, Nan::New(static_cast<double>(region.x + result.left)));
+    Nan::Set(rect, 1, Nan::New(static_cast<double>(result.top)));
+    Nan::Set(rect, 2, Nan::New(static_cast<double>(result.right - result.left + 1)));
+    Nan::Set(rect, 3, Nan::New(static_cast<double>(result.bottom - result.top + 1)));
+    info.GetReturnValue().Set(rect);
+}
+
+NAN_MODULE_INIT(InitAnalyze) {
+    Nan::Set(target, Nan::New("__native_histogram").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(histogram)).ToLocalChecked());
+    Nan::Set(target, Nan::New("__native_stats").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(stats)).ToLocalChecked());
+    Nan::Set(target, Nan::New("__native_isOpaque").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(isOpaque)).ToLocalChecked());
+    Nan::Set(target, Nan::New("__native_isGrayscale").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(isGrayscale)).ToLocalChecked());
+    Nan::Set(target, Nan::New("__native_trimBounds").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(trimBounds)).ToLocalChecked());
+}
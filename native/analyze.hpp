@@ -0,0 +1,14 @@
+#ifndef ANALYZE_HPP
+#define ANALYZE_HPP
+
+#include <nan.h>
+
+NAN_METHOD(histogram);
+NAN_METHOD(stats);
+NAN_METHOD(isOpaque);
+NAN_METHOD(isGrayscale);
+NAN_METHOD(trimBounds);
+
+NAN_MODULE_INIT(InitAnalyze);
+
+#endif
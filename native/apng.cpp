@@ -0,0 +1,593 @@
+#include <png.h>
+#include <zlib.h>
+#include <node_buffer.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "apng.hpp"
+#include "bands.hpp"
+#include "encode.hpp"
+#include "png-image.hpp"
+#include "scheduler.hpp"
+
+using namespace node;
+using namespace v8;
+using namespace std;
+
+// The size of the data of the chunks defined by the APNG specification.
+static const uint32_t animationControlSize = 8;
+static const uint32_t frameControlSize = 26;
+// The size of the sequence number in front of the data of `fcTL` and `fdAT` chunks.
+static const uint32_t sequenceSize = 4;
+
+static uint16_t readUint16(const uint8_t *source) {
+    return static_cast<uint16_t>((source[0] << 8) | source[1]);
+}
+
+static void writeUint16(uint8_t *target, uint16_t value) {
+    target[0] = static_cast<uint8_t>(value >> 8);
+    target[1] = static_cast<uint8_t>(value);
+}
+
+/**
+ * Reads the `fcTL` chunk at `data`, checking that the frame lies within the canvas.
+ */
+static bool parseFrameControl(const uint8_t *data, const ApngStructure &apng, ApngFrameControl &frame, string &error) {
+    frame.region = { readUint32(data + 12), readUint32(data + 16), readUint32(data + 4), readUint32(data + 8) };
+    frame.delayNumerator = readUint16(data + 20);
+    frame.delayDenominator = readUint16(data + 22);
+    const auto &region = frame.region;
+    if (
+        region.width == 0 || region.height == 0 ||
+        static_cast<uint64_t>(region.x) + region.width > apng.width ||
+        static_cast<uint64_t>(region.y) + region.height > apng.height
+    ) {
+        error = "Error decoding APNG: Frame exceeds the canvas.";
+        return false;
+    }
+    if (data[24] > 2 || data[25] > 1) {
+        error = "Error decoding APNG: Invalid dispose or blend operation.";
+        return false;
+    }
+    frame.dispose = static_cast<ApngDispose>(data[24]);
+    frame.blend = static_cast<ApngBlend>(data[25]);
+    return true;
+}
+
+bool parseApng(const uint8_t *input, size_t inputSize, const DecodeOptions &options, ApngStructure &apng, string &error) {
+    vector<ChunkSpan> chunks;
+    if (!splitChunks(input, inputSize, chunks, error)) {
+        return false;
+    }
+    if (chunks[0].type != "IHDR" || chunks[0].length != 13) {
+        error = "Error decoding APNG: Missing IHDR chunk.";
+        return false;
+    }
+    apng.header = chunks[0].offset + 8;
+    apng.width = readUint32(input + apng.header);
+    apng.height = readUint32(input + apng.header + 4);
+    apng.plays = 0;
+    // The rows of every frame are composited onto an 8 bit RGBA canvas of the image's size.
+    if (
+        (options.maxWidth != 0 && apng.width > options.maxWidth) ||
+        (options.maxHeight != 0 && apng.height > options.maxHeight) ||
+        (options.maxDecodedBytes != 0 && 4.0 * apng.width * apng.height > options.maxDecodedBytes)
+    ) {
+        error = "Error decoding APNG: Image exceeds the size limits.";
+        return false;
+    }
+    bool animated = false;
+    bool imageData = false;
+    // Whether the `IDAT` chunks are the first frame of the animation instead of a default image shown by
+    // decoders not supporting APNG.
+    bool firstFrameInImageData = false;
+    uint32_t sequence = 0;
+    vector<pair<size_t, uint32_t>> imageDataSpans;
+    for (size_t index = 1; index < chunks.size(); ++index) {
+        const auto &chunk = chunks[index];
+        const uint8_t *data = input + chunk.offset + 8;
+        if (!options.trusted && crc32(crc32(0, Z_NULL, 0), input + chunk.offset + 4, chunk.length + 4) != readUint32(data + chunk.length)) {
+            error = "Error decoding APNG: CRC error in chunk " + chunk.type + ".";
+            return false;
+        }
+        if (chunk.type == "IEND") {
+            break;
+        }
+        if (chunk.type == "acTL" && !imageData) {
+            if (chunk.length != animationControlSize) {
+                error = "Error decoding APNG: Invalid acTL chunk.";
+                return false;
+            }
+            animated = true;
+            apng.plays = readUint32(data + 4);
+        } else if (chunk.type == "fcTL" || chunk.type == "fdAT") {
+            const auto minimum = chunk.type == "fcTL" ? frameControlSize : sequenceSize;
+            if (!animated || chunk.length < minimum || (chunk.type == "fcTL" && chunk.length != minimum)) {
+                error = "Error decoding APNG: Invalid " + chunk.type + " chunk.";
+                return false;
+            }
+            if (readUint32(data) != sequence++) {
+                error = "Error decoding APNG: Invalid sequence number in chunk " + chunk.type + ".";
+                return false;
+            }
+            if (chunk.type == "fcTL") {
+                ApngFrameControl frame;
+                if (!parseFrameControl(data, apng, frame, error)) {
+                    return false;
+                }
+                firstFrameInImageData = firstFrameInImageData || (apng.frames.empty() && !imageData);
+                apng.frames.push_back(frame);
+            } else if (apng.frames.empty() || (firstFrameInImageData && apng.frames.size() == 1)) {
+                error = "Error decoding APNG: Invalid fdAT chunk.";
+                return false;
+            } else {
+                apng.frames.back().data.push_back({ chunk.offset + 8 + sequenceSize, chunk.length - sequenceSize });
+            }
+        } else if (chunk.type == "IDAT") {
+            imageData = true;
+            imageDataSpans.push_back({ chunk.offset + 8, chunk.length });
+        } else if (!imageData) {
+            apng.shared.push_back(chunk);
+        }
+    }
+    if (!animated) {
+        // A still image is an animation with a single frame.
+        apng.frames.push_back({ { 0, 0, apng.width, apng.height }, 0, 0, ApngDispose::NONE, ApngBlend::SOURCE, {} });
+        firstFrameInImageData = true;
+    }
+    if (firstFrameInImageData) {
+        const auto &region = apng.frames[0].region;
+        // The default image always covers the whole canvas.
+        if (region.x != 0 || region.y != 0 || region.width != apng.width || region.height != apng.height) {
+            error = "Error decoding APNG: The first frame needs to cover the canvas.";
+            return false;
+        }
+        apng.frames[0].data = imageDataSpans;
+    }
+    if (apng.frames.empty()) {
+        error = "Error decoding APNG: No frames found.";
+        return false;
+    }
+    for (const auto &frame : apng.frames) {
+        if (frame.data.empty()) {
+            error = "Error decoding APNG: Missing image data of a frame.";
+            return false;
+        }
+    }
+    return true;
+}
+
+ApngDecoder::ApngDecoder(vector<uint8_t> &input, const DecodeOptions &options, ApngStructure &apng) :
+    options(options), nextFrame(0) {
+    this->input.swap(input);
+    swap(this->apng, apng);
+}
+
+/**
+ * Decodes a frame into tightly packed 8 bit RGBA rows.
+ */
+static bool decodeFrame(
+    const uint8_t *input,
+    const ApngStructure &apng,
+    const ApngFrameControl &frame,
+    const DecodeOptions &options,
+    DecodedImage &image,
+    string &error
+) {
+    // libpng doesn't know about APNG, so the frame is wrapped into a standalone PNG image made of the header with the
+    // frame's size, the shared chunks and the frame's data.
+    size_t size = 8 + chunkSize(13) + chunkSize(0);
+    for (const auto &chunk : apng.shared) {
+        size += chunkSize(chunk.length);
+    }
+    for (const auto &span : frame.data) {
+        size += chunkSize(span.second);
+    }
+    vector<uint8_t> png(size);
+    auto output = png.data();
+    memcpy(output, input, 8);
+    output += 8;
+    uint8_t header[13];
+    memcpy(header, input + apng.header, 13);
+    writeUint32(header, frame.region.width);
+    writeUint32(header + 4, frame.region.height);
+    writeChunk(output, "IHDR", header, 13);
+    output += chunkSize(13);
+    for (const auto &chunk : apng.shared) {
+        memcpy(output, input + chunk.offset, chunkSize(chunk.length));
+        output += chunkSize(chunk.length);
+    }
+    for (const auto &span : frame.data) {
+        writeChunk(output, "IDAT", input + span.first, span.second);
+        output += chunkSize(span.second);
+    }
+    writeChunk(output, "IEND", nullptr, 0);
+    // The limits on the canvas have already been checked, the frames are never larger.
+    DecodeOptions frameOptions;
+    frameOptions.output = DecodeOutput::RGBA8;
+    frameOptions.trusted = options.trusted;
+    frameOptions.maxChunks = options.maxChunks;
+    frameOptions.maxChunkBytes = options.maxChunkBytes;
+    return decodePng(png.data(), static_cast<uint32_t>(png.size()), frameOptions, image, error);
+}
+
+/**
+ * Composites a frame with straight alpha over the canvas, as specified for the `APNG_BLEND_OP_OVER` operation.
+ */
+static void blendOver(const uint8_t *source, uint8_t *target, uint32_t width) {
+    for (uint32_t x = 0; x < width; ++x, source += 4, target += 4) {
+        const uint32_t sourceAlpha = source[3];
+        if (sourceAlpha == 255) {
+            memcpy(target, source, 4);
+            continue;
+        }
+        if (sourceAlpha == 0) {
+            continue;
+        }
+        const uint32_t sourceWeight = sourceAlpha * 255;
+        const uint32_t targetWeight = (255 - sourceAlpha) * target[3];
+        const uint32_t alpha = sourceWeight + targetWeight;
+        for (uint32_t channel = 0; channel < 3; ++channel) {
+            target[channel] = static_cast<uint8_t>((source[channel] * sourceWeight + target[channel] * targetWeight) / alpha);
+        }
+        target[3] = static_cast<uint8_t>(alpha / 255);
+    }
+}
+
+bool renderApngFrame(
+    const uint8_t *input,
+    const ApngStructure &apng,
+    const DecodeOptions &options,
+    uint32_t index,
+    uint8_t *canvas,
+    vector<uint8_t> &saved,
+    string &error
+) {
+    const size_t stride = static_cast<size_t>(apng.width) * 4;
+    if (index == 0) {
+        memset(canvas, 0, stride * apng.height);
+    } else {
+        // Dispose the previous frame. Restoring the first frame clears it, the same as specified for
+        // `APNG_DISPOSE_OP_PREVIOUS` on the first frame.
+        const auto &previous = apng.frames[index - 1];
+        const auto &region = previous.region;
+        const size_t regionStride = static_cast<size_t>(region.width) * 4;
+        for (uint32_t y = 0; y < region.height; ++y) {
+            auto row = canvas + (region.y + y) * stride + region.x * 4;
+            if (previous.dispose == ApngDispose::BACKGROUND) {
+                memset(row, 0, regionStride);
+            } else if (previous.dispose == ApngDispose::PREVIOUS) {
+                memcpy(row, saved.data() + y * regionStride, regionStride);
+            }
+        }
+    }
+    const auto &frame = apng.frames[index];
+    const auto &region = frame.region;
+    const size_t regionStride = static_cast<size_t>(region.width) * 4;
+    DecodedImage image;
+    if (!decodeFrame(input, apng, frame, options, image, error)) {
+        return false;
+    }
+    if (frame.dispose == ApngDispose::PREVIOUS) {
+        saved.resize(regionStride * region.height);
+    }
+    for (uint32_t y = 0; y < region.height; ++y) {
+        auto row = canvas + (region.y + y) * stride + region.x * 4;
+        const auto source = image.data + y * regionStride;
+        if (frame.dispose == ApngDispose::PREVIOUS) {
+            memcpy(saved.data() + y * regionStride, row, regionStride);
+        }
+        if (frame.blend == ApngBlend::SOURCE) {
+            memcpy(row, source, regionStride);
+        } else {
+            blendOver(source, row, region.width);
+        }
+    }
+    png_destroy_read_struct(&image.pngPtr, &image.infoPtr, nullptr);
+    delete[] image.data;
+    return true;
+}
+
+NAN_MODULE_INIT(ApngDecoder::Init) {
+    Nan::HandleScope scope;
+    auto ctor = Nan::New<FunctionTemplate>(ApngDecoder::New);
+    ctor->SetClassName(Nan::New("__native_ApngDecoder").ToLocalChecked());
+    ctor->InstanceTemplate()->SetInternalFieldCount(1);
+    Nan::SetPrototypeMethod(ctor, "next", ApngDecoder::next);
+    Nan::SetPrototypeMethod(ctor, "rewind", ApngDecoder::rewind);
+    // Instances are only ever created from JS, so the constructor doesn't need to be kept per isolate.
+    Nan::Set(target, Nan::New("__native_ApngDecoder").ToLocalChecked(), Nan::GetFunction(ctor).ToLocalChecked());
+}
+
+NAN_METHOD(ApngDecoder::New) {
+    if (!info.IsConstructCall()) {
+        Nan::ThrowTypeError("ApngDecoder needs to be called with `new`.");
+        return;
+    }
+    // 1st Parameter: The buffer with the encoded image. It is copied, as the frames are decoded on demand.
+    Local<Object> inputBuffer = Local<Object>::Cast(info[0]);
+    const auto data = reinterpret_cast<uint8_t*>(Buffer::Data(inputBuffer));
+    vector<uint8_t> input(data, data + Buffer::Length(inputBuffer));
+    // 2nd Parameter: Optional decode options, of which only `trusted` and `limits` are used.
+    DecodeOptions options;
+    if (!parseDecodeOptions(info[1], options)) {
+        return;
+    }
+    ApngStructure apng;
+    string error;
+    if (!parseApng(input.data(), input.size(), options, apng, error)) {
+        Nan::ThrowTypeError(error.c_str());
+        return;
+    }
+    Nan::Set(info.This(), Nan::New("width").ToLocalChecked(), Nan::New(static_cast<double>(apng.width)));
+    Nan::Set(info.This(), Nan::New("height").ToLocalChecked(), Nan::New(static_cast<double>(apng.height)));
+    Nan::Set(info.This(), Nan::New("plays").ToLocalChecked(), Nan::New(static_cast<double>(apng.plays)));
+    Nan::Set(info.This(), Nan::New("frameCount").ToLocalChecked(), Nan::New(static_cast<double>(apng.frames.size())));
+    auto decoder = new ApngDecoder(input, options, apng);
+    decoder->Wrap(info.This());
+    info.GetReturnValue().Set(info.This());
+}
+
+NAN_METHOD(ApngDecoder::next) {
+    auto decoder = Nan::ObjectWrap::Unwrap<ApngDecoder>(info.Holder());
+    const auto &apng = decoder->apng;
+    // 1st Parameter: The canvas to render onto, which needs to keep the previous frame.
+    Local<Object> canvasBuffer = Local<Object>::Cast(info[0]);
+    if (Buffer::Length(canvasBuffer) != static_cast<size_t>(apng.width) * apng.height * 4) {
+        Nan::ThrowError("Canvas doesn't match the size of the image.");
+        return;
+    }
+    const auto index = decoder->nextFrame;
+    if (index == apng.frames.size()) {
+        return;
+    }
+    string error;
+    auto canvas = reinterpret_cast<uint8_t*>(Buffer::Data(canvasBuffer));
+    if (!renderApngFrame(decoder->input.data(), apng, decoder->options, index, canvas, decoder->saved, error)) {
+        Nan::ThrowTypeError(error.c_str());
+        return;
+    }
+    ++decoder->nextFrame;
+    const auto &frame = apng.frames[index];
+    auto result = Nan::New<Object>();
+    Nan::Set(result, Nan::New("index").ToLocalChecked(), Nan::New(static_cast<double>(index)));
+    Nan::Set(result, Nan::New("x").ToLocalChecked(), Nan::New(static_cast<double>(frame.region.x)));
+    Nan::Set(result, Nan::New("y").ToLocalChecked(), Nan::New(static_cast<double>(frame.region.y)));
+    Nan::Set(result, Nan::New("width").ToLocalChecked(), Nan::New(static_cast<double>(frame.region.width)));
+    Nan::Set(result, Nan::New("height").ToLocalChecked(), Nan::New(static_cast<double>(frame.region.height)));
+    Nan::Set(result, Nan::New("delayNumerator").ToLocalChecked(), Nan::New(static_cast<double>(frame.delayNumerator)));
+    Nan::Set(result, Nan::New("delayDenominator").ToLocalChecked(), Nan::New(static_cast<double>(frame.delayDenominator)));
+    info.GetReturnValue().Set(result);
+}
+
+NAN_METHOD(ApngDecoder::rewind) {
+    auto decoder = Nan::ObjectWrap::Unwrap<ApngDecoder>(info.Holder());
+    decoder->nextFrame = 0;
+}
+
+ApngRegion changedRegion(const uint8_t *previous, const uint8_t *current, uint32_t width, uint32_t height, uint32_t channels) {
+    const size_t stride = static_cast<size_t>(width) * channels;
+    // Whole rows are compared using `memcmp`, which is vectorized by the C library.
+    uint32_t top = 0;
+    while (top < height && memcmp(previous + top * stride, current + top * stride, stride) == 0) {
+        ++top;
+    }
+    if (top == height) {
+        return { 0, 0, 0, 0 };
+    }
+    uint32_t bottom = height;
+    while (memcmp(previous + (bottom - 1) * stride, current + (bottom - 1) * stride, stride) == 0) {
+        --bottom;
+    }
+    // Only the columns outside of the region found so far need to be compared in the remaining rows.
+    uint32_t left = width;
+    uint32_t right = 0;
+    for (auto y = top; y < bottom; ++y) {
+        const auto previousRow = previous + y * stride;
+        const auto currentRow = current + y * stride;
+        if (left > 0 && memcmp(previousRow, currentRow, static_cast<size_t>(left) * channels) != 0) {
+            uint32_t x = 0;
+            while (memcmp(previousRow + x * channels, currentRow + x * channels, channels) == 0) {
+                ++x;
+            }
+            left = x;
+        }
+        for (auto x = width; x > right; --x) {
+            if (memcmp(previousRow + (x - 1) * channels, currentRow + (x - 1) * channels, channels) != 0) {
+                right = x;
+                break;
+            }
+        }
+    }
+    return { left, top, right - left, bottom - top };
+}
+
+/**
+ * Writes an `fcTL` chunk describing a frame which replaces its region and is kept as it is afterwards.
+ */
+static void writeFrameControl(vector<uint8_t> &output, uint32_t sequence, const ApngRegion &region, uint16_t delay) {
+    uint8_t data[frameControlSize];
+    writeUint32(data, sequence);
+    writeUint32(data + 4, region.width);
+    writeUint32(data + 8, region.height);
+    writeUint32(data + 12, region.x);
+    writeUint32(data + 16, region.y);
+    // Delays are stored in milliseconds.
+    writeUint16(data + 20, delay);
+    writeUint16(data + 22, 1000);
+    data[24] = static_cast<uint8_t>(ApngDispose::NONE);
+    data[25] = static_cast<uint8_t>(ApngBlend::SOURCE);
+    const auto offset = output.size();
+    output.resize(offset + chunkSize(frameControlSize));
+    writeChunk(output.data() + offset, "fcTL", data, frameControlSize);
+}
+
+bool encodeAnimation(const ApngEncodeParameters &parameters, vector<uint8_t> &output, string &error) {
+    const auto count = static_cast<uint32_t>(parameters.frames.size());
+    const uint32_t channels = parameters.alpha ? 4 : 3;
+    const size_t stride = static_cast<size_t>(parameters.width) * channels;
+    vector<ApngRegion> regions(count);
+    vector<vector<uint8_t>> encoded(count);
+    mutex errorLock;
+    atomic<bool> failed(false);
+    uint32_t failedIndex = 0;
+    // Every frame is compared to the previous input frame and only its changed region is encoded. With every frame
+    // replacing its region and being kept, the canvas always equals the previous input frame. The frames are
+    // independent of each other, so they are compressed concurrently.
+    forEachInJob(count, stride * parameters.height * count >= parallelThreshold, [&] (uint32_t index) {
+        if (failed) {
+            return;
+        }
+        auto region = index == 0 ?
+            ApngRegion{ 0, 0, parameters.width, parameters.height } :
+            changedRegion(parameters.frames[index - 1], parameters.frames[index], parameters.width, parameters.height, channels);
+        // Frames need to cover at least one pixel. A frame without changes repeats the top left one.
+        if (region.width == 0) {
+            region = { 0, 0, 1, 1 };
+        }
+        regions[index] = region;
+        EncodeParameters encodeParameters = {};
+        encodeParameters.input = const_cast<uint8_t*>(parameters.frames[index]) + region.y * stride + region.x * channels;
+        encodeParameters.stride = stride;
+        encodeParameters.width = region.width;
+        encodeParameters.height = region.height;
+        encodeParameters.alpha = parameters.alpha;
+        encodeParameters.compression = parameters.compression;
+        string frameError;
+        if (!encodePng(encodeParameters, &encoded[index], appendToVector, frameError)) {
+            lock_guard<mutex> guard(errorLock);
+            if (!failed || index < failedIndex) {
+                failedIndex = index;
+                error = frameError;
+            }
+            failed = true;
+        }
+    });
+    if (failed) {
+        return false;
+    }
+
+    // Assemble the animation from the signature and header of the first frame, followed by the image data of all
+    // frames. The first frame is stored in `IDAT` chunks, so it is shown by decoders not supporting APNG.
+    uint32_t sequence = 0;
+    for (uint32_t index = 0; index < count; ++index) {
+        vector<ChunkSpan> chunks;
+        if (!splitChunks(encoded[index].data(), encoded[index].size(), chunks, error)) {
+            return false;
+        }
+        const auto frame = encoded[index].data();
+        if (index == 0) {
+            output.insert(output.end(), frame, frame + 8);
+            output.insert(output.end(), frame + chunks[0].offset, frame + chunks[0].offset + chunkSize(chunks[0].length));
+            uint8_t animationControl[animationControlSize];
+            writeUint32(animationControl, count);
+            writeUint32(animationControl + 4, parameters.plays);
+            output.resize(output.size() + chunkSize(animationControlSize));
+            writeChunk(output.data() + output.size() - chunkSize(animationControlSize), "acTL", animationControl, animationControlSize);
+        }
+        writeFrameControl(output, sequence++, regions[index], parameters.delays[index]);
+        for (const auto &chunk : chunks) {
+            if (chunk.type != "IDAT") {
+                continue;
+            }
+            const auto data = frame + chunk.offset + 8;
+            if (index == 0) {
+                output.insert(output.end(), frame + chunk.offset, frame + chunk.offset + chunkSize(chunk.length));
+                continue;
+            }
+            // `fdAT` chunks carry the same data as `IDAT` chunks, preceded by a sequence number.
+            vector<uint8_t> frameData(sequenceSize + chunk.length);
+            writeUint32(frameData.data(), sequence++);
+            memcpy(frameData.data() + sequenceSize, data, chunk.length);
+            const auto offset = output.size();
+            output.resize(offset + chunkSize(static_cast<uint32_t>(frameData.size())));
+            writeChunk(output.data() + offset, "fdAT", frameData.data(), static_cast<uint32_t>(frameData.size()));
+        }
+    }
+    const auto offset = output.size();
+    output.resize(offset + chunkSize(0));
+    writeChunk(output.data() + offset, "IEND", nullptr, 0);
+    return true;
+}
+
+/**
+ * Encodes an animation on a thread of the scheduler's pool.
+ */
+class EncodeApngWorker : public ScheduledWorker {
+    public:
+        EncodeApngWorker(Nan::Callback *callback, const ApngEncodeParameters &parameters) :
+            ScheduledWorker(callback, "node-libpng:encodeApng"), parameters(parameters) {}
+
+        void Execute() override {
+            string error;
+            if (!encodeAnimation(parameters, output, error)) {
+                SetErrorMessage(error.c_str());
+            }
+        }
+
+    protected:
+        void HandleOKCallback() override {
+            Nan::HandleScope scope;
+            Local<Value> argv[] = {
+                Nan::Null(),
+                Nan::CopyBuffer(reinterpret_cast<char*>(output.data()), output.size()).ToLocalChecked(),
+            };
+            callback->Call(2, argv, async_resource);
+        }
+
+        void HandleErrorCallback() override {
+            Nan::HandleScope scope;
+            Local<Value> argv[] = { Nan::Error(ErrorMessage()) };
+            callback->Call(1, argv, async_resource);
+        }
+
+    private:
+        ApngEncodeParameters parameters;
+        vector<uint8_t> output;
+};
+
+NAN_METHOD(encodeApng) {
+    ApngEncodeParameters parameters;
+    // 3rd, 4th and 5th Parameter: The size of the frames and whether they have an alpha channel.
+    parameters.width = Nan::To<uint32_t>(info[2]).FromMaybe(0);
+    parameters.height = Nan::To<uint32_t>(info[3]).FromMaybe(0);
+    parameters.alpha = Nan::To<bool>(info[4]).FromMaybe(false);
+    const size_t expectedSize = static_cast<size_t>(parameters.width) * parameters.height * (parameters.alpha ? 4 : 3);
+    // 1st and 2nd Parameter: The buffers with the samples of the frames and the delay of every frame in milliseconds.
+    auto frames = Local<Array>::Cast(info[0]);
+    auto delays = Local<Array>::Cast(info[1]);
+    for (uint32_t index = 0; index < frames->Length(); ++index) {
+        auto frame = Nan::Get(frames, index).ToLocalChecked();
+        if (parameters.width == 0 || parameters.height == 0 || Buffer::Length(frame) < expectedSize) {
+            Nan::ThrowError("Input buffer is too small for the specified dimensions.");
+            return;
+        }
+        parameters.frames.push_back(reinterpret_cast<uint8_t*>(Buffer::Data(frame)));
+        parameters.delays.push_back(static_cast<uint16_t>(Nan::To<uint32_t>(Nan::Get(delays, index).ToLocalChecked()).FromMaybe(0)));
+    }
+    if (parameters.frames.empty()) {
+        Nan::ThrowError("At least one frame is needed.");
+        return;
+    }
+    // 6th and 7th Parameter: How often the animation is played and the compression level.
+    parameters.plays = Nan::To<uint32_t>(info[5]).FromMaybe(0);
+    parameters.compression = Nan::To<uint32_t>(info[6]).FromMaybe(9);
+    // 8th Parameter: Whether to queue the job in the batch lane.
+    const auto priority = parseJobPriority(info[7]);
+    // 9th Parameter: The callback to call with an error or the encoded animation.
+    auto callback = new Nan::Callback(Local<Function>::Cast(info[8]));
+    auto worker = new EncodeApngWorker(callback, parameters);
+    // Keep the frames alive while they are encoded on the pool.
+    worker->SaveToPersistent("frames", info[0]);
+    const auto id = scheduleWorker(worker, priority);
+    info.GetReturnValue().Set(Nan::New(static_cast<double>(id)));
+}
+
+NAN_MODULE_INIT(InitApng) {
+    ApngDecoder::Init(target);
+    Nan::Set(target, Nan::New("__native_encodeApng").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(encodeApng)).ToLocalChecked());
+}
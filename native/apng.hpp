@@ -0,0 +1,153 @@
+#ifndef APNG_HPP
+#define APNG_HPP
+
+#include <nan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "chunks.hpp"
+#include "decode-options.hpp"
+
+/**
+ * How the area of a frame is cleared before the next frame is rendered, as stored in the `fcTL` chunk.
+ */
+enum class ApngDispose {
+    // Keep the frame as it is.
+    NONE = 0,
+    // Clear the area of the frame to transparent black.
+    BACKGROUND = 1,
+    // Restore the area of the frame to what it was before the frame was rendered.
+    PREVIOUS = 2
+};
+
+/**
+ * How a frame is rendered onto the canvas, as stored in the `fcTL` chunk.
+ */
+enum class ApngBlend {
+    // Replace the area of the frame, including its alpha.
+    SOURCE = 0,
+    // Composite the frame over the area using its alpha.
+    OVER = 1
+};
+
+/**
+ * The area of the canvas covered by a frame.
+ */
+struct ApngRegion {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+};
+
+/**
+ * A frame of an animated image as described by its `fcTL` chunk.
+ */
+struct ApngFrameControl {
+    ApngRegion region;
+    uint16_t delayNumerator;
+    uint16_t delayDenominator;
+    ApngDispose dispose;
+    ApngBlend blend;
+    // The compressed image data of the frame, as offsets and lengths of the data within the `IDAT` or `fdAT` chunks.
+    std::vector<std::pair<size_t, uint32_t>> data;
+};
+
+/**
+ * The chunks of an animated image, found by `parseApng`.
+ */
+struct ApngStructure {
+    uint32_t width;
+    uint32_t height;
+    uint32_t plays;
+    // The offset of the `IHDR` chunk's data.
+    size_t header;
+    // All chunks before the image data which every frame shares, such as `PLTE` or `gAMA`.
+    std::vector<ChunkSpan> shared;
+    std::vector<ApngFrameControl> frames;
+};
+
+/**
+ * Finds the frames of the animated PNG in `input`. An image without an `acTL` chunk is treated as an animation
+ * with a single frame. The frames are handed to libpng in new chunks, so the CRCs are checked here unless
+ * `options.trusted` is set. Returns `false` and sets `error` if the image is malformed.
+ */
+bool parseApng(const uint8_t *input, size_t inputSize, const DecodeOptions &options, ApngStructure &apng, std::string &error);
+
+/**
+ * Renders the frame `index` onto the 8 bit RGBA `canvas`, which needs to hold the frame before it or is cleared
+ * for the first frame. The previous frame is disposed and the frame is blended according to their `fcTL` chunks.
+ * `saved` keeps the area of a frame to restore when it is disposed and needs to be handed to every call.
+ * Returns `false` and sets `error` if the frame could not be decoded.
+ */
+bool renderApngFrame(
+    const uint8_t *input,
+    const ApngStructure &apng,
+    const DecodeOptions &options,
+    uint32_t index,
+    uint8_t *canvas,
+    std::vector<uint8_t> &saved,
+    std::string &error
+);
+
+/**
+ * Decodes the animated PNG handed to its constructor frame by frame, compositing every frame onto an 8 bit RGBA
+ * canvas according to the frames' dispose and blend operations.
+ */
+class ApngDecoder : public Nan::ObjectWrap {
+    public:
+        static NAN_MODULE_INIT(Init);
+
+    private:
+        static NAN_METHOD(New);
+        // Renders the next frame onto the canvas, returning its region and delay or `undefined` after the last frame.
+        static NAN_METHOD(next);
+        // Starts over with the first frame.
+        static NAN_METHOD(rewind);
+
+        ApngDecoder(std::vector<uint8_t> &input, const DecodeOptions &options, ApngStructure &apng);
+
+        std::vector<uint8_t> input;
+        DecodeOptions options;
+        ApngStructure apng;
+        // The index of the next frame to render.
+        uint32_t nextFrame;
+        // The area of the canvas covered by the previous frame before it was rendered, if it is to be restored.
+        std::vector<uint8_t> saved;
+};
+
+/**
+ * Describes a sequence of RGB or RGBA frames with 8 bit per sample and the same size to encode as animated PNG.
+ */
+struct ApngEncodeParameters {
+    std::vector<const uint8_t*> frames;
+    // The delay of every frame in milliseconds.
+    std::vector<uint16_t> delays;
+    uint32_t width;
+    uint32_t height;
+    bool alpha;
+    // How often the animation is played, `0` meaning forever.
+    uint32_t plays;
+    uint32_t compression;
+};
+
+/**
+ * Returns the smallest region containing every pixel which differs between two frames.
+ * The region is empty if the frames are identical.
+ */
+ApngRegion changedRegion(const uint8_t *previous, const uint8_t *current, uint32_t width, uint32_t height, uint32_t channels);
+
+/**
+ * Encodes the frames as animated PNG into `output`. Every frame after the first one only stores the region which
+ * changed since the previous frame. The frames are compressed concurrently.
+ * Doesn't touch any JS values, so it can be called from worker threads.
+ * Returns `false` and sets `error` if a frame could not be encoded or the job was aborted.
+ */
+bool encodeAnimation(const ApngEncodeParameters &parameters, std::vector<uint8_t> &output, std::string &error);
+
+NAN_METHOD(encodeApng);
+
+NAN_MODULE_INIT(InitApng);
+
+#endif
@@ -0,0 +1,201 @@
+#include <png.h>
+#include <node_buffer.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "atlas.hpp"
+#include "bands.hpp"
+#include "encode.hpp"
+#include "png-reader.hpp"
+#include "scheduler.hpp"
+
+using namespace node;
+using namespace v8;
+using namespace std;
+
+/**
+ * Decodes a sprite as 8 bit RGBA straight into its slot of the atlas. Every row is handed to libpng as a pointer into
+ * the atlas, so no intermediate buffer is needed. For interlaced images libpng only fills in the pixels of the
+ * current pass, so the passes are combined in place as well.
+ */
+static bool decodeSprite(const AtlasSprite &sprite, const DecodeOptions &options, uint8_t *atlas, size_t stride, string &error) {
+    if (sprite.inputSize < 8 || png_sig_cmp(sprite.input, 0, 8)) {
+        error = "Invalid PNG buffer.";
+        return false;
+    }
+    png_structp pngPtr = png_create_read_struct(PNG_LIBPNG_VER_STRING, &error, storeError, ignoreWarning);
+    png_infop infoPtr = pngPtr ? png_create_info_struct(pngPtr) : nullptr;
+    if (!infoPtr) {
+        png_destroy_read_struct(&pngPtr, nullptr, nullptr);
+        error = "Unable to initialize libpng.";
+        return false;
+    }
+    if (setjmp(png_jmpbuf(pngPtr))) {
+        png_destroy_read_struct(&pngPtr, &infoPtr, nullptr);
+        return false;
+    }
+    ReadStruct readStruct{ sprite.inputSize, sprite.input, 8 };
+    png_set_read_fn(pngPtr, &readStruct, readFromBuffer);
+    png_set_sig_bytes(pngPtr, 8);
+    applyReadPolicy(pngPtr, options);
+    abortAtRowBoundaries(pngPtr, true);
+    png_read_info(pngPtr, infoPtr);
+    // The slot was packed using the header read on the JS side. Never write beyond it, even if the buffer changed.
+    if (png_get_image_width(pngPtr, infoPtr) != sprite.width || png_get_image_height(pngPtr, infoPtr) != sprite.height) {
+        png_error(pngPtr, "Image size doesn't match the packed slot.");
+    }
+    applyDecodeOptions(pngPtr, infoPtr, options);
+    const int passes = png_get_interlace_type(pngPtr, infoPtr) == PNG_INTERLACE_ADAM7 ? PNG_INTERLACE_ADAM7_PASSES : 1;
+    uint8_t *slot = atlas + sprite.y * stride + static_cast<size_t>(sprite.x) * 4;
+    for (int pass = 0; pass < passes; ++pass) {
+        for (uint32_t y = 0; y < sprite.height; ++y) {
+            png_read_row(pngPtr, slot + y * stride, nullptr);
+        }
+    }
+    png_read_end(pngPtr, nullptr);
+    png_destroy_read_struct(&pngPtr, &infoPtr, nullptr);
+    return true;
+}
+
+bool buildAtlasPng(const AtlasParameters &parameters, vector<uint8_t> &output, string &error) {
+    const size_t stride = static_cast<size_t>(parameters.width) * 4;
+    // The padding and all space not covered by sprites stays transparent.
+    vector<uint8_t> atlas(stride * parameters.height, 0);
+    DecodeOptions options = parameters.decodeOptions;
+    options.output = DecodeOutput::RGBA8;
+    options.premultiplied = false;
+    options.linear = false;
+    size_t decodedBytes = 0;
+    for (const auto &sprite : parameters.sprites) {
+        decodedBytes += static_cast<size_t>(sprite.width) * sprite.height * 4;
+    }
+
+    // The slots don't overlap, so the sprites can be decoded on several threads without locking the atlas.
+    mutex errorLock;
+    atomic<bool> failed(false);
+    uint32_t failedIndex = 0;
+    const auto count = static_cast<uint32_t>(parameters.sprites.size());
+    forEachInJob(count, decodedBytes >= parallelThreshold, [&] (uint32_t index) {
+        if (failed) {
+            return;
+        }
+        string spriteError;
+        if (!decodeSprite(parameters.sprites[index], options, atlas.data(), stride, spriteError)) {
+            lock_guard<mutex> guard(errorLock);
+            // Report the first failing sprite, independent of the order in which the threads got to them.
+            if (!failed || index < failedIndex) {
+                failedIndex = index;
+                error = "Error decoding sprite " + to_string(index) + ": " + spriteError;
+            }
+            failed = true;
+        }
+    });
+    if (failed) {
+        return false;
+    }
+
+    EncodeParameters encodeParameters = {};
+    encodeParameters.input = atlas.data();
+    encodeParameters.width = parameters.width;
+    encodeParameters.height = parameters.height;
+    encodeParameters.alpha = true;
+    encodeParameters.compression = parameters.compressionLevel;
+    encodeParameters.premultiplied = false;
+    return encodePng(encodeParameters, &output, appendToVector, error);
+}
+
+/**
+ * Builds an atlas on a thread of the scheduler's pool.
+ */
+class BuildAtlasWorker : public ScheduledWorker {
+    public:
+        BuildAtlasWorker(Nan::Callback *callback, const AtlasParameters &parameters) :
+            ScheduledWorker(callback, "node-libpng:buildAtlas"), parameters(parameters) {}
+
+        void Execute() override {
+            string error;
+            if (!buildAtlasPng(parameters, output, error)) {
+                SetErrorMessage(error.c_str());
+            }
+        }
+
+    protected:
+        void HandleOKCallback() override {
+            Nan::HandleScope scope;
+            Local<Value> argv[] = {
+                Nan::Null(),
+                Nan::CopyBuffer(reinterpret_cast<char*>(output.data()), output.size()).ToLocalChecked(),
+            };
+            callback->Call(2, argv, async_resource);
+        }
+
+        void HandleErrorCallback() override {
+            Nan::HandleScope scope;
+            Local<Value> argv[] = { Nan::TypeError(ErrorMessage()) };
+            callback->Call(1, argv, async_resource);
+        }
+
+    private:
+        AtlasParameters parameters;
+        vector<uint8_t> output;
+};
+
+NAN_METHOD(buildAtlas) {
+    // 1st Parameter: An array of buffers with the encoded sprites.
+    Local<Array> inputs = Local<Array>::Cast(info[0]);
+    // 2nd Parameter: An array with the `x`, `y`, `width` and `height` of every sprite's slot.
+    Local<Array> slots = Local<Array>::Cast(info[1]);
+    AtlasParameters parameters;
+    // 3rd and 4th Parameter: The size of the atlas.
+    parameters.width = Nan::To<uint32_t>(info[2]).FromMaybe(0);
+    parameters.height = Nan::To<uint32_t>(info[3]).FromMaybe(0);
+    // 5th Parameter: Optional decode options, of which only `trusted` and `limits` are used.
+    if (!parseDecodeOptions(info[4], parameters.decodeOptions)) {
+        return;
+    }
+    // 6th Parameter: The compression level.
+    parameters.compressionLevel = Nan::To<uint32_t>(info[5]).FromMaybe(9);
+    // 7th Parameter: Whether to queue the job in the batch lane.
+    const auto priority = parseJobPriority(info[6]);
+    if (slots->Length() != inputs->Length() * 4) {
+        Nan::ThrowError("A slot needs to be specified for every sprite.");
+        return;
+    }
+    for (uint32_t index = 0; index < inputs->Length(); ++index) {
+        Local<Value> input = Nan::Get(inputs, index).ToLocalChecked();
+        if (!Buffer::HasInstance(input) || Buffer::Length(input) > UINT32_MAX) {
+            Nan::ThrowError("Input is not a buffer.");
+            return;
+        }
+        AtlasSprite sprite;
+        sprite.input = reinterpret_cast<uint8_t*>(Buffer::Data(input));
+        sprite.inputSize = static_cast<uint32_t>(Buffer::Length(input));
+        sprite.x = Nan::To<uint32_t>(Nan::Get(slots, index * 4).ToLocalChecked()).FromMaybe(0);
+        sprite.y = Nan::To<uint32_t>(Nan::Get(slots, index * 4 + 1).ToLocalChecked()).FromMaybe(0);
+        sprite.width = Nan::To<uint32_t>(Nan::Get(slots, index * 4 + 2).ToLocalChecked()).FromMaybe(0);
+        sprite.height = Nan::To<uint32_t>(Nan::Get(slots, index * 4 + 3).ToLocalChecked()).FromMaybe(0);
+        // Guards the memory of the atlas against slots computed wrongly on the JS side.
+        if (
+            static_cast<uint64_t>(sprite.x) + sprite.width > parameters.width ||
+            static_cast<uint64_t>(sprite.y) + sprite.height > parameters.height
+        ) {
+            Nan::ThrowError("Slot exceeds the atlas.");
+            return;
+        }
+        parameters.sprites.push_back(sprite);
+    }
+    // 8th Parameter: The callback to call with an error or the encoded atlas.
+    auto callback = new Nan::Callback(Local<Function>::Cast(info[7]));
+    auto worker = new BuildAtlasWorker(callback, parameters);
+    // Keep the sprites alive while they are decoded on the pool.
+    worker->SaveToPersistent("inputs", info[0]);
+    const auto id = scheduleWorker(worker, priority);
+    info.GetReturnValue().Set(Nan::New(static_cast<double>(id)));
+}
+
+NAN_MODULE_INIT(InitAtlas) {
+    Nan::Set(target, Nan::New("__native_buildAtlas").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(buildAtlas)).ToLocalChecked());
+}
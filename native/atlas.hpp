@@ -0,0 +1,48 @@
+#ifndef ATLAS_HPP
+#define ATLAS_HPP
+
+#include <nan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "decode-options.hpp"
+
+/**
+ * An encoded image and the slot of the atlas it is decoded into.
+ */
+struct AtlasSprite {
+    uint8_t *input;
+    uint32_t inputSize;
+    // The position of the slot in the atlas.
+    uint32_t x;
+    uint32_t y;
+    // The size of the slot, as read from the header of the image before packing.
+    uint32_t width;
+    uint32_t height;
+};
+
+/**
+ * Describes an atlas to build.
+ */
+struct AtlasParameters {
+    std::vector<AtlasSprite> sprites;
+    uint32_t width;
+    uint32_t height;
+    // Only `trusted` and the limits are used, the sprites are always decoded as 8 bit RGBA.
+    DecodeOptions decodeOptions;
+    uint32_t compressionLevel;
+};
+
+/**
+ * Decodes every sprite straight into its slot of an 8 bit RGBA canvas and encodes the canvas into `output`.
+ * The sprites are decoded in parallel. Doesn't touch any JS values, so it can be called from worker threads.
+ * Returns `false` and sets `error` if a sprite could not be decoded or the atlas could not be encoded.
+ */
+bool buildAtlasPng(const AtlasParameters &parameters, std::vector<uint8_t> &output, std::string &error);
+
+NAN_METHOD(buildAtlas);
+
+NAN_MODULE_INIT(InitAtlas);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef BANDS_HPP
+#define BANDS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "scheduler.hpp"
+
+// Work on less bytes than this is done on the calling thread.
+static const size_t parallelThreshold = 4 * 1024 * 1024;
+// Every band processed by a thread spans at least this many rows.
+static const uint32_t minRowsPerBand = 64;
+
+/**
+ * Returns in how many bands `height` rows with a total of `bytes` bytes should be split.
+ */
+inline uint32_t bandCount(uint32_t height, size_t bytes) {
+    if (bytes < parallelThreshold) {
+        return 1;
+    }
+    return std::max(1u, std::min(poolSize(), height / minRowsPerBand));
+}
+
+/**
+ * Splits the `height` rows starting at row `first` into bands and calls `work(firstRow, endRow, partial)` once
+ * per band. The bands are spread over the scheduler's pool by `forEachInJob` if `bytes`, the amount of data touched,
+ * is large enough.
+ * Each band accumulates into its own copy of `initial`. Returns the partial results in the order of the bands.
+ */
+template<typename Partial, typename Work>
+std::vector<Partial> inBands(uint32_t first, uint32_t height, size_t bytes, const Partial &initial, Work work) {
+    const auto bands = bandCount(height, bytes);
+    std::vector<Partial> partials(bands, initial);
+    if (bands == 1) {
+        work(first, first + height, partials[0]);
+        return partials;
+    }
+    forEachInJob(bands, true, [&] (uint32_t band) {
+        const auto bandFirst = first + static_cast<uint32_t>(static_cast<uint64_t>(height) * band / bands);
+        const auto bandEnd = first + static_cast<uint32_t>(static_cast<uint64_t>(height) * (band + 1) / bands);
+        work(bandFirst, bandEnd, partials[band]);
+    });
+    return partials;
+}
+
+#endif
@@ -0,0 +1,210 @@
+#include <png.h>
+#include <zlib.h>
+#include <node_buffer.h>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "chunks.hpp"
+
+using namespace node;
+using namespace v8;
+using namespace std;
+
+bool splitChunks(const uint8_t *input, size_t inputSize, vector<ChunkSpan> &chunks, string &error) {
+    if (inputSize < 8 || png_sig_cmp(input, 0, 8)) {
+        error = "Invalid PNG buffer.";
+        return false;
+    }
+    size_t offset = 8;
+    while (offset + 8 <= inputSize) {
+        const auto length = readUint32(input + offset);
+        // The PNG specification limits the length of a chunk to 2^31 - 1 bytes.
+        if (length > PNG_UINT_31_MAX || chunkSize(length) > inputSize - offset) {
+            error = "Chunk at offset " + to_string(offset) + " exceeds the end of the buffer.";
+            return false;
+        }
+        chunks.push_back({ offset, length, string(reinterpret_cast<const char*>(input) + offset + 4, 4) });
+        offset += chunkSize(length);
+        if (chunks.back().type == "IEND") {
+            return true;
+        }
+    }
+    error = "Missing IEND chunk.";
+    return false;
+}
+
+void writeChunk(uint8_t *target, const string &type, const uint8_t *data, uint32_t length) {
+    writeUint32(target, length);
+    memcpy(target + 4, type.data(), 4);
+    if (length > 0) {
+        memcpy(target + 8, data, length);
+    }
+    // The CRC covers the type and the data, but not the length.
+    writeUint32(target + 8 + length, static_cast<uint32_t>(crc32(0, target + 4, length + 4)));
+}
+
+NAN_METHOD(readChunks) {
+    // 1st Parameter: The buffer with the encoded PNG image.
+    auto *input = reinterpret_cast<uint8_t*>(Buffer::Data(info[0]));
+    const auto inputSize = Buffer::Length(info[0]);
+    vector<ChunkSpan> chunks;
+    string error;
+    if (!splitChunks(input, inputSize, chunks, error)) {
+        Nan::ThrowError(error.c_str());
+        return;
+    }
+    // Only the location of every chunk is returned, the data is sliced from the input on the JS side.
+    Local<Array> result = Nan::New<Array>(chunks.size());
+    for (uint32_t index = 0; index < chunks.size(); ++index) {
+        const auto &chunk = chunks[index];
+        Local<Object> entry = Nan::New<Object>();
+        Nan::Set(entry, Nan::New("type").ToLocalChecked(), Nan::New(chunk.type).ToLocalChecked());
+        Nan::Set(entry, Nan::New("offset").ToLocalChecked(), Nan::New(static_cast<double>(chunk.offset)));
+        Nan::Set(entry, Nan::New("length").ToLocalChecked(), Nan::New(static_cast<double>(chunk.length)));
+        Nan::Set(result, index, entry);
+    }
+    info.GetReturnValue().Set(result);
+}
+
+/**
+ * A chunk which should be written into the image.
+ */
+struct NewChunk {
+    string type;
+    const uint8_t *data;
+    uint32_t length;
+    // Whether the chunk has already been placed in the output.
+    bool placed;
+};
+
+/**
+ * Reads an array of `{ type, data }` objects as passed from the JS side.
+ */
+static vector<NewChunk> parseNewChunks(Local<Value> value) {
+    Local<Array> array = Local<Array>::Cast(value);
+    vector<NewChunk> chunks;
+    for (uint32_t index = 0; index < array->Length(); ++index) {
+        Local<Object> entry = Nan::To<Object>(Nan::Get(array, index).ToLocalChecked()).ToLocalChecked();
+        Local<Value> data = Nan::Get(entry, Nan::New("data").ToLocalChecked()).ToLocalChecked();
+        chunks.push_back({
+            *Nan::Utf8String(Nan::Get(entry, Nan::New("type").ToLocalChecked()).ToLocalChecked()),
+            reinterpret_cast<uint8_t*>(Buffer::Data(data)),
+            static_cast<uint32_t>(Buffer::Length(data)),
+            false,
+        });
+    }
+    return chunks;
+}
+
+/**
+ * Chunks which the PNG specification requires to appear before `PLTE`. All other chunks are added right before
+ * the first `IDAT`, which is valid for every ancillary chunk.
+ */
+static bool belongsBeforePalette(const string &type) {
+    static const set<string> types = { "cHRM", "gAMA", "iCCP", "sBIT", "sRGB" };
+    return types.count(type) > 0;
+}
+
+/**
+ * A part of the rewritten image: Either a chunk copied verbatim from the input or a new chunk.
+ */
+struct Piece {
+    const uint8_t *source;
+    size_t length;
+    const NewChunk *chunk;
+};
+
+NAN_METHOD(rewriteChunks) {
+    // 1st Parameter: The buffer with the encoded PNG image.
+    auto *input = reinterpret_cast<uint8_t*>(Buffer::Data(info[0]));
+    const auto inputSize = Buffer::Length(info[0]);
+    // 2nd Parameter: The types of the chunks to remove.
+    Local<Array> removeArray = Local<Array>::Cast(info[1]);
+    set<string> remove;
+    for (uint32_t index = 0; index < removeArray->Length(); ++index) {
+        remove.insert(*Nan::Utf8String(Nan::Get(removeArray, index).ToLocalChecked()));
+    }
+    // 3rd Parameter: The chunks replacing all existing chunks of the same type.
+    auto replace = parseNewChunks(info[2]);
+    // 4th Parameter: The chunks to add.
+    auto add = parseNewChunks(info[3]);
+
+    vector<ChunkSpan> chunks;
+    string error;
+    if (!splitChunks(input, inputSize, chunks, error)) {
+        Nan::ThrowError(error.c_str());
+        return;
+    }
+    map<string, NewChunk*> replacements;
+    for (auto &chunk : replace) {
+        replacements[chunk.type] = &chunk;
+    }
+    // Replacements for chunks which are kept are placed where the first of them is, even if that is after `IDAT`.
+    set<string> kept;
+    for (const auto &chunk : chunks) {
+        if (remove.count(chunk.type) == 0) {
+            kept.insert(chunk.type);
+        }
+    }
+
+    // Plan the output first, so it can be written into a buffer of the exact size.
+    vector<Piece> pieces;
+    pieces.push_back({ input, 8, nullptr });
+    const auto placePending = [&] (bool beforePalette) {
+        for (auto *pending : { &replace, &add }) {
+            for (auto &chunk : *pending) {
+                const bool inPlace = pending == &replace && kept.count(chunk.type) > 0;
+                if (!chunk.placed && !inPlace && (!beforePalette || belongsBeforePalette(chunk.type))) {
+                    pieces.push_back({ nullptr, 0, &chunk });
+                    chunk.placed = true;
+                }
+            }
+        }
+    };
+    for (const auto &chunk : chunks) {
+        if (chunk.type == "PLTE") {
+            placePending(true);
+        } else if (chunk.type == "IDAT" || chunk.type == "IEND") {
+            placePending(false);
+        }
+        if (remove.count(chunk.type) > 0) {
+            continue;
+        }
+        // The first chunk of a replaced type is replaced in place, all others are dropped.
+        const auto replacement = replacements.find(chunk.type);
+        if (replacement != replacements.end()) {
+            if (!replacement->second->placed) {
+                pieces.push_back({ nullptr, 0, replacement->second });
+                replacement->second->placed = true;
+            }
+            continue;
+        }
+        // Unchanged chunks, including all image data, are copied with their original CRC.
+        pieces.push_back({ input + chunk.offset, chunkSize(chunk.length), nullptr });
+    }
+
+    size_t outputSize = 0;
+    for (const auto &piece : pieces) {
+        outputSize += piece.chunk ? chunkSize(piece.chunk->length) : piece.length;
+    }
+    Local<Object> outputBuffer = Nan::NewBuffer(outputSize).ToLocalChecked();
+    auto *output = reinterpret_cast<uint8_t*>(Buffer::Data(outputBuffer));
+    for (const auto &piece : pieces) {
+        if (piece.chunk) {
+            writeChunk(output, piece.chunk->type, piece.chunk->data, piece.chunk->length);
+            output += chunkSize(piece.chunk->length);
+        } else {
+            memcpy(output, piece.source, piece.length);
+            output += piece.length;
+        }
+    }
+    info.GetReturnValue().Set(outputBuffer);
+}
+
+NAN_MODULE_INIT(InitChunks) {
+    Nan::Set(target, Nan::New("__native_readChunks").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(readChunks)).ToLocalChecked());
+    Nan::Set(target, Nan::New("__native_rewriteChunks").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(rewriteChunks)).ToLocalChecked());
+}
@@ -0,0 +1,64 @@
+#ifndef CHUNKS_HPP
+#define CHUNKS_HPP
+
+#include <nan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * The location of a chunk inside an encoded PNG image.
+ */
+struct ChunkSpan {
+    // The offset of the chunk's length field.
+    size_t offset;
+    // The length of the chunk's data, without the length, type and CRC fields.
+    uint32_t length;
+    std::string type;
+};
+
+/**
+ * The size of a chunk including its length, type and CRC fields.
+ */
+inline size_t chunkSize(uint32_t length) {
+    return static_cast<size_t>(length) + 12;
+}
+
+/**
+ * Reads a big endian 32 bit integer, as used by the length field of chunks and within many chunks.
+ */
+inline uint32_t readUint32(const uint8_t *source) {
+    return (static_cast<uint32_t>(source[0]) << 24) | (static_cast<uint32_t>(source[1]) << 16) |
+        (static_cast<uint32_t>(source[2]) << 8) | static_cast<uint32_t>(source[3]);
+}
+
+/**
+ * Writes a big endian 32 bit integer.
+ */
+inline void writeUint32(uint8_t *target, uint32_t value) {
+    target[0] = static_cast<uint8_t>(value >> 24);
+    target[1] = static_cast<uint8_t>(value >> 16);
+    target[2] = static_cast<uint8_t>(value >> 8);
+    target[3] = static_cast<uint8_t>(value);
+}
+
+/**
+ * Splits the PNG in `input` into its chunks, up to and including `IEND`. Checks the signature and
+ * the length of every chunk, but neither the CRCs nor the content of the chunks.
+ * Returns `false` and sets `error` if the image is malformed.
+ */
+bool splitChunks(const uint8_t *input, size_t inputSize, std::vector<ChunkSpan> &chunks, std::string &error);
+
+/**
+ * Writes a complete chunk with the given type and data to `target`, computing its CRC.
+ * `target` needs to provide `chunkSize(length)` bytes.
+ */
+void writeChunk(uint8_t *target, const std::string &type, const uint8_t *data, uint32_t length);
+
+NAN_METHOD(readChunks);
+
+NAN_METHOD(rewriteChunks);
+
+NAN_MODULE_INIT(InitChunks);
+
+#endif
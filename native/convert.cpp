@@ -0,0 +1,299 @@
+#include "convert.hpp"
+
+#include <cstring>
+
+using namespace std;
+
+bool parseColorType(const string &name, png_byte &colorType) {
+    if (name == "palette") { colorType = PNG_COLOR_TYPE_PALETTE; return true; }
+    if (name == "gray-scale") { colorType = PNG_COLOR_TYPE_GRAY; return true; }
+    if (name == "gray-scale-alpha") { colorType = PNG_COLOR_TYPE_GRAY_ALPHA; return true; }
+    if (name == "rgb") { colorType = PNG_COLOR_TYPE_RGB; return true; }
+    if (name == "rgba") { colorType = PNG_COLOR_TYPE_RGB_ALPHA; return true; }
+    return false;
+}
+
+uint32_t channelCount(png_byte colorType) {
+    switch (colorType) {
+        case PNG_COLOR_TYPE_GRAY_ALPHA: return 2;
+        case PNG_COLOR_TYPE_RGB: return 3;
+        case PNG_COLOR_TYPE_RGB_ALPHA: return 4;
+        default: return 1;
+    }
+}
+
+size_t rowBytesFor(const PixelFormat &format, uint32_t width) {
+    const size_t bits = static_cast<size_t>(width) * channelCount(format.colorType) * format.bitDepth;
+    return (bits + 7) / 8;
+}
+
+/**
+ * Reads the raw value of a single sample. `index` counts samples from the start of the row.
+ * The generic version handles samples of less than 8 bit.
+ */
+template<unsigned BitDepth>
+static inline uint32_t readSample(const uint8_t *row, size_t index) {
+    const auto bit = index * BitDepth;
+    const auto shift = 8 - BitDepth - (bit & 7);
+    return (row[bit >> 3] >> shift) & ((1u << BitDepth) - 1);
+}
+
+template<>
+inline uint32_t readSample<8>(const uint8_t *row, size_t index) {
+    return row[index];
+}
+
+template<>
+inline uint32_t readSample<16>(const uint8_t *row, size_t index) {
+    return (static_cast<uint32_t>(row[index * 2]) << 8) | row[index * 2 + 1];
+}
+
+/**
+ * Writes the raw value of a single sample. `index` counts samples from the start of the row.
+ * The generic version handles samples of less than 8 bit.
+ */
+template<unsigned BitDepth>
+static inline void writeSample(uint8_t *row, size_t index, uint32_t value) {
+    const auto bit = index * BitDepth;
+    const auto shift = 8 - BitDepth - (bit & 7);
+    const auto mask = static_cast<uint8_t>(((1u << BitDepth) - 1) << shift);
+    row[bit >> 3] = static_cast<uint8_t>((row[bit >> 3] & ~mask) | ((value << shift) & mask));
+}
+
+template<>
+inline void writeSample<8>(uint8_t *row, size_t index, uint32_t value) {
+    row[index] = static_cast<uint8_t>(value);
+}
+
+template<>
+inline void writeSample<16>(uint8_t *row, size_t index, uint32_t value) {
+    row[index * 2] = static_cast<uint8_t>(value >> 8);
+    row[index * 2 + 1] = static_cast<uint8_t>(value);
+}
+
+template<unsigned BitDepth>
+static void unpackRow(const uint8_t *row, size_t first, size_t count, uint16_t *target) {
+    for (size_t i = 0; i < count; ++i) {
+        target[i] = static_cast<uint16_t>(readSample<BitDepth>(row, first + i));
+    }
+}
+
+void unpackSamples(const uint8_t *row, size_t first, size_t count, png_byte bitDepth, uint16_t *target) {
+    switch (bitDepth) {
+        case 1: unpackRow<1>(row, first, count, target); break;
+        case 2: unpackRow<2>(row, first, count, target); break;
+        case 4: unpackRow<4>(row, first, count, target); break;
+        case 8: unpackRow<8>(row, first, count, target); break;
+        case 16: unpackRow<16>(row, first, count, target); break;
+    }
+}
+
+// Luminance weights as used by libpng's `png_set_rgb_to_gray` defaults, scaled to 2^15.
+static inline uint32_t luminance(uint32_t r, uint32_t g, uint32_t b) {
+    return (6968 * r + 23434 * g + 2366 * b + 16384) >> 15;
+}
+
+template<typename Sample, unsigned SourceDepth>
+RowConverter::ConvertRow RowConverter::selectTargetDepth(png_byte targetDepth, bool indices) {
+    switch (targetDepth) {
+        case 1: return indices ? &RowConverter::copyIndices<SourceDepth, 1> : &RowConverter::convertRow<Sample, SourceDepth, 1>;
+        case 2: return indices ? &RowConverter::copyIndices<SourceDepth, 2> : &RowConverter::convertRow<Sample, SourceDepth, 2>;
+        case 4: return indices ? &RowConverter::copyIndices<SourceDepth, 4> : &RowConverter::convertRow<Sample, SourceDepth, 4>;
+        case 8: return indices ? &RowConverter::copyIndices<SourceDepth, 8> : &RowConverter::convertRow<Sample, SourceDepth, 8>;
+        case 16: return indices ? &RowConverter::copyIndices<SourceDepth, 16> : &RowConverter::convertRow<Sample, SourceDepth, 16>;
+        default: return nullptr;
+    }
+}
+
+template<typename Sample>
+RowConverter::ConvertRow RowConverter::selectSourceDepth(png_byte sourceDepth, png_byte targetDepth, bool indices) {
+    switch (sourceDepth) {
+        case 1: return selectTargetDepth<Sample, 1>(targetDepth, indices);
+        case 2: return selectTargetDepth<Sample, 2>(targetDepth, indices);
+        case 4: return selectTargetDepth<Sample, 4>(targetDepth, indices);
+        case 8: return selectTargetDepth<Sample, 8>(targetDepth, indices);
+        case 16: return selectTargetDepth<Sample, 16>(targetDepth, indices);
+        default: return nullptr;
+    }
+}
+
+RowConverter::RowConverter(const PixelFormat &source, const PixelFormat &target, const uint8_t *palette, size_t paletteSize) :
+    source(source),
+    target(target),
+    wide(source.bitDepth == 16 || target.bitDepth == 16) {
+    // Palette images can only be copied into palette images, which only requires repacking the indices.
+    const bool indices = target.colorType == PNG_COLOR_TYPE_PALETTE;
+    convertPixels = wide ?
+        selectSourceDepth<uint16_t>(source.bitDepth, target.bitDepth, indices) :
+        selectSourceDepth<uint8_t>(source.bitDepth, target.bitDepth, indices);
+    // Byte-aligned pixels in identical formats are copied as they are.
+    const bool sameFormat = source.colorType == target.colorType && source.bitDepth == target.bitDepth;
+    if (convertPixels && sameFormat && source.bitDepth >= 8) {
+        convertPixels = &RowConverter::copyPixels;
+    }
+    const uint32_t maximum = wide ? 65535 : 255;
+    // Rescale every possible raw value of a source with up to 8 bit per sample.
+    if (source.bitDepth <= 8) {
+        const uint32_t sourceMaximum = (1u << source.bitDepth) - 1;
+        scaleTable.resize(sourceMaximum + 1);
+        for (uint32_t value = 0; value <= sourceMaximum; ++value) {
+            scaleTable[value] = static_cast<uint16_t>(value * (maximum / sourceMaximum));
+        }
+    }
+    // Expand the palette into the intermediate format. Missing entries are opaque black.
+    if (source.colorType == PNG_COLOR_TYPE_PALETTE) {
+        paletteTable.assign(256 * 4, 0);
+        for (size_t index = 0; index < 256; ++index) {
+            paletteTable[index * 4 + 3] = maximum;
+        }
+        for (size_t index = 0; palette && index < paletteSize && index < 256; ++index) {
+            for (size_t channel = 0; channel < 4; ++channel) {
+                const uint32_t value = palette[index * 4 + channel];
+                paletteTable[index * 4 + channel] = static_cast<uint16_t>(wide ? value * 257 : value);
+            }
+        }
+    }
+}
+
+bool RowConverter::isSupported() const {
+    if (!convertPixels) {
+        return false;
+    }
+    if (target.colorType == PNG_COLOR_TYPE_PALETTE) {
+        return source.colorType == PNG_COLOR_TYPE_PALETTE;
+    }
+    // Only gray-scale images may have less than 8 bit per sample besides palette images.
+    return target.bitDepth >= 8 || target.colorType == PNG_COLOR_TYPE_GRAY;
+}
+
+template<typename Sample, unsigned SourceDepth>
+void RowConverter::expand(const uint8_t *row, uint32_t sourceX, uint32_t count, Sample *rgba) {
+    const Sample opaque = static_cast<Sample>(wide ? 65535 : 255);
+    // 16 bit sources are only expanded into 16 bit intermediate rows, so no rescaling is needed for them.
+    // Samples of 8 bit are rescaled arithmetically rather than through the table, which leaves the loops
+    // over byte-aligned samples free of lookups so the compiler can vectorize them.
+    const auto sample = [&] (size_t index) -> Sample {
+        const auto value = readSample<SourceDepth>(row, index);
+        if (SourceDepth == 16) { return static_cast<Sample>(value); }
+        if (SourceDepth == 8) { return static_cast<Sample>(sizeof(Sample) == 2 ? value * 257 : value); }
+        return static_cast<Sample>(scaleTable[value]);
+    };
+    switch (source.colorType) {
+        case PNG_COLOR_TYPE_PALETTE:
+            for (size_t i = 0; i < count; ++i) {
+                const auto *entry = &paletteTable[readSample<SourceDepth>(row, static_cast<size_t>(sourceX) + i) * 4];
+                rgba[i * 4] = static_cast<Sample>(entry[0]);
+                rgba[i * 4 + 1] = static_cast<Sample>(entry[1]);
+                rgba[i * 4 + 2] = static_cast<Sample>(entry[2]);
+                rgba[i * 4 + 3] = static_cast<Sample>(entry[3]);
+            }
+            break;
+        case PNG_COLOR_TYPE_GRAY:
+            for (size_t i = 0; i < count; ++i) {
+                const auto gray = sample(sourceX + i);
+                rgba[i * 4] = rgba[i * 4 + 1] = rgba[i * 4 + 2] = gray;
+                rgba[i * 4 + 3] = opaque;
+            }
+            break;
+        case PNG_COLOR_TYPE_GRAY_ALPHA:
+            for (size_t i = 0; i < count; ++i) {
+                const size_t index = (static_cast<size_t>(sourceX) + i) * 2;
+                const auto gray = sample(index);
+                rgba[i * 4] = rgba[i * 4 + 1] = rgba[i * 4 + 2] = gray;
+                rgba[i * 4 + 3] = sample(index + 1);
+            }
+            break;
+        case PNG_COLOR_TYPE_RGB:
+            for (size_t i = 0; i < count; ++i) {
+                const size_t index = (static_cast<size_t>(sourceX) + i) * 3;
+                rgba[i * 4] = sample(index);
+                rgba[i * 4 + 1] = sample(index + 1);
+                rgba[i * 4 + 2] = sample(index + 2);
+                rgba[i * 4 + 3] = opaque;
+            }
+            break;
+        case PNG_COLOR_TYPE_RGB_ALPHA:
+            for (size_t i = 0; i < static_cast<size_t>(count) * 4; ++i) {
+                rgba[i] = sample(static_cast<size_t>(sourceX) * 4 + i);
+            }
+            break;
+    }
+}
+
+template<typename Sample, unsigned TargetDepth>
+void RowConverter::pack(const Sample *rgba, uint8_t *row, uint32_t targetX, uint32_t count) {
+    // Reduce an intermediate sample to the target's bit depth. Going from 16 to 8 bit rounds like libpng's `PNG_DIV257`.
+    // Intermediate rows are 16 bit wide exactly if `Sample` is, so all of these conditions are resolved at compile time.
+    const auto scale = [] (uint32_t value) -> uint32_t {
+        if (sizeof(Sample) == 2) {
+            if (TargetDepth == 16) { return value; }
+            if (TargetDepth == 8) { return (value * 255 + 32895) >> 16; }
+            return value >> (TargetDepth < 16 ? 16 - TargetDepth : 0);
+        }
+        return TargetDepth == 8 ? value : value >> (TargetDepth < 8 ? 8 - TargetDepth : 0);
+    };
+    switch (target.colorType) {
+        case PNG_COLOR_TYPE_GRAY:
+            for (size_t i = 0; i < count; ++i) {
+                const auto gray = luminance(rgba[i * 4], rgba[i * 4 + 1], rgba[i * 4 + 2]);
+                writeSample<TargetDepth>(row, static_cast<size_t>(targetX) + i, scale(gray));
+            }
+            break;
+        case PNG_COLOR_TYPE_GRAY_ALPHA:
+            for (size_t i = 0; i < count; ++i) {
+                const size_t index = (static_cast<size_t>(targetX) + i) * 2;
+                writeSample<TargetDepth>(row, index, scale(luminance(rgba[i * 4], rgba[i * 4 + 1], rgba[i * 4 + 2])));
+                writeSample<TargetDepth>(row, index + 1, scale(rgba[i * 4 + 3]));
+            }
+            break;
+        case PNG_COLOR_TYPE_RGB:
+            for (size_t i = 0; i < count; ++i) {
+                const size_t index = (static_cast<size_t>(targetX) + i) * 3;
+                writeSample<TargetDepth>(row, index, scale(rgba[i * 4]));
+                writeSample<TargetDepth>(row, index + 1, scale(rgba[i * 4 + 1]));
+                writeSample<TargetDepth>(row, index + 2, scale(rgba[i * 4 + 2]));
+            }
+            break;
+        case PNG_COLOR_TYPE_RGB_ALPHA:
+            for (size_t i = 0; i < static_cast<size_t>(count) * 4; ++i) {
+                writeSample<TargetDepth>(row, static_cast<size_t>(targetX) * 4 + i, scale(rgba[i]));
+            }
+            break;
+    }
+}
+
+template<unsigned SourceDepth, unsigned TargetDepth>
+void RowConverter::copyIndices(const uint8_t *row, uint32_t sourceX, uint8_t *targetRow, uint32_t targetX, uint32_t count) {
+    const auto mask = (1u << TargetDepth) - 1;
+    for (size_t i = 0; i < count; ++i) {
+        const auto index = readSample<SourceDepth>(row, static_cast<size_t>(sourceX) + i);
+        writeSample<TargetDepth>(targetRow, static_cast<size_t>(targetX) + i, index & mask);
+    }
+}
+
+void RowConverter::copyPixels(const uint8_t *row, uint32_t sourceX, uint8_t *targetRow, uint32_t targetX, uint32_t count) {
+    const size_t pixelBytes = channelCount(source.colorType) * source.bitDepth / 8;
+    memcpy(targetRow + targetX * pixelBytes, row + sourceX * pixelBytes, count * pixelBytes);
+}
+
+template<>
+vector<uint8_t> &RowConverter::scratch<uint8_t>() {
+    return scratch8;
+}
+
+template<>
+vector<uint16_t> &RowConverter::scratch<uint16_t>() {
+    return scratch16;
+}
+
+template<typename Sample, unsigned SourceDepth, unsigned TargetDepth>
+void RowConverter::convertRow(const uint8_t *row, uint32_t sourceX, uint8_t *targetRow, uint32_t targetX, uint32_t count) {
+    auto &rgba = scratch<Sample>();
+    rgba.resize(static_cast<size_t>(count) * 4);
+    expand<Sample, SourceDepth>(row, sourceX, count, rgba.data());
+    pack<Sample, TargetDepth>(rgba.data(), targetRow, targetX, count);
+}
+
+void RowConverter::convert(const uint8_t *row, uint32_t sourceX, uint8_t *targetRow, uint32_t targetX, uint32_t count) {
+    (this->*convertPixels)(row, sourceX, targetRow, targetX, count);
+}
@@ -0,0 +1,99 @@
+#ifndef CONVERT_HPP
+#define CONVERT_HPP
+
+#include <png.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Describes the layout of a buffer of decoded pixels as produced by libpng:
+ * Rows are tightly packed, samples of 16 bit are stored in big-endian byte order and
+ * samples of less than 8 bit are packed with the leftmost pixel in the high-order bits.
+ */
+struct PixelFormat {
+    png_byte colorType;
+    png_byte bitDepth;
+};
+
+/**
+ * Converts a color type as used on the JS side (`"rgba"`, `"palette"`, ...) into libpng's enum.
+ * Returns `false` if the name is unknown.
+ */
+bool parseColorType(const std::string &name, png_byte &colorType);
+
+/**
+ * Returns the amount of samples per pixel for one of libpng's color types.
+ */
+uint32_t channelCount(png_byte colorType);
+
+/**
+ * Returns the amount of bytes a row of `width` pixels in the given format occupies.
+ */
+size_t rowBytesFor(const PixelFormat &format, uint32_t width);
+
+/**
+ * Reads `count` raw samples of any bit depth starting at sample `first` of `row` into `target`.
+ */
+void unpackSamples(const uint8_t *row, size_t first, size_t count, png_byte bitDepth, uint16_t *target);
+
+/**
+ * Converts runs of pixels from one format into another.
+ *
+ * Every source pixel is expanded into an intermediate RGBA row (8 bit per sample if neither format exceeds
+ * 8 bit and 16 bit otherwise) and then packed into the target format. Palette lookups and sample rescaling
+ * go through tables computed once in the constructor, samples of 8 and 16 bit are rescaled arithmetically.
+ * The routines reading and writing the samples are specialized for every bit depth and picked once in the
+ * constructor as well, so the loops over byte-aligned samples are branch-free and can be vectorized by the compiler.
+ * Byte-aligned pixels in identical formats are copied directly.
+ * An instance keeps a scratch row and must not be shared between threads.
+ */
+class RowConverter {
+    public:
+        /**
+         * `palette` points to `paletteSize` RGBA entries (4 bytes each) used when the source is a palette image.
+         * It may be `nullptr` otherwise.
+         */
+        RowConverter(const PixelFormat &source, const PixelFormat &target, const uint8_t *palette, size_t paletteSize);
+        /**
+         * Returns `false` if the conversion is not supported. Only palette images can be converted into palette images.
+         */
+        bool isSupported() const;
+        /**
+         * Converts `count` pixels starting at pixel `sourceX` of the row `source` into the row `target`, starting
+         * at pixel `targetX`.
+         */
+        void convert(const uint8_t *source, uint32_t sourceX, uint8_t *target, uint32_t targetX, uint32_t count);
+
+    private:
+        typedef void (RowConverter::*ConvertRow)(const uint8_t *source, uint32_t sourceX, uint8_t *target, uint32_t targetX, uint32_t count);
+
+        // Pick the routine for the bit depths of the source and the target, one template parameter at a time.
+        template<typename Sample> static ConvertRow selectSourceDepth(png_byte sourceDepth, png_byte targetDepth, bool indices);
+        template<typename Sample, unsigned SourceDepth> static ConvertRow selectTargetDepth(png_byte targetDepth, bool indices);
+
+        template<typename Sample, unsigned SourceDepth, unsigned TargetDepth>
+        void convertRow(const uint8_t *source, uint32_t sourceX, uint8_t *target, uint32_t targetX, uint32_t count);
+        template<typename Sample, unsigned SourceDepth> void expand(const uint8_t *source, uint32_t sourceX, uint32_t count, Sample *rgba);
+        template<typename Sample, unsigned TargetDepth> void pack(const Sample *rgba, uint8_t *target, uint32_t targetX, uint32_t count);
+        template<unsigned SourceDepth, unsigned TargetDepth>
+        void copyIndices(const uint8_t *source, uint32_t sourceX, uint8_t *target, uint32_t targetX, uint32_t count);
+        void copyPixels(const uint8_t *source, uint32_t sourceX, uint8_t *target, uint32_t targetX, uint32_t count);
+        template<typename Sample> std::vector<Sample> &scratch();
+
+        PixelFormat source;
+        PixelFormat target;
+        // The routine converting a run of pixels, chosen once for the formats in the constructor.
+        ConvertRow convertPixels;
+        // Whether the intermediate row uses 16 bit per sample.
+        bool wide;
+        // Maps raw sample values of sources with up to 8 bit to the intermediate sample width.
+        std::vector<uint16_t> scaleTable;
+        // RGBA entries of the palette in the intermediate sample width, 256 entries.
+        std::vector<uint16_t> paletteTable;
+        // Intermediate RGBA rows.
+        std::vector<uint8_t> scratch8;
+        std::vector<uint16_t> scratch16;
+};
+
+#endif
@@ -1,9 +1,11 @@
 #include <png.h>
 #include <node_buffer.h>
 #include <cstring>
+#include <string>
 #include <iostream>
 
 #include "is-png.hpp"
+#include "convert.hpp"
 
 using namespace node;
 using namespace v8;
@@ -37,15 +39,61 @@ NAN_METHOD(copy) {
     // 12th Parameter: The y offset for writing to the target buffer.
     const auto targetOffsetTop = static_cast<uint32_t>(Nan::To<uint32_t>(info[11]).ToChecked());
 
+    // 13th Parameter: The color type of the source image.
+    const std::string sourceColorTypeName = *Nan::Utf8String(info[12]);
+    // 14th Parameter: The bit depth of the source image.
+    const auto sourceBitDepth = static_cast<uint32_t>(Nan::To<uint32_t>(info[13]).ToChecked());
+    // 15th Parameter: The color type of the target image.
+    const std::string targetColorTypeName = *Nan::Utf8String(info[14]);
+    // 16th Parameter: The bit depth of the target image.
+    const auto targetBitDepth = static_cast<uint32_t>(Nan::To<uint32_t>(info[15]).ToChecked());
+    // 17th Parameter: An optional buffer with the RGBA entries of the source's palette.
+    const uint8_t *palette = nullptr;
+    size_t paletteSize = 0;
+    if (Buffer::HasInstance(info[16])) {
+        palette = reinterpret_cast<uint8_t*>(Buffer::Data(info[16]));
+        paletteSize = Buffer::Length(info[16]) / 4;
+    }
+
+    PixelFormat sourceFormat{ 0, static_cast<png_byte>(sourceBitDepth) };
+    PixelFormat targetFormat{ 0, static_cast<png_byte>(targetBitDepth) };
+    if (!parseColorType(sourceColorTypeName, sourceFormat.colorType) || !parseColorType(targetColorTypeName, targetFormat.colorType)) {
+        Nan::ThrowError("Unsupported color type.");
+        return;
+    }
+
     // Computed values.
-    const auto bytesPerPixel = sourceLength / (sourceWidth * sourceHeight);
-    const auto bytes = bytesPerPixel * sourceClipWidth;
+    const auto sourceRowBytes = rowBytesFor(sourceFormat, sourceWidth);
+    const auto targetRowBytes = rowBytesFor(targetFormat, targetWidth);
+    if (sourceLength < sourceRowBytes * sourceHeight) {
+        Nan::ThrowError("Width and height do not match buffer size.");
+        return;
+    }
+
+    // If both images share the same format, every row can be copied verbatim.
+    const auto sameFormat = sourceFormat.colorType == targetFormat.colorType && sourceBitDepth == targetBitDepth;
+    if (sameFormat && sourceBitDepth >= 8) {
+        const auto bytesPerPixel = rowBytesFor(sourceFormat, 1);
+        const auto bytes = bytesPerPixel * sourceClipWidth;
+        // Iterate over every row in the source image.
+        for (auto ySource = sourceOffsetTop; ySource < sourceOffsetTop + sourceClipHeight; ++ySource) {
+            const auto indexSource = ySource * sourceRowBytes + sourceOffsetLeft * bytesPerPixel;
+            const auto indexTarget = (targetOffsetTop + ySource - sourceOffsetTop) * targetRowBytes + targetOffsetLeft * bytesPerPixel;
+            std::memcpy(targetData + indexTarget, sourceData + indexSource, bytes);
+        }
+        return;
+    }
 
-    // Iterate over every row in the source image.
+    // Otherwise convert each row of the clipping rectangle into the target's format.
+    RowConverter converter(sourceFormat, targetFormat, palette, paletteSize);
+    if (!converter.isSupported()) {
+        Nan::ThrowError("Unsupported color type conversion.");
+        return;
+    }
     for (auto ySource = sourceOffsetTop; ySource < sourceOffsetTop + sourceClipHeight; ++ySource) {
-        const auto indexSource = (ySource * sourceClipWidth + sourceOffsetLeft) * bytesPerPixel;
-        const auto indexTarget = (((targetOffsetTop + ySource - sourceOffsetTop) * targetWidth) + targetOffsetLeft) * bytesPerPixel;
-        std::memcpy(targetData + indexTarget, sourceData + indexSource, bytes);
+        const auto *sourceRow = sourceData + ySource * sourceRowBytes;
+        auto *targetRow = targetData + (targetOffsetTop + ySource - sourceOffsetTop) * targetRowBytes;
+        converter.convert(sourceRow, sourceOffsetLeft, targetRow, targetOffsetLeft, sourceClipWidth);
     }
 }
 
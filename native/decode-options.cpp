@@ -0,0 +1,199 @@
+#include "decode-options.hpp"
+
+#include <string>
+
+using namespace v8;
+using namespace std;
+
+/**
+ * A libpng user transformation premultiplying the color samples of each decoded row with their alpha, in the
+ * gamma encoded space of the image. The alpha channel is the last sample of every pixel.
+ */
+static void premultiplyRow(png_structp pngPtr, png_row_infop rowInfo, png_bytep row) {
+    const uint32_t channels = rowInfo->channels;
+    if (rowInfo->bit_depth == 16) {
+        // 16 bit samples are stored in big-endian byte order.
+        for (png_uint_32 x = 0; x < rowInfo->width; ++x) {
+            auto *pixel = row + x * channels * 2;
+            const uint32_t alpha = (pixel[(channels - 1) * 2] << 8) | pixel[(channels - 1) * 2 + 1];
+            for (uint32_t channel = 0; channel < channels - 1; ++channel) {
+                const uint32_t sample = (pixel[channel * 2] << 8) | pixel[channel * 2 + 1];
+                const uint32_t premultiplied = (sample * alpha + 32767) / 65535;
+                pixel[channel * 2] = static_cast<png_byte>(premultiplied >> 8);
+                pixel[channel * 2 + 1] = static_cast<png_byte>(premultiplied & 0xff);
+            }
+        }
+        return;
+    }
+    for (png_uint_32 x = 0; x < rowInfo->width; ++x) {
+        auto *pixel = row + x * channels;
+        const uint32_t alpha = pixel[channels - 1];
+        for (uint32_t channel = 0; channel < channels - 1; ++channel) {
+            pixel[channel] = static_cast<png_byte>((pixel[channel] * alpha + 127) / 255);
+        }
+    }
+}
+
+/**
+ * Reads a single limit from the `limits` object. `undefined` results in `0`.
+ */
+static double readLimit(Local<Object> limits, const char *name) {
+    auto value = Nan::Get(limits, Nan::New(name).ToLocalChecked()).ToLocalChecked();
+    return value->IsUndefined() ? 0 : Nan::To<double>(value).FromMaybe(0);
+}
+
+bool parseDecodeOptions(Local<Value> value, DecodeOptions &options) {
+    if (!value->IsObject()) {
+        return true;
+    }
+    auto object = Nan::To<Object>(value).ToLocalChecked();
+    auto output = Nan::Get(object, Nan::New("output").ToLocalChecked()).ToLocalChecked();
+    if (!output->IsUndefined()) {
+        const string name = *Nan::Utf8String(output);
+        if (name == "native") {
+            options.output = DecodeOutput::NATIVE;
+        } else if (name == "rgba8") {
+            options.output = DecodeOutput::RGBA8;
+        } else if (name == "rgb8") {
+            options.output = DecodeOutput::RGB8;
+        } else if (name == "gray8") {
+            options.output = DecodeOutput::GRAY8;
+        } else {
+            Nan::ThrowError("Unsupported output format.");
+            return false;
+        }
+    }
+    options.premultiplied = Nan::To<bool>(Nan::Get(object, Nan::New("premultiplied").ToLocalChecked()).ToLocalChecked()).FromMaybe(false);
+    options.linear = Nan::To<bool>(Nan::Get(object, Nan::New("linear").ToLocalChecked()).ToLocalChecked()).FromMaybe(false);
+    options.trusted = Nan::To<bool>(Nan::Get(object, Nan::New("trusted").ToLocalChecked()).ToLocalChecked()).FromMaybe(false);
+    auto limitsValue = Nan::Get(object, Nan::New("limits").ToLocalChecked()).ToLocalChecked();
+    if (limitsValue->IsObject()) {
+        auto limits = Nan::To<Object>(limitsValue).ToLocalChecked();
+        const double dimensions[] = { readLimit(limits, "maxWidth"), readLimit(limits, "maxHeight") };
+        const double chunks[] = { readLimit(limits, "maxChunks"), readLimit(limits, "maxChunkBytes") };
+        // libpng can't represent dimensions beyond 2^31 - 1 and counts chunks and their bytes in 32 bit.
+        if (dimensions[0] < 0 || dimensions[1] < 0 || dimensions[0] > PNG_UINT_31_MAX || dimensions[1] > PNG_UINT_31_MAX) {
+            Nan::ThrowError("Unsupported dimension limit.");
+            return false;
+        }
+        if (chunks[0] < 0 || chunks[1] < 0 || chunks[0] > UINT32_MAX || chunks[1] > UINT32_MAX) {
+            Nan::ThrowError("Unsupported chunk limit.");
+            return false;
+        }
+        options.maxWidth = static_cast<uint32_t>(dimensions[0]);
+        options.maxHeight = static_cast<uint32_t>(dimensions[1]);
+        options.maxChunks = static_cast<uint32_t>(chunks[0]);
+        options.maxChunkBytes = static_cast<uint32_t>(chunks[1]);
+        options.maxDecodedBytes = readLimit(limits, "maxDecodedBytes");
+    }
+    return true;
+}
+
+void applyReadPolicy(png_structp pngPtr, const DecodeOptions &options) {
+    if (options.trusted) {
+        // Use the data of chunks with a broken CRC without warning and don't compute the adler32 checksum of the
+        // compressed image data at all. libpng still needs to compute the CRCs of critical chunks, but discards them.
+        png_set_crc_action(pngPtr, PNG_CRC_QUIET_USE, PNG_CRC_QUIET_USE);
+        png_set_option(pngPtr, PNG_IGNORE_ADLER32, PNG_OPTION_ON);
+    }
+    // The dimensions are checked by libpng when reading the `IHDR` chunk, before any image data is inflated.
+    if (options.maxWidth != 0 || options.maxHeight != 0) {
+        png_set_user_limits(
+            pngPtr,
+            options.maxWidth != 0 ? options.maxWidth : PNG_USER_WIDTH_MAX,
+            options.maxHeight != 0 ? options.maxHeight : PNG_USER_HEIGHT_MAX
+        );
+    }
+    if (options.maxChunks != 0) {
+        png_set_chunk_cache_max(pngPtr, options.maxChunks);
+    }
+    if (options.maxChunkBytes != 0) {
+        png_set_chunk_malloc_max(pngPtr, options.maxChunkBytes);
+    }
+}
+
+void checkDecodedSize(png_structp pngPtr, png_infop infoPtr, const DecodeOptions &options) {
+    if (options.maxDecodedBytes == 0) {
+        return;
+    }
+    const double decodedSize = static_cast<double>(png_get_rowbytes(pngPtr, infoPtr)) * png_get_image_height(pngPtr, infoPtr);
+    if (decodedSize > options.maxDecodedBytes) {
+        png_error(pngPtr, "Decoded image exceeds size limit.");
+    }
+}
+
+void applyDecodeOptions(png_structp pngPtr, png_infop infoPtr, const DecodeOptions &options) {
+    const auto colorType = png_get_color_type(pngPtr, infoPtr);
+    const auto bitDepth = png_get_bit_depth(pngPtr, infoPtr);
+    const bool hasAlphaChannel = (colorType & PNG_COLOR_MASK_ALPHA) != 0;
+    const bool hasTransparency = png_get_valid(pngPtr, infoPtr, PNG_INFO_tRNS) != 0;
+    if (options.output != DecodeOutput::NATIVE) {
+        // Every normalized output has 8 bit per sample: Expand palettes and packed gray-scale samples
+        // and scale 16 bit samples down.
+        if (colorType == PNG_COLOR_TYPE_PALETTE) {
+            png_set_palette_to_rgb(pngPtr);
+        }
+        if (colorType == PNG_COLOR_TYPE_GRAY && bitDepth < 8) {
+            png_set_expand_gray_1_2_4_to_8(pngPtr);
+        }
+        if (bitDepth == 16) {
+            png_set_scale_16(pngPtr);
+        }
+    }
+    switch (options.output) {
+        case DecodeOutput::NATIVE:
+            break;
+        case DecodeOutput::RGBA8:
+            if (!(colorType & PNG_COLOR_MASK_COLOR)) {
+                png_set_gray_to_rgb(pngPtr);
+            }
+            // Use the `tRNS` chunk as alpha channel if present and add an opaque alpha channel otherwise.
+            if (hasTransparency) {
+                png_set_tRNS_to_alpha(pngPtr);
+            } else if (!hasAlphaChannel) {
+                png_set_add_alpha(pngPtr, 0xff, PNG_FILLER_AFTER);
+            }
+            break;
+        case DecodeOutput::RGB8:
+            if (!(colorType & PNG_COLOR_MASK_COLOR)) {
+                png_set_gray_to_rgb(pngPtr);
+            }
+            // Expanding a palette also turns its `tRNS` chunk into an alpha channel, which is dropped as well.
+            if (hasAlphaChannel || hasTransparency) {
+                png_set_strip_alpha(pngPtr);
+            }
+            break;
+        case DecodeOutput::GRAY8:
+            // Palette images have been expanded to RGB above and need to be reduced as well.
+            if (colorType & PNG_COLOR_MASK_COLOR) {
+                png_set_rgb_to_gray_fixed(pngPtr, PNG_ERROR_ACTION_NONE, -1, -1);
+            }
+            if (hasAlphaChannel || hasTransparency) {
+                png_set_strip_alpha(pngPtr);
+            }
+            break;
+    }
+    // Images decoded without an alpha channel are never premultiplied.
+    const bool outputAlpha = options.output == DecodeOutput::RGBA8 ||
+        (options.output == DecodeOutput::NATIVE && hasAlphaChannel);
+    const bool premultiplied = options.premultiplied && outputAlpha;
+    if (options.linear) {
+        // Linearization and premultiplication in linear light are done by libpng's gamma and alpha mode
+        // transformations, which compute their lookup tables once and apply them to each row.
+        png_set_alpha_mode(pngPtr, premultiplied ? PNG_ALPHA_STANDARD : PNG_ALPHA_PNG, PNG_GAMMA_LINEAR);
+        // Images without `gAMA` chunk are assumed to be sRGB encoded instead of already being linear.
+        double fileGamma;
+        if (png_get_gAMA(pngPtr, infoPtr, &fileGamma) == 0) {
+            fileGamma = PNG_DEFAULT_sRGB;
+        }
+        png_set_gamma(pngPtr, PNG_GAMMA_LINEAR, fileGamma);
+    } else if (premultiplied) {
+        // Without linearization the samples are premultiplied in the image's own gamma encoded space as expected by
+        // most compositors. libpng's alpha mode transformation would convert them into linear light and back into
+        // another gamma, so they would no longer match the gamma kept in the metadata.
+        png_set_read_user_transform_fn(pngPtr, premultiplyRow);
+    }
+    // Let libpng take care of combining the passes of interlaced images.
+    png_set_interlace_handling(pngPtr);
+    png_read_update_info(pngPtr, infoPtr);
+}
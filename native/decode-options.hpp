@@ -0,0 +1,65 @@
+#ifndef DECODE_OPTIONS_HPP
+#define DECODE_OPTIONS_HPP
+
+#include <nan.h>
+#include <png.h>
+
+/**
+ * The pixel format the decoder should normalize the image into.
+ */
+enum class DecodeOutput {
+    // Keep the image's own color type and bit depth.
+    NATIVE,
+    // 8 bit RGBA.
+    RGBA8,
+    // 8 bit RGB.
+    RGB8,
+    // 8 bit gray-scale.
+    GRAY8,
+};
+
+/**
+ * Options used when decoding a PNG image, as passed from the JS side.
+ */
+struct DecodeOptions {
+    DecodeOutput output = DecodeOutput::NATIVE;
+    // Multiply the color samples with the alpha channel.
+    bool premultiplied = false;
+    // Convert the color samples into linear light, using the image's gamma or sRGB if none is specified.
+    bool linear = false;
+    // Skip verifying the CRCs of all chunks and the adler32 checksum of the image data.
+    bool trusted = false;
+    // Resource limits for untrusted input. `0` keeps libpng's defaults.
+    uint32_t maxWidth = 0;
+    uint32_t maxHeight = 0;
+    uint32_t maxChunks = 0;
+    uint32_t maxChunkBytes = 0;
+    // The maximum size of the decoded image in bytes. `0` disables the limit.
+    double maxDecodedBytes = 0;
+};
+
+/**
+ * Reads the options from a JS object. `undefined` results in the defaults.
+ * Throws a JS error and returns `false` if the options are invalid.
+ */
+bool parseDecodeOptions(v8::Local<v8::Value> value, DecodeOptions &options);
+
+/**
+ * Configures checksum verification and resource limits according to the options. Needs to be called before
+ * `png_read_info`, so images exceeding the limits are rejected while reading the header.
+ */
+void applyReadPolicy(png_structp pngPtr, const DecodeOptions &options);
+
+/**
+ * Raises a libpng error if the transformed image would exceed the decoded size limit of the options.
+ * Needs to be called after `applyDecodeOptions` and before allocating the decoded image.
+ */
+void checkDecodedSize(png_structp pngPtr, png_infop infoPtr, const DecodeOptions &options);
+
+/**
+ * Configures libpng's read transformations according to the options. Needs to be called after `png_read_info`.
+ * Calls `png_read_update_info`, so the info struct will describe the transformed image afterwards.
+ */
+void applyDecodeOptions(png_structp pngPtr, png_infop infoPtr, const DecodeOptions &options);
+
+#endif
@@ -0,0 +1,177 @@
+#include <png.h>
+#include <node_buffer.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "decode-tensor.hpp"
+#include "decode-options.hpp"
+#include "png-reader.hpp"
+
+using namespace node;
+using namespace v8;
+using namespace std;
+
+/**
+ * Describes how the decoded samples are laid out and normalized in the tensor.
+ */
+struct TensorFormat {
+    // `true` for NCHW (one plane per channel) and `false` for NHWC (interleaved channels).
+    bool planar;
+    // `true` for float32 samples and `false` for uint8 samples.
+    bool floating;
+    // The amount of channels per pixel (1, 3 or 4).
+    uint32_t channels;
+    // For float32 tensors: One table of 256 entries per channel mapping each 8 bit sample to its normalized value.
+    vector<float> tables;
+};
+
+/**
+ * Writes one decoded row of interleaved 8 bit samples into the tensor of a single image.
+ */
+static void writeTensorRow(const TensorFormat &format, const png_byte *row, uint32_t y, uint32_t width, uint32_t height, uint8_t *image) {
+    const auto channels = format.channels;
+    const size_t pixelsBefore = static_cast<size_t>(y) * width;
+    if (!format.floating && !format.planar) {
+        memcpy(image + pixelsBefore * channels, row, static_cast<size_t>(width) * channels);
+        return;
+    }
+    for (uint32_t channel = 0; channel < channels; ++channel) {
+        // In planar layout each channel is a contiguous plane, otherwise channels are interleaved.
+        const size_t start = format.planar ? channel * static_cast<size_t>(height) * width + pixelsBefore : pixelsBefore * channels + channel;
+        const size_t stride = format.planar ? 1 : channels;
+        if (format.floating) {
+            const float *table = &format.tables[channel * 256];
+            auto *target = reinterpret_cast<float*>(image) + start;
+            for (uint32_t x = 0; x < width; ++x) {
+                target[x * stride] = table[row[x * channels + channel]];
+            }
+        } else {
+            auto *target = image + start;
+            for (uint32_t x = 0; x < width; ++x) {
+                target[x * stride] = row[x * channels + channel];
+            }
+        }
+    }
+}
+
+/**
+ * Decodes the PNG in `input` as image number `index` of `count` images into the tensor.
+ * The tensor is allocated when decoding the first image, as its dimensions are only known then.
+ * All subsequent images need to have the same dimensions.
+ * Returns `false` and sets `error` if the image could not be decoded.
+ */
+static bool decodeIntoTensor(
+    uint8_t *input,
+    uint32_t inputSize,
+    const TensorFormat &format,
+    uint32_t index,
+    uint32_t count,
+    uint32_t &width,
+    uint32_t &height,
+    uint8_t *&tensor,
+    string &error
+) {
+    uint8_t *image = nullptr;
+    const auto configure = [&](png_structp pngPtr, png_infop infoPtr) {
+        // Let libpng normalize every image into 8 bit samples with the requested amount of channels.
+        DecodeOptions options;
+        options.output = format.channels == 1 ? DecodeOutput::GRAY8 : format.channels == 3 ? DecodeOutput::RGB8 : DecodeOutput::RGBA8;
+        applyDecodeOptions(pngPtr, infoPtr, options);
+        // The rows are copied assuming this layout, so a mismatch would produce a shifted tensor.
+        if (png_get_channels(pngPtr, infoPtr) != format.channels) {
+            png_error(pngPtr, "Image could not be converted into the requested amount of channels.");
+        }
+
+        const auto imageWidth = png_get_image_width(pngPtr, infoPtr);
+        const auto imageHeight = png_get_image_height(pngPtr, infoPtr);
+        const size_t bytesPerImage = static_cast<size_t>(imageWidth) * imageHeight * format.channels * (format.floating ? sizeof(float) : 1);
+        if (index == 0) {
+            width = imageWidth;
+            height = imageHeight;
+            tensor = new uint8_t[bytesPerImage * count];
+        } else if (imageWidth != width || imageHeight != height) {
+            png_error(pngPtr, "All images in a batch need to have the same dimensions.");
+        }
+        image = tensor + bytesPerImage * index;
+    };
+    // Convert every row right after libpng decoded it.
+    const auto visit = [&](const png_byte *row, uint32_t y, uint32_t imageWidth, uint32_t imageHeight) {
+        writeTensorRow(format, row, y, imageWidth, imageHeight, image);
+    };
+    return readRows(input, inputSize, configure, visit, error);
+}
+
+NAN_METHOD(decodeTensor) {
+    // 1st Parameter: An array of buffers with the PNG images to decode.
+    Local<Array> inputs = Local<Array>::Cast(info[0]);
+    // 2nd Parameter: Whether to use the planar NCHW layout instead of NHWC.
+    const auto planar = static_cast<bool>(Nan::To<bool>(info[1]).ToChecked());
+    // 3rd Parameter: Whether to produce float32 instead of uint8 samples.
+    const auto floating = static_cast<bool>(Nan::To<bool>(info[2]).ToChecked());
+    // 4th Parameter: The amount of channels (1, 3 or 4).
+    const auto channels = static_cast<uint32_t>(Nan::To<uint32_t>(info[3]).ToChecked());
+    // 5th Parameter: The mean per channel.
+    Local<Array> mean = Local<Array>::Cast(info[4]);
+    // 6th Parameter: The standard deviation per channel.
+    Local<Array> deviation = Local<Array>::Cast(info[5]);
+
+    if (channels != 1 && channels != 3 && channels != 4) {
+        Nan::ThrowError("Unsupported amount of channels.");
+        return;
+    }
+    if (mean->Length() != channels || deviation->Length() != channels) {
+        Nan::ThrowError("Mean and standard deviation need to be specified for every channel.");
+        return;
+    }
+    if (inputs->Length() == 0) {
+        Nan::ThrowError("At least one image needs to be specified.");
+        return;
+    }
+
+    // Precompute `(sample / 255 - mean) / std` for every possible sample of every channel.
+    TensorFormat format{ planar, floating, channels, {} };
+    if (floating) {
+        format.tables.resize(channels * 256);
+        for (uint32_t channel = 0; channel < channels; ++channel) {
+            const auto channelMean = Nan::To<double>(Nan::Get(mean, channel).ToLocalChecked()).ToChecked();
+            const auto channelDeviation = Nan::To<double>(Nan::Get(deviation, channel).ToLocalChecked()).ToChecked();
+            for (uint32_t sample = 0; sample < 256; ++sample) {
+                format.tables[channel * 256 + sample] = static_cast<float>((sample / 255.0 - channelMean) / channelDeviation);
+            }
+        }
+    }
+
+    const auto count = inputs->Length();
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint8_t *tensor = nullptr;
+    string error;
+    for (uint32_t index = 0; index < count; ++index) {
+        Local<Value> inputBuffer = Nan::Get(inputs, index).ToLocalChecked();
+        if (!Buffer::HasInstance(inputBuffer)) {
+            delete[] tensor;
+            Nan::ThrowError("Input is not a buffer.");
+            return;
+        }
+        auto *input = reinterpret_cast<uint8_t*>(Buffer::Data(inputBuffer));
+        const auto inputSize = static_cast<uint32_t>(Buffer::Length(inputBuffer));
+        if (!decodeIntoTensor(input, inputSize, format, index, count, width, height, tensor, error)) {
+            delete[] tensor;
+            Nan::ThrowError(error.c_str());
+            return;
+        }
+    }
+
+    const size_t length = static_cast<size_t>(width) * height * channels * count * (floating ? sizeof(float) : 1);
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result, Nan::New("data").ToLocalChecked(), Nan::NewBuffer(reinterpret_cast<char*>(tensor), length).ToLocalChecked());
+    Nan::Set(result, Nan::New("width").ToLocalChecked(), Nan::New(static_cast<double>(width)));
+    Nan::Set(result, Nan::New("height").ToLocalChecked(), Nan::New(static_cast<double>(height)));
+    info.GetReturnValue().Set(result);
+}
+
+NAN_MODULE_INIT(InitDecodeTensor) {
+    Nan::Set(target, Nan::New("__native_decodeTensor").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(decodeTensor)).ToLocalChecked());
+}
@@ -0,0 +1,10 @@
+#ifndef DECODE_TENSOR_HPP
+#define DECODE_TENSOR_HPP
+
+#include <nan.h>
+
+NAN_METHOD(decodeTensor);
+
+NAN_MODULE_INIT(InitDecodeTensor);
+
+#endif
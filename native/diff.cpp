@@ -0,0 +1,373 @@
+#include <png.h>
+#include <node_buffer.h>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "diff.hpp"
+#include "convert.hpp"
+#include "bands.hpp"
+
+using namespace node;
+using namespace v8;
+using namespace std;
+
+/**
+ * One of the two decoded images which are compared.
+ */
+struct DiffImage {
+    const uint8_t *data;
+    PixelFormat format;
+    size_t rowBytes;
+    // The RGBA entries of the palette if the image is a palette image.
+    const uint8_t *palette;
+    size_t paletteSize;
+};
+
+/**
+ * Provides rows of an image converted to 8 bit RGBA. Keeps the last five rows, which is enough for
+ * the neighbourhood examined by the anti-aliasing detection. Images already in 8 bit RGBA are not copied.
+ * An instance must not be shared between threads.
+ */
+class RgbaRows {
+    public:
+        static const uint32_t slots = 5;
+
+        RgbaRows(const DiffImage &image, uint32_t width) :
+            image(image),
+            width(width),
+            converter(image.format, PixelFormat{ PNG_COLOR_TYPE_RGB_ALPHA, 8 }, image.palette, image.paletteSize),
+            direct(image.format.colorType == PNG_COLOR_TYPE_RGB_ALPHA && image.format.bitDepth == 8),
+            rows(direct ? 0 : static_cast<size_t>(width) * 4 * slots),
+            cached(slots, numeric_limits<int64_t>::max()) {}
+
+        const uint8_t *get(uint32_t y) {
+            const auto *source = image.data + y * image.rowBytes;
+            if (direct) {
+                return source;
+            }
+            auto *row = &rows[(y % slots) * width * 4];
+            if (cached[y % slots] != y) {
+                converter.convert(source, 0, row, 0, width);
+                cached[y % slots] = y;
+            }
+            return row;
+        }
+
+    private:
+        const DiffImage &image;
+        uint32_t width;
+        RowConverter converter;
+        bool direct;
+        vector<uint8_t> rows;
+        vector<int64_t> cached;
+};
+
+static inline float blend(float color, float alpha) {
+    return 255.0f + (color - 255.0f) * alpha;
+}
+
+static inline float rgbToY(float r, float g, float b) { return r * 0.29889531f + g * 0.58662247f + b * 0.11448223f; }
+static inline float rgbToI(float r, float g, float b) { return r * 0.59597799f - g * 0.27417610f - b * 0.32180189f; }
+static inline float rgbToQ(float r, float g, float b) { return r * 0.21147017f - g * 0.52261711f + b * 0.31114694f; }
+
+/**
+ * Computes the perceived difference between two RGBA pixels in YIQ color space after blending both over white.
+ * Positive if the first pixel is darker. With `brightnessOnly` only the difference in brightness is returned.
+ */
+static inline float pixelDelta(const uint8_t *first, const uint8_t *second, bool brightnessOnly) {
+    const auto alpha1 = first[3] / 255.0f;
+    const auto alpha2 = second[3] / 255.0f;
+    const auto r1 = blend(first[0], alpha1), g1 = blend(first[1], alpha1), b1 = blend(first[2], alpha1);
+    const auto r2 = blend(second[0], alpha2), g2 = blend(second[1], alpha2), b2 = blend(second[2], alpha2);
+    const auto y1 = rgbToY(r1, g1, b1);
+    const auto y2 = rgbToY(r2, g2, b2);
+    const auto y = y1 - y2;
+    if (brightnessOnly) {
+        return y;
+    }
+    const auto i = rgbToI(r1, g1, b1) - rgbToI(r2, g2, b2);
+    const auto q = rgbToQ(r1, g1, b1) - rgbToQ(r2, g2, b2);
+    const auto delta = 0.5053f * y * y + 0.299f * i * i + 0.1957f * q * q;
+    return y1 > y2 ? -delta : delta;
+}
+
+/**
+ * Computes the squared YIQ distance of every pixel of two RGBA rows. The loop has no branches
+ * so the compiler can vectorize it. Identical pixels always yield `0`.
+ */
+static void rowDeltas(const uint8_t *first, const uint8_t *second, uint32_t width, float *deltas) {
+    for (uint32_t x = 0; x < width; ++x) {
+        const auto *a = first + x * 4;
+        const auto *b = second + x * 4;
+        const auto alpha1 = a[3] / 255.0f;
+        const auto alpha2 = b[3] / 255.0f;
+        const auto r1 = blend(a[0], alpha1), g1 = blend(a[1], alpha1), b1 = blend(a[2], alpha1);
+        const auto r2 = blend(b[0], alpha2), g2 = blend(b[1], alpha2), b2 = blend(b[2], alpha2);
+        const auto y = rgbToY(r1, g1, b1) - rgbToY(r2, g2, b2);
+        const auto i = rgbToI(r1, g1, b1) - rgbToI(r2, g2, b2);
+        const auto q = rgbToQ(r1, g1, b1) - rgbToQ(r2, g2, b2);
+        deltas[x] = 0.5053f * y * y + 0.299f * i * i + 0.1957f * q * q;
+    }
+}
+
+/**
+ * Checks whether at least three pixels around the pixel (including the image's border) have exactly its color.
+ */
+static bool hasManySiblings(RgbaRows &rows, uint32_t x1, uint32_t y1, uint32_t width, uint32_t height) {
+    const auto x0 = x1 > 0 ? x1 - 1 : 0;
+    const auto y0 = y1 > 0 ? y1 - 1 : 0;
+    const auto x2 = min(x1 + 1, width - 1);
+    const auto y2 = min(y1 + 1, height - 1);
+    const auto *center = rows.get(y1) + x1 * 4;
+    uint32_t zeroes = x1 == x0 || x1 == x2 || y1 == y0 || y1 == y2 ? 1 : 0;
+    for (auto y = y0; y <= y2; ++y) {
+        const auto *row = rows.get(y);
+        for (auto x = x0; x <= x2; ++x) {
+            if ((x == x1 && y == y1) || memcmp(center, row + x * 4, 4) != 0) {
+                continue;
+            }
+            if (++zeroes > 2) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Checks whether the pixel is likely part of an anti-aliased edge: Its brightness lies between that of its
+ * darkest and brightest neighbours, and one of these neighbours lies in a uniformly colored area in both images.
+ * Based on "Anti-aliased Pixel and Intensity Slope Detector" by V. Vyšniauskas, 2009.
+ */
+static bool isAntialiased(RgbaRows &image, RgbaRows &other, uint32_t x1, uint32_t y1, uint32_t width, uint32_t height) {
+    const auto x0 = x1 > 0 ? x1 - 1 : 0;
+    const auto y0 = y1 > 0 ? y1 - 1 : 0;
+    const auto x2 = min(x1 + 1, width - 1);
+    const auto y2 = min(y1 + 1, height - 1);
+    const auto *center = image.get(y1) + x1 * 4;
+    uint32_t zeroes = x1 == x0 || x1 == x2 || y1 == y0 || y1 == y2 ? 1 : 0;
+    float minimum = 0, maximum = 0;
+    uint32_t minX = 0, minY = 0, maxX = 0, maxY = 0;
+    for (auto y = y0; y <= y2; ++y) {
+        const auto *row = image.get(y);
+        for (auto x = x0; x <= x2; ++x) {
+            if (x == x1 && y == y1) {
+                continue;
+            }
+            const auto delta = pixelDelta(center, row + x * 4, true);
+            if (delta == 0) {
+                if (++zeroes > 2) {
+                    return false;
+                }
+            } else if (delta < minimum) {
+                minimum = delta;
+                minX = x;
+                minY = y;
+            } else if (delta > maximum) {
+                maximum = delta;
+                maxX = x;
+                maxY = y;
+            }
+        }
+    }
+    if (minimum == 0 || maximum == 0) {
+        return false;
+    }
+    return (hasManySiblings(image, minX, minY, width, height) && hasManySiblings(other, minX, minY, width, height)) ||
+        (hasManySiblings(image, maxX, maxY, width, height) && hasManySiblings(other, maxX, maxY, width, height));
+}
+
+/**
+ * The horizontal extent of the differing pixels of a row.
+ */
+struct RowExtent {
+    uint32_t y;
+    uint32_t left;
+    uint32_t right;
+};
+
+/**
+ * The results of comparing one band of rows.
+ */
+struct DiffBand {
+    uint64_t mismatched;
+    uint64_t antialiased;
+    vector<RowExtent> extents;
+};
+
+/**
+ * Parses the image starting at argument `offset` as `(data, colorType, bitDepth, palette)`.
+ * Throws a JS error and returns `false` if it is invalid.
+ */
+static bool parseDiffImage(const Nan::FunctionCallbackInfo<Value> &info, int offset, uint32_t width, uint32_t height, DiffImage &image) {
+    Local<Object> buffer = Local<Object>::Cast(info[offset]);
+    image.data = reinterpret_cast<uint8_t*>(Buffer::Data(buffer));
+    const string colorTypeName = *Nan::Utf8String(info[offset + 1]);
+    const auto bitDepth = static_cast<uint32_t>(Nan::To<uint32_t>(info[offset + 2]).ToChecked());
+    image.palette = nullptr;
+    image.paletteSize = 0;
+    if (Buffer::HasInstance(info[offset + 3])) {
+        image.palette = reinterpret_cast<uint8_t*>(Buffer::Data(info[offset + 3]));
+        image.paletteSize = Buffer::Length(info[offset + 3]) / 4;
+    }
+    if (!parseColorType(colorTypeName, image.format.colorType)) {
+        Nan::ThrowError("Unsupported color type.");
+        return false;
+    }
+    if (bitDepth != 1 && bitDepth != 2 && bitDepth != 4 && bitDepth != 8 && bitDepth != 16) {
+        Nan::ThrowError("Unsupported bit depth.");
+        return false;
+    }
+    image.format.bitDepth = static_cast<png_byte>(bitDepth);
+    image.rowBytes = rowBytesFor(image.format, width);
+    if (Buffer::Length(buffer) < image.rowBytes * height) {
+        Nan::ThrowError("Width and height do not match buffer size.");
+        return false;
+    }
+    return true;
+}
+
+NAN_METHOD(diff) {
+    // 1st to 4th Parameter: The data, color type, bit depth and palette table of the first image.
+    // 5th to 8th Parameter: The data, color type, bit depth and palette table of the second image.
+    // 9th Parameter: The width of both images.
+    const auto width = static_cast<uint32_t>(Nan::To<uint32_t>(info[8]).ToChecked());
+    // 10th Parameter: The height of both images.
+    const auto height = static_cast<uint32_t>(Nan::To<uint32_t>(info[9]).ToChecked());
+    // 11th Parameter: The threshold between 0 and 1 above which pixels are considered different.
+    const auto threshold = Nan::To<double>(info[10]).ToChecked();
+    // 12th Parameter: Whether to detect anti-aliased pixels and not count them as mismatches.
+    const auto detectAntialiasing = Nan::To<bool>(info[11]).ToChecked();
+    // 13th Parameter: Whether to draw a diff image.
+    const auto drawOutput = Nan::To<bool>(info[12]).ToChecked();
+    // 14th Parameter: Stop comparing after this many mismatches were found. `0` to compare all pixels.
+    const auto maxMismatches = static_cast<uint64_t>(Nan::To<double>(info[13]).ToChecked());
+
+    DiffImage first;
+    DiffImage second;
+    if (!parseDiffImage(info, 0, width, height, first) || !parseDiffImage(info, 4, width, height, second)) {
+        return;
+    }
+    if (width == 0 || height == 0) {
+        Nan::ThrowError("Images must not be empty.");
+        return;
+    }
+
+    // Rows can be compared byte by byte if both images share the same format.
+    const auto sameFormat = first.format.colorType == second.format.colorType && first.format.bitDepth == second.format.bitDepth &&
+        (first.format.colorType != PNG_COLOR_TYPE_PALETTE || (first.paletteSize == second.paletteSize &&
+        memcmp(first.palette, second.palette, first.paletteSize * 4) == 0));
+    // The maximum acceptable squared YIQ distance. 35215 is the distance between black and white.
+    const auto maxDelta = static_cast<float>(35215.0 * threshold * threshold);
+    vector<uint8_t> output(drawOutput ? static_cast<size_t>(width) * height * 4 : 0);
+    atomic<uint64_t> totalMismatched(0);
+
+    const DiffBand initial{ 0, 0, {} };
+    const auto bytes = (first.rowBytes + second.rowBytes) * height;
+    auto bands = inBands(0, height, bytes, initial, [&](uint32_t firstRow, uint32_t endRow, DiffBand &band) {
+        RgbaRows firstRows(first, width);
+        RgbaRows secondRows(second, width);
+        vector<float> deltas(width);
+        for (auto y = firstRow; y < endRow; ++y) {
+            if (maxMismatches != 0 && totalMismatched.load(memory_order_relaxed) >= maxMismatches) {
+                return;
+            }
+            const auto identical = sameFormat && memcmp(first.data + y * first.rowBytes, second.data + y * second.rowBytes, first.rowBytes) == 0;
+            auto *outputRow = drawOutput ? &output[static_cast<size_t>(y) * width * 4] : nullptr;
+            const uint8_t *firstRow = nullptr;
+            if (drawOutput || !identical) {
+                firstRow = firstRows.get(y);
+            }
+            if (!identical) {
+                rowDeltas(firstRow, secondRows.get(y), width, deltas.data());
+            }
+            uint64_t rowMismatched = 0;
+            uint32_t left = width;
+            uint32_t right = 0;
+            for (uint32_t x = 0; x < width; ++x) {
+                const auto differs = !identical && deltas[x] > maxDelta;
+                auto antialiased = false;
+                if (differs && detectAntialiasing) {
+                    antialiased = isAntialiased(firstRows, secondRows, x, y, width, height) ||
+                        isAntialiased(secondRows, firstRows, x, y, width, height);
+                }
+                if (differs && !antialiased) {
+                    ++rowMismatched;
+                    left = min(left, x);
+                    right = max(right, x);
+                } else if (antialiased) {
+                    ++band.antialiased;
+                }
+                if (outputRow) {
+                    auto *pixel = outputRow + x * 4;
+                    if (differs) {
+                        // Mismatches are red, anti-aliased pixels yellow.
+                        pixel[0] = 0xff;
+                        pixel[1] = antialiased ? 0xff : 0;
+                        pixel[2] = 0;
+                    } else {
+                        // Matching pixels are drawn as a faded gray scale version of the first image.
+                        const auto *source = firstRow + x * 4;
+                        const auto brightness = rgbToY(source[0], source[1], source[2]);
+                        const auto gray = static_cast<uint8_t>(lround(blend(brightness, 0.1f * source[3] / 255.0f)));
+                        pixel[0] = pixel[1] = pixel[2] = gray;
+                    }
+                    pixel[3] = 0xff;
+                }
+            }
+            if (rowMismatched > 0) {
+                band.mismatched += rowMismatched;
+                band.extents.push_back(RowExtent{ y, left, right });
+                totalMismatched += rowMismatched;
+            }
+        }
+    });
+
+    // Merge the extents of vertically adjacent rows into regions. Bands are ordered, so the rows are too.
+    uint64_t mismatched = 0;
+    uint64_t antialiased = 0;
+    vector<array<uint32_t, 4>> regions;
+    uint32_t lastRow = 0;
+    for (const auto &band : bands) {
+        mismatched += band.mismatched;
+        antialiased += band.antialiased;
+        for (const auto &extent : band.extents) {
+            if (!regions.empty() && extent.y == lastRow + 1) {
+                auto &region = regions.back();
+                const auto regionRight = max(region[0] + region[2] - 1, extent.right);
+                region[0] = min(region[0], extent.left);
+                region[2] = regionRight - region[0] + 1;
+                region[3] += 1;
+            } else {
+                regions.push_back({ extent.left, extent.y, extent.right - extent.left + 1, 1 });
+            }
+            lastRow = extent.y;
+        }
+    }
+
+    Local<Array> regionArray = Nan::New<Array>(static_cast<uint32_t>(regions.size()));
+    for (uint32_t index = 0; index < regions.size(); ++index) {
+        Local<Array> region = Nan::New<Array>(4);
+        for (uint32_t component = 0; component < 4; ++component) {
+            Nan::Set(region, component, Nan::New(static_cast<double>(regions[index][component])));
+        }
+        Nan::Set(regionArray, index, region);
+    }
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result, Nan::New("mismatched").ToLocalChecked(), Nan::New(static_cast<double>(mismatched)));
+    Nan::Set(result, Nan::New("antialiased").ToLocalChecked(), Nan::New(static_cast<double>(antialiased)));
+    Nan::Set(result, Nan::New("regions").ToLocalChecked(), regionArray);
+    if (drawOutput) {
+        Nan::Set(result, Nan::New("output").ToLocalChecked(), Nan::CopyBuffer(reinterpret_cast<char*>(output.data()), output.size()).ToLocalChecked());
+    }
+    info.GetReturnValue().Set(result);
+}
+
+NAN_MODULE_INIT(InitDiff) {
+    Nan::Set(target, Nan::New("__native_diff").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(diff)).ToLocalChecked());
+}
@@ -0,0 +1,10 @@
+#ifndef DIFF_HPP
+#define DIFF_HPP
+
+#include <nan.h>
+
+NAN_METHOD(diff);
+
+NAN_MODULE_INIT(InitDiff);
+
+#endif
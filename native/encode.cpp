@@ -1,76 +1,313 @@
 #include <png.h>
 #include <zlib.h>
 #include <node_buffer.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
 #include <iostream>
 
-#include "is-png.hpp"
+#include "encode.hpp"
+#include "png-reader.hpp"
+#include "scheduler.hpp"
 
 using namespace node;
 using namespace v8;
 using namespace std;
 
-NAN_METHOD(encode) {
-    // 1st Parameter: The input buffer to encode.
-    Local<Object> inputBuffer = Local<Object>::Cast(info[0]);
-    uint8_t *input = reinterpret_cast<uint8_t*>(Buffer::Data(inputBuffer));
-    // 2nd Parameter: The width of the image to encode.
-    const auto width = static_cast<uint32_t>(Nan::To<uint32_t>(info[1]).ToChecked());
-    // 3rd Parameter: The height of the image to encode.
-    const auto height = static_cast<uint32_t>(Nan::To<uint32_t>(info[2]).ToChecked());
-    // 4th Parameter: Whether to use alpha channel or not.
-    const auto alpha = static_cast<bool>(Nan::To<bool>(info[3]).ToChecked());
-    // 5th Parameter: Compression level, default to best compression
-    const auto compression = static_cast<uint32_t>(Nan::To<uint32_t>(info[4]).FromMaybe(Z_BEST_COMPRESSION));
+/**
+ * Returns a table of 16.16 fixed point factors `255 / alpha` used to reverse premultiplication.
+ */
+static const vector<uint32_t> &unpremultiplyTable() {
+    static const vector<uint32_t> table = [] () {
+        vector<uint32_t> factors(256, 0);
+        for (uint32_t alpha = 1; alpha < 256; ++alpha) {
+            factors[alpha] = ((255u << 16) + alpha / 2) / alpha;
+        }
+        return factors;
+    }();
+    return table;
+}
+
+void unpremultiplyPixels(uint8_t *pixels, uint32_t width) {
+    const auto &factors = unpremultiplyTable();
+    for (uint32_t x = 0; x < width; ++x) {
+        auto *pixel = pixels + x * 4;
+        const auto factor = factors[pixel[3]];
+        for (auto channel = 0; channel < 3; ++channel) {
+            pixel[channel] = static_cast<uint8_t>(min<uint32_t>(255, (pixel[channel] * factor + 32768) >> 16));
+        }
+    }
+}
+
+/**
+ * A libpng user transformation reverting premultiplied alpha on each row of an RGBA image.
+ * It is applied to libpng's own copy of the row, so the input buffer stays untouched.
+ */
+static void unpremultiplyRow(png_structp pngPtr, png_row_infop rowInfo, png_bytep row) {
+    unpremultiplyPixels(row, rowInfo->width);
+}
+
+/**
+ * Hands the metadata to libpng, which writes the chunks along with the image.
+ * libpng copies all data, so `metadata` doesn't need to outlive this call.
+ */
+static void applyMetadata(png_structp pngPtr, png_infop infoPtr, const EncodeMetadata &metadata) {
+    if (metadata.hasGamma) {
+        png_set_gAMA(pngPtr, infoPtr, metadata.gamma);
+    }
+    if (metadata.hasTime) {
+        png_set_tIME(pngPtr, infoPtr, &metadata.time);
+    }
+    if (metadata.hasBackground) {
+        png_set_bKGD(pngPtr, infoPtr, &metadata.background);
+    }
+    if (metadata.hasPhysical) {
+        png_set_pHYs(pngPtr, infoPtr, metadata.pixelsPerMeterX, metadata.pixelsPerMeterY, PNG_RESOLUTION_METER);
+    }
+    if (metadata.hasOffset) {
+        png_set_oFFs(pngPtr, infoPtr, metadata.offsetX, metadata.offsetY, PNG_OFFSET_PIXEL);
+    }
+    if (metadata.hasSrgbIntent) {
+        png_set_sRGB(pngPtr, infoPtr, metadata.srgbIntent);
+    }
+    if (metadata.hasIccProfile) {
+        png_set_iCCP(pngPtr, infoPtr, metadata.iccName.c_str(), PNG_COMPRESSION_TYPE_BASE, metadata.iccProfile.data(),
+            static_cast<png_uint_32>(metadata.iccProfile.size()));
+    }
+    if (!metadata.texts.empty()) {
+        vector<png_text> texts(metadata.texts.size());
+        for (size_t index = 0; index < texts.size(); ++index) {
+            const auto &text = metadata.texts[index];
+            auto &target = texts[index];
+            memset(&target, 0, sizeof(png_text));
+            if (text.international) {
+                target.compression = text.compressed ? PNG_ITXT_COMPRESSION_zTXt : PNG_ITXT_COMPRESSION_NONE;
+                target.lang = const_cast<png_charp>(text.language.c_str());
+                target.lang_key = const_cast<png_charp>("");
+            } else {
+                target.compression = text.compressed ? PNG_TEXT_COMPRESSION_zTXt : PNG_TEXT_COMPRESSION_NONE;
+            }
+            target.key = const_cast<png_charp>(text.keyword.c_str());
+            target.text = const_cast<png_charp>(text.text.c_str());
+            target.text_length = text.text.size();
+        }
+        png_set_text(pngPtr, infoPtr, texts.data(), static_cast<int>(texts.size()));
+    }
+}
+
+/**
+ * Sets the header and the metadata of the image to encode.
+ */
+static void applyHeader(png_structp pngPtr, png_infop infoPtr, const EncodeParameters &parameters) {
+    const auto colorType = parameters.alpha ? PNG_COLOR_TYPE_RGBA : PNG_COLOR_TYPE_RGB;
+    // Initialize write call with available options such as `width`, `height`, etc.
+    png_set_IHDR(pngPtr, infoPtr, parameters.width, parameters.height, 8, colorType, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    // Ancillary chunks are written in the same pass, before and after the image data as libpng sees fit.
+    applyMetadata(pngPtr, infoPtr, parameters.metadata);
+}
+
+void appendToVector(png_structp pngPtr, png_bytep data, png_size_t length) {
+    auto encoded = reinterpret_cast<vector<uint8_t>*>(png_get_io_ptr(pngPtr));
+    encoded->insert(encoded->end(), data, data + length);
+}
+
+bool encodePngHeader(const EncodeParameters &parameters, vector<uint8_t> &output, string &error) {
+    png_structp pngPtr = png_create_write_struct(PNG_LIBPNG_VER_STRING, &error, storeError, ignoreWarning);
+    if (!pngPtr) {
+        error = "Unable to initialize libpng for writing.";
+        return false;
+    }
+    png_infop infoPtr = png_create_info_struct(pngPtr);
+    if (!infoPtr) {
+        png_destroy_write_struct(&pngPtr, nullptr);
+        error = "Unable to initialize libpng info struct.";
+        return false;
+    }
+    if (setjmp(png_jmpbuf(pngPtr))) {
+        png_destroy_write_struct(&pngPtr, &infoPtr);
+        error = "Error encoding PNG: " + error;
+        return false;
+    }
+    png_set_write_fn(pngPtr, &output, appendToVector, nullptr);
+    // Compressed chunks such as `iCCP` and `zTXt` use the same level as the image data.
+    png_set_compression_level(pngPtr, parameters.compression);
+    applyHeader(pngPtr, infoPtr, parameters);
+    // libpng writes the signature and every chunk it has been given here, stopping right before the image data.
+    png_write_info(pngPtr, infoPtr);
+    png_free_data(pngPtr, infoPtr, PNG_FREE_ALL, -1);
+    png_destroy_write_struct(&pngPtr, &infoPtr);
+    return true;
+}
+
+bool encodePng(const EncodeParameters &parameters, png_voidp ioPtr, png_rw_ptr write, string &error) {
     // calculate derived parameters.
-    const auto colorType = alpha ? PNG_COLOR_TYPE_RGBA : PNG_COLOR_TYPE_RGB;
-    const auto rowBytes = (alpha ? 4 : 3) * width;
+    const auto rowBytes = parameters.stride ? parameters.stride : static_cast<size_t>(parameters.alpha ? 4 : 3) * parameters.width;
     // Create libpng write struct. Fail if unable to create.
-    auto errorHandler = [] (png_structp pngPtr, png_const_charp message) {
-        Nan::ThrowError(message);
-    };
-    auto warningHandler = [] (png_structp pngPtr, png_const_charp message) {};
-    png_structp pngPtr = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, errorHandler, warningHandler);
+    png_structp pngPtr = png_create_write_struct(PNG_LIBPNG_VER_STRING, &error, storeError, ignoreWarning);
     if (!pngPtr) {
-        Nan::ThrowError("Unable to initialize libpng for writing.");
-        return;
+        error = "Unable to initialize libpng for writing.";
+        return false;
     }
     // Create libpng info struct. Fail if unable to create.
     png_infop infoPtr = png_create_info_struct(pngPtr);
     if (!infoPtr) {
-        Nan::ThrowError("Unable to initialize libpng info struct.");
-        return;
+        png_destroy_write_struct(&pngPtr, nullptr);
+        error = "Unable to initialize libpng info struct.";
+        return false;
     }
-    // libpng will jump to this if an error occured while reading.
+    // Declared before `setjmp` so it is cleaned up when libpng jumps back on an error.
+    vector<png_bytep> rows;
+    // libpng will jump to this if an error occured while writing.
     if (setjmp(png_jmpbuf(pngPtr))) {
-        Nan::ThrowTypeError("Error encoding PNG.");
-        return;
+        png_destroy_write_struct(&pngPtr, &infoPtr);
+        error = "Error encoding PNG: " + error;
+        return false;
     }
-    vector<uint8_t> encoded;
     // This callback will be called each time libpng wants to write an encoded chunk.
-    png_set_write_fn(pngPtr, &encoded, [] (png_structp pngPtr, png_bytep data, png_size_t length) {
-        auto encoded = reinterpret_cast<vector<uint8_t>*>(png_get_io_ptr(pngPtr));
-        encoded->insert(encoded->end(), data, data + length);
-    }, nullptr);
+    png_set_write_fn(pngPtr, ioPtr, write, nullptr);
     // Use passed compression level.
-    png_set_compression_level(pngPtr, compression);
-    // Initialize write call with available options such as `width`, `height`, etc.
-    png_set_IHDR(pngPtr, infoPtr, width, height, 8, colorType, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_set_compression_level(pngPtr, parameters.compression);
+    // Stop early if the image is encoded by a job which has been aborted.
+    abortAtRowBoundaries(pngPtr, false);
+    // PNG stores straight alpha, so premultiplied samples need to be divided by their alpha before being written.
+    if (parameters.alpha && parameters.premultiplied) {
+        png_set_write_user_transform_fn(pngPtr, unpremultiplyRow);
+    }
+    applyHeader(pngPtr, infoPtr, parameters);
     // A vector is used to address each row of the image inside the 1-dimensional `input` array.
     // Resize the vector to the amount of rows used, assigning each row to `nullptr`.
-    vector<png_bytep> rows;
-    rows.resize(height, nullptr);
+    rows.resize(parameters.height, nullptr);
     // Iterate over every row, and assign the pointer inside the `input` array to the element in the vector.
     // This way each element in the vector points to the beginning of the 2-dimensional row inside the 1-dimensional array.
-    for(size_t row = 0; row < height; ++row) {
-        rows[row] = input + row * rowBytes;
+    for(size_t row = 0; row < parameters.height; ++row) {
+        rows[row] = parameters.input + row * rowBytes;
     }
     // Encode the PNG.
     png_write_info(pngPtr, infoPtr);
-    png_write_rows(pngPtr, &rows[0], height);
+    png_write_rows(pngPtr, &rows[0], parameters.height);
     png_write_end(pngPtr, nullptr);
     // Free libpng write struct.
     png_free_data(pngPtr, infoPtr, PNG_FREE_ALL, -1);
     png_destroy_write_struct(&pngPtr, &infoPtr);
+    return true;
+}
+
+static Local<Value> getProperty(Local<Object> object, const char *name) {
+    return Nan::Get(object, Nan::New(name).ToLocalChecked()).ToLocalChecked();
+}
+
+static double getElement(Local<Value> array, uint32_t index) {
+    return Nan::To<double>(Nan::Get(Local<Object>::Cast(array), index).ToLocalChecked()).FromJust();
+}
+
+static string bufferToString(Local<Value> buffer) {
+    return string(Buffer::Data(buffer), Buffer::Length(buffer));
+}
+
+void parseEncodeMetadata(Local<Value> value, EncodeMetadata &metadata) {
+    metadata.hasGamma = metadata.hasTime = metadata.hasBackground = metadata.hasPhysical = false;
+    metadata.hasOffset = metadata.hasSrgbIntent = metadata.hasIccProfile = false;
+    if (!value->IsObject()) {
+        return;
+    }
+    auto object = Nan::To<Object>(value).ToLocalChecked();
+    auto gamma = getProperty(object, "gamma");
+    if ((metadata.hasGamma = !gamma->IsUndefined())) {
+        metadata.gamma = Nan::To<double>(gamma).FromJust();
+    }
+    auto time = getProperty(object, "time");
+    if ((metadata.hasTime = !time->IsUndefined())) {
+        metadata.time.year = static_cast<png_uint_16>(getElement(time, 0));
+        metadata.time.month = static_cast<png_byte>(getElement(time, 1));
+        metadata.time.day = static_cast<png_byte>(getElement(time, 2));
+        metadata.time.hour = static_cast<png_byte>(getElement(time, 3));
+        metadata.time.minute = static_cast<png_byte>(getElement(time, 4));
+        metadata.time.second = static_cast<png_byte>(getElement(time, 5));
+    }
+    auto background = getProperty(object, "background");
+    if ((metadata.hasBackground = !background->IsUndefined())) {
+        memset(&metadata.background, 0, sizeof(png_color_16));
+        metadata.background.red = static_cast<png_uint_16>(getElement(background, 0));
+        metadata.background.green = static_cast<png_uint_16>(getElement(background, 1));
+        metadata.background.blue = static_cast<png_uint_16>(getElement(background, 2));
+    }
+    auto physical = getProperty(object, "physical");
+    if ((metadata.hasPhysical = !physical->IsUndefined())) {
+        metadata.pixelsPerMeterX = static_cast<uint32_t>(getElement(physical, 0));
+        metadata.pixelsPerMeterY = static_cast<uint32_t>(getElement(physical, 1));
+    }
+    auto offset = getProperty(object, "offset");
+    if ((metadata.hasOffset = !offset->IsUndefined())) {
+        metadata.offsetX = static_cast<int32_t>(getElement(offset, 0));
+        metadata.offsetY = static_cast<int32_t>(getElement(offset, 1));
+    }
+    auto srgbIntent = getProperty(object, "srgbIntent");
+    if ((metadata.hasSrgbIntent = !srgbIntent->IsUndefined())) {
+        metadata.srgbIntent = Nan::To<int32_t>(srgbIntent).FromJust();
+    }
+    auto iccProfile = getProperty(object, "iccProfile");
+    if ((metadata.hasIccProfile = !iccProfile->IsUndefined())) {
+        auto profile = Nan::To<Object>(iccProfile).ToLocalChecked();
+        metadata.iccName = bufferToString(getProperty(profile, "name"));
+        auto data = getProperty(profile, "data");
+        const auto *bytes = reinterpret_cast<png_byte*>(Buffer::Data(data));
+        metadata.iccProfile.assign(bytes, bytes + Buffer::Length(data));
+    }
+    auto texts = getProperty(object, "texts");
+    if (!texts->IsUndefined()) {
+        auto array = Local<Array>::Cast(texts);
+        for (uint32_t index = 0; index < array->Length(); ++index) {
+            auto entry = Nan::To<Object>(Nan::Get(array, index).ToLocalChecked()).ToLocalChecked();
+            auto language = getProperty(entry, "language");
+            metadata.texts.push_back({
+                bufferToString(getProperty(entry, "keyword")),
+                bufferToString(getProperty(entry, "text")),
+                language->IsUndefined() ? string() : bufferToString(language),
+                !language->IsUndefined(),
+                Nan::To<bool>(getProperty(entry, "compressed")).FromMaybe(false),
+            });
+        }
+    }
+}
+
+bool parseEncodeParameters(const Nan::FunctionCallbackInfo<Value> &info, int first, EncodeParameters &parameters) {
+    // 1st Parameter: The input buffer to encode.
+    Local<Object> inputBuffer = Local<Object>::Cast(info[first]);
+    parameters.input = reinterpret_cast<uint8_t*>(Buffer::Data(inputBuffer));
+    parameters.stride = 0;
+    // 2nd Parameter: The width of the image to encode.
+    parameters.width = static_cast<uint32_t>(Nan::To<uint32_t>(info[first + 1]).ToChecked());
+    // 3rd Parameter: The height of the image to encode.
+    parameters.height = static_cast<uint32_t>(Nan::To<uint32_t>(info[first + 2]).ToChecked());
+    // 4th Parameter: Whether to use alpha channel or not.
+    parameters.alpha = static_cast<bool>(Nan::To<bool>(info[first + 3]).ToChecked());
+    // 5th Parameter: Compression level, default to best compression
+    parameters.compression = static_cast<uint32_t>(Nan::To<uint32_t>(info[first + 4]).FromMaybe(Z_BEST_COMPRESSION));
+    // 6th Parameter: Whether the color samples are premultiplied with the alpha channel.
+    parameters.premultiplied = static_cast<bool>(Nan::To<bool>(info[first + 5]).FromMaybe(false));
+    // 7th Parameter: Optional metadata to write along with the image.
+    parseEncodeMetadata(info[first + 6], parameters.metadata);
+    // libpng reads `height` rows of `width` pixels from the input.
+    const size_t expectedSize = static_cast<size_t>(parameters.width) * parameters.height * (parameters.alpha ? 4 : 3);
+    if (Buffer::Length(inputBuffer) < expectedSize) {
+        Nan::ThrowError("Input buffer is too small for the specified dimensions.");
+        return false;
+    }
+    return true;
+}
+
+NAN_METHOD(encode) {
+    EncodeParameters parameters;
+    if (!parseEncodeParameters(info, 0, parameters)) {
+        return;
+    }
+    vector<uint8_t> encoded;
+    string error;
+    if (!encodePng(parameters, &encoded, appendToVector, error)) {
+        Nan::ThrowTypeError(error.c_str());
+        return;
+    }
     // Return created encoded image as a buffer. Needs to be a copy as the vector from above will be freed.
     info.GetReturnValue().Set(Nan::CopyBuffer(reinterpret_cast<char*>(&encoded[0]), encoded.size()).ToLocalChecked());
 }
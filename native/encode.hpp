@@ -2,6 +2,107 @@
 #define ENCODE_HPP
 
 #include <nan.h>
+#include <png.h>
+#include <string>
+#include <vector>
+
+/**
+ * A text chunk to write. Written as `iTXt` if `international` is set, otherwise as `tEXt`, or `zTXt` if compressed.
+ */
+struct EncodeText {
+    // Latin-1 keyword.
+    std::string keyword;
+    // Latin-1 text for `tEXt` and `zTXt`, UTF-8 text for `iTXt`.
+    std::string text;
+    // The language tag of an `iTXt` chunk.
+    std::string language;
+    bool international;
+    bool compressed;
+};
+
+/**
+ * The ancillary chunks to write along with the image. Every chunk is only written if its `has...` flag is set.
+ */
+struct EncodeMetadata {
+    bool hasGamma;
+    double gamma;
+    bool hasTime;
+    png_time time;
+    bool hasBackground;
+    png_color_16 background;
+    bool hasPhysical;
+    uint32_t pixelsPerMeterX;
+    uint32_t pixelsPerMeterY;
+    bool hasOffset;
+    int32_t offsetX;
+    int32_t offsetY;
+    bool hasSrgbIntent;
+    int srgbIntent;
+    bool hasIccProfile;
+    std::string iccName;
+    std::vector<png_byte> iccProfile;
+    std::vector<EncodeText> texts;
+};
+
+/**
+ * Describes an RGB or RGBA image with 8 bit per sample to encode.
+ */
+struct EncodeParameters {
+    // The rows of the image.
+    uint8_t *input;
+    // The distance between the starts of two rows in bytes, or `0` for tightly packed rows.
+    size_t stride;
+    uint32_t width;
+    uint32_t height;
+    // Whether the image has an alpha channel.
+    bool alpha;
+    // The zlib compression level between 0 and 9.
+    uint32_t compression;
+    // Whether the color samples are premultiplied with the alpha channel.
+    bool premultiplied;
+    // Owns its data, so it stays valid when the parameters are handed to another thread.
+    EncodeMetadata metadata;
+};
+
+/**
+ * Reads the metadata as prepared by the JS side. Every property is optional:
+ * `gamma` as a number, `time` as `[year, month, day, hour, minute, second]`, `background` as `[red, green, blue]`,
+ * `physical` and `offset` as `[x, y]`, `srgbIntent` as a number, `iccProfile` as `{ name, data }` with buffers and
+ * `texts` as an array of `{ keyword, text, language, compressed }` with buffers and an optional language.
+ */
+void parseEncodeMetadata(v8::Local<v8::Value> value, EncodeMetadata &metadata);
+
+/**
+ * Reads the parameters as passed from the JS side, starting with the input buffer at argument `first`.
+ * Consumes seven arguments, the last one being the optional metadata.
+ * Throws a JS error and returns `false` if the input buffer is too small.
+ */
+bool parseEncodeParameters(const Nan::FunctionCallbackInfo<v8::Value> &info, int first, EncodeParameters &parameters);
+
+/**
+ * Encodes the image, handing the encoded data to `write` with `ioPtr` as io pointer. `write` may call `png_error`.
+ * Doesn't touch any JS values, so it can be called from worker threads.
+ * Returns `false` and sets `error` if the image could not be encoded.
+ */
+bool encodePng(const EncodeParameters &parameters, png_voidp ioPtr, png_rw_ptr write, std::string &error);
+
+/**
+ * A libpng write callback appending the encoded data to the `std::vector<uint8_t>` used as io pointer.
+ * Can be passed to `encodePng` or `png_set_write_fn`.
+ */
+void appendToVector(png_structp pngPtr, png_bytep data, png_size_t length);
+
+/**
+ * Writes the signature, the header and the metadata of the image to `output`, stopping right before the image data.
+ * Doesn't touch any JS values, so it can be called from worker threads.
+ * Returns `false` and sets `error` if the chunks could not be encoded.
+ */
+bool encodePngHeader(const EncodeParameters &parameters, std::vector<uint8_t> &output, std::string &error);
+
+/**
+ * Divides the color samples of `width` premultiplied RGBA pixels by their alpha in place.
+ */
+void unpremultiplyPixels(uint8_t *pixels, uint32_t width);
 
 NAN_METHOD(encode);
 
@@ -0,0 +1,253 @@
+#include <png.h>
+#include <zlib.h>
+#include <node_buffer.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "encoder-session.hpp"
+#include "bands.hpp"
+#include "chunks.hpp"
+#include "scheduler.hpp"
+
+using namespace node;
+using namespace v8;
+using namespace std;
+
+// The compressed image data is split into `IDAT` chunks of at most this many bytes.
+static const size_t maxIdatLength = 65536;
+
+/**
+ * The predictor of the Paeth filter as defined by the PNG specification.
+ */
+static uint8_t paeth(uint8_t left, uint8_t above, uint8_t aboveLeft) {
+    const int estimate = left + above - aboveLeft;
+    const auto distanceLeft = abs(estimate - left);
+    const auto distanceAbove = abs(estimate - above);
+    const auto distanceAboveLeft = abs(estimate - aboveLeft);
+    if (distanceLeft <= distanceAbove && distanceLeft <= distanceAboveLeft) {
+        return left;
+    }
+    return distanceAbove <= distanceAboveLeft ? above : aboveLeft;
+}
+
+/**
+ * Filters `row` into `output`, prefixed with the filter type. Every filter type is tried and the one with the
+ * smallest sum of absolute differences is kept, the same heuristic libpng uses. Without a `previous` row only
+ * the filters which don't refer to the row above are used. `candidates` needs to hold five rows.
+ */
+static void filterRow(const uint8_t *row, const uint8_t *previous, size_t rowBytes, uint32_t bytesPerPixel, uint8_t *output, uint8_t *candidates) {
+    const auto filterCount = previous ? 5 : 2;
+    auto best = 0;
+    auto bestSum = ~static_cast<uint64_t>(0);
+    for (auto filter = 0; filter < filterCount; ++filter) {
+        auto *candidate = candidates + filter * rowBytes;
+        uint64_t sum = 0;
+        for (size_t index = 0; index < rowBytes; ++index) {
+            const uint8_t left = index >= bytesPerPixel ? row[index - bytesPerPixel] : 0;
+            const uint8_t above = previous ? previous[index] : 0;
+            const uint8_t aboveLeft = previous && index >= bytesPerPixel ? previous[index - bytesPerPixel] : 0;
+            uint8_t predictor = 0;
+            switch (filter) {
+                case PNG_FILTER_VALUE_SUB: predictor = left; break;
+                case PNG_FILTER_VALUE_UP: predictor = above; break;
+                case PNG_FILTER_VALUE_AVG: predictor = static_cast<uint8_t>((left + above) >> 1); break;
+                case PNG_FILTER_VALUE_PAETH: predictor = paeth(left, above, aboveLeft); break;
+            }
+            const auto value = static_cast<uint8_t>(row[index] - predictor);
+            candidate[index] = value;
+            // The filtered bytes are treated as signed, so small negative differences count as small.
+            sum += value < 128 ? value : 256 - value;
+        }
+        if (sum < bestSum) {
+            bestSum = sum;
+            best = filter;
+        }
+    }
+    output[0] = static_cast<uint8_t>(best);
+    memcpy(output + 1, candidates + best * rowBytes, rowBytes);
+}
+
+bool deflateBand(const EncodeParameters &parameters, uint32_t first, uint32_t end, DeflatedBand &band, string &error) {
+    const uint32_t bytesPerPixel = parameters.alpha ? 4 : 3;
+    const auto rowBytes = static_cast<size_t>(parameters.width) * bytesPerPixel;
+    const auto stride = parameters.stride ? parameters.stride : rowBytes;
+    const auto unpremultiply = parameters.alpha && parameters.premultiplied;
+    // Every filtered row is prefixed with its filter type.
+    vector<uint8_t> filtered((rowBytes + 1) * (end - first));
+    vector<uint8_t> candidates(rowBytes * 5);
+    // Premultiplied rows are converted into two alternating rows, so the previous row stays available.
+    vector<uint8_t> converted(unpremultiply ? rowBytes * 2 : 0);
+    const uint8_t *previous = nullptr;
+    for (auto y = first; y < end; ++y) {
+        const uint8_t *row = parameters.input + y * stride;
+        if (unpremultiply) {
+            auto *target = converted.data() + (y % 2) * rowBytes;
+            memcpy(target, row, rowBytes);
+            unpremultiplyPixels(target, parameters.width);
+            row = target;
+        }
+        filterRow(row, previous, rowBytes, bytesPerPixel, filtered.data() + (y - first) * (rowBytes + 1), candidates.data());
+        previous = row;
+    }
+    // A raw stream without header and checksum, as the bands are framed into one zlib stream when assembled.
+    z_stream stream;
+    memset(&stream, 0, sizeof(z_stream));
+    if (deflateInit2(&stream, static_cast<int>(parameters.compression), Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        error = "Error encoding PNG: Unable to initialize zlib.";
+        return false;
+    }
+    // The sync flush appends an empty stored block of at most five bytes, plus the bits needed to reach a byte boundary.
+    band.data.resize(deflateBound(&stream, filtered.size()) + 16);
+    stream.next_in = filtered.data();
+    stream.avail_in = static_cast<uInt>(filtered.size());
+    stream.next_out = band.data.data();
+    stream.avail_out = static_cast<uInt>(band.data.size());
+    // A sync flush ends the band at a byte boundary without marking its last block as the final one.
+    const auto result = deflate(&stream, Z_SYNC_FLUSH);
+    band.data.resize(band.data.size() - stream.avail_out);
+    const auto complete = result == Z_OK && stream.avail_in == 0 && stream.avail_out > 0;
+    deflateEnd(&stream);
+    if (!complete) {
+        error = "Error encoding PNG: Unable to compress the image data.";
+        return false;
+    }
+    band.adler = adler32(adler32(0, nullptr, 0), filtered.data(), static_cast<uInt>(filtered.size()));
+    band.length = filtered.size();
+    band.dirty = false;
+    return true;
+}
+
+bool assembleBands(const EncodeParameters &parameters, const vector<DeflatedBand> &bands, vector<uint8_t> &output, string &error) {
+    if (!encodePngHeader(parameters, output, error)) {
+        return false;
+    }
+    // The zlib header announces a window of 32 KiB and the compression level, checked by the remainder modulo 31.
+    const uint8_t method = 0x78;
+    const auto level = parameters.compression < 2 ? 0 : parameters.compression < 6 ? 1 : parameters.compression == 6 ? 2 : 3;
+    auto flags = static_cast<uint8_t>(level << 6);
+    flags += 31 - ((method << 8) + flags) % 31;
+    vector<uint8_t> stream { method, flags };
+    auto adler = adler32(0, nullptr, 0);
+    for (const auto &band : bands) {
+        stream.insert(stream.end(), band.data.begin(), band.data.end());
+        adler = adler32_combine(adler, band.adler, static_cast<z_off_t>(band.length));
+    }
+    // An empty block with fixed codes marked as final ends the stream, followed by the checksum of all bands.
+    stream.insert(stream.end(), { 0x03, 0x00, 0, 0, 0, 0 });
+    writeUint32(stream.data() + stream.size() - 4, static_cast<uint32_t>(adler));
+    for (size_t offset = 0; offset < stream.size(); offset += maxIdatLength) {
+        const auto length = static_cast<uint32_t>(min(maxIdatLength, stream.size() - offset));
+        const auto position = output.size();
+        output.resize(position + chunkSize(length));
+        writeChunk(output.data() + position, "IDAT", stream.data() + offset, length);
+    }
+    const auto position = output.size();
+    output.resize(position + chunkSize(0));
+    writeChunk(output.data() + position, "IEND", nullptr, 0);
+    return true;
+}
+
+EncoderSession::EncoderSession(uint32_t width, uint32_t height, bool alpha, uint32_t compression, uint32_t bandHeight) :
+    width(width), height(height), alpha(alpha), compression(compression), bandHeight(bandHeight),
+    bands((height + bandHeight - 1) / bandHeight, DeflatedBand { {}, 0, 0, true }) {}
+
+NAN_MODULE_INIT(EncoderSession::Init) {
+    Nan::HandleScope scope;
+    auto ctor = Nan::New<FunctionTemplate>(EncoderSession::New);
+    ctor->SetClassName(Nan::New("__native_EncoderSession").ToLocalChecked());
+    ctor->InstanceTemplate()->SetInternalFieldCount(1);
+    Nan::SetPrototypeMethod(ctor, "invalidate", EncoderSession::invalidate);
+    Nan::SetPrototypeMethod(ctor, "encode", EncoderSession::encode);
+    // Instances are only ever created from JS, so the constructor doesn't need to be kept per isolate.
+    Nan::Set(target, Nan::New("__native_EncoderSession").ToLocalChecked(), Nan::GetFunction(ctor).ToLocalChecked());
+}
+
+NAN_METHOD(EncoderSession::New) {
+    if (!info.IsConstructCall()) {
+        Nan::ThrowTypeError("EncoderSession needs to be called with `new`.");
+        return;
+    }
+    // 1st Parameter: The width of the image.
+    const auto width = static_cast<uint32_t>(Nan::To<uint32_t>(info[0]).ToChecked());
+    // 2nd Parameter: The height of the image.
+    const auto height = static_cast<uint32_t>(Nan::To<uint32_t>(info[1]).ToChecked());
+    // 3rd Parameter: Whether the image has an alpha channel.
+    const auto alpha = Nan::To<bool>(info[2]).ToChecked();
+    // 4th Parameter: The zlib compression level.
+    const auto compression = static_cast<uint32_t>(Nan::To<uint32_t>(info[3]).ToChecked());
+    // 5th Parameter: The amount of rows per band.
+    const auto bandHeight = max(1u, static_cast<uint32_t>(Nan::To<uint32_t>(info[4]).ToChecked()));
+    auto session = new EncoderSession(width, height, alpha, compression, bandHeight);
+    session->Wrap(info.This());
+    info.GetReturnValue().Set(info.This());
+}
+
+NAN_METHOD(EncoderSession::invalidate) {
+    auto session = Nan::ObjectWrap::Unwrap<EncoderSession>(info.Holder());
+    // 1st Parameter: The first changed row.
+    const auto first = min(session->height, static_cast<uint32_t>(Nan::To<uint32_t>(info[0]).ToChecked()));
+    // 2nd Parameter: The row after the last changed row.
+    const auto end = min(session->height, static_cast<uint32_t>(Nan::To<uint32_t>(info[1]).ToChecked()));
+    if (first >= end) {
+        return;
+    }
+    for (auto row = first - first % session->bandHeight; row < end; row += session->bandHeight) {
+        session->bands[row / session->bandHeight].dirty = true;
+    }
+}
+
+NAN_METHOD(EncoderSession::encode) {
+    auto session = Nan::ObjectWrap::Unwrap<EncoderSession>(info.Holder());
+    EncodeParameters parameters = {};
+    // 1st Parameter: The pixels of the image.
+    Local<Object> inputBuffer = Local<Object>::Cast(info[0]);
+    parameters.input = reinterpret_cast<uint8_t*>(Buffer::Data(inputBuffer));
+    parameters.width = session->width;
+    parameters.height = session->height;
+    parameters.alpha = session->alpha;
+    parameters.compression = session->compression;
+    // 2nd Parameter: Whether the color samples are premultiplied with the alpha channel.
+    parameters.premultiplied = Nan::To<bool>(info[1]).FromMaybe(false);
+    // 3rd Parameter: Optional metadata to write along with the image.
+    parseEncodeMetadata(info[2], parameters.metadata);
+    const auto rowBytes = static_cast<size_t>(parameters.width) * (parameters.alpha ? 4 : 3);
+    if (Buffer::Length(inputBuffer) < rowBytes * parameters.height) {
+        Nan::ThrowError("Input buffer is too small for the specified dimensions.");
+        return;
+    }
+    auto &bands = session->bands;
+    vector<uint32_t> dirty;
+    for (uint32_t index = 0; index < bands.size(); ++index) {
+        if (bands[index].dirty) {
+            dirty.push_back(index);
+        }
+    }
+    // Only compress the changed bands, concurrently if there is enough of them.
+    vector<string> errors(dirty.size());
+    const auto bandHeight = session->bandHeight;
+    const auto parallel = dirty.size() > 1 && rowBytes * bandHeight * dirty.size() >= parallelThreshold;
+    forEachInJob(static_cast<uint32_t>(dirty.size()), parallel, [&] (uint32_t index) {
+        const auto first = dirty[index] * bandHeight;
+        const auto end = min(parameters.height, first + bandHeight);
+        deflateBand(parameters, first, end, bands[dirty[index]], errors[index]);
+    });
+    string error;
+    for (const auto &bandError : errors) {
+        if (!bandError.empty()) {
+            error = bandError;
+            break;
+        }
+    }
+    vector<uint8_t> encoded;
+    if (!error.empty() || !assembleBands(parameters, bands, encoded, error)) {
+        Nan::ThrowError(error.c_str());
+        return;
+    }
+    auto result = Nan::New<Object>();
+    Nan::Set(result, Nan::New("data").ToLocalChecked(), Nan::CopyBuffer(reinterpret_cast<char*>(encoded.data()), encoded.size()).ToLocalChecked());
+    Nan::Set(result, Nan::New("encodedBands").ToLocalChecked(), Nan::New(static_cast<double>(dirty.size())));
+    info.GetReturnValue().Set(result);
+}
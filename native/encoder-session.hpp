@@ -0,0 +1,66 @@
+#ifndef ENCODER_SESSION_HPP
+#define ENCODER_SESSION_HPP
+
+#include <nan.h>
+#include <zlib.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "encode.hpp"
+
+/**
+ * The compressed image data of a band of rows, as produced by `deflateBand`.
+ */
+struct DeflatedBand {
+    // Raw deflate data ending at a byte boundary without a final block, so that bands can be concatenated.
+    std::vector<uint8_t> data;
+    // The adler32 checksum and the length of the filtered rows, to combine into the checksum of the whole stream.
+    uLong adler;
+    size_t length;
+    // Whether the rows changed since `data` was computed.
+    bool dirty;
+};
+
+/**
+ * Filters and compresses the rows from `first` up to `end` of the image into `band`. The first row of a band
+ * doesn't refer to the row above it, so every band can be compressed again on its own when its rows change.
+ * Doesn't touch any JS values, so it can be called from worker threads.
+ * Returns `false` and sets `error` if the rows could not be compressed.
+ */
+bool deflateBand(const EncodeParameters &parameters, uint32_t first, uint32_t end, DeflatedBand &band, std::string &error);
+
+/**
+ * Encodes the image into `output`, splicing the compressed bands into one zlib stream for the `IDAT` chunks.
+ * All bands need to be up to date.
+ * Returns `false` and sets `error` if the chunks before the image data could not be encoded.
+ */
+bool assembleBands(const EncodeParameters &parameters, const std::vector<DeflatedBand> &bands, std::vector<uint8_t> &output, std::string &error);
+
+/**
+ * Keeps the compressed bands of an image between encodes, so that only the bands which changed since
+ * the previous encode need to be compressed again.
+ */
+class EncoderSession : public Nan::ObjectWrap {
+    public:
+        static NAN_MODULE_INIT(Init);
+
+    private:
+        static NAN_METHOD(New);
+        // Marks the bands containing a range of rows as changed.
+        static NAN_METHOD(invalidate);
+        // Compresses the changed bands and returns the encoded image along with the amount of bands compressed.
+        static NAN_METHOD(encode);
+
+        EncoderSession(uint32_t width, uint32_t height, bool alpha, uint32_t compression, uint32_t bandHeight);
+
+        uint32_t width;
+        uint32_t height;
+        bool alpha;
+        uint32_t compression;
+        // The amount of rows in every band but the last one.
+        uint32_t bandHeight;
+        std::vector<DeflatedBand> bands;
+};
+
+#endif
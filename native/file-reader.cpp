@@ -0,0 +1,107 @@
+#include "file-reader.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// The size of the buffer through which the file is read.
+static const size_t bufferSize = 64 * 1024;
+
+#ifdef _WIN32
+
+static int openFile(const string &path) {
+    // The path is UTF-8 encoded and needs to be converted for the wide character API.
+    const int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+    wstring wide(length, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide[0], length);
+    return _wopen(wide.c_str(), _O_RDONLY | _O_BINARY | _O_SEQUENTIAL);
+}
+
+static int readFile(int fd, uint8_t *target, size_t length) {
+    return _read(fd, target, static_cast<unsigned int>(length));
+}
+
+static int closeFile(int fd) {
+    return _close(fd);
+}
+
+#else
+
+static int openFile(const string &path) {
+    return open(path.c_str(), O_RDONLY);
+}
+
+static int readFile(int fd, uint8_t *target, size_t length) {
+    return static_cast<int>(read(fd, target, length));
+}
+
+static int closeFile(int fd) {
+    return close(fd);
+}
+
+#endif
+
+FileReader::FileReader(const string &path) : path(path), fd(-1), position(0), available(0) {}
+
+FileReader::~FileReader() {
+    if (fd != -1) {
+        closeFile(fd);
+    }
+}
+
+bool FileReader::open(string &error) {
+    fd = openFile(path);
+    if (fd == -1) {
+        error = "Unable to open file \"" + path + "\": " + strerror(errno);
+        return false;
+    }
+    buffer.resize(bufferSize);
+    return true;
+}
+
+bool FileReader::read(uint8_t *target, size_t length, size_t &count, string &error) {
+    count = 0;
+    while (count < length) {
+        if (position == available) {
+            if (!fill(error)) {
+                return false;
+            }
+            // The end of the file has been reached.
+            if (available == 0) {
+                return true;
+            }
+        }
+        const auto chunk = min(length - count, available - position);
+        memcpy(target + count, buffer.data() + position, chunk);
+        position += chunk;
+        count += chunk;
+    }
+    return true;
+}
+
+bool FileReader::fill(string &error) {
+    position = 0;
+    available = 0;
+    while (true) {
+        const auto result = readFile(fd, buffer.data(), buffer.size());
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = "Unable to read file \"" + path + "\": " + strerror(errno);
+            return false;
+        }
+        available = static_cast<size_t>(result);
+        return true;
+    }
+}
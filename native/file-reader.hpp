@@ -0,0 +1,36 @@
+#ifndef FILE_READER_HPP
+#define FILE_READER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Reads a file from start to end through a fixed size buffer, so only the buffer needs to be kept in memory
+ * regardless of the size of the file.
+ */
+class FileReader {
+    public:
+        explicit FileReader(const std::string &path);
+        ~FileReader();
+        FileReader(const FileReader&) = delete;
+        FileReader& operator=(const FileReader&) = delete;
+        // Opens the file. Returns `false` and sets `error` if that failed.
+        bool open(std::string &error);
+        // Reads up to `length` bytes into `target` and sets `count` to the amount read, which is only less than
+        // `length` at the end of the file. Returns `false` and sets `error` if reading failed.
+        bool read(uint8_t *target, size_t length, size_t &count, std::string &error);
+
+    private:
+        // Refills the buffer from the file. Leaves it empty at the end of the file.
+        bool fill(std::string &error);
+        std::string path;
+        int fd;
+        std::vector<uint8_t> buffer;
+        // The position of the next byte to hand out and the end of the valid data inside `buffer`.
+        size_t position;
+        size_t available;
+};
+
+#endif
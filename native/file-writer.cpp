@@ -0,0 +1,209 @@
+#include "file-writer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#include <process.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// The size of the buffer in which the encoded data is collected before it is written to the file.
+static const size_t bufferSize = 256 * 1024;
+
+#ifdef _WIN32
+
+/**
+ * Converts an UTF-8 encoded path for use with the wide character API.
+ */
+static wstring widen(const string &path) {
+    const int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+    wstring wide(length, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide[0], length);
+    return wide;
+}
+
+static int openFile(const string &path) {
+    return _wopen(widen(path).c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+
+static int writeFile(int fd, const uint8_t *data, size_t length) {
+    return _write(fd, data, static_cast<unsigned int>(length));
+}
+
+static int syncFile(int fd) {
+    return _commit(fd);
+}
+
+static int closeFile(int fd) {
+    return _close(fd);
+}
+
+static void removeFile(const string &path) {
+    _wunlink(widen(path).c_str());
+}
+
+static bool replaceFile(const string &from, const string &to) {
+    return MoveFileExW(widen(from).c_str(), widen(to).c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+static int processId() {
+    return _getpid();
+}
+
+static int makeDirectory(const string &path) {
+    return _wmkdir(widen(path).c_str());
+}
+
+#else
+
+static int openFile(const string &path) {
+    return open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+}
+
+static int writeFile(int fd, const uint8_t *data, size_t length) {
+    return static_cast<int>(write(fd, data, length));
+}
+
+static int syncFile(int fd) {
+    return fsync(fd);
+}
+
+static int closeFile(int fd) {
+    return close(fd);
+}
+
+static void removeFile(const string &path) {
+    unlink(path.c_str());
+}
+
+static bool replaceFile(const string &from, const string &to) {
+    return rename(from.c_str(), to.c_str()) == 0;
+}
+
+static int processId() {
+    return getpid();
+}
+
+static int makeDirectory(const string &path) {
+    return mkdir(path.c_str(), 0777);
+}
+
+#endif
+
+/**
+ * Returns a path for a temporary file in the same directory as `path`, so it can be renamed atomically.
+ * The process id and a counter keep concurrent writers from colliding.
+ */
+static string temporaryPath(const string &path) {
+    static atomic<uint32_t> counter(0);
+    return path + ".tmp-" + to_string(processId()) + "-" + to_string(counter++);
+}
+
+FileWriter::FileWriter(const string &path, bool atomic) :
+    path(path), writePath(atomic ? temporaryPath(path) : path), atomic(atomic), committed(false), fd(-1), used(0) {}
+
+FileWriter::~FileWriter() {
+    if (fd != -1) {
+        closeFile(fd);
+    }
+    if (atomic && !committed) {
+        removeFile(writePath);
+    }
+}
+
+bool FileWriter::open(string &error) {
+    fd = openFile(writePath);
+    if (fd == -1) {
+        error = "Unable to open file \"" + writePath + "\": " + strerror(errno);
+        return false;
+    }
+    buffer.resize(bufferSize);
+    return true;
+}
+
+bool FileWriter::write(const uint8_t *data, size_t length, string &error) {
+    while (length > 0) {
+        if (used == buffer.size() && !flush(error)) {
+            return false;
+        }
+        const auto chunk = min(length, buffer.size() - used);
+        memcpy(buffer.data() + used, data, chunk);
+        used += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+bool FileWriter::flush(string &error) {
+    size_t written = 0;
+    while (written < used) {
+        const auto result = writeFile(fd, buffer.data() + written, used - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = "Unable to write file \"" + writePath + "\": " + strerror(errno);
+            return false;
+        }
+        written += static_cast<size_t>(result);
+    }
+    used = 0;
+    return true;
+}
+
+bool FileWriter::commit(bool sync, string &error) {
+    if (!flush(error)) {
+        return false;
+    }
+    if (sync && syncFile(fd) != 0) {
+        error = "Unable to sync file \"" + writePath + "\": " + strerror(errno);
+        return false;
+    }
+    const auto result = closeFile(fd);
+    fd = -1;
+    if (result != 0) {
+        error = "Unable to close file \"" + writePath + "\": " + strerror(errno);
+        return false;
+    }
+    if (atomic) {
+        if (!replaceFile(writePath, path)) {
+            error = "Unable to replace file \"" + path + "\": " + strerror(errno);
+            return false;
+        }
+        committed = true;
+#ifndef _WIN32
+        // The rename itself is only durable once the directory has been flushed as well.
+        if (sync) {
+            const auto separator = path.find_last_of('/');
+            const auto directory = separator == string::npos ? string(".") : separator == 0 ? string("/") : path.substr(0, separator);
+            const int directoryFd = ::open(directory.c_str(), O_RDONLY);
+            if (directoryFd != -1) {
+                fsync(directoryFd);
+                close(directoryFd);
+            }
+        }
+#endif
+    }
+    return true;
+}
+
+bool createDirectory(const string &path, string &error) {
+    if (makeDirectory(path) != 0 && errno != EEXIST) {
+        error = "Unable to create directory \"" + path + "\": " + strerror(errno);
+        return false;
+    }
+    return true;
+}
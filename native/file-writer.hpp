@@ -0,0 +1,48 @@
+#ifndef FILE_WRITER_HPP
+#define FILE_WRITER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Writes a file through a fixed size buffer, so only the buffer needs to be kept in memory.
+ * In atomic mode the data is written to a temporary file next to the target, which replaces the
+ * target once it is complete. The temporary file is removed again if the writer is destroyed before.
+ */
+class FileWriter {
+    public:
+        FileWriter(const std::string &path, bool atomic);
+        ~FileWriter();
+        FileWriter(const FileWriter&) = delete;
+        FileWriter& operator=(const FileWriter&) = delete;
+        // Creates the file. Returns `false` and sets `error` if that failed.
+        bool open(std::string &error);
+        // Appends data to the file. Returns `false` and sets `error` if writing failed.
+        bool write(const uint8_t *data, size_t length, std::string &error);
+        // Writes the remaining buffer, optionally flushes the file to disk and closes it. In atomic mode the
+        // target is replaced afterwards. Returns `false` and sets `error` if any of these steps failed.
+        bool commit(bool sync, std::string &error);
+
+    private:
+        // Writes the buffer to the file and empties it.
+        bool flush(std::string &error);
+        // The path of the target file.
+        std::string path;
+        // The path of the file which is actually written, a temporary file in atomic mode.
+        std::string writePath;
+        bool atomic;
+        bool committed;
+        int fd;
+        std::vector<uint8_t> buffer;
+        size_t used;
+};
+
+/**
+ * Creates the directory at `path` unless it exists already. Its parent directory needs to exist.
+ * Returns `false` and sets `error` if that failed.
+ */
+bool createDirectory(const std::string &path, std::string &error);
+
+#endif
@@ -0,0 +1,250 @@
+#include <png.h>
+#include <node_buffer.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "hash.hpp"
+#include "decode-options.hpp"
+#include "png-reader.hpp"
+#include "xxhash.hpp"
+
+using namespace node;
+using namespace v8;
+using namespace std;
+
+/**
+ * Formats a 64 bit hash as a string of 16 hexadecimal digits.
+ */
+static string toHex(uint64_t hash) {
+    char digits[17];
+    snprintf(digits, sizeof(digits), "%016llx", static_cast<unsigned long long>(hash));
+    return string(digits);
+}
+
+NAN_METHOD(pixelHash) {
+    // 1st Parameter: The buffer with the encoded PNG image.
+    if (!Buffer::HasInstance(info[0])) {
+        Nan::ThrowError("Input is not a buffer.");
+        return;
+    }
+    auto *input = reinterpret_cast<uint8_t*>(Buffer::Data(info[0]));
+    const auto inputSize = static_cast<uint32_t>(Buffer::Length(info[0]));
+
+    XXHash64 hash;
+    uint32_t bytesPerSample = 1;
+    // Normalize every image into RGBA, so images with the same pixels but a different color type, filtering or
+    // compression have the same hash. 16 bit images are kept at 16 bit to not lose precision.
+    const auto configure = [&](png_structp pngPtr, png_infop infoPtr) {
+        if (png_get_bit_depth(pngPtr, infoPtr) == 16) {
+            bytesPerSample = 2;
+            const auto colorType = png_get_color_type(pngPtr, infoPtr);
+            if (!(colorType & PNG_COLOR_MASK_COLOR)) {
+                png_set_gray_to_rgb(pngPtr);
+            }
+            if (png_get_valid(pngPtr, infoPtr, PNG_INFO_tRNS)) {
+                png_set_tRNS_to_alpha(pngPtr);
+            } else if (!(colorType & PNG_COLOR_MASK_ALPHA)) {
+                png_set_add_alpha(pngPtr, 0xffff, PNG_FILLER_AFTER);
+            }
+            png_set_interlace_handling(pngPtr);
+            png_read_update_info(pngPtr, infoPtr);
+        } else {
+            DecodeOptions options;
+            options.output = DecodeOutput::RGBA8;
+            applyDecodeOptions(pngPtr, infoPtr, options);
+        }
+        // The dimensions and sample size are part of the hash, so images with the same data but a different shape differ.
+        const uint32_t header[] = { png_get_image_width(pngPtr, infoPtr), png_get_image_height(pngPtr, infoPtr), bytesPerSample };
+        for (const auto value : header) {
+            const uint8_t bytes[] = {
+                static_cast<uint8_t>(value >> 24),
+                static_cast<uint8_t>(value >> 16),
+                static_cast<uint8_t>(value >> 8),
+                static_cast<uint8_t>(value),
+            };
+            hash.update(bytes, sizeof(bytes));
+        }
+    };
+    const auto visit = [&](const png_byte *row, uint32_t y, uint32_t width, uint32_t height) {
+        hash.update(row, static_cast<size_t>(width) * 4 * bytesPerSample);
+    };
+    string error;
+    if (!readRows(input, inputSize, configure, visit, error)) {
+        Nan::ThrowError(error.c_str());
+        return;
+    }
+    info.GetReturnValue().Set(Nan::New(toHex(hash.digest())).ToLocalChecked());
+}
+
+/**
+ * Reduces an image to a small grid of gray scale values while it is being decoded by averaging
+ * all pixels falling into each cell. Every cell receives at least one pixel, even if the image is smaller than the grid.
+ */
+class GridReducer {
+    public:
+        GridReducer(uint32_t columns, uint32_t rows) : columns(columns), rows(rows), sums(columns * rows, 0), counts(columns * rows, 0) {}
+
+        void addRow(const png_byte *row, uint32_t y, uint32_t width, uint32_t height) {
+            // The cells of every column only depend on the width and are computed once.
+            if (columnCells.size() != width * 2) {
+                columnCells.resize(width * 2);
+                for (uint32_t x = 0; x < width; ++x) {
+                    columnCells[x * 2] = cellOf(x, width, columns);
+                    columnCells[x * 2 + 1] = lastCellOf(x, width, columns);
+                }
+            }
+            const auto firstRow = cellOf(y, height, rows);
+            const auto lastRow = lastCellOf(y, height, rows);
+            for (uint32_t x = 0; x < width; ++x) {
+                const auto firstColumn = columnCells[x * 2];
+                const auto lastColumn = columnCells[x * 2 + 1];
+                for (auto cellY = firstRow; cellY <= lastRow; ++cellY) {
+                    for (auto cellX = firstColumn; cellX <= lastColumn; ++cellX) {
+                        sums[cellY * columns + cellX] += row[x];
+                        counts[cellY * columns + cellX]++;
+                    }
+                }
+            }
+        }
+
+        double at(uint32_t x, uint32_t y) const {
+            const auto index = y * columns + x;
+            return counts[index] == 0 ? 0 : static_cast<double>(sums[index]) / counts[index];
+        }
+
+    private:
+        static uint32_t cellOf(uint32_t position, uint32_t size, uint32_t cells) {
+            return static_cast<uint32_t>(static_cast<uint64_t>(position) * cells / size);
+        }
+
+        static uint32_t lastCellOf(uint32_t position, uint32_t size, uint32_t cells) {
+            const auto last = static_cast<uint32_t>((static_cast<uint64_t>(position + 1) * cells - 1) / size);
+            return max(cellOf(position, size, cells), last);
+        }
+
+        uint32_t columns;
+        uint32_t rows;
+        vector<uint64_t> sums;
+        vector<uint32_t> counts;
+        // The first and last cell of every column of the image.
+        vector<uint32_t> columnCells;
+};
+
+/**
+ * The difference hash: One bit per horizontally adjacent pair of cells in a 9x8 grid, set if the left cell is brighter.
+ */
+static uint64_t differenceHash(const GridReducer &grid) {
+    uint64_t hash = 0;
+    for (uint32_t y = 0; y < 8; ++y) {
+        for (uint32_t x = 0; x < 8; ++x) {
+            hash = (hash << 1) | (grid.at(x, y) > grid.at(x + 1, y) ? 1 : 0);
+        }
+    }
+    return hash;
+}
+
+/**
+ * The perceptual hash: The 8x8 lowest frequencies of the discrete cosine transform of a 32x32 grid,
+ * one bit per frequency, set if it is above the median of all frequencies except the constant one.
+ */
+static uint64_t dctHash(const GridReducer &grid) {
+    const double pi = 3.14159265358979323846;
+    const uint32_t size = 32;
+    const uint32_t frequencies = 8;
+    vector<double> cosines(frequencies * size);
+    for (uint32_t frequency = 0; frequency < frequencies; ++frequency) {
+        for (uint32_t position = 0; position < size; ++position) {
+            cosines[frequency * size + position] = cos((2.0 * position + 1.0) * frequency * pi / (2.0 * size));
+        }
+    }
+    // The transform is separable: First along the rows, then along the columns.
+    vector<double> rowTransformed(size * frequencies, 0);
+    for (uint32_t y = 0; y < size; ++y) {
+        for (uint32_t u = 0; u < frequencies; ++u) {
+            double sum = 0;
+            for (uint32_t x = 0; x < size; ++x) {
+                sum += grid.at(x, y) * cosines[u * size + x];
+            }
+            rowTransformed[y * frequencies + u] = sum;
+        }
+    }
+    vector<double> coefficients(frequencies * frequencies, 0);
+    for (uint32_t v = 0; v < frequencies; ++v) {
+        for (uint32_t u = 0; u < frequencies; ++u) {
+            double sum = 0;
+            for (uint32_t y = 0; y < size; ++y) {
+                sum += rowTransformed[y * frequencies + u] * cosines[v * size + y];
+            }
+            coefficients[v * frequencies + u] = sum;
+        }
+    }
+    vector<double> sorted(coefficients.begin() + 1, coefficients.end());
+    nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+    const auto median = sorted[sorted.size() / 2];
+    // Frequencies within rounding errors of the median don't count as above it, so uniform areas hash stably.
+    const double epsilon = 1e-6;
+    uint64_t hash = 0;
+    for (const auto coefficient : coefficients) {
+        hash = (hash << 1) | (coefficient > median + epsilon ? 1 : 0);
+    }
+    return hash;
+}
+
+NAN_METHOD(perceptualHash) {
+    // 1st Parameter: The buffer with the encoded PNG image.
+    if (!Buffer::HasInstance(info[0])) {
+        Nan::ThrowError("Input is not a buffer.");
+        return;
+    }
+    auto *input = reinterpret_cast<uint8_t*>(Buffer::Data(info[0]));
+    const auto inputSize = static_cast<uint32_t>(Buffer::Length(info[0]));
+    // 2nd Parameter: The algorithm, either "dhash" or "phash".
+    const string algorithm = *Nan::Utf8String(info[1]);
+    if (algorithm != "dhash" && algorithm != "phash") {
+        Nan::ThrowError("Unsupported hash algorithm.");
+        return;
+    }
+
+    const auto difference = algorithm == "dhash";
+    GridReducer grid(difference ? 9 : 32, difference ? 8 : 32);
+    // Only a gray scale version of the image is needed. Rows are reduced right after decoding them.
+    const auto configure = [&](png_structp pngPtr, png_infop infoPtr) {
+        DecodeOptions options;
+        options.output = DecodeOutput::GRAY8;
+        applyDecodeOptions(pngPtr, infoPtr, options);
+        // The grid reads a single sample per pixel.
+        if (png_get_channels(pngPtr, infoPtr) != 1) {
+            png_error(pngPtr, "Image could not be converted to gray-scale.");
+        }
+    };
+    const auto visit = [&](const png_byte *row, uint32_t y, uint32_t width, uint32_t height) {
+        grid.addRow(row, y, width, height);
+    };
+    string error;
+    if (!readRows(input, inputSize, configure, visit, error)) {
+        Nan::ThrowError(error.c_str());
+        return;
+    }
+    const auto hash = difference ? differenceHash(grid) : dctHash(grid);
+    info.GetReturnValue().Set(Nan::New(toHex(hash)).ToLocalChecked());
+}
+
+NAN_METHOD(bufferHash) {
+    // 1st Parameter: The buffer to hash.
+    if (!Buffer::HasInstance(info[0])) {
+        Nan::ThrowError("Input is not a buffer.");
+        return;
+    }
+    XXHash64 hash;
+    hash.update(reinterpret_cast<uint8_t*>(Buffer::Data(info[0])), Buffer::Length(info[0]));
+    info.GetReturnValue().Set(Nan::New(toHex(hash.digest())).ToLocalChecked());
+}
+
+NAN_MODULE_INIT(InitHash) {
+    Nan::Set(target, Nan::New("__native_pixelHash").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(pixelHash)).ToLocalChecked());
+    Nan::Set(target, Nan::New("__native_bufferHash").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(bufferHash)).ToLocalChecked());
+    Nan::Set(target, Nan::New("__native_perceptualHash").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(perceptualHash)).ToLocalChecked());
+}
@@ -0,0 +1,12 @@
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include <nan.h>
+
+NAN_METHOD(pixelHash);
+NAN_METHOD(perceptualHash);
+NAN_METHOD(bufferHash);
+
+NAN_MODULE_INIT(InitHash);
+
+#endif
@@ -0,0 +1,331 @@
+#include <png.h>
+#include <node_buffer.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mipmaps.hpp"
+#include "bands.hpp"
+#include "scheduler.hpp"
+
+using namespace node;
+using namespace v8;
+using namespace std;
+
+/**
+ * Converts 8 bit samples into linear light and back.
+ */
+class GammaTable {
+    public:
+        /**
+         * Uses the power law of `gamma` as stored in the `gAMA` chunk, or the sRGB curve if `gamma` is `0`.
+         */
+        explicit GammaTable(double gamma) {
+            for (uint32_t sample = 0; sample < 256; ++sample) {
+                const double encoded = sample / 255.0;
+                if (gamma > 0) {
+                    linear[sample] = static_cast<float>(pow(encoded, 1.0 / gamma));
+                } else {
+                    linear[sample] = static_cast<float>(encoded <= 0.04045 ? encoded / 12.92 : pow((encoded + 0.055) / 1.055, 2.4));
+                }
+            }
+        }
+
+        float toLinear(uint8_t sample) const {
+            return linear[sample];
+        }
+
+        /**
+         * Returns the sample closest to `value`. The table is increasing, so it is found by a binary search.
+         */
+        uint8_t fromLinear(float value) const {
+            const auto upper = lower_bound(linear.begin(), linear.end(), value);
+            if (upper == linear.begin()) {
+                return 0;
+            }
+            if (upper == linear.end()) {
+                return 255;
+            }
+            const auto index = static_cast<uint8_t>(upper - linear.begin());
+            return value - *(upper - 1) < *upper - value ? index - 1 : index;
+        }
+
+    private:
+        array<float, 256> linear;
+};
+
+/**
+ * A level to compute from the level above it.
+ */
+struct Reduction {
+    const uint8_t *source;
+    uint32_t sourceWidth;
+    uint32_t sourceHeight;
+    uint8_t *target;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    // Whether the last channel is alpha.
+    bool alpha;
+    // Whether the colors need to be weighted by their alpha, as they are not premultiplied.
+    bool weighted;
+    // Only set for the gamma correct filter.
+    const GammaTable *gammaTable;
+};
+
+/**
+ * Computes the rows `first` to `end` of a level. Every pixel is the average of a block of 2x2 pixels in the
+ * level above. Blocks in the last column and row span three pixels if the level above has an odd size, so no
+ * pixel is skipped. Two rows of the level above are read to compute one row, so the rows stay in the cache.
+ * `Sum` is an integer for averaging the encoded samples and a float for averaging in linear light.
+ */
+template<typename Sum>
+static void reduceRows(const Reduction &reduction, uint32_t first, uint32_t end) {
+    const auto channels = reduction.channels;
+    const auto colors = reduction.alpha ? channels - 1 : channels;
+    const auto sourceStride = static_cast<size_t>(reduction.sourceWidth) * channels;
+    for (uint32_t y = first; y < end; ++y) {
+        const auto top = 2 * y;
+        const auto bottom = y == reduction.height - 1 ? reduction.sourceHeight : top + 2;
+        uint8_t *output = reduction.target + static_cast<size_t>(y) * reduction.width * channels;
+        for (uint32_t x = 0; x < reduction.width; ++x, output += channels) {
+            const auto left = 2 * x;
+            const auto right = x == reduction.width - 1 ? reduction.sourceWidth : left + 2;
+            Sum sums[4] = {};
+            uint32_t alphaSum = 0;
+            uint32_t count = 0;
+            for (auto row = top; row < bottom; ++row) {
+                const uint8_t *pixel = reduction.source + row * sourceStride + static_cast<size_t>(left) * channels;
+                for (auto column = left; column < right; ++column, pixel += channels) {
+                    const uint32_t alpha = reduction.alpha ? pixel[channels - 1] : 255;
+                    const uint32_t weight = reduction.weighted ? alpha : 1;
+                    for (uint32_t channel = 0; channel < colors; ++channel) {
+                        if (reduction.gammaTable) {
+                            sums[channel] += reduction.gammaTable->toLinear(pixel[channel]) * weight;
+                        } else {
+                            sums[channel] += pixel[channel] * weight;
+                        }
+                    }
+                    alphaSum += alpha;
+                    ++count;
+                }
+            }
+            // Fully transparent blocks have no color.
+            const auto total = reduction.weighted ? alphaSum : count;
+            for (uint32_t channel = 0; channel < colors; ++channel) {
+                if (total == 0) {
+                    output[channel] = 0;
+                } else if (reduction.gammaTable) {
+                    output[channel] = reduction.gammaTable->fromLinear(static_cast<float>(sums[channel] / total));
+                } else {
+                    output[channel] = static_cast<uint8_t>((static_cast<uint32_t>(sums[channel]) + total / 2) / total);
+                }
+            }
+            if (reduction.alpha) {
+                output[channels - 1] = static_cast<uint8_t>((alphaSum + count / 2) / count);
+            }
+        }
+    }
+}
+
+vector<MipmapLevel> mipmapLevels(uint32_t width, uint32_t height, uint32_t channels, size_t &totalSize) {
+    vector<MipmapLevel> levels;
+    totalSize = 0;
+    while (width > 1 || height > 1) {
+        width = max(1u, width / 2);
+        height = max(1u, height / 2);
+        levels.push_back({ width, height, totalSize });
+        totalSize += static_cast<size_t>(width) * height * channels;
+    }
+    return levels;
+}
+
+bool generateMipmaps(const MipmapParameters &parameters, uint8_t *levelData, vector<vector<uint8_t>> &encoded, string &error) {
+    size_t totalSize;
+    const auto levels = mipmapLevels(parameters.width, parameters.height, parameters.channels, totalSize);
+    const bool alpha = parameters.channels == 2 || parameters.channels == 4;
+    unique_ptr<GammaTable> gammaTable;
+    if (parameters.filter == MipmapFilter::GAMMA) {
+        gammaTable.reset(new GammaTable(parameters.gamma));
+    }
+    // Every level is computed from the previous one, so the image itself is only read once.
+    Reduction reduction = {
+        parameters.input,
+        parameters.width,
+        parameters.height,
+        nullptr,
+        0,
+        0,
+        parameters.channels,
+        alpha,
+        alpha && !parameters.premultiplied,
+        gammaTable.get(),
+    };
+    for (const auto &level : levels) {
+        if (jobAborted()) {
+            error = "Aborted.";
+            return false;
+        }
+        reduction.target = levelData + level.offset;
+        reduction.width = level.width;
+        reduction.height = level.height;
+        const size_t bytes = static_cast<size_t>(reduction.sourceWidth) * reduction.sourceHeight * parameters.channels;
+        inBands(0, level.height, bytes, static_cast<uint8_t>(0), [&reduction](uint32_t first, uint32_t end, uint8_t &) {
+            if (reduction.gammaTable) {
+                reduceRows<float>(reduction, first, end);
+            } else {
+                reduceRows<uint32_t>(reduction, first, end);
+            }
+        });
+        reduction.source = reduction.target;
+        reduction.sourceWidth = level.width;
+        reduction.sourceHeight = level.height;
+    }
+    if (!parameters.encode) {
+        return true;
+    }
+
+    // The image itself is the first level. The levels are independent, so they are encoded concurrently.
+    const auto count = static_cast<uint32_t>(levels.size() + 1);
+    const size_t imageSize = static_cast<size_t>(parameters.width) * parameters.height * parameters.channels;
+    encoded.assign(count, vector<uint8_t>());
+    mutex errorLock;
+    atomic<bool> failed(false);
+    uint32_t failedIndex = 0;
+    forEachInJob(count, imageSize + totalSize >= parallelThreshold, [&] (uint32_t index) {
+        if (failed) {
+            return;
+        }
+        EncodeParameters encodeParameters = {};
+        encodeParameters.input = index == 0 ? parameters.input : levelData + levels[index - 1].offset;
+        encodeParameters.width = index == 0 ? parameters.width : levels[index - 1].width;
+        encodeParameters.height = index == 0 ? parameters.height : levels[index - 1].height;
+        encodeParameters.alpha = alpha;
+        encodeParameters.compression = parameters.compressionLevel;
+        encodeParameters.premultiplied = parameters.premultiplied;
+        encodeParameters.metadata = parameters.metadata;
+        string levelError;
+        if (!encodePng(encodeParameters, &encoded[index], appendToVector, levelError)) {
+            lock_guard<mutex> guard(errorLock);
+            if (!failed || index < failedIndex) {
+                failedIndex = index;
+                error = levelError;
+            }
+            failed = true;
+        }
+    });
+    return !failed;
+}
+
+/**
+ * Computes and optionally encodes the mipmaps on a thread of the scheduler's pool.
+ */
+class MipmapsWorker : public ScheduledWorker {
+    public:
+        MipmapsWorker(Nan::Callback *callback, const MipmapParameters &parameters) :
+            ScheduledWorker(callback, "node-libpng:mipmaps"), parameters(parameters), levelData(nullptr), totalSize(0) {}
+
+        ~MipmapsWorker() {
+            delete[] levelData;
+        }
+
+        void Execute() override {
+            levels = mipmapLevels(parameters.width, parameters.height, parameters.channels, totalSize);
+            // One allocation holds all levels. Unless they are encoded it is handed to JS as it is.
+            levelData = new uint8_t[max<size_t>(1, totalSize)];
+            string error;
+            if (!generateMipmaps(parameters, levelData, encoded, error)) {
+                SetErrorMessage(error.c_str());
+            }
+        }
+
+    protected:
+        void HandleOKCallback() override {
+            Nan::HandleScope scope;
+            if (parameters.encode) {
+                Local<Array> buffers = Nan::New<Array>(static_cast<uint32_t>(encoded.size()));
+                for (uint32_t index = 0; index < encoded.size(); ++index) {
+                    const auto &level = encoded[index];
+                    Nan::Set(buffers, index, Nan::CopyBuffer(reinterpret_cast<const char*>(level.data()), level.size()).ToLocalChecked());
+                }
+                Local<Value> argv[] = { Nan::Null(), buffers };
+                callback->Call(2, argv, async_resource);
+                return;
+            }
+            Local<Array> sizes = Nan::New<Array>(static_cast<uint32_t>(levels.size() * 2));
+            for (uint32_t index = 0; index < levels.size(); ++index) {
+                Nan::Set(sizes, index * 2, Nan::New(static_cast<double>(levels[index].width)));
+                Nan::Set(sizes, index * 2 + 1, Nan::New(static_cast<double>(levels[index].height)));
+            }
+            Local<Object> result = Nan::New<Object>();
+            // The buffer takes over the levels' memory.
+            Nan::Set(result, Nan::New("data").ToLocalChecked(), Nan::NewBuffer(reinterpret_cast<char*>(levelData), totalSize).ToLocalChecked());
+            levelData = nullptr;
+            Nan::Set(result, Nan::New("sizes").ToLocalChecked(), sizes);
+            Local<Value> argv[] = { Nan::Null(), result };
+            callback->Call(2, argv, async_resource);
+        }
+
+        void HandleErrorCallback() override {
+            Nan::HandleScope scope;
+            Local<Value> argv[] = { Nan::Error(ErrorMessage()) };
+            callback->Call(1, argv, async_resource);
+        }
+
+    private:
+        MipmapParameters parameters;
+        vector<MipmapLevel> levels;
+        uint8_t *levelData;
+        size_t totalSize;
+        vector<vector<uint8_t>> encoded;
+};
+
+NAN_METHOD(mipmaps) {
+    MipmapParameters parameters;
+    // 1st Parameter: The buffer with the samples of the image.
+    Local<Object> inputBuffer = Local<Object>::Cast(info[0]);
+    parameters.input = reinterpret_cast<uint8_t*>(Buffer::Data(inputBuffer));
+    // 2nd, 3rd and 4th Parameter: The size of the image and its amount of channels.
+    parameters.width = Nan::To<uint32_t>(info[1]).FromMaybe(0);
+    parameters.height = Nan::To<uint32_t>(info[2]).FromMaybe(0);
+    parameters.channels = Nan::To<uint32_t>(info[3]).FromMaybe(0);
+    // 5th Parameter: Whether the color samples are premultiplied with the alpha channel.
+    parameters.premultiplied = Nan::To<bool>(info[4]).FromMaybe(false);
+    // 6th Parameter: The gamma of the image, or `undefined` for sRGB.
+    parameters.gamma = info[5]->IsNumber() ? Nan::To<double>(info[5]).FromJust() : 0;
+    // 7th Parameter: Whether to average in linear light.
+    parameters.filter = Nan::To<bool>(info[6]).FromMaybe(false) ? MipmapFilter::GAMMA : MipmapFilter::BOX;
+    // 8th and 9th Parameter: Whether to encode the levels and the compression level to use.
+    parameters.encode = Nan::To<bool>(info[7]).FromMaybe(false);
+    parameters.compressionLevel = Nan::To<uint32_t>(info[8]).FromMaybe(6);
+    // 10th Parameter: Optional metadata to write along with every level.
+    parseEncodeMetadata(info[9], parameters.metadata);
+    // 11th Parameter: Whether to queue the job in the batch lane.
+    const auto priority = parseJobPriority(info[10]);
+    if (parameters.channels < 1 || parameters.channels > 4 || (parameters.encode && parameters.channels < 3)) {
+        Nan::ThrowError("Unsupported amount of channels.");
+        return;
+    }
+    const size_t expectedSize = static_cast<size_t>(parameters.width) * parameters.height * parameters.channels;
+    if (parameters.width == 0 || parameters.height == 0 || Buffer::Length(inputBuffer) < expectedSize) {
+        Nan::ThrowError("Input buffer is too small for the specified dimensions.");
+        return;
+    }
+    // 12th Parameter: The callback to call with an error, the encoded levels or the raw levels and their sizes.
+    auto callback = new Nan::Callback(Local<Function>::Cast(info[11]));
+    auto worker = new MipmapsWorker(callback, parameters);
+    // Keep the image alive while the levels are computed on the pool.
+    worker->SaveToPersistent("input", info[0]);
+    const auto id = scheduleWorker(worker, priority);
+    info.GetReturnValue().Set(Nan::New(static_cast<double>(id)));
+}
+
+NAN_MODULE_INIT(InitMipmaps) {
+    Nan::Set(target, Nan::New("__native_mipmaps").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(mipmaps)).ToLocalChecked());
+}
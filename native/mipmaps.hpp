@@ -0,0 +1,73 @@
+#ifndef MIPMAPS_HPP
+#define MIPMAPS_HPP
+
+#include <nan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "encode.hpp"
+
+/**
+ * How the pixels of a level are averaged into the next level.
+ */
+enum class MipmapFilter {
+    // Averages the encoded samples.
+    BOX,
+    // Averages the samples in linear light.
+    GAMMA
+};
+
+/**
+ * Describes an image with 8 bit per sample and one to four channels to create the mipmaps of.
+ */
+struct MipmapParameters {
+    uint8_t *input;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    // Whether the color samples are premultiplied with the alpha channel. Straight colors are weighted by their alpha.
+    bool premultiplied;
+    // The gamma of the image as stored in the `gAMA` chunk, or `0` for sRGB.
+    double gamma;
+    MipmapFilter filter;
+    // Encode all levels including the image itself instead of returning the raw levels.
+    bool encode;
+    uint32_t compressionLevel;
+    // Written along with every encoded level.
+    EncodeMetadata metadata;
+};
+
+/**
+ * The size of a level and where its pixels start in the buffer holding all levels.
+ */
+struct MipmapLevel {
+    uint32_t width;
+    uint32_t height;
+    size_t offset;
+};
+
+/**
+ * Returns the sizes of the levels below the image, each half the size of the previous one rounded down,
+ * until a single pixel is left. Also computes the size of the buffer holding all of them.
+ */
+std::vector<MipmapLevel> mipmapLevels(uint32_t width, uint32_t height, uint32_t channels, size_t &totalSize);
+
+/**
+ * Computes every level from the previous one into `levels`, which needs to be as large as reported by `mipmapLevels`.
+ * If `encode` is set, the image and all levels are encoded concurrently into `encoded`.
+ * Doesn't touch any JS values, so it can be called from worker threads.
+ * Returns `false` and sets `error` if a level could not be encoded or the job was aborted.
+ */
+bool generateMipmaps(
+    const MipmapParameters &parameters,
+    uint8_t *levels,
+    std::vector<std::vector<uint8_t>> &encoded,
+    std::string &error
+);
+
+NAN_METHOD(mipmaps);
+
+NAN_MODULE_INIT(InitMipmaps);
+
+#endif
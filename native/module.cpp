@@ -6,6 +6,22 @@
 #include "resize.hpp"
 #include "copy.hpp"
 #include "fill.hpp"
+#include "decode-tensor.hpp"
+#include "analyze.hpp"
+#include "diff.hpp"
+#include "hash.hpp"
+#include "verify.hpp"
+#include "read-file.hpp"
+#include "write-file.hpp"
+#include "scheduler.hpp"
+#include "chunks.hpp"
+#include "recompress.hpp"
+#include "atlas.hpp"
+#include "pyramid.hpp"
+#include "mipmaps.hpp"
+#include "progressive.hpp"
+#include "apng.hpp"
+#include "encoder-session.hpp"
 
 NAN_MODULE_INIT(InitNodeLibPng) {
     PngImage::Init(target);
@@ -14,6 +30,24 @@ NAN_MODULE_INIT(InitNodeLibPng) {
     InitResize(target);
     InitCopy(target);
     InitFill(target);
+    InitDecodeTensor(target);
+    InitAnalyze(target);
+    InitDiff(target);
+    InitHash(target);
+    InitVerify(target);
+    InitReadFile(target);
+    InitWriteFile(target);
+    InitScheduler(target);
+    InitChunks(target);
+    InitRecompress(target);
+    InitAtlas(target);
+    InitPyramid(target);
+    InitMipmaps(target);
+    ProgressiveDecoder::Init(target);
+    InitApng(target);
+    EncoderSession::Init(target);
 }
 
-NODE_MODULE(node_libpng, InitNodeLibPng)
+// Context aware, so the addon can be loaded by worker threads. All state is either kept per isolate,
+// immutable or shared by all isolates behind a mutex, such as the scheduler's thread pool.
+NAN_MODULE_WORKER_ENABLED(node_libpng, InitNodeLibPng)
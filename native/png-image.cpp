@@ -1,6 +1,14 @@
 #include "png-image.hpp"
+#include "decode-options.hpp"
+#include "png-reader.hpp"
+#include "scheduler.hpp"
 
+#include <node.h>
 #include <node_buffer.h>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -9,11 +17,33 @@ using namespace node;
 using namespace v8;
 using namespace std;
 
-Nan::Persistent<Function> constructor;
+// The addon can be loaded by the main thread and any amount of worker threads, each with its own isolate.
+// Every isolate needs its own constructor, which is removed again when the isolate's environment is torn down.
+static mutex constructorsMutex;
+static map<Isolate*, unique_ptr<Nan::Global<Function>>> constructors;
+
+/**
+ * Returns the constructor of `PngImage` for the current isolate.
+ */
+static Local<Function> constructor() {
+    lock_guard<mutex> lock(constructorsMutex);
+    return Nan::New(*constructors.at(Isolate::GetCurrent()));
+}
+
+/**
+ * Cleanup hook removing the constructor of an isolate once its environment is torn down.
+ */
+static void removeConstructor(void *isolate) {
+    lock_guard<mutex> lock(constructorsMutex);
+    constructors.erase(reinterpret_cast<Isolate*>(isolate));
+}
 
 PngImage::PngImage(png_structp &pngPtr, png_infop &infoPtr) : pngPtr(pngPtr), infoPtr(infoPtr) {}
 
-PngImage::~PngImage() {}
+PngImage::~PngImage() {
+    // The structs are kept alive for the getters and are only freed once the JS object has been garbage collected.
+    png_destroy_read_struct(&pngPtr, &infoPtr, nullptr);
+}
 
 NAN_MODULE_INIT(PngImage::Init) {
     Nan::HandleScope scope;
@@ -37,90 +67,134 @@ NAN_MODULE_INIT(PngImage::Init) {
     Nan::SetAccessor(ctorInstance, Nan::New("time").ToLocalChecked(), PngImage::getTime);
     Nan::SetAccessor(ctorInstance, Nan::New("backgroundColor").ToLocalChecked(), PngImage::getBackgroundColor);
     Nan::SetAccessor(ctorInstance, Nan::New("palette").ToLocalChecked(), PngImage::getPalette);
+    Nan::SetAccessor(ctorInstance, Nan::New("paletteAlpha").ToLocalChecked(), PngImage::getPaletteAlpha);
     Nan::SetAccessor(ctorInstance, Nan::New("gamma").ToLocalChecked(), PngImage::getGamma);
-    // Make sure the constructor stays persisted by storing it in a `Nan::Persistant`.
-    constructor.Reset(Nan::GetFunction(ctor).ToLocalChecked());
+    Nan::SetAccessor(ctorInstance, Nan::New("texts").ToLocalChecked(), PngImage::getTexts);
+    Nan::SetAccessor(ctorInstance, Nan::New("srgbIntent").ToLocalChecked(), PngImage::getSrgbIntent);
+    Nan::SetAccessor(ctorInstance, Nan::New("iccProfile").ToLocalChecked(), PngImage::getIccProfile);
+    // Make sure the constructor stays persisted by storing it in a `Nan::Global` for the current isolate.
+    auto isolate = Isolate::GetCurrent();
+    bool firstLoad;
+    {
+        lock_guard<mutex> lock(constructorsMutex);
+        auto &entry = constructors[isolate];
+        firstLoad = !entry;
+        entry.reset(new Nan::Global<Function>(Nan::GetFunction(ctor).ToLocalChecked()));
+    }
+    // node aborts if the same cleanup hook is registered twice, for example when the addon is loaded into another context.
+    if (firstLoad) {
+        node::AddEnvironmentCleanupHook(isolate, removeConstructor, isolate);
+    }
     // Store `NativePngImage` in the module's exports.
     Nan::Set(target, Nan::New("__native_PngImage").ToLocalChecked(), Nan::GetFunction(ctor).ToLocalChecked());
 }
 
-/*
- * This struct is used when reading (decoding) the PNG image into a raw buffer.
- * It stores information about the data which should be read and how much data has already
- * been consumed.
- */
-struct ReadStruct {
-    // The total size of `input`.
-    uint32_t length;
-    // The pointer to the raw PNG data.
-    uint8_t *input;
-    // The amount of bytes which have already been read.
-    uint32_t consumed;
-};
+bool decodePng(uint8_t *input, uint32_t inputSize, const DecodeOptions &options, DecodedImage &image, string &error) {
+    // Check if the buffer contains a PNG image at all.
+    if (inputSize < 8 || png_sig_cmp(input, 0, 8)) {
+        error = "Invalid PNG buffer.";
+        return false;
+    }
+    // Store information about the read progres in a separate struct which will be handed into the read function.
+    ReadStruct readStruct{ inputSize, input, 8 };
+    return decodePngFrom(readFromBuffer, &readStruct, options, image, error);
+}
+
+bool decodePngFrom(png_rw_ptr read, png_voidp io, const DecodeOptions &options, DecodedImage &image, string &error) {
+    image.pngPtr = png_create_read_struct(PNG_LIBPNG_VER_STRING, &error, storeError, ignoreWarning);
+    if (!image.pngPtr) {
+        error = "Could not create PNG read struct.";
+        return false;
+    }
+    // Try to grab the info struct from the loaded PNG file.
+    image.infoPtr = png_create_info_struct(image.pngPtr);
+    if (!image.infoPtr) {
+        png_destroy_read_struct(&image.pngPtr, nullptr, nullptr);
+        error = "Could not create PNG info struct.";
+        return false;
+    }
+    // Declared before `setjmp`, so it is cleaned up when libpng jumps back on an error.
+    vector<png_bytep> rows;
+    image.data = nullptr;
+    // libpng will jump to this if an error occured while reading.
+    if (setjmp(png_jmpbuf(image.pngPtr))) {
+        png_destroy_read_struct(&image.pngPtr, &image.infoPtr, nullptr);
+        delete[] image.data;
+        error = "Error decoding PNG buffer: " + error;
+        return false;
+    }
+    auto pngPtr = image.pngPtr;
+    auto infoPtr = image.infoPtr;
+    // This callback will be called each time libpng requests a new chunk.
+    png_set_read_fn(pngPtr, io, read);
+    // Tell libpng that the initial 8 bytes for the header have already been read.
+    png_set_sig_bytes(pngPtr, 8);
+    // Configure checksums and limits before the header is read, as libpng checks the dimensions right away.
+    applyReadPolicy(pngPtr, options);
+    // Stop early if the image is decoded by a job which has been aborted.
+    abortAtRowBoundaries(pngPtr, true);
+    // Read the infos.
+    png_read_info(pngPtr, infoPtr);
+    // Set up the requested transformations. From here on the info struct describes the transformed image.
+    applyDecodeOptions(pngPtr, infoPtr, options);
+    // Reject decompression bombs before allocating the memory for the decoded image.
+    checkDecodedSize(pngPtr, infoPtr, options);
+
+    auto rowCount = png_get_image_height(pngPtr, infoPtr);
+    auto rowBytes = png_get_rowbytes(pngPtr, infoPtr);
+    image.size = rowBytes * rowCount;
+    // A vector is used to address each row of the image inside the 1-dimensional `decoded` array.
+    // Resize the vector to the amount of rows used, assigning each row to `nullptr`.
+    rows.resize(rowCount, nullptr);
+    // Initialize the array into which the decoded data will be written.
+    // This array will be handed to a `Buffer` instance which will take care of freeing the memory.
+    image.data = new png_byte[image.size];
+    // Iterate over every row, and assign the pointer inside the `decoded` array to the element in the vector.
+    // This way each element in the vector points to the beginning of the 2-dimensional row inside the 1-dimensional array.
+    for(size_t row = 0; row < rowCount; ++row) {
+        rows[row] = image.data + row * rowBytes;
+    }
+    png_read_image(pngPtr, &rows[0]);
+    // `error` doesn't outlive this call, but the read struct is handed over to a `PngImage`. Errors raised later on
+    // must not write into it.
+    png_set_error_fn(pngPtr, nullptr, storeError, ignoreWarning);
+    return true;
+}
+
+Local<Object> PngImage::NewInstance(DecodedImage &image) {
+    Nan::EscapableHandleScope scope;
+    // The image is handed to the constructor as an external value instead of a buffer.
+    Local<Value> argv[] = { Nan::New<External>(&image) };
+    return scope.Escape(Nan::NewInstance(constructor(), 1, argv).ToLocalChecked());
+}
 
 NAN_METHOD(PngImage::New) {
     if (info.IsConstructCall()) {
-        // 1st Parameter: The input buffer.
-        Local<Object> inputBuffer = Local<Object>::Cast(info[0]);
-        uint32_t inputSize = Buffer::Length(inputBuffer);
-        uint8_t *input = reinterpret_cast<uint8_t*>(Buffer::Data(inputBuffer));
-
-        // Check if the buffer contains a PNG image at all.
-        if (inputSize < 8 || png_sig_cmp(input, 0, 8)) {
-            Nan::ThrowTypeError("Invalid PNG buffer.");
-            return;
-        }
-
-        auto pngPtr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-        if (!pngPtr) {
-            Nan::ThrowTypeError("Could not create PNG read struct.");
-            return;
-        }
-        // Try to grab the info struct from the loaded PNG file.
-        auto infoPtr = png_create_info_struct(pngPtr);
-        if (!infoPtr) {
-            Nan::ThrowTypeError("Could not create PNG info struct.");
-            return;
-        }
-        // libpng will jump to this if an error occured while reading.
-        if (setjmp(png_jmpbuf(pngPtr))) {
-            Nan::ThrowTypeError("Error decoding PNG buffer.");
-            return;
+        DecodedImage image;
+        if (info[0]->IsExternal()) {
+            // Invoked from `PngImage::NewInstance` with an image which has already been decoded.
+            image = *reinterpret_cast<DecodedImage*>(Local<External>::Cast(info[0])->Value());
+        } else {
+            // 1st Parameter: The input buffer.
+            Local<Object> inputBuffer = Local<Object>::Cast(info[0]);
+            uint32_t inputSize = Buffer::Length(inputBuffer);
+            uint8_t *input = reinterpret_cast<uint8_t*>(Buffer::Data(inputBuffer));
+            // 2nd Parameter: Optional decode options.
+            DecodeOptions options;
+            if (!parseDecodeOptions(info[1], options)) {
+                return;
+            }
+            string error;
+            if (!decodePng(input, inputSize, options, image, error)) {
+                Nan::ThrowTypeError(error.c_str());
+                return;
+            }
         }
         // Create instance of `PngImage`.
-        PngImage* instance = new PngImage(pngPtr, infoPtr);
+        PngImage* instance = new PngImage(image.pngPtr, image.infoPtr);
         instance->Wrap(info.This());
-        // Store information about the read progres in a separate struct which will be handed into the read function.
-        ReadStruct readStruct{ inputSize, input, 8 };
-        // This callback will be called each time libpng requests a new chunk.
-        png_set_read_fn(pngPtr, reinterpret_cast<png_voidp>(&readStruct), [] (png_structp passedStruct, png_bytep target, png_size_t length) {
-            auto readStruct = reinterpret_cast<ReadStruct*>(png_get_io_ptr(passedStruct));
-            memcpy(reinterpret_cast<uint8_t*>(target), readStruct->input + readStruct->consumed, length);
-            readStruct->consumed += length;
-        });
-        // Tell libpng that the initial 8 bytes for the header have already been read.
-        png_set_sig_bytes(pngPtr, 8);
-        // Read the infos.
-        png_read_info(pngPtr, infoPtr);
-
-        auto rowCount = png_get_image_height(pngPtr, infoPtr);
-        auto rowBytes = png_get_rowbytes(pngPtr, infoPtr);
-        auto decodedSize = rowBytes * rowCount;
-        // A vector is used to address each row of the image inside the 1-dimensional `decoded` array.
-        // Resize the vector to the amount of rows used, assigning each row to `nullptr`.
-        vector<png_bytep> rows;
-        rows.resize(rowCount, nullptr);
-        // Initialize the array into which the decoded data will be written.
-        // This array will be handed to a `Buffer` instance which will take care of freeing the memory.
-        auto decoded = new png_byte[decodedSize];
-        // Iterate over every row, and assign the pointer inside the `decoded` array to the element in the vector.
-        // This way each element in the vector points to the beginning of the 2-dimensional row inside the 1-dimensional array.
-        for(size_t row = 0; row < rowCount; ++row) {
-            rows[row] = decoded + row * rowBytes;
-        }
-        png_read_image(pngPtr, &rows[0]);
         // Store the created buffer on the object.
-        Nan::Set(info.This(), Nan::New("data").ToLocalChecked(), Nan::NewBuffer(reinterpret_cast<char*>(decoded), decodedSize).ToLocalChecked());
+        Nan::Set(info.This(), Nan::New("data").ToLocalChecked(), Nan::NewBuffer(reinterpret_cast<char*>(image.data), image.size).ToLocalChecked());
         // Set the return value of the call to the constructor to the newly created instance.
         info.GetReturnValue().Set(info.This());
     } else {
@@ -129,7 +203,7 @@ NAN_METHOD(PngImage::New) {
         for (size_t i = 0; i < args.size(); ++i) {
             args[i] = info[i];
         }
-        auto instance = Nan::NewInstance(Nan::New(constructor), args.size(), args.data());
+        auto instance = Nan::NewInstance(constructor(), args.size(), args.data());
         if (!instance.IsEmpty()) {
             info.GetReturnValue().Set(instance.ToLocalChecked());
         }
@@ -264,7 +338,7 @@ NAN_GETTER(PngImage::getPixelsPerMeterX) {
  */
 NAN_GETTER(PngImage::getPixelsPerMeterY) {
     auto pngImageInstance = Nan::ObjectWrap::Unwrap<PngImage>(info.Holder());
-    double pixelsPerMeterY = png_get_x_pixels_per_meter(pngImageInstance->pngPtr, pngImageInstance->infoPtr);
+    double pixelsPerMeterY = png_get_y_pixels_per_meter(pngImageInstance->pngPtr, pngImageInstance->infoPtr);
     info.GetReturnValue().Set(Nan::New(pixelsPerMeterY));
 }
 
@@ -349,6 +423,26 @@ NAN_GETTER(PngImage::getPalette) {
     info.GetReturnValue().Set(palette);
 }
 
+/**
+ * This getter will return the alpha values of the palette entries, gathered from `png_get_tRNS`.
+ */
+NAN_GETTER(PngImage::getPaletteAlpha) {
+    auto pngImageInstance = Nan::ObjectWrap::Unwrap<PngImage>(info.Holder());
+    png_bytep alphas;
+    int alphaCount;
+    // Only palette images store alpha values per palette entry. Return `undefined` if none are available.
+    if (png_get_color_type(pngImageInstance->pngPtr, pngImageInstance->infoPtr) != PNG_COLOR_TYPE_PALETTE ||
+        png_get_tRNS(pngImageInstance->pngPtr, pngImageInstance->infoPtr, &alphas, &alphaCount, nullptr) == 0) {
+        info.GetReturnValue().Set(Nan::Undefined());
+        return;
+    }
+    Local<Array> paletteAlpha = Nan::New<Array>(alphaCount);
+    for (auto i = 0; i < alphaCount; ++i) {
+        Nan::Set(paletteAlpha, i, Nan::New(static_cast<double>(alphas[i])));
+    }
+    info.GetReturnValue().Set(paletteAlpha);
+}
+
 /**
  * This getter will return the gamma value of the image, gathered from `png_get_gAMA`.
  */
@@ -362,3 +456,66 @@ NAN_GETTER(PngImage::getGamma) {
     }
     info.GetReturnValue().Set(Nan::New(gamma));
 }
+
+/**
+ * This getter will return the text chunks of the image, gathered from `png_get_text`.
+ * Only text chunks before the image data are read.
+ */
+NAN_GETTER(PngImage::getTexts) {
+    auto pngImageInstance = Nan::ObjectWrap::Unwrap<PngImage>(info.Holder());
+    png_textp texts;
+    int textCount = png_get_text(pngImageInstance->pngPtr, pngImageInstance->infoPtr, &texts, nullptr);
+    Local<Array> result = Nan::New<Array>(textCount);
+    for (auto i = 0; i < textCount; ++i) {
+        const auto &text = texts[i];
+        const bool international = text.compression >= PNG_ITXT_COMPRESSION_NONE;
+        Local<Object> entry = Nan::New<Object>();
+        // Keywords and the text of `tEXt` and `zTXt` chunks are Latin-1, only `iTXt` chunks contain UTF-8.
+        Nan::Set(entry, Nan::New("keyword").ToLocalChecked(), Nan::Encode(text.key, strlen(text.key), Nan::BINARY));
+        const auto encoding = international ? Nan::UTF8 : Nan::BINARY;
+        const auto length = international ? text.itxt_length : text.text_length;
+        Nan::Set(entry, Nan::New("text").ToLocalChecked(), Nan::Encode(text.text, length, encoding));
+        if (international) {
+            Nan::Set(entry, Nan::New("language").ToLocalChecked(), Nan::New(text.lang ? text.lang : "").ToLocalChecked());
+        }
+        const bool compressed = text.compression == PNG_TEXT_COMPRESSION_zTXt || text.compression == PNG_ITXT_COMPRESSION_zTXt;
+        Nan::Set(entry, Nan::New("compressed").ToLocalChecked(), Nan::New(compressed));
+        Nan::Set(result, i, entry);
+    }
+    info.GetReturnValue().Set(result);
+}
+
+/**
+ * This getter will return the rendering intent of the sRGB chunk, gathered from `png_get_sRGB`.
+ */
+NAN_GETTER(PngImage::getSrgbIntent) {
+    auto pngImageInstance = Nan::ObjectWrap::Unwrap<PngImage>(info.Holder());
+    int intent;
+    // If no sRGB chunk is present, simply return `undefined`.
+    if (png_get_sRGB(pngImageInstance->pngPtr, pngImageInstance->infoPtr, &intent) == 0) {
+        info.GetReturnValue().Set(Nan::Undefined());
+        return;
+    }
+    info.GetReturnValue().Set(Nan::New(static_cast<double>(intent)));
+}
+
+/**
+ * This getter will return the embedded ICC profile as `{ name, data }`, gathered from `png_get_iCCP`.
+ */
+NAN_GETTER(PngImage::getIccProfile) {
+    auto pngImageInstance = Nan::ObjectWrap::Unwrap<PngImage>(info.Holder());
+    png_charp name;
+    int compressionType;
+    png_bytep profile;
+    png_uint_32 profileLength;
+    // If no ICC profile is embedded, simply return `undefined`.
+    if (png_get_iCCP(pngImageInstance->pngPtr, pngImageInstance->infoPtr, &name, &compressionType, &profile, &profileLength) == 0) {
+        info.GetReturnValue().Set(Nan::Undefined());
+        return;
+    }
+    Local<Object> returnValue = Nan::New<Object>();
+    Nan::Set(returnValue, Nan::New("name").ToLocalChecked(), Nan::Encode(name, strlen(name), Nan::BINARY));
+    // Copy the profile, as it is owned by libpng.
+    Nan::Set(returnValue, Nan::New("data").ToLocalChecked(), Nan::CopyBuffer(reinterpret_cast<char*>(profile), profileLength).ToLocalChecked());
+    info.GetReturnValue().Set(returnValue);
+}
@@ -3,11 +3,41 @@
 
 #include <nan.h>
 #include <png.h>
+#include <string>
 #include <vector>
 
+#include "decode-options.hpp"
+
+/**
+ * An image decoded by `decodePng` which has not yet been handed to a `PngImage` instance.
+ */
+struct DecodedImage {
+    png_structp pngPtr;
+    png_infop infoPtr;
+    // The decoded rows, allocated using `new[]`.
+    png_bytep data;
+    // The size of `data` in bytes.
+    size_t size;
+};
+
+/**
+ * Decodes the PNG in `input` according to the options into `image`.
+ * Doesn't touch any JS values, so it can be called from worker threads.
+ * Returns `false` and sets `error` if the image could not be decoded.
+ */
+bool decodePng(uint8_t *input, uint32_t inputSize, const DecodeOptions &options, DecodedImage &image, std::string &error);
+
+/**
+ * Decodes the PNG read by the callback `read` from `io` like `decodePng`. The signature needs to have been
+ * checked already, so `read` continues with the first chunk.
+ */
+bool decodePngFrom(png_rw_ptr read, png_voidp io, const DecodeOptions &options, DecodedImage &image, std::string &error);
+
 class PngImage : public Nan::ObjectWrap {
     public:
         static NAN_MODULE_INIT(Init);
+        // Creates a new instance taking ownership of an image decoded using `decodePng`.
+        static v8::Local<v8::Object> NewInstance(DecodedImage &image);
 
     private:
         // Define a method for creating a new instance using the `new` keyword.
@@ -28,7 +58,11 @@ class PngImage : public Nan::ObjectWrap {
         static NAN_GETTER(getTime);
         static NAN_GETTER(getBackgroundColor);
         static NAN_GETTER(getPalette);
+        static NAN_GETTER(getPaletteAlpha);
         static NAN_GETTER(getGamma);
+        static NAN_GETTER(getTexts);
+        static NAN_GETTER(getSrgbIntent);
+        static NAN_GETTER(getIccProfile);
 
         // C++ only constructor and destructor.
         explicit PngImage(png_structp &pngPtr, png_infop &infoPtr);
@@ -0,0 +1,113 @@
+#include "png-reader.hpp"
+
+#include <cstring>
+#include <vector>
+
+void readFromBuffer(png_structp pngPtr, png_bytep target, png_size_t length) {
+    auto readStruct = reinterpret_cast<ReadStruct*>(png_get_io_ptr(pngPtr));
+    if (length > readStruct->length - readStruct->consumed) {
+        png_error(pngPtr, "Unexpected end of PNG data.");
+    }
+    memcpy(reinterpret_cast<uint8_t*>(target), readStruct->input + readStruct->consumed, length);
+    readStruct->consumed += length;
+}
+
+bool openPngFile(FileReader &file, std::string &error, bool &readFailed) {
+    readFailed = true;
+    png_byte signature[8];
+    size_t count;
+    if (!file.open(error) || !file.read(signature, 8, count, error)) {
+        return false;
+    }
+    readFailed = false;
+    // Check if the file contains a PNG image at all.
+    if (count < 8 || png_sig_cmp(signature, 0, 8)) {
+        error = "Invalid PNG buffer.";
+        return false;
+    }
+    return true;
+}
+
+void readFromFile(png_structp pngPtr, png_bytep target, png_size_t length) {
+    auto readStruct = reinterpret_cast<FileReadStruct*>(png_get_io_ptr(pngPtr));
+    size_t count;
+    if (!readStruct->file->read(target, length, count, readStruct->readError)) {
+        png_error(pngPtr, readStruct->readError.c_str());
+    }
+    if (count < length) {
+        png_error(pngPtr, "Unexpected end of PNG data.");
+    }
+}
+
+void storeError(png_structp pngPtr, png_const_charp message) {
+    auto error = reinterpret_cast<std::string*>(png_get_error_ptr(pngPtr));
+    if (error) {
+        *error = message;
+    }
+    png_longjmp(pngPtr, 1);
+}
+
+void ignoreWarning(png_structp pngPtr, png_const_charp message) {}
+
+bool readRows(
+    uint8_t *input,
+    uint32_t inputSize,
+    const std::function<void(png_structp, png_infop)> &configure,
+    const std::function<void(const png_byte*, uint32_t, uint32_t, uint32_t)> &visit,
+    std::string &error
+) {
+    // Check if the buffer contains a PNG image at all.
+    if (inputSize < 8 || png_sig_cmp(input, 0, 8)) {
+        error = "Invalid PNG buffer.";
+        return false;
+    }
+    auto pngPtr = png_create_read_struct(PNG_LIBPNG_VER_STRING, &error, storeError, ignoreWarning);
+    if (!pngPtr) {
+        error = "Could not create PNG read struct.";
+        return false;
+    }
+    auto infoPtr = png_create_info_struct(pngPtr);
+    if (!infoPtr) {
+        png_destroy_read_struct(&pngPtr, nullptr, nullptr);
+        error = "Could not create PNG info struct.";
+        return false;
+    }
+    // Declared before `setjmp` so they are cleaned up when libpng jumps back on an error.
+    std::vector<png_byte> decoded;
+    std::vector<png_bytep> rows;
+    // libpng will jump to this if an error occured while reading.
+    if (setjmp(png_jmpbuf(pngPtr))) {
+        png_destroy_read_struct(&pngPtr, &infoPtr, nullptr);
+        return false;
+    }
+    ReadStruct readStruct{ inputSize, input, 8 };
+    png_set_read_fn(pngPtr, reinterpret_cast<png_voidp>(&readStruct), readFromBuffer);
+    png_set_sig_bytes(pngPtr, 8);
+    png_read_info(pngPtr, infoPtr);
+    configure(pngPtr, infoPtr);
+
+    const auto width = png_get_image_width(pngPtr, infoPtr);
+    const auto height = png_get_image_height(pngPtr, infoPtr);
+    const auto rowBytes = png_get_rowbytes(pngPtr, infoPtr);
+    if (png_get_interlace_type(pngPtr, infoPtr) == PNG_INTERLACE_NONE) {
+        decoded.resize(rowBytes);
+        for (uint32_t y = 0; y < height; ++y) {
+            png_read_row(pngPtr, decoded.data(), nullptr);
+            visit(decoded.data(), y, width, height);
+        }
+    } else {
+        // The rows of interlaced images are only complete after the last pass.
+        decoded.resize(rowBytes * height);
+        rows.resize(height);
+        for (uint32_t y = 0; y < height; ++y) {
+            rows[y] = decoded.data() + y * rowBytes;
+        }
+        png_read_image(pngPtr, rows.data());
+        for (uint32_t y = 0; y < height; ++y) {
+            visit(rows[y], y, width, height);
+        }
+    }
+    png_read_end(pngPtr, nullptr);
+    png_destroy_read_struct(&pngPtr, &infoPtr, nullptr);
+    return true;
+}
@@ -0,0 +1,81 @@
+#ifndef PNG_READER_HPP
+#define PNG_READER_HPP
+
+#include <png.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "file-reader.hpp"
+
+/**
+ * This struct is used when reading (decoding) the PNG image into a raw buffer.
+ * It stores information about the data which should be read and how much data has already
+ * been consumed.
+ */
+struct ReadStruct {
+    // The total size of `input`.
+    uint32_t length;
+    // The pointer to the raw PNG data.
+    uint8_t *input;
+    // The amount of bytes which have already been read.
+    uint32_t consumed;
+};
+
+/**
+ * Read callback for `png_set_read_fn` reading from a `ReadStruct` handed in as io pointer.
+ * Raises a libpng error when reading beyond the end of the input.
+ */
+void readFromBuffer(png_structp pngPtr, png_bytep target, png_size_t length);
+
+/**
+ * This struct is used when decoding a PNG image straight from a file, so only the buffer of the
+ * `FileReader` is kept in memory instead of the whole encoded image.
+ */
+struct FileReadStruct {
+    FileReader *file;
+    // Set if reading the file failed, to tell it apart from invalid image data.
+    std::string readError;
+};
+
+/**
+ * Opens `file` and reads the PNG signature, so libpng can continue with the first chunk.
+ * Returns `false` and sets `error` if that failed. `readFailed` tells read errors and files which aren't PNGs apart.
+ */
+bool openPngFile(FileReader &file, std::string &error, bool &readFailed);
+
+/**
+ * Read callback for `png_set_read_fn` reading from a `FileReadStruct` handed in as io pointer.
+ * Raises a libpng error when the file could not be read or ends early, such as when it was truncated
+ * while being decoded.
+ */
+void readFromFile(png_structp pngPtr, png_bytep target, png_size_t length);
+
+/**
+ * Error callback for libpng storing the message in the `std::string` handed in as error pointer
+ * before jumping back to the `setjmp` call.
+ */
+void storeError(png_structp pngPtr, png_const_charp message);
+
+/**
+ * Warning callback for libpng discarding all warnings.
+ */
+void ignoreWarning(png_structp pngPtr, png_const_charp message);
+
+/**
+ * Decodes the PNG in `input` row by row.
+ * `configure(pngPtr, infoPtr)` is called after the header has been read. It should set up the read transformations
+ * and needs to finish with `png_read_update_info`. It may call `png_error` to abort decoding.
+ * `visit(row, y, width, height)` is then called for every row of the transformed image, from top to bottom.
+ * Only a single row is kept in memory unless the image is interlaced.
+ * Returns `false` and sets `error` if the image could not be decoded.
+ */
+bool readRows(
+    uint8_t *input,
+    uint32_t inputSize,
+    const std::function<void(png_structp, png_infop)> &configure,
+    const std::function<void(const png_byte*, uint32_t, uint32_t, uint32_t)> &visit,
+    std::string &error
+);
+
+#endif
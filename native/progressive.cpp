@@ -0,0 +1,183 @@
+#include "progressive.hpp"
+#include "png-image.hpp"
+#include "png-reader.hpp"
+
+#include <node.h>
+#include <node_buffer.h>
+#include <string>
+#include <vector>
+
+using namespace node;
+using namespace v8;
+using namespace std;
+
+ProgressiveDecoder::ProgressiveDecoder(const DecodeOptions &options) :
+    options(options), pngPtr(nullptr), infoPtr(nullptr), data(nullptr), rowBytes(0), height(0), pass(-1), complete(false) {}
+
+ProgressiveDecoder::~ProgressiveDecoder() {
+    // Both are `nullptr` if the image has been handed over to a `PngImage`, which is fine for libpng and `delete[]`.
+    png_destroy_read_struct(&pngPtr, &infoPtr, nullptr);
+    delete[] data;
+}
+
+NAN_MODULE_INIT(ProgressiveDecoder::Init) {
+    Nan::HandleScope scope;
+    auto ctor = Nan::New<FunctionTemplate>(ProgressiveDecoder::New);
+    ctor->SetClassName(Nan::New("__native_ProgressiveDecoder").ToLocalChecked());
+    ctor->InstanceTemplate()->SetInternalFieldCount(1);
+    Nan::SetPrototypeMethod(ctor, "push", ProgressiveDecoder::push);
+    Nan::SetPrototypeMethod(ctor, "header", ProgressiveDecoder::header);
+    Nan::SetPrototypeMethod(ctor, "finish", ProgressiveDecoder::finish);
+    // Instances are only ever created from JS, so the constructor doesn't need to be kept per isolate.
+    Nan::Set(target, Nan::New("__native_ProgressiveDecoder").ToLocalChecked(), Nan::GetFunction(ctor).ToLocalChecked());
+}
+
+NAN_METHOD(ProgressiveDecoder::New) {
+    if (!info.IsConstructCall()) {
+        Nan::ThrowTypeError("ProgressiveDecoder needs to be called with `new`.");
+        return;
+    }
+    // 1st Parameter: Optional decode options.
+    DecodeOptions options;
+    if (!parseDecodeOptions(info[0], options)) {
+        return;
+    }
+    auto decoder = new ProgressiveDecoder(options);
+    decoder->Wrap(info.This());
+    decoder->pngPtr = png_create_read_struct(PNG_LIBPNG_VER_STRING, &decoder->error, storeError, ignoreWarning);
+    if (!decoder->pngPtr) {
+        Nan::ThrowError("Could not create PNG read struct.");
+        return;
+    }
+    decoder->infoPtr = png_create_info_struct(decoder->pngPtr);
+    if (!decoder->infoPtr) {
+        png_destroy_read_struct(&decoder->pngPtr, nullptr, nullptr);
+        Nan::ThrowError("Could not create PNG info struct.");
+        return;
+    }
+    png_set_progressive_read_fn(decoder->pngPtr, decoder, readInfo, readRow, readEnd);
+    // Configure checksums and limits before the header is read, as libpng checks the dimensions right away.
+    applyReadPolicy(decoder->pngPtr, options);
+    info.GetReturnValue().Set(info.This());
+}
+
+void ProgressiveDecoder::readInfo(png_structp pngPtr, png_infop infoPtr) {
+    auto decoder = reinterpret_cast<ProgressiveDecoder*>(png_get_progressive_ptr(pngPtr));
+    // Also enables libpng's interlace handling, so every pass is combined into the full size rows.
+    applyDecodeOptions(pngPtr, infoPtr, decoder->options);
+    checkDecodedSize(pngPtr, infoPtr, decoder->options);
+    decoder->rowBytes = png_get_rowbytes(pngPtr, infoPtr);
+    decoder->height = png_get_image_height(pngPtr, infoPtr);
+    // Zeroed, as the rows of an interlaced image are combined with what has been decoded before.
+    decoder->data = new png_byte[decoder->rowBytes * decoder->height]();
+}
+
+void ProgressiveDecoder::readRow(png_structp pngPtr, png_bytep row, png_uint_32 rowNumber, int pass) {
+    auto decoder = reinterpret_cast<ProgressiveDecoder*>(png_get_progressive_ptr(pngPtr));
+    // The first row of a new pass means all previous passes are complete. Passes which are empty
+    // for small images are skipped by libpng, so `pass` is the amount of passes decoded so far.
+    if (pass != decoder->pass) {
+        if (decoder->pass != -1) {
+            auto size = decoder->rowBytes * decoder->height;
+            decoder->previews.push_back({ pass, vector<png_byte>(decoder->data, decoder->data + size) });
+        }
+        decoder->pass = pass;
+    }
+    // libpng combines the rows using its "blocky" display mode, replicating every pixel decoded so far over
+    // the pixels of the later passes. `row` is `nullptr` for rows not touched by the current pass.
+    png_progressive_combine_row(pngPtr, decoder->data + rowNumber * decoder->rowBytes, row);
+}
+
+void ProgressiveDecoder::readEnd(png_structp pngPtr, png_infop infoPtr) {
+    auto decoder = reinterpret_cast<ProgressiveDecoder*>(png_get_progressive_ptr(pngPtr));
+    decoder->complete = true;
+}
+
+NAN_METHOD(ProgressiveDecoder::push) {
+    auto decoder = Nan::ObjectWrap::Unwrap<ProgressiveDecoder>(info.Holder());
+    if (!decoder->pngPtr) {
+        Nan::ThrowError("The decoder has already failed or finished.");
+        return;
+    }
+    // 1st Parameter: The next chunk of the encoded image.
+    if (!info[0]->IsUint8Array()) {
+        Nan::ThrowTypeError("Chunk needs to be a buffer.");
+        return;
+    }
+    Local<Object> chunkBuffer = Local<Object>::Cast(info[0]);
+    auto chunk = reinterpret_cast<png_bytep>(Buffer::Data(chunkBuffer));
+    auto chunkSize = Buffer::Length(chunkBuffer);
+    decoder->previews.clear();
+    // libpng will jump to this if an error occured while decoding the chunk. The decoder can't be used afterwards.
+    if (setjmp(png_jmpbuf(decoder->pngPtr))) {
+        png_destroy_read_struct(&decoder->pngPtr, &decoder->infoPtr, nullptr);
+        delete[] decoder->data;
+        decoder->data = nullptr;
+        decoder->previews.clear();
+        Nan::ThrowTypeError(("Error decoding PNG: " + decoder->error).c_str());
+        return;
+    }
+    // Data following the end of the image is ignored.
+    if (!decoder->complete) {
+        png_process_data(decoder->pngPtr, decoder->infoPtr, chunk, chunkSize);
+    }
+    // Hand the previews of all passes completed by the chunk over to JS.
+    auto result = Nan::New<Array>(decoder->previews.size());
+    for (size_t index = 0; index < decoder->previews.size(); ++index) {
+        auto &preview = decoder->previews[index];
+        auto object = Nan::New<Object>();
+        Nan::Set(object, Nan::New("pass").ToLocalChecked(), Nan::New(static_cast<double>(preview.pass)));
+        Nan::Set(object, Nan::New("data").ToLocalChecked(), Nan::CopyBuffer(
+            reinterpret_cast<char*>(preview.data.data()),
+            preview.data.size()
+        ).ToLocalChecked());
+        Nan::Set(result, index, object);
+    }
+    decoder->previews.clear();
+    info.GetReturnValue().Set(result);
+}
+
+NAN_METHOD(ProgressiveDecoder::header) {
+    auto decoder = Nan::ObjectWrap::Unwrap<ProgressiveDecoder>(info.Holder());
+    if (!decoder->data) {
+        return;
+    }
+    auto pngPtr = decoder->pngPtr;
+    auto infoPtr = decoder->infoPtr;
+    // The info struct describes the transformed image, as `applyDecodeOptions` already updated it.
+    auto result = Nan::New<Object>();
+    double width = png_get_image_width(pngPtr, infoPtr);
+    double height = png_get_image_height(pngPtr, infoPtr);
+    double channels = png_get_channels(pngPtr, infoPtr);
+    double bitDepth = png_get_bit_depth(pngPtr, infoPtr);
+    Nan::Set(result, Nan::New("width").ToLocalChecked(), Nan::New(width));
+    Nan::Set(result, Nan::New("height").ToLocalChecked(), Nan::New(height));
+    Nan::Set(result, Nan::New("channels").ToLocalChecked(), Nan::New(channels));
+    Nan::Set(result, Nan::New("bitDepth").ToLocalChecked(), Nan::New(bitDepth));
+    Nan::Set(
+        result,
+        Nan::New("interlaced").ToLocalChecked(),
+        Nan::New(png_get_interlace_type(pngPtr, infoPtr) == PNG_INTERLACE_ADAM7)
+    );
+    info.GetReturnValue().Set(result);
+}
+
+NAN_METHOD(ProgressiveDecoder::finish) {
+    auto decoder = Nan::ObjectWrap::Unwrap<ProgressiveDecoder>(info.Holder());
+    if (!decoder->pngPtr) {
+        Nan::ThrowError("The decoder has already failed or finished.");
+        return;
+    }
+    if (!decoder->complete) {
+        Nan::ThrowTypeError("Error decoding PNG: Unexpected end of PNG data.");
+        return;
+    }
+    // The decoder's `error` member doesn't live as long as the `PngImage`, so errors raised later on must not write into it.
+    png_set_error_fn(decoder->pngPtr, nullptr, storeError, ignoreWarning);
+    // The new `PngImage` takes ownership of the structs and the decoded rows.
+    DecodedImage image{ decoder->pngPtr, decoder->infoPtr, decoder->data, decoder->rowBytes * decoder->height };
+    decoder->pngPtr = nullptr;
+    decoder->infoPtr = nullptr;
+    decoder->data = nullptr;
+    info.GetReturnValue().Set(PngImage::NewInstance(image));
+}
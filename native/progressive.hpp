@@ -0,0 +1,64 @@
+#ifndef PROGRESSIVE_HPP
+#define PROGRESSIVE_HPP
+
+#include <nan.h>
+#include <png.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "decode-options.hpp"
+
+/**
+ * The image as it looked after an Adam7 pass had been decoded.
+ */
+struct PassPreview {
+    // The amount of passes decoded so far, between `1` and `6`.
+    int pass;
+    // The decoded image with each pixel of the passes so far replicated over the pixels of later passes.
+    std::vector<png_byte> data;
+};
+
+/**
+ * Decodes a PNG image from chunks of data as they arrive, using libpng's progressive reader.
+ * Interlaced images produce a preview of the whole image after every pass but the last one.
+ */
+class ProgressiveDecoder : public Nan::ObjectWrap {
+    public:
+        static NAN_MODULE_INIT(Init);
+
+    private:
+        static NAN_METHOD(New);
+        // Decodes the next chunk of data, returning the previews of all passes completed by it.
+        static NAN_METHOD(push);
+        // Returns the header of the image, or `undefined` if it hasn't been read yet.
+        static NAN_METHOD(header);
+        // Hands the decoded image over to a new `PngImage` instance.
+        static NAN_METHOD(finish);
+
+        // Callbacks for `png_set_progressive_read_fn`.
+        static void readInfo(png_structp pngPtr, png_infop infoPtr);
+        static void readRow(png_structp pngPtr, png_bytep row, png_uint_32 rowNumber, int pass);
+        static void readEnd(png_structp pngPtr, png_infop infoPtr);
+
+        explicit ProgressiveDecoder(const DecodeOptions &options);
+        ~ProgressiveDecoder();
+
+        DecodeOptions options;
+        png_structp pngPtr;
+        png_infop infoPtr;
+        // The message of the last libpng error.
+        std::string error;
+        // The decoded image, allocated using `new[]` once the header has been read.
+        png_bytep data;
+        size_t rowBytes;
+        uint32_t height;
+        // The pass of the last row received, or `-1` if no row has been received yet.
+        int pass;
+        // Whether all rows of the image have been decoded.
+        bool complete;
+        // Previews collected while processing the current chunk.
+        std::vector<PassPreview> previews;
+};
+
+#endif
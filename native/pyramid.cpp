@@ -0,0 +1,375 @@
+#include <png.h>
+#include <node_buffer.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "pyramid.hpp"
+#include "bands.hpp"
+#include "encode.hpp"
+#include "file-reader.hpp"
+#include "file-writer.hpp"
+#include "png-reader.hpp"
+#include "scheduler.hpp"
+
+using namespace node;
+using namespace v8;
+using namespace std;
+
+/**
+ * One level of the pyramid. Only the band of rows which is currently filled is kept in memory.
+ */
+struct PyramidLevel {
+    // The number of the level in the directory structure. The full resolution has the highest number.
+    uint32_t number;
+    uint32_t width;
+    uint32_t height;
+    // The amount of rows which have been completed.
+    uint32_t rows;
+    // `tileSize` rows of the level. Row `y` is stored at `y % tileSize`.
+    vector<uint8_t> band;
+};
+
+/**
+ * Reduces two rows into one row of half the width by averaging blocks of 2x2 pixels. The last column is repeated
+ * for odd widths and `bottom` may be the same as `top` for odd heights. Colors are weighted by their alpha,
+ * so transparent pixels don't darken their neighbours.
+ */
+static void reduceRows(const uint8_t *top, const uint8_t *bottom, uint32_t width, uint32_t channels, uint8_t *target) {
+    const auto reducedWidth = (width + 1) / 2;
+    for (uint32_t x = 0; x < reducedWidth; ++x) {
+        const auto left = static_cast<size_t>(2 * x) * channels;
+        const auto right = static_cast<size_t>(min(2 * x + 1, width - 1)) * channels;
+        const uint8_t *pixels[] = { top + left, top + right, bottom + left, bottom + right };
+        uint8_t *output = target + static_cast<size_t>(x) * channels;
+        if (channels == 3) {
+            for (uint32_t channel = 0; channel < 3; ++channel) {
+                const uint32_t sum = pixels[0][channel] + pixels[1][channel] + pixels[2][channel] + pixels[3][channel];
+                output[channel] = static_cast<uint8_t>((sum + 2) / 4);
+            }
+            continue;
+        }
+        const uint32_t alpha = pixels[0][3] + pixels[1][3] + pixels[2][3] + pixels[3][3];
+        for (uint32_t channel = 0; channel < 3; ++channel) {
+            uint32_t weighted = 0;
+            for (const auto pixel : pixels) {
+                weighted += pixel[channel] * pixel[3];
+            }
+            output[channel] = alpha == 0 ? 0 : static_cast<uint8_t>((weighted + alpha / 2) / alpha);
+        }
+        output[3] = static_cast<uint8_t>((alpha + 2) / 4);
+    }
+}
+
+/**
+ * Collects the rows of all levels and writes their tiles.
+ */
+class PyramidBuilder {
+    public:
+        PyramidBuilder(const PyramidParameters &parameters) : parameters(parameters), channels(0), tiles(0), ioFailed(false) {}
+
+        /**
+         * Creates the levels for an image of the given size and the directories for their tiles.
+         */
+        bool start(uint32_t width, uint32_t height, uint32_t imageChannels, string &error) {
+            channels = imageChannels;
+            // Halve the size until a single pixel is left.
+            uint32_t count = 1;
+            for (auto size = max(width, height); size > 1; size = (size + 1) / 2) {
+                ++count;
+            }
+            levels.resize(count);
+            for (uint32_t index = 0; index < count; ++index) {
+                auto &level = levels[index];
+                level.number = count - 1 - index;
+                level.width = index == 0 ? width : (levels[index - 1].width + 1) / 2;
+                level.height = index == 0 ? height : (levels[index - 1].height + 1) / 2;
+                level.rows = 0;
+                level.band.resize(static_cast<size_t>(level.width) * channels * min(parameters.tileSize, level.height));
+            }
+            root = parameters.layout == PyramidLayout::DZI ? parameters.outputPath + "_files" : parameters.outputPath;
+            if (!createDirectory(root, error)) {
+                ioFailed = true;
+                return false;
+            }
+            for (const auto &level : levels) {
+                if (!createDirectory(root + "/" + to_string(level.number), error)) {
+                    ioFailed = true;
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * Returns where the next row of the level needs to be written to.
+         */
+        uint8_t *nextRow(size_t index) {
+            auto &level = levels[index];
+            return level.band.data() + static_cast<size_t>(level.rows % parameters.tileSize) * level.width * channels;
+        }
+
+        /**
+         * Called once the next row of the level has been written. Reduces every second row into the next level and
+         * writes the tiles of the band once it is complete.
+         */
+        bool completeRow(size_t index, string &error) {
+            auto &level = levels[index];
+            const auto y = level.rows;
+            const auto *row = nextRow(index);
+            ++level.rows;
+            const bool last = level.rows == level.height;
+            // The rows of a pair are in different slots of the band as long as tiles span at least two rows,
+            // so the even row is still there when the odd one arrives.
+            if (index + 1 < levels.size() && (y % 2 == 1 || last)) {
+                const auto *top = y % 2 == 1 ? level.band.data() + static_cast<size_t>((y - 1) % parameters.tileSize) * level.width * channels : row;
+                reduceRows(top, row, level.width, channels, nextRow(index + 1));
+                if (!completeRow(index + 1, error)) {
+                    return false;
+                }
+            }
+            if (level.rows % parameters.tileSize == 0 || last) {
+                return writeBand(level, y / parameters.tileSize, y % parameters.tileSize + 1, error);
+            }
+            return true;
+        }
+
+        uint32_t levelCount() const { return static_cast<uint32_t>(levels.size()); }
+
+        uint32_t tileCount() const { return tiles; }
+
+        bool failedWriting() const { return ioFailed; }
+
+    private:
+        string tilePath(const PyramidLevel &level, uint32_t column, uint32_t row) const {
+            const auto directory = root + "/" + to_string(level.number) + "/";
+            if (parameters.layout == PyramidLayout::DZI) {
+                return directory + to_string(column) + "_" + to_string(row) + ".png";
+            }
+            return directory + to_string(column) + "/" + to_string(row) + ".png";
+        }
+
+        /**
+         * Encodes and writes the tiles of a complete band. The tiles are encoded in parallel straight from the band.
+         */
+        bool writeBand(const PyramidLevel &level, uint32_t bandRow, uint32_t rows, string &error) {
+            const auto columns = (level.width + parameters.tileSize - 1) / parameters.tileSize;
+            if (parameters.layout == PyramidLayout::ZXY && bandRow == 0) {
+                for (uint32_t column = 0; column < columns; ++column) {
+                    if (!createDirectory(root + "/" + to_string(level.number) + "/" + to_string(column), error)) {
+                        ioFailed = true;
+                        return false;
+                    }
+                }
+            }
+            const size_t stride = static_cast<size_t>(level.width) * channels;
+            mutex errorLock;
+            atomic<bool> failed(false);
+            forEachInJob(columns, stride * rows >= parallelThreshold, [&] (uint32_t column) {
+                if (failed) {
+                    return;
+                }
+                EncodeParameters tile = {};
+                tile.input = const_cast<uint8_t*>(level.band.data()) + static_cast<size_t>(column) * parameters.tileSize * channels;
+                tile.stride = stride;
+                tile.width = min(parameters.tileSize, level.width - column * parameters.tileSize);
+                tile.height = rows;
+                tile.alpha = channels == 4;
+                tile.compression = parameters.compressionLevel;
+                vector<uint8_t> encoded;
+                string tileError;
+                FileWriter writer(tilePath(level, column, bandRow), false);
+                const bool written = encodePng(tile, &encoded, appendToVector, tileError) &&
+                    writer.open(tileError) && writer.write(encoded.data(), encoded.size(), tileError) &&
+                    writer.commit(false, tileError);
+                if (!written) {
+                    lock_guard<mutex> guard(errorLock);
+                    if (!failed) {
+                        error = tileError;
+                    }
+                    failed = true;
+                }
+            });
+            if (failed) {
+                ioFailed = true;
+                return false;
+            }
+            tiles += columns;
+            return true;
+        }
+
+        const PyramidParameters &parameters;
+        // The levels, starting with the full resolution.
+        vector<PyramidLevel> levels;
+        string root;
+        uint32_t channels;
+        uint32_t tiles;
+        bool ioFailed;
+};
+
+/**
+ * Decodes the image read by the callback `read` from `io` row by row straight into the band of the first level.
+ * The signature needs to have been checked already.
+ */
+static bool decodeIntoPyramid(png_rw_ptr read, png_voidp io, const PyramidParameters &parameters, PyramidResult &result, string &error, bool &ioFailed) {
+    png_structp pngPtr = png_create_read_struct(PNG_LIBPNG_VER_STRING, &error, storeError, ignoreWarning);
+    png_infop infoPtr = pngPtr ? png_create_info_struct(pngPtr) : nullptr;
+    if (!infoPtr) {
+        png_destroy_read_struct(&pngPtr, nullptr, nullptr);
+        error = "Unable to initialize libpng.";
+        return false;
+    }
+    // Declared before `setjmp` so it is cleaned up when libpng jumps back on an error.
+    PyramidBuilder builder(parameters);
+    if (setjmp(png_jmpbuf(pngPtr))) {
+        png_destroy_read_struct(&pngPtr, &infoPtr, nullptr);
+        error = "Error decoding PNG: " + error;
+        return false;
+    }
+    png_set_read_fn(pngPtr, io, read);
+    png_set_sig_bytes(pngPtr, 8);
+    applyReadPolicy(pngPtr, parameters.decodeOptions);
+    abortAtRowBoundaries(pngPtr, true);
+    png_read_info(pngPtr, infoPtr);
+    // The rows of interlaced images are only complete after the last pass, which would need the whole image.
+    if (png_get_interlace_type(pngPtr, infoPtr) != PNG_INTERLACE_NONE) {
+        png_error(pngPtr, "Interlaced images can't be tiled row by row.");
+    }
+    // Tiles of opaque images are encoded without alpha channel.
+    DecodeOptions options = parameters.decodeOptions;
+    const bool alpha = (png_get_color_type(pngPtr, infoPtr) & PNG_COLOR_MASK_ALPHA) || png_get_valid(pngPtr, infoPtr, PNG_INFO_tRNS);
+    options.output = alpha ? DecodeOutput::RGBA8 : DecodeOutput::RGB8;
+    options.premultiplied = false;
+    options.linear = false;
+    applyDecodeOptions(pngPtr, infoPtr, options);
+    const auto width = png_get_image_width(pngPtr, infoPtr);
+    const auto height = png_get_image_height(pngPtr, infoPtr);
+    if (!builder.start(width, height, png_get_channels(pngPtr, infoPtr), error)) {
+        png_destroy_read_struct(&pngPtr, &infoPtr, nullptr);
+        ioFailed = builder.failedWriting();
+        return false;
+    }
+    for (uint32_t y = 0; y < height; ++y) {
+        png_read_row(pngPtr, builder.nextRow(0), nullptr);
+        if (!builder.completeRow(0, error)) {
+            png_destroy_read_struct(&pngPtr, &infoPtr, nullptr);
+            ioFailed = builder.failedWriting();
+            return false;
+        }
+    }
+    png_read_end(pngPtr, nullptr);
+    png_destroy_read_struct(&pngPtr, &infoPtr, nullptr);
+    result = { width, height, builder.levelCount(), builder.tileCount() };
+    return true;
+}
+
+bool generatePyramidTiles(const PyramidParameters &parameters, PyramidResult &result, string &error, bool &ioFailed) {
+    ioFailed = false;
+    if (parameters.inputPath.empty()) {
+        if (parameters.inputSize < 8 || png_sig_cmp(parameters.input, 0, 8)) {
+            error = "Invalid PNG buffer.";
+            return false;
+        }
+        ReadStruct readStruct{ parameters.inputSize, parameters.input, 8 };
+        return decodeIntoPyramid(readFromBuffer, &readStruct, parameters, result, error, ioFailed);
+    }
+    // The file is read through a fixed size buffer, so a file truncated while it is decoded is reported as invalid.
+    FileReader file(parameters.inputPath);
+    if (!openPngFile(file, error, ioFailed)) {
+        return false;
+    }
+    FileReadStruct readStruct{ &file, "" };
+    if (!decodeIntoPyramid(readFromFile, &readStruct, parameters, result, error, ioFailed)) {
+        if (!readStruct.readError.empty()) {
+            error = readStruct.readError;
+            ioFailed = true;
+        }
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Generates a pyramid on a thread of the scheduler's pool.
+ */
+class GeneratePyramidWorker : public ScheduledWorker {
+    public:
+        GeneratePyramidWorker(Nan::Callback *callback, const PyramidParameters &parameters) :
+            ScheduledWorker(callback, "node-libpng:generatePyramid"), parameters(parameters), ioFailed(false) {}
+
+        void Execute() override {
+            string error;
+            if (!generatePyramidTiles(parameters, result, error, ioFailed)) {
+                SetErrorMessage(error.c_str());
+            }
+        }
+
+    protected:
+        void HandleOKCallback() override {
+            Nan::HandleScope scope;
+            Local<Object> pyramid = Nan::New<Object>();
+            Nan::Set(pyramid, Nan::New("width").ToLocalChecked(), Nan::New(static_cast<double>(result.width)));
+            Nan::Set(pyramid, Nan::New("height").ToLocalChecked(), Nan::New(static_cast<double>(result.height)));
+            Nan::Set(pyramid, Nan::New("levels").ToLocalChecked(), Nan::New(static_cast<double>(result.levels)));
+            Nan::Set(pyramid, Nan::New("tiles").ToLocalChecked(), Nan::New(static_cast<double>(result.tiles)));
+            Local<Value> argv[] = { Nan::Null(), pyramid };
+            callback->Call(2, argv, async_resource);
+        }
+
+        void HandleErrorCallback() override {
+            Nan::HandleScope scope;
+            // Decoding errors are type errors, the same as when decoding a buffer.
+            Local<Value> argv[] = { ioFailed ? Nan::Error(ErrorMessage()) : Nan::TypeError(ErrorMessage()) };
+            callback->Call(1, argv, async_resource);
+        }
+
+    private:
+        PyramidParameters parameters;
+        PyramidResult result;
+        bool ioFailed;
+};
+
+NAN_METHOD(generatePyramid) {
+    PyramidParameters parameters;
+    // 1st Parameter: The buffer with the encoded image or the path of the file to read it from.
+    if (Buffer::HasInstance(info[0])) {
+        if (Buffer::Length(info[0]) > UINT32_MAX) {
+            Nan::ThrowError("Input buffer is too large.");
+            return;
+        }
+        parameters.input = reinterpret_cast<uint8_t*>(Buffer::Data(info[0]));
+        parameters.inputSize = static_cast<uint32_t>(Buffer::Length(info[0]));
+    } else {
+        parameters.input = nullptr;
+        parameters.inputSize = 0;
+        parameters.inputPath = *Nan::Utf8String(info[0]);
+    }
+    // 2nd Parameter: The path to write the tiles to.
+    parameters.outputPath = *Nan::Utf8String(info[1]);
+    // 3rd Parameter: Whether to use the ZXY layout instead of DZI.
+    parameters.layout = Nan::To<bool>(info[2]).FromMaybe(false) ? PyramidLayout::ZXY : PyramidLayout::DZI;
+    // 4th Parameter: The width and height of the tiles, at least 2.
+    parameters.tileSize = max(2u, Nan::To<uint32_t>(info[3]).FromMaybe(256));
+    // 5th Parameter: The compression level of the tiles.
+    parameters.compressionLevel = Nan::To<uint32_t>(info[4]).FromMaybe(6);
+    // 6th Parameter: Optional decode options, of which only `trusted` and `limits` are used.
+    if (!parseDecodeOptions(info[5], parameters.decodeOptions)) {
+        return;
+    }
+    // 7th Parameter: Whether to queue the job in the batch lane.
+    const auto priority = parseJobPriority(info[6]);
+    // 8th Parameter: The callback to call with an error or the size of the pyramid.
+    auto callback = new Nan::Callback(Local<Function>::Cast(info[7]));
+    auto worker = new GeneratePyramidWorker(callback, parameters);
+    // Keep the input buffer alive while it is decoded on the pool.
+    worker->SaveToPersistent("input", info[0]);
+    const auto id = scheduleWorker(worker, priority);
+    info.GetReturnValue().Set(Nan::New(static_cast<double>(id)));
+}
+
+NAN_MODULE_INIT(InitPyramid) {
+    Nan::Set(target, Nan::New("__native_generatePyramid").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(generatePyramid)).ToLocalChecked());
+}
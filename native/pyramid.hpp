@@ -0,0 +1,61 @@
+#ifndef PYRAMID_HPP
+#define PYRAMID_HPP
+
+#include <nan.h>
+#include <cstdint>
+#include <string>
+
+#include "decode-options.hpp"
+
+/**
+ * The directory structure the tiles are written in.
+ */
+enum class PyramidLayout {
+    // `<path>_files/<level>/<column>_<row>.png`, as expected by Deep Zoom viewers.
+    DZI,
+    // `<path>/<level>/<column>/<row>.png`, as expected by most map viewers.
+    ZXY,
+};
+
+/**
+ * Describes a pyramid to generate.
+ */
+struct PyramidParameters {
+    // The encoded image, unless `inputPath` is set.
+    uint8_t *input;
+    uint32_t inputSize;
+    // The path of the file to read the encoded image from, or empty to read from `input`.
+    std::string inputPath;
+    std::string outputPath;
+    PyramidLayout layout;
+    uint32_t tileSize;
+    uint32_t compressionLevel;
+    // Only `trusted` and the limits are used, the image is always decoded as 8 bit RGB or RGBA.
+    DecodeOptions decodeOptions;
+};
+
+/**
+ * Describes a generated pyramid.
+ */
+struct PyramidResult {
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;
+    uint32_t tiles;
+};
+
+/**
+ * Decodes the image row by row and writes the tiles of every level as soon as a band of `tileSize` rows is complete.
+ * Each level only keeps one band in memory. The rows of each level are reduced into the next level while they
+ * arrive and the tiles of a band are encoded in parallel.
+ * Doesn't touch any JS values, so it can be called from worker threads.
+ * Returns `false` and sets `error` if the image could not be decoded or a tile could not be written.
+ * `ioFailed` tells both cases apart.
+ */
+bool generatePyramidTiles(const PyramidParameters &parameters, PyramidResult &result, std::string &error, bool &ioFailed);
+
+NAN_METHOD(generatePyramid);
+
+NAN_MODULE_INIT(InitPyramid);
+
+#endif
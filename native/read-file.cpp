@@ -0,0 +1,114 @@
+#include <png.h>
+#include <cstdint>
+#include <string>
+
+#include "read-file.hpp"
+#include "decode-options.hpp"
+#include "file-reader.hpp"
+#include "png-image.hpp"
+#include "png-reader.hpp"
+#include "scheduler.hpp"
+
+using namespace v8;
+using namespace std;
+
+/**
+ * Decodes the file at `path` while reading it through a fixed size buffer, so the encoded data is never held
+ * in memory as a whole. A file which is truncated while it is decoded is reported as invalid PNG data.
+ * Doesn't touch any JS values, so it can be called from worker threads.
+ * Returns `false` and sets `error` if the file could not be read or decoded. `readFailed` tells both cases apart.
+ */
+static bool decodeFile(const string &path, const DecodeOptions &options, DecodedImage &image, string &error, bool &readFailed) {
+    FileReader file(path);
+    if (!openPngFile(file, error, readFailed)) {
+        return false;
+    }
+    FileReadStruct readStruct{ &file, "" };
+    if (!decodePngFrom(readFromFile, &readStruct, options, image, error)) {
+        if (!readStruct.readError.empty()) {
+            error = readStruct.readError;
+            readFailed = true;
+        }
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Reads and decodes a file on a thread of the scheduler's pool.
+ */
+class ReadPngFileWorker : public ScheduledWorker {
+    public:
+        ReadPngFileWorker(Nan::Callback *callback, const string &path, const DecodeOptions &options) :
+            ScheduledWorker(callback, "node-libpng:readPngFile"), path(path), options(options), readFailed(false) {}
+
+        void Execute() override {
+            string error;
+            if (!decodeFile(path, options, image, error, readFailed)) {
+                SetErrorMessage(error.c_str());
+            }
+        }
+
+    protected:
+        void HandleOKCallback() override {
+            Nan::HandleScope scope;
+            Local<Value> argv[] = { Nan::Null(), PngImage::NewInstance(image) };
+            callback->Call(2, argv, async_resource);
+        }
+
+        void HandleErrorCallback() override {
+            Nan::HandleScope scope;
+            // Decoding errors are type errors, the same as when decoding a buffer.
+            Local<Value> argv[] = { readFailed ? Nan::Error(ErrorMessage()) : Nan::TypeError(ErrorMessage()) };
+            callback->Call(1, argv, async_resource);
+        }
+
+    private:
+        string path;
+        DecodeOptions options;
+        DecodedImage image;
+        bool readFailed;
+};
+
+NAN_METHOD(readPngFile) {
+    // 1st Parameter: The path of the file to decode.
+    const string path = *Nan::Utf8String(info[0]);
+    // 2nd Parameter: Optional decode options.
+    DecodeOptions options;
+    if (!parseDecodeOptions(info[1], options)) {
+        return;
+    }
+    // 3rd Parameter: Whether to queue the job in the batch lane.
+    const auto priority = parseJobPriority(info[2]);
+    // 4th Parameter: The callback to call with an error or the decoded image.
+    auto callback = new Nan::Callback(Local<Function>::Cast(info[3]));
+    const auto id = scheduleWorker(new ReadPngFileWorker(callback, path, options), priority);
+    info.GetReturnValue().Set(Nan::New(static_cast<double>(id)));
+}
+
+NAN_METHOD(readPngFileSync) {
+    // 1st Parameter: The path of the file to decode.
+    const string path = *Nan::Utf8String(info[0]);
+    // 2nd Parameter: Optional decode options.
+    DecodeOptions options;
+    if (!parseDecodeOptions(info[1], options)) {
+        return;
+    }
+    DecodedImage image;
+    string error;
+    bool readFailed;
+    if (!decodeFile(path, options, image, error, readFailed)) {
+        if (readFailed) {
+            Nan::ThrowError(error.c_str());
+        } else {
+            Nan::ThrowTypeError(error.c_str());
+        }
+        return;
+    }
+    info.GetReturnValue().Set(PngImage::NewInstance(image));
+}
+
+NAN_MODULE_INIT(InitReadFile) {
+    Nan::Set(target, Nan::New("__native_readPngFile").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(readPngFile)).ToLocalChecked());
+    Nan::Set(target, Nan::New("__native_readPngFileSync").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(readPngFileSync)).ToLocalChecked());
+}
@@ -0,0 +1,11 @@
+#ifndef READ_FILE_HPP
+#define READ_FILE_HPP
+
+#include <nan.h>
+
+NAN_METHOD(readPngFile);
+NAN_METHOD(readPngFileSync);
+
+NAN_MODULE_INIT(InitReadFile);
+
+#endif
@@ -0,0 +1,251 @@
+#include <png.h>
+#include <zlib.h>
+#include <node_buffer.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "recompress.hpp"
+#include "encode.hpp"
+#include "png-reader.hpp"
+#include "scheduler.hpp"
+
+using namespace node;
+using namespace v8;
+using namespace std;
+
+/**
+ * Chunks dropped when stripping metadata. All other chunks known to libpng describe how to display the image.
+ */
+static const png_byte metadataChunks[] = "tEXt\0zTXt\0iTXt\0tIME";
+
+/**
+ * Makes libpng store all ancillary chunks except `tRNS` verbatim as unknown chunks, so they can be handed to the
+ * encoder without being parsed and serialized again. Needs to be called before `png_read_info`.
+ */
+static void keepAncillaryChunks(png_structp readPtr, bool stripMetadata) {
+    // A negative amount of chunks selects all ancillary chunks known to libpng except `tRNS`.
+    png_set_keep_unknown_chunks(readPtr, PNG_HANDLE_CHUNK_ALWAYS, nullptr, -1);
+    if (stripMetadata) {
+        // Drops the chunks unknown to libpng, then the metadata among the known ones.
+        png_set_keep_unknown_chunks(readPtr, PNG_HANDLE_CHUNK_NEVER, nullptr, 0);
+        png_set_keep_unknown_chunks(readPtr, PNG_HANDLE_CHUNK_NEVER, metadataChunks, 4);
+    }
+}
+
+/**
+ * Hands the chunks stored while reading up to the encoder. The location recorded by the decoder makes the encoder
+ * write them before `PLTE`, before `IDAT` or after `IDAT` again.
+ */
+static void copyChunks(png_structp readPtr, png_infop readInfo, png_structp writePtr, png_infop writeInfo) {
+    png_unknown_chunkp chunks;
+    const int count = png_get_unknown_chunks(readPtr, readInfo, &chunks);
+    if (count > 0) {
+        png_set_unknown_chunks(writePtr, writeInfo, chunks, count);
+    }
+}
+
+/**
+ * Copies the header, the palette and the transparency, which libpng always parses itself.
+ */
+static void copyHeader(png_structp readPtr, png_infop readInfo, png_structp writePtr, png_infop writeInfo) {
+    png_uint_32 width, height;
+    int bitDepth, colorType, interlaceType;
+    png_get_IHDR(readPtr, readInfo, &width, &height, &bitDepth, &colorType, &interlaceType, nullptr, nullptr);
+    png_set_IHDR(writePtr, writeInfo, width, height, bitDepth, colorType, interlaceType, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+    png_colorp palette;
+    int paletteSize;
+    if (png_get_PLTE(readPtr, readInfo, &palette, &paletteSize)) {
+        png_set_PLTE(writePtr, writeInfo, palette, paletteSize);
+    }
+    png_bytep alphas;
+    int alphaCount;
+    png_color_16p transparentColor;
+    if (png_get_tRNS(readPtr, readInfo, &alphas, &alphaCount, &transparentColor)) {
+        png_set_tRNS(writePtr, writeInfo, alphas, alphaCount, transparentColor);
+    }
+    // Chunks which are unknown to libpng need to be allowed explicitly to be written.
+    png_set_keep_unknown_chunks(writePtr, PNG_HANDLE_CHUNK_ALWAYS, nullptr, 0);
+    copyChunks(readPtr, readInfo, writePtr, writeInfo);
+}
+
+bool recompressPng(uint8_t *input, uint32_t inputSize, const RecompressParameters &parameters, vector<uint8_t> &output, string &error) {
+    if (inputSize < 8 || png_sig_cmp(input, 0, 8)) {
+        error = "Invalid PNG buffer.";
+        return false;
+    }
+    png_structp readPtr = png_create_read_struct(PNG_LIBPNG_VER_STRING, &error, storeError, ignoreWarning);
+    png_structp writePtr = png_create_write_struct(PNG_LIBPNG_VER_STRING, &error, storeError, ignoreWarning);
+    png_infop readInfo = readPtr ? png_create_info_struct(readPtr) : nullptr;
+    png_infop endInfo = readPtr ? png_create_info_struct(readPtr) : nullptr;
+    png_infop writeInfo = writePtr ? png_create_info_struct(writePtr) : nullptr;
+    const auto destroy = [&] () {
+        png_destroy_read_struct(&readPtr, &readInfo, &endInfo);
+        png_destroy_write_struct(&writePtr, &writeInfo);
+    };
+    if (!readInfo || !endInfo || !writeInfo) {
+        destroy();
+        error = "Unable to initialize libpng.";
+        return false;
+    }
+    // Declared before `setjmp` so it is cleaned up when libpng jumps back on an error.
+    vector<png_byte> row;
+    // Both structs jump back to this frame, the decoder while reading and the encoder while writing.
+    if (setjmp(png_jmpbuf(readPtr))) {
+        destroy();
+        error = "Error decoding PNG: " + error;
+        return false;
+    }
+    if (setjmp(png_jmpbuf(writePtr))) {
+        destroy();
+        error = "Error encoding PNG: " + error;
+        return false;
+    }
+    ReadStruct readStruct = { inputSize, input, 8 };
+    png_set_read_fn(readPtr, &readStruct, readFromBuffer);
+    png_set_sig_bytes(readPtr, 8);
+    applyReadPolicy(readPtr, parameters.decodeOptions);
+    // Stop early if the image is recompressed by a job which has been aborted.
+    abortAtRowBoundaries(readPtr, true);
+    keepAncillaryChunks(readPtr, parameters.stripMetadata);
+    png_read_info(readPtr, readInfo);
+
+    png_set_write_fn(writePtr, &output, appendToVector, nullptr);
+    png_set_compression_level(writePtr, parameters.compressionLevel);
+    if (parameters.strategy >= 0) {
+        png_set_compression_strategy(writePtr, parameters.strategy);
+    }
+    if (parameters.filters >= 0) {
+        png_set_filter(writePtr, PNG_FILTER_TYPE_BASE, parameters.filters);
+    }
+    copyHeader(readPtr, readInfo, writePtr, writeInfo);
+    png_write_info(writePtr, writeInfo);
+
+    // No transformations are set up, so the rows are handed over in the image's own format.
+    // For interlaced images the decoder fills in the pixels of the current pass, which are exactly the pixels
+    // the encoder takes from the row in that pass. A single row suffices either way.
+    const int passes = png_set_interlace_handling(readPtr);
+    png_set_interlace_handling(writePtr);
+    png_read_update_info(readPtr, readInfo);
+    row.resize(png_get_rowbytes(readPtr, readInfo));
+    const auto height = png_get_image_height(readPtr, readInfo);
+    for (int pass = 0; pass < passes; ++pass) {
+        for (png_uint_32 y = 0; y < height; ++y) {
+            png_read_row(readPtr, row.data(), nullptr);
+            png_write_row(writePtr, row.data());
+        }
+    }
+    // Chunks after the image data, such as texts or the modification time, are written after it again.
+    png_read_end(readPtr, endInfo);
+    copyChunks(readPtr, endInfo, writePtr, writeInfo);
+    png_write_end(writePtr, writeInfo);
+    destroy();
+    return true;
+}
+
+/**
+ * Recompresses an image on a thread of the scheduler's pool.
+ */
+class RecompressWorker : public ScheduledWorker {
+    public:
+        RecompressWorker(Nan::Callback *callback, uint8_t *input, uint32_t inputSize, const RecompressParameters &parameters) :
+            ScheduledWorker(callback, "node-libpng:recompress"), input(input), inputSize(inputSize), parameters(parameters) {}
+
+        void Execute() override {
+            string error;
+            if (!recompressPng(input, inputSize, parameters, output, error)) {
+                SetErrorMessage(error.c_str());
+            }
+        }
+
+    protected:
+        void HandleOKCallback() override {
+            Nan::HandleScope scope;
+            Local<Value> argv[] = {
+                Nan::Null(),
+                Nan::CopyBuffer(reinterpret_cast<char*>(output.data()), output.size()).ToLocalChecked(),
+            };
+            callback->Call(2, argv, async_resource);
+        }
+
+        void HandleErrorCallback() override {
+            Nan::HandleScope scope;
+            // Decoding and encoding errors are type errors, the same as for `decode` and `encode`.
+            Local<Value> argv[] = { Nan::TypeError(ErrorMessage()) };
+            callback->Call(1, argv, async_resource);
+        }
+
+    private:
+        uint8_t *input;
+        uint32_t inputSize;
+        RecompressParameters parameters;
+        vector<uint8_t> output;
+};
+
+/**
+ * Maps the filter names used on the JS side to libpng's filter flags. `adaptive` lets libpng pick the best
+ * filter for every row.
+ */
+static int parseFilters(Local<Value> value) {
+    if (value->IsUndefined()) {
+        return -1;
+    }
+    const string name = *Nan::Utf8String(value);
+    if (name == "none") { return PNG_FILTER_NONE; }
+    if (name == "sub") { return PNG_FILTER_SUB; }
+    if (name == "up") { return PNG_FILTER_UP; }
+    if (name == "average") { return PNG_FILTER_AVG; }
+    if (name == "paeth") { return PNG_FILTER_PAETH; }
+    return PNG_ALL_FILTERS;
+}
+
+/**
+ * Maps the strategy names used on the JS side to zlib's strategies.
+ */
+static int parseStrategy(Local<Value> value) {
+    if (value->IsUndefined()) {
+        return -1;
+    }
+    const string name = *Nan::Utf8String(value);
+    if (name == "filtered") { return Z_FILTERED; }
+    if (name == "huffman") { return Z_HUFFMAN_ONLY; }
+    if (name == "rle") { return Z_RLE; }
+    if (name == "fixed") { return Z_FIXED; }
+    return Z_DEFAULT_STRATEGY;
+}
+
+NAN_METHOD(recompress) {
+    // 1st Parameter: The buffer with the encoded PNG image.
+    auto *input = reinterpret_cast<uint8_t*>(Buffer::Data(info[0]));
+    const auto inputSize = Buffer::Length(info[0]);
+    if (inputSize > UINT32_MAX) {
+        Nan::ThrowError("Input buffer is too large.");
+        return;
+    }
+    RecompressParameters parameters;
+    // 2nd Parameter: Optional decode options, of which only `trusted` and `limits` are used.
+    if (!parseDecodeOptions(info[1], parameters.decodeOptions)) {
+        return;
+    }
+    // 3rd Parameter: The compression level.
+    parameters.compressionLevel = Nan::To<int32_t>(info[2]).FromMaybe(Z_BEST_COMPRESSION);
+    // 4th Parameter: The name of the filter or `undefined`.
+    parameters.filters = parseFilters(info[3]);
+    // 5th Parameter: The name of the zlib strategy or `undefined`.
+    parameters.strategy = parseStrategy(info[4]);
+    // 6th Parameter: Whether to drop texts, the modification time and unknown chunks.
+    parameters.stripMetadata = Nan::To<bool>(info[5]).FromMaybe(false);
+    // 7th Parameter: Whether to queue the job in the batch lane.
+    const auto priority = parseJobPriority(info[6]);
+    // 8th Parameter: The callback to call with an error or the recompressed image.
+    auto callback = new Nan::Callback(Local<Function>::Cast(info[7]));
+    auto worker = new RecompressWorker(callback, input, static_cast<uint32_t>(inputSize), parameters);
+    // Keep the input buffer alive while it is recompressed on the pool.
+    worker->SaveToPersistent("input", info[0]);
+    const auto id = scheduleWorker(worker, priority);
+    info.GetReturnValue().Set(Nan::New(static_cast<double>(id)));
+}
+
+NAN_MODULE_INIT(InitRecompress) {
+    Nan::Set(target, Nan::New("__native_recompress").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(recompress)).ToLocalChecked());
+}
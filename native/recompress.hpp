@@ -0,0 +1,45 @@
+#ifndef RECOMPRESS_HPP
+#define RECOMPRESS_HPP
+
+#include <nan.h>
+#include <png.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "decode-options.hpp"
+
+/**
+ * Describes how an image is recompressed.
+ */
+struct RecompressParameters {
+    // Only `trusted` and the limits are used, the image is never transformed.
+    DecodeOptions decodeOptions;
+    int compressionLevel;
+    // The `PNG_FILTER_...` flags to choose from, or `-1` to keep libpng's default for the image's format.
+    int filters;
+    // The zlib strategy, or `-1` to keep libpng's default.
+    int strategy;
+    // Drop text chunks, `tIME` and all chunks unknown to libpng.
+    bool stripMetadata;
+};
+
+/**
+ * Decodes the PNG in `input` and encodes it again with the given settings, handing every decoded row straight to the
+ * encoder. Color type, bit depth, interlacing, the palette and all ancillary chunks are kept.
+ * Doesn't touch any JS values, so it can be called from worker threads.
+ * Returns `false` and sets `error` if the image could not be decoded or encoded.
+ */
+bool recompressPng(
+    uint8_t *input,
+    uint32_t inputSize,
+    const RecompressParameters &parameters,
+    std::vector<uint8_t> &output,
+    std::string &error
+);
+
+NAN_METHOD(recompress);
+
+NAN_MODULE_INIT(InitRecompress);
+
+#endif
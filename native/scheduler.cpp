@@ -0,0 +1,476 @@
+#include <node.h>
+#include <uv.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "scheduler.hpp"
+
+using namespace v8;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Dispatcher;
+
+/**
+ * A worker which has been handed to the scheduler, from being queued until its callback was called.
+ */
+struct Job {
+    ScheduledWorker *worker;
+    JobPriority priority;
+    uint32_t id;
+    // The environment which scheduled the job and receives its result.
+    Dispatcher *dispatcher;
+    // Checked by libpng's row callbacks while the job is running.
+    atomic<bool> aborted;
+    Clock::time_point queuedAt;
+    Clock::time_point startedAt;
+};
+
+/**
+ * Delivers finished jobs to the event loop of one environment. The main thread and every worker thread
+ * which scheduled a job have their own dispatcher.
+ */
+struct Dispatcher {
+    uv_async_t async;
+    // Jobs waiting for their callback to be called. Guarded by the pool's mutex.
+    vector<Job*> finished;
+    // The amount of this environment's jobs currently executed on the pool. Guarded by the pool's mutex.
+    uint32_t running;
+    // The amount of jobs scheduled but not completed yet. Only touched on the environment's thread.
+    uint32_t pending;
+};
+
+/**
+ * Work split into indices by `forEachInJob`, which idle threads of the pool help with.
+ */
+struct HelperTask {
+    const function<void(uint32_t)> *work;
+    uint32_t count;
+    // The next index to work on. Guarded by the pool's mutex.
+    uint32_t next;
+    // The amount of helping threads currently working on an index. Guarded by the pool's mutex.
+    uint32_t running;
+    // The job which split its work, so the helping threads act on its behalf.
+    Job *job;
+};
+
+/**
+ * Counters of one lane. All times are in milliseconds.
+ */
+struct LaneStats {
+    uint32_t running;
+    double completed;
+    double aborted;
+    double totalWaitTime;
+    double maxWaitTime;
+    double totalRunTime;
+};
+
+/**
+ * The state of the thread pool, shared by all environments.
+ */
+struct Pool {
+    mutex lock;
+    // Notified when a job was queued, a batch job finished or the size changed.
+    condition_variable wake;
+    // Notified whenever a job finished executing.
+    condition_variable idle;
+    // One queue per `JobPriority`.
+    deque<Job*> lanes[2];
+    // Work of running jobs with indices left which idle threads can help with.
+    deque<HelperTask*> tasks;
+    // All jobs which are queued or running, by id.
+    unordered_map<uint32_t, Job*> jobs;
+    uint32_t nextId;
+    // The configured amount of threads.
+    uint32_t size;
+    // The amount of started threads and how many of them are waiting for a job.
+    uint32_t threads;
+    uint32_t idleThreads;
+    LaneStats stats[2];
+    // One dispatcher per isolate.
+    unordered_map<Isolate*, Dispatcher*> dispatchers;
+};
+
+/**
+ * The pool is never freed: Its threads are detached and may still be waiting for jobs while the process exits.
+ */
+static Pool &pool() {
+    static Pool *instance = [] () {
+        auto created = new Pool();
+        created->nextId = 1;
+        created->size = max(1u, thread::hardware_concurrency());
+        return created;
+    }();
+    return *instance;
+}
+
+// The job executed by the current thread, if any.
+static thread_local Job *currentJob = nullptr;
+
+static double millisecondsBetween(Clock::time_point start, Clock::time_point end) {
+    return chrono::duration<double, milli>(end - start).count();
+}
+
+/**
+ * Batch jobs leave one thread to interactive jobs, so an interactive job never waits for a long running batch.
+ */
+static uint32_t batchThreads(const Pool &state) {
+    return state.size > 1 ? state.size - 1 : 1;
+}
+
+/**
+ * Hands a job to the environment which scheduled it. Needs to be called with the pool's mutex locked.
+ */
+static void deliver(Job *job) {
+    job->dispatcher->finished.push_back(job);
+    uv_async_send(&job->dispatcher->async);
+}
+
+/**
+ * Takes the next job from the lanes, or returns `nullptr` if no job may be started right now.
+ * Needs to be called with the pool's mutex locked.
+ */
+static Job *takeJob(Pool &state) {
+    for (auto priority : { JobPriority::INTERACTIVE, JobPriority::BATCH }) {
+        auto &lane = state.lanes[static_cast<int>(priority)];
+        if (lane.empty()) {
+            continue;
+        }
+        if (priority == JobPriority::BATCH && state.stats[static_cast<int>(priority)].running >= batchThreads(state)) {
+            continue;
+        }
+        auto job = lane.front();
+        lane.pop_front();
+        return job;
+    }
+    return nullptr;
+}
+
+/**
+ * Returns a task with indices left, or `nullptr` if there is none. Needs to be called with the pool's mutex locked.
+ */
+static HelperTask *takeTask(Pool &state) {
+    for (auto task : state.tasks) {
+        if (task->next < task->count) {
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * The loop of every thread in the pool.
+ */
+static void runThread() {
+    auto &state = pool();
+    unique_lock<mutex> lock(state.lock);
+    while (true) {
+        // Threads exceeding the configured size stop once they are done with their job.
+        if (state.threads > state.size) {
+            --state.threads;
+            --state.idleThreads;
+            return;
+        }
+        auto job = takeJob(state);
+        if (!job) {
+            // Help a running job with a single index, so queued jobs are started again right after.
+            auto task = takeTask(state);
+            if (!task) {
+                state.wake.wait(lock);
+                continue;
+            }
+            const auto index = task->next++;
+            --state.idleThreads;
+            ++task->running;
+            lock.unlock();
+            currentJob = task->job;
+            (*task->work)(index);
+            currentJob = nullptr;
+            lock.lock();
+            ++state.idleThreads;
+            --task->running;
+            state.idle.notify_all();
+            continue;
+        }
+        auto &stats = state.stats[static_cast<int>(job->priority)];
+        --state.idleThreads;
+        ++stats.running;
+        ++job->dispatcher->running;
+        job->startedAt = Clock::now();
+        const auto waitTime = millisecondsBetween(job->queuedAt, job->startedAt);
+        stats.totalWaitTime += waitTime;
+        stats.maxWaitTime = max(stats.maxWaitTime, waitTime);
+        lock.unlock();
+
+        currentJob = job;
+        job->worker->Execute();
+        currentJob = nullptr;
+
+        lock.lock();
+        ++state.idleThreads;
+        --stats.running;
+        --job->dispatcher->running;
+        stats.totalRunTime += millisecondsBetween(job->startedAt, Clock::now());
+        if (job->aborted) {
+            ++stats.aborted;
+        } else {
+            ++stats.completed;
+        }
+        state.jobs.erase(job->id);
+        deliver(job);
+        state.idle.notify_all();
+        // A waiting batch job might be allowed to start now.
+        state.wake.notify_one();
+    }
+}
+
+/**
+ * Starts threads until there is one for every queued job and every index left to help with
+ * or the configured size is reached. Needs to be called with the pool's mutex locked.
+ */
+static void startThreads(Pool &state) {
+    auto queued = state.lanes[0].size() + state.lanes[1].size();
+    for (auto task : state.tasks) {
+        queued += task->count - task->next;
+    }
+    while (state.threads < state.size && state.idleThreads < queued) {
+        ++state.threads;
+        ++state.idleThreads;
+        thread(runThread).detach();
+    }
+}
+
+/**
+ * Calls the callbacks of the jobs which finished since the last call. Runs on the environment's thread.
+ */
+static void completeJobs(uv_async_t *async) {
+    auto dispatcher = reinterpret_cast<Dispatcher*>(async->data);
+    vector<Job*> finished;
+    {
+        lock_guard<mutex> lock(pool().lock);
+        finished.swap(dispatcher->finished);
+    }
+    for (auto job : finished) {
+        job->worker->WorkComplete();
+        job->worker->Destroy();
+        delete job;
+        // Don't keep the event loop alive when no jobs are left.
+        if (--dispatcher->pending == 0) {
+            uv_unref(reinterpret_cast<uv_handle_t*>(&dispatcher->async));
+        }
+    }
+}
+
+static void deleteDispatcher(uv_handle_t *handle) {
+    delete reinterpret_cast<Dispatcher*>(handle->data);
+}
+
+/**
+ * Cleanup hook for an environment which is torn down, for example when a worker thread exits.
+ * Drops its queued jobs, aborts its running jobs and waits for them to stop, as they must not
+ * deliver their results to the environment anymore.
+ */
+static void removeDispatcher(void *isolate) {
+    auto &state = pool();
+    vector<Job*> jobs;
+    Dispatcher *dispatcher;
+    {
+        unique_lock<mutex> lock(state.lock);
+        dispatcher = state.dispatchers.at(reinterpret_cast<Isolate*>(isolate));
+        state.dispatchers.erase(reinterpret_cast<Isolate*>(isolate));
+        for (auto &lane : state.lanes) {
+            const auto end = remove_if(lane.begin(), lane.end(), [&] (Job *job) {
+                if (job->dispatcher != dispatcher) {
+                    return false;
+                }
+                state.jobs.erase(job->id);
+                jobs.push_back(job);
+                return true;
+            });
+            lane.erase(end, lane.end());
+        }
+        for (auto &entry : state.jobs) {
+            if (entry.second->dispatcher == dispatcher) {
+                entry.second->aborted = true;
+            }
+        }
+        state.idle.wait(lock, [&] { return dispatcher->running == 0; });
+        jobs.insert(jobs.end(), dispatcher->finished.begin(), dispatcher->finished.end());
+        dispatcher->finished.clear();
+    }
+    for (auto job : jobs) {
+        job->worker->Destroy();
+        delete job;
+    }
+    uv_close(reinterpret_cast<uv_handle_t*>(&dispatcher->async), deleteDispatcher);
+}
+
+/**
+ * Returns the dispatcher of the current environment, creating it on first use.
+ * Needs to be called with the pool's mutex locked.
+ */
+static Dispatcher *currentDispatcher(Pool &state) {
+    auto isolate = Isolate::GetCurrent();
+    auto &dispatcher = state.dispatchers[isolate];
+    if (!dispatcher) {
+        dispatcher = new Dispatcher();
+        dispatcher->async.data = dispatcher;
+        uv_async_init(Nan::GetCurrentEventLoop(), &dispatcher->async, completeJobs);
+        uv_unref(reinterpret_cast<uv_handle_t*>(&dispatcher->async));
+        node::AddEnvironmentCleanupHook(isolate, removeDispatcher, isolate);
+    }
+    return dispatcher;
+}
+
+uint32_t scheduleWorker(ScheduledWorker *worker, JobPriority priority) {
+    auto &state = pool();
+    lock_guard<mutex> lock(state.lock);
+    auto job = new Job();
+    job->worker = worker;
+    job->priority = priority;
+    job->id = state.nextId++;
+    job->dispatcher = currentDispatcher(state);
+    job->aborted = false;
+    job->queuedAt = Clock::now();
+    if (job->dispatcher->pending++ == 0) {
+        uv_ref(reinterpret_cast<uv_handle_t*>(&job->dispatcher->async));
+    }
+    state.jobs[job->id] = job;
+    state.lanes[static_cast<int>(priority)].push_back(job);
+    startThreads(state);
+    state.wake.notify_one();
+    return job->id;
+}
+
+JobPriority parseJobPriority(Local<Value> value) {
+    return Nan::To<bool>(value).FromMaybe(false) ? JobPriority::BATCH : JobPriority::INTERACTIVE;
+}
+
+bool jobAborted() {
+    return currentJob && currentJob->aborted.load(memory_order_relaxed);
+}
+
+/**
+ * Row callback for libpng raising an error if the current job was aborted.
+ */
+static void abortIfRequested(png_structp pngPtr, png_uint_32 row, int pass) {
+    if (jobAborted()) {
+        png_error(pngPtr, "Aborted.");
+    }
+}
+
+void abortAtRowBoundaries(png_structp pngPtr, bool reading) {
+    if (reading) {
+        png_set_read_status_fn(pngPtr, abortIfRequested);
+    } else {
+        png_set_write_status_fn(pngPtr, abortIfRequested);
+    }
+}
+
+uint32_t poolSize() {
+    auto &state = pool();
+    lock_guard<mutex> lock(state.lock);
+    return state.size;
+}
+
+void forEachInJob(uint32_t count, bool parallel, const function<void(uint32_t)> &work) {
+    if (!parallel || count <= 1) {
+        for (uint32_t index = 0; index < count; ++index) {
+            work(index);
+        }
+        return;
+    }
+    // The current thread and idle threads of the pool take the next index until none are left, so uneven work
+    // is balanced. No threads beyond the configured size of the pool are started.
+    auto &state = pool();
+    HelperTask task{ &work, count, 0, 0, currentJob };
+    unique_lock<mutex> lock(state.lock);
+    state.tasks.push_back(&task);
+    startThreads(state);
+    state.wake.notify_all();
+    while (task.next < count) {
+        const auto index = task.next++;
+        lock.unlock();
+        work(index);
+        lock.lock();
+    }
+    state.tasks.erase(find(state.tasks.begin(), state.tasks.end(), &task));
+    // Threads still working on an index refer to `task` and `work`.
+    state.idle.wait(lock, [&] { return task.running == 0; });
+}
+
+NAN_METHOD(abortJob) {
+    // 1st Parameter: The id of the job as returned when it was scheduled.
+    const auto id = Nan::To<uint32_t>(info[0]).FromMaybe(0);
+    auto &state = pool();
+    lock_guard<mutex> lock(state.lock);
+    const auto entry = state.jobs.find(id);
+    // The job might already be done.
+    if (entry == state.jobs.end()) {
+        return;
+    }
+    auto job = entry->second;
+    job->aborted = true;
+    // Running jobs stop at the next row boundary. Queued jobs are removed right away and never executed.
+    auto &lane = state.lanes[static_cast<int>(job->priority)];
+    const auto queued = find(lane.begin(), lane.end(), job);
+    if (queued == lane.end()) {
+        return;
+    }
+    lane.erase(queued);
+    state.jobs.erase(entry);
+    ++state.stats[static_cast<int>(job->priority)].aborted;
+    job->worker->Abort();
+    deliver(job);
+}
+
+NAN_METHOD(configureScheduler) {
+    // 1st Parameter: The amount of threads in the pool.
+    auto &state = pool();
+    lock_guard<mutex> lock(state.lock);
+    state.size = max(1u, Nan::To<uint32_t>(info[0]).FromMaybe(state.size));
+    // Surplus threads stop once they are done with their job, missing threads are started if jobs are queued.
+    startThreads(state);
+    state.wake.notify_all();
+}
+
+/**
+ * Converts the counters of a lane into a JS object.
+ */
+static Local<Object> laneStatsObject(const LaneStats &stats, size_t queued) {
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result, Nan::New("queued").ToLocalChecked(), Nan::New(static_cast<double>(queued)));
+    Nan::Set(result, Nan::New("running").ToLocalChecked(), Nan::New(static_cast<double>(stats.running)));
+    Nan::Set(result, Nan::New("completed").ToLocalChecked(), Nan::New(stats.completed));
+    Nan::Set(result, Nan::New("aborted").ToLocalChecked(), Nan::New(stats.aborted));
+    Nan::Set(result, Nan::New("totalWaitTime").ToLocalChecked(), Nan::New(stats.totalWaitTime));
+    Nan::Set(result, Nan::New("maxWaitTime").ToLocalChecked(), Nan::New(stats.maxWaitTime));
+    Nan::Set(result, Nan::New("totalRunTime").ToLocalChecked(), Nan::New(stats.totalRunTime));
+    return result;
+}
+
+NAN_METHOD(schedulerStats) {
+    auto &state = pool();
+    lock_guard<mutex> lock(state.lock);
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result, Nan::New("threads").ToLocalChecked(), Nan::New(static_cast<double>(state.size)));
+    Nan::Set(result, Nan::New("interactive").ToLocalChecked(), laneStatsObject(state.stats[0], state.lanes[0].size()));
+    Nan::Set(result, Nan::New("batch").ToLocalChecked(), laneStatsObject(state.stats[1], state.lanes[1].size()));
+    info.GetReturnValue().Set(result);
+}
+
+NAN_MODULE_INIT(InitScheduler) {
+    Nan::Set(target, Nan::New("__native_abortJob").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(abortJob)).ToLocalChecked());
+    Nan::Set(target, Nan::New("__native_configureScheduler").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(configureScheduler)).ToLocalChecked());
+    Nan::Set(target, Nan::New("__native_schedulerStats").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(schedulerStats)).ToLocalChecked());
+}
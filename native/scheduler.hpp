@@ -0,0 +1,77 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <nan.h>
+#include <png.h>
+#include <cstdint>
+#include <functional>
+
+/**
+ * The lanes of the scheduler. Queued interactive jobs are always started before queued batch jobs.
+ */
+enum class JobPriority {
+    INTERACTIVE = 0,
+    BATCH = 1
+};
+
+/**
+ * An `AsyncWorker` which is run on the library's own thread pool instead of libuv's threadpool.
+ */
+class ScheduledWorker : public Nan::AsyncWorker {
+    public:
+        ScheduledWorker(Nan::Callback *callback, const char *resourceName) : Nan::AsyncWorker(callback, resourceName) {}
+
+        /**
+         * Called on the main thread instead of `Execute` if the job was aborted before it was started.
+         */
+        void Abort() {
+            SetErrorMessage("Aborted.");
+        }
+};
+
+/**
+ * Queues `worker` in the lane of `priority`. `Execute` is called on a thread of the pool and the callbacks
+ * on the thread which scheduled the job. Takes ownership of the worker.
+ * Returns an id which can be handed to `__native_abortJob`.
+ */
+uint32_t scheduleWorker(ScheduledWorker *worker, JobPriority priority);
+
+/**
+ * Reads the priority as passed from the JS side: `true` for the batch lane and `false` for the interactive lane.
+ */
+JobPriority parseJobPriority(v8::Local<v8::Value> value);
+
+/**
+ * Makes libpng raise an error at the next row boundary once the job running on the current thread was aborted.
+ * Has no effect when called outside of the scheduler's threads. `reading` tells read and write structs apart.
+ */
+void abortAtRowBoundaries(png_structp pngPtr, bool reading);
+
+/**
+ * Returns whether the job running on the current thread was aborted, for work done outside of libpng.
+ * Always `false` outside of the scheduler's threads.
+ */
+bool jobAborted();
+
+/**
+ * Returns the configured amount of threads in the pool.
+ */
+uint32_t poolSize();
+
+/**
+ * Calls `work(index)` for every index below `count`. If `parallel` is set, idle threads of the pool help the
+ * current thread with the indices, and `work` needs to be thread-safe. The pool's configured size is never exceeded
+ * and queued jobs are started before helping. The helping threads act on behalf of the job running on the current
+ * thread, so `abortAtRowBoundaries` works within them. Returns once all calls are done.
+ */
+void forEachInJob(uint32_t count, bool parallel, const std::function<void(uint32_t)> &work);
+
+NAN_METHOD(abortJob);
+
+NAN_METHOD(configureScheduler);
+
+NAN_METHOD(schedulerStats);
+
+NAN_MODULE_INIT(InitScheduler);
+
+#endif
@@ -0,0 +1,239 @@
+#include <png.h>
+#include <node_buffer.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "verify.hpp"
+#include "file-reader.hpp"
+#include "png-reader.hpp"
+#include "scheduler.hpp"
+
+using namespace node;
+using namespace v8;
+using namespace std;
+
+/**
+ * The outcome of verifying an image, as returned to the JS side.
+ */
+struct VerifyResult {
+    bool valid;
+    // The type of the first invalid chunk, or an empty string if the error occured outside of a chunk.
+    string chunk;
+    // The offset of the first invalid chunk's header.
+    size_t offset;
+    string reason;
+};
+
+/**
+ * The encoded data being verified, either a buffer or a file, along with the chunk which is currently being read.
+ * Exactly one of `buffer` and `file` is set.
+ */
+struct VerifyStruct {
+    ReadStruct *buffer;
+    FileReader *file;
+    // The amount of bytes read so far.
+    size_t consumed;
+    // The offset of the current chunk's header inside the input.
+    size_t chunkOffset;
+    // The type of the current chunk, or an empty string if its header could not be read.
+    string chunk;
+    // Set if reading the file failed, which is reported as an error instead of an invalid image.
+    string readError;
+};
+
+/**
+ * Reads up to `length` bytes of the input into `target`, setting `count` to the amount read.
+ * Returns `false` and sets `error` if the file could not be read.
+ */
+static bool readInput(VerifyStruct &verifyStruct, uint8_t *target, size_t length, size_t &count, string &error) {
+    if (verifyStruct.file) {
+        return verifyStruct.file->read(target, length, count, error);
+    }
+    auto &buffer = *verifyStruct.buffer;
+    count = min(length, static_cast<size_t>(buffer.length - buffer.consumed));
+    memcpy(target, buffer.input + buffer.consumed, count);
+    buffer.consumed += static_cast<uint32_t>(count);
+    return true;
+}
+
+/**
+ * Read callback for `png_set_read_fn` remembering the type and offset of every chunk header read by libpng.
+ */
+static void readAndTrackChunks(png_structp pngPtr, png_bytep target, png_size_t length) {
+    auto verifyStruct = reinterpret_cast<VerifyStruct*>(png_get_io_ptr(pngPtr));
+    const bool header = (png_get_io_state(pngPtr) & PNG_IO_CHUNK_HDR) != 0;
+    if (header) {
+        verifyStruct->chunkOffset = verifyStruct->consumed;
+        verifyStruct->chunk.clear();
+    }
+    size_t count;
+    if (!readInput(*verifyStruct, target, length, count, verifyStruct->readError)) {
+        png_error(pngPtr, verifyStruct->readError.c_str());
+    }
+    verifyStruct->consumed += count;
+    if (count < length) {
+        png_error(pngPtr, "Unexpected end of PNG data.");
+    }
+    // libpng reads the length and the type of a chunk at once.
+    if (header && length == 8) {
+        verifyStruct->chunk.assign(reinterpret_cast<char*>(target) + 4, 4);
+    }
+}
+
+/**
+ * Verifies the image read from `verifyStruct`. Only a single row of the image and the buffer of a file are kept
+ * in memory. Doesn't touch any JS values, so it can be called from worker threads.
+ * Returns `false` and sets `error` if the input could not be read, invalid images are described by `result`.
+ */
+static bool verifyPng(VerifyStruct &verifyStruct, VerifyResult &result, string &error) {
+    uint8_t signature[8];
+    size_t count;
+    if (!readInput(verifyStruct, signature, 8, count, error)) {
+        return false;
+    }
+    verifyStruct.consumed = count;
+    if (count < 8 || png_sig_cmp(signature, 0, 8)) {
+        result = { false, "", 0, "Invalid PNG signature." };
+        return true;
+    }
+    string pngError;
+    auto pngPtr = png_create_read_struct(PNG_LIBPNG_VER_STRING, &pngError, storeError, ignoreWarning);
+    if (!pngPtr) {
+        error = "Could not create PNG read struct.";
+        return false;
+    }
+    auto infoPtr = png_create_info_struct(pngPtr);
+    if (!infoPtr) {
+        png_destroy_read_struct(&pngPtr, nullptr, nullptr);
+        error = "Could not create PNG info struct.";
+        return false;
+    }
+    // Declared before `setjmp` so it is cleaned up when libpng jumps back on an error.
+    vector<png_byte> row;
+    // libpng will jump to this if the image is invalid or the file could not be read.
+    if (setjmp(png_jmpbuf(pngPtr))) {
+        png_destroy_read_struct(&pngPtr, &infoPtr, nullptr);
+        if (!verifyStruct.readError.empty()) {
+            error = verifyStruct.readError;
+            return false;
+        }
+        // Errors raised with `png_chunk_error` are prefixed with the chunk's type, which is reported separately.
+        const auto prefix = verifyStruct.chunk + ": ";
+        if (!verifyStruct.chunk.empty() && pngError.compare(0, prefix.size(), prefix) == 0) {
+            pngError.erase(0, prefix.size());
+        }
+        result = { false, verifyStruct.chunk, verifyStruct.chunkOffset, pngError };
+        return true;
+    }
+    png_set_read_fn(pngPtr, reinterpret_cast<png_voidp>(&verifyStruct), readAndTrackChunks);
+    png_set_sig_bytes(pngPtr, 8);
+    // Treat every problem as an error: Broken CRCs of ancillary chunks, too much or too little image data
+    // and palette indices out of range.
+    png_set_crc_action(pngPtr, PNG_CRC_ERROR_QUIT, PNG_CRC_ERROR_QUIT);
+    png_set_benign_errors(pngPtr, 0);
+    png_read_info(pngPtr, infoPtr);
+    // Without transformations a row of the untouched image is the largest row libpng writes, also for the passes
+    // of interlaced images. As the rows are discarded, the same buffer can be used for every row of every pass.
+    const auto passes = png_set_interlace_handling(pngPtr);
+    png_read_update_info(pngPtr, infoPtr);
+    const auto height = png_get_image_height(pngPtr, infoPtr);
+    row.resize(png_get_rowbytes(pngPtr, infoPtr));
+    for (int pass = 0; pass < passes; ++pass) {
+        for (uint32_t y = 0; y < height; ++y) {
+            png_read_row(pngPtr, row.data(), nullptr);
+        }
+    }
+    // Verify the chunks after the image data up to and including `IEND`.
+    png_read_end(pngPtr, infoPtr);
+    png_destroy_read_struct(&pngPtr, &infoPtr, nullptr);
+    result = { true, "", 0, "" };
+    return true;
+}
+
+/**
+ * Converts the result of a verification into the object returned to the JS side.
+ */
+static Local<Object> convertResult(const VerifyResult &verifyResult) {
+    Nan::EscapableHandleScope scope;
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result, Nan::New("valid").ToLocalChecked(), Nan::New(verifyResult.valid));
+    if (verifyResult.valid) {
+        return scope.Escape(result);
+    }
+    if (!verifyResult.chunk.empty()) {
+        Nan::Set(result, Nan::New("chunk").ToLocalChecked(), Nan::New(verifyResult.chunk).ToLocalChecked());
+    }
+    Nan::Set(result, Nan::New("offset").ToLocalChecked(), Nan::New(static_cast<double>(verifyResult.offset)));
+    Nan::Set(result, Nan::New("reason").ToLocalChecked(), Nan::New(verifyResult.reason).ToLocalChecked());
+    return scope.Escape(result);
+}
+
+NAN_METHOD(verify) {
+    // 1st Parameter: The buffer with the encoded PNG image.
+    if (!Buffer::HasInstance(info[0])) {
+        Nan::ThrowError("Input is not a buffer.");
+        return;
+    }
+    auto *input = reinterpret_cast<uint8_t*>(Buffer::Data(info[0]));
+    const auto inputSize = static_cast<uint32_t>(Buffer::Length(info[0]));
+    ReadStruct buffer{ inputSize, input, 0 };
+    VerifyStruct verifyStruct{ &buffer, nullptr, 0, 0, "", "" };
+    VerifyResult result;
+    string error;
+    if (!verifyPng(verifyStruct, result, error)) {
+        Nan::ThrowError(error.c_str());
+        return;
+    }
+    info.GetReturnValue().Set(convertResult(result));
+}
+
+/**
+ * Reads a file through a fixed size buffer and verifies it on a thread of the scheduler's pool.
+ */
+class VerifyFileWorker : public ScheduledWorker {
+    public:
+        VerifyFileWorker(Nan::Callback *callback, const string &path) :
+            ScheduledWorker(callback, "node-libpng:verifyFile"), path(path) {}
+
+        void Execute() override {
+            FileReader file(path);
+            string error;
+            if (!file.open(error)) {
+                SetErrorMessage(error.c_str());
+                return;
+            }
+            VerifyStruct verifyStruct{ nullptr, &file, 0, 0, "", "" };
+            if (!verifyPng(verifyStruct, result, error)) {
+                SetErrorMessage(error.c_str());
+            }
+        }
+
+    protected:
+        void HandleOKCallback() override {
+            Nan::HandleScope scope;
+            Local<Value> argv[] = { Nan::Null(), convertResult(result) };
+            callback->Call(2, argv, async_resource);
+        }
+
+    private:
+        string path;
+        VerifyResult result;
+};
+
+NAN_METHOD(verifyFile) {
+    // 1st Parameter: The path of the file to verify.
+    const string path = *Nan::Utf8String(info[0]);
+    // 2nd Parameter: Whether to queue the job in the batch lane.
+    const auto priority = parseJobPriority(info[1]);
+    // 3rd Parameter: The callback to call with an error or the result.
+    auto callback = new Nan::Callback(Local<Function>::Cast(info[2]));
+    const auto id = scheduleWorker(new VerifyFileWorker(callback, path), priority);
+    info.GetReturnValue().Set(Nan::New(static_cast<double>(id)));
+}
+
+NAN_MODULE_INIT(InitVerify) {
+    Nan::Set(target, Nan::New("__native_verify").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(verify)).ToLocalChecked());
+    Nan::Set(target, Nan::New("__native_verifyFile").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(verifyFile)).ToLocalChecked());
+}
@@ -0,0 +1,11 @@
+#ifndef VERIFY_HPP
+#define VERIFY_HPP
+
+#include <nan.h>
+
+NAN_METHOD(verify);
+NAN_METHOD(verifyFile);
+
+NAN_MODULE_INIT(InitVerify);
+
+#endif
@@ -0,0 +1,125 @@
+#include <png.h>
+#include <string>
+
+#include "write-file.hpp"
+#include "encode.hpp"
+#include "file-writer.hpp"
+#include "scheduler.hpp"
+
+using namespace v8;
+using namespace std;
+
+/**
+ * Describes where and how an encoded image is written to disk.
+ */
+struct WriteParameters {
+    std::string path;
+    // Flush the file to disk before reporting success.
+    bool sync;
+    // Write to a temporary file which replaces the target once complete.
+    bool atomic;
+};
+
+/**
+ * Handed to the write callback as io pointer.
+ */
+struct FileOutput {
+    FileOutput(const string &path, bool atomic) : writer(path, atomic) {}
+    FileWriter writer;
+    // Outlives the write callback, which doesn't return when it raises a libpng error.
+    string error;
+};
+
+/**
+ * Write callback for `png_set_write_fn` handing the encoded data to a `FileWriter`.
+ */
+static void writeToFile(png_structp pngPtr, png_bytep data, png_size_t length) {
+    auto output = reinterpret_cast<FileOutput*>(png_get_io_ptr(pngPtr));
+    if (!output->writer.write(data, length, output->error)) {
+        png_error(pngPtr, output->error.c_str());
+    }
+}
+
+/**
+ * Encodes the image straight into a file. Doesn't touch any JS values, so it can be called from worker threads.
+ * Returns `false` and sets `error` if the image could not be encoded or written.
+ */
+static bool encodeToFile(const EncodeParameters &parameters, const WriteParameters &file, string &error) {
+    FileOutput output(file.path, file.atomic);
+    return output.writer.open(error) && encodePng(parameters, &output, writeToFile, error) && output.writer.commit(file.sync, error);
+}
+
+/**
+ * Reads the path and the write flags, starting with the path at argument `first`.
+ */
+static void parseWriteParameters(const Nan::FunctionCallbackInfo<Value> &info, int first, WriteParameters &file) {
+    file.path = *Nan::Utf8String(info[first]);
+    file.sync = Nan::To<bool>(info[first + 1]).FromMaybe(false);
+    file.atomic = Nan::To<bool>(info[first + 2]).FromMaybe(false);
+}
+
+/**
+ * Encodes and writes an image on a thread of the scheduler's pool.
+ */
+class WritePngFileWorker : public ScheduledWorker {
+    public:
+        WritePngFileWorker(Nan::Callback *callback, const EncodeParameters &parameters, const WriteParameters &file) :
+            ScheduledWorker(callback, "node-libpng:writePngFile"), parameters(parameters), file(file) {}
+
+        void Execute() override {
+            string error;
+            if (!encodeToFile(parameters, file, error)) {
+                SetErrorMessage(error.c_str());
+            }
+        }
+
+    protected:
+        void HandleOKCallback() override {
+            Nan::HandleScope scope;
+            Local<Value> argv[] = { Nan::Null() };
+            callback->Call(1, argv, async_resource);
+        }
+
+    private:
+        EncodeParameters parameters;
+        WriteParameters file;
+};
+
+NAN_METHOD(writePngFile) {
+    // 1st to 3rd Parameter: The path, whether to sync and whether to write atomically.
+    WriteParameters file;
+    parseWriteParameters(info, 0, file);
+    // 4th to 10th Parameter: The image to encode, as passed to `encode`.
+    EncodeParameters parameters;
+    if (!parseEncodeParameters(info, 3, parameters)) {
+        return;
+    }
+    // 11th Parameter: Whether to queue the job in the batch lane.
+    const auto priority = parseJobPriority(info[10]);
+    // 12th Parameter: The callback to call once the file is written.
+    auto worker = new WritePngFileWorker(new Nan::Callback(Local<Function>::Cast(info[11])), parameters, file);
+    // Keep the input buffer alive while it is encoded on the pool.
+    worker->SaveToPersistent("input", info[3]);
+    const auto id = scheduleWorker(worker, priority);
+    info.GetReturnValue().Set(Nan::New(static_cast<double>(id)));
+}
+
+NAN_METHOD(writePngFileSync) {
+    // 1st to 3rd Parameter: The path, whether to sync and whether to write atomically.
+    WriteParameters file;
+    parseWriteParameters(info, 0, file);
+    // 4th to 10th Parameter: The image to encode, as passed to `encode`.
+    EncodeParameters parameters;
+    if (!parseEncodeParameters(info, 3, parameters)) {
+        return;
+    }
+    string error;
+    if (!encodeToFile(parameters, file, error)) {
+        Nan::ThrowError(error.c_str());
+    }
+}
+
+NAN_MODULE_INIT(InitWriteFile) {
+    Nan::Set(target, Nan::New("__native_writePngFile").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(writePngFile)).ToLocalChecked());
+    Nan::Set(target, Nan::New("__native_writePngFileSync").ToLocalChecked(), Nan::GetFunction(Nan::New<FunctionTemplate>(writePngFileSync)).ToLocalChecked());
+}
@@ -0,0 +1,11 @@
+#ifndef WRITE_FILE_HPP
+#define WRITE_FILE_HPP
+
+#include <nan.h>
+
+NAN_METHOD(writePngFile);
+NAN_METHOD(writePngFileSync);
+
+NAN_MODULE_INIT(InitWriteFile);
+
+#endif
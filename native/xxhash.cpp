@@ -0,0 +1,118 @@
+#include "xxhash.hpp"
+
+#include <cstring>
+
+static const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t prime3 = 0x165667B19E3779F9ULL;
+static const uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// xxHash is specified on little-endian values, independent of the host.
+static inline uint64_t read64(const uint8_t *data) {
+    uint64_t value = 0;
+    for (int byte = 7; byte >= 0; --byte) {
+        value = (value << 8) | data[byte];
+    }
+    return value;
+}
+
+static inline uint32_t read32(const uint8_t *data) {
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+        (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+static inline uint64_t xxRound(uint64_t accumulator, uint64_t input) {
+    accumulator += input * prime2;
+    accumulator = rotateLeft(accumulator, 31);
+    return accumulator * prime1;
+}
+
+static inline uint64_t mergeRound(uint64_t hash, uint64_t accumulator) {
+    hash ^= xxRound(0, accumulator);
+    return hash * prime1 + prime4;
+}
+
+XXHash64::XXHash64(uint64_t seed) : seed(seed), totalLength(0), buffered(0) {
+    accumulators[0] = seed + prime1 + prime2;
+    accumulators[1] = seed + prime2;
+    accumulators[2] = seed;
+    accumulators[3] = seed - prime1;
+}
+
+void XXHash64::consumeStripe(const uint8_t *stripe) {
+    for (int lane = 0; lane < 4; ++lane) {
+        accumulators[lane] = xxRound(accumulators[lane], read64(stripe + lane * 8));
+    }
+}
+
+void XXHash64::update(const uint8_t *data, size_t length) {
+    totalLength += length;
+    // Complete a partially filled stripe first.
+    if (buffered > 0) {
+        const auto missing = sizeof(buffer) - buffered;
+        if (length < missing) {
+            memcpy(buffer + buffered, data, length);
+            buffered += length;
+            return;
+        }
+        memcpy(buffer + buffered, data, missing);
+        consumeStripe(buffer);
+        data += missing;
+        length -= missing;
+        buffered = 0;
+    }
+    while (length >= sizeof(buffer)) {
+        consumeStripe(data);
+        data += sizeof(buffer);
+        length -= sizeof(buffer);
+    }
+    memcpy(buffer, data, length);
+    buffered = length;
+}
+
+uint64_t XXHash64::digest() const {
+    uint64_t hash;
+    if (totalLength >= sizeof(buffer)) {
+        hash = rotateLeft(accumulators[0], 1) + rotateLeft(accumulators[1], 7) +
+            rotateLeft(accumulators[2], 12) + rotateLeft(accumulators[3], 18);
+        for (int lane = 0; lane < 4; ++lane) {
+            hash = mergeRound(hash, accumulators[lane]);
+        }
+    } else {
+        hash = seed + prime5;
+    }
+    hash += totalLength;
+
+    const uint8_t *remaining = buffer;
+    size_t length = buffered;
+    while (length >= 8) {
+        hash ^= xxRound(0, read64(remaining));
+        hash = rotateLeft(hash, 27) * prime1 + prime4;
+        remaining += 8;
+        length -= 8;
+    }
+    if (length >= 4) {
+        hash ^= static_cast<uint64_t>(read32(remaining)) * prime1;
+        hash = rotateLeft(hash, 23) * prime2 + prime3;
+        remaining += 4;
+        length -= 4;
+    }
+    while (length > 0) {
+        hash ^= (*remaining) * prime5;
+        hash = rotateLeft(hash, 11) * prime1;
+        ++remaining;
+        --length;
+    }
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
@@ -0,0 +1,29 @@
+#ifndef XXHASH_HPP
+#define XXHASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Streaming implementation of the 64 bit xxHash (XXH64) algorithm, a fast non-cryptographic hash.
+ * Feed data using `update` and retrieve the hash using `digest`. The result does not depend on how
+ * the data was split into calls to `update`.
+ */
+class XXHash64 {
+    public:
+        explicit XXHash64(uint64_t seed = 0);
+        void update(const uint8_t *data, size_t length);
+        uint64_t digest() const;
+
+    private:
+        void consumeStripe(const uint8_t *stripe);
+
+        uint64_t accumulators[4];
+        uint64_t seed;
+        uint64_t totalLength;
+        // Input which did not fill a whole stripe of 32 bytes yet.
+        uint8_t buffer[32];
+        size_t buffered;
+};
+
+#endif
@@ -0,0 +1,186 @@
+import { EventEmitter } from "events";
+import { readFileSync } from "fs";
+import { ApngDecoder, encodeApng, decode, rect, AbortSignalLike } from "..";
+
+const fixtures = `${__dirname}/fixtures`;
+const animated = readFileSync(`${fixtures}/animated-16px.png`);
+const indexed = readFileSync(`${fixtures}/indexed-16px.png`);
+
+class TestSignal implements AbortSignalLike {
+    public aborted = false;
+    private emitter = new EventEmitter();
+
+    public addEventListener(type: "abort", listener: () => void) {
+        this.emitter.on(type, listener);
+    }
+
+    public removeEventListener(type: "abort", listener: () => void) {
+        this.emitter.removeListener(type, listener);
+    }
+
+    public abort() {
+        this.aborted = true;
+        this.emitter.emit("abort");
+    }
+}
+
+// Returns the RGBA samples of a pixel of the canvas.
+function pixel(data: Buffer, width: number, x: number, y: number) {
+    return [...data.slice((y * width + x) * 4, (y * width + x + 1) * 4)];
+}
+
+// Creates a frame of 32x32 pixels with a gradient and a block of the given color.
+function frame(x: number, y: number, width: number, height: number, color: number[]) {
+    const data = Buffer.alloc(32 * 32 * 4);
+    for (let index = 0; index < 32 * 32; ++index) {
+        const column = index % 32;
+        const row = Math.floor(index / 32);
+        const inside = column >= x && column < x + width && row >= y && row < y + height;
+        data.set(inside ? color : [column * 8, row * 8, 128, 255], index * 4);
+    }
+    return data;
+}
+
+describe("ApngDecoder", () => {
+    it("renders the frames of an animation", () => {
+        const decoder = new ApngDecoder(animated);
+        expect([decoder.width, decoder.height, decoder.frameCount, decoder.plays]).toEqual([16, 16, 3, 2]);
+        const rendered = [];
+        for (const { index, region, delay, data } of decoder.frames()) {
+            expect(data).toBe(decoder.canvas);
+            rendered.push({ index, region, delay, pixels: [pixel(data, 16, 0, 0), pixel(data, 16, 5, 5)] });
+        }
+        expect(rendered).toEqual([
+            { index: 0, region: rect(0, 0, 16, 16), delay: 100, pixels: [[255, 0, 0, 255], [255, 0, 0, 255]] },
+            { index: 1, region: rect(4, 4, 8, 8), delay: 50, pixels: [[255, 0, 0, 255], [127, 128, 0, 255]] },
+            { index: 2, region: rect(0, 0, 4, 4), delay: 10, pixels: [[255, 255, 255, 255], [255, 0, 0, 255]] },
+        ]);
+    });
+
+    it("starts over on every iteration", () => {
+        const decoder = new ApngDecoder(animated);
+        const first = [...decoder].map(({ data }) => Buffer.from(data));
+        const second = [...decoder].map(({ data }) => Buffer.from(data));
+        expect(first).toHaveLength(3);
+        expect(second).toEqual(first);
+        expect(first[0].equals(first[1])).toBe(false);
+    });
+
+    it("decodes still images as a single frame", () => {
+        const decoder = new ApngDecoder(indexed, { limits: { maxWidth: 16 } });
+        expect([decoder.frameCount, decoder.plays]).toEqual([1, 0]);
+        const frames = [...decoder.frames()];
+        expect(frames.map(({ region, delay }) => ({ region, delay }))).toEqual([
+            { region: rect(0, 0, 16, 16), delay: 0 },
+        ]);
+        expect(frames[0].data.equals(decode(indexed, { output: "rgba8" }).data)).toBe(true);
+    });
+
+    it("checks the CRCs unless the input is trusted", () => {
+        const corrupted = Buffer.from(animated);
+        const offset = corrupted.indexOf("fdAT") - 4;
+        corrupted[offset + 8 + corrupted.readUInt32BE(offset)] ^= 0xff;
+        expect(() => new ApngDecoder(corrupted)).toThrowErrorMatchingSnapshot();
+        const frames = [...new ApngDecoder(corrupted, { trusted: true })].map(({ data }) => Buffer.from(data));
+        expect(frames).toEqual([...new ApngDecoder(animated)].map(({ data }) => Buffer.from(data)));
+    });
+
+    it("rejects invalid input", () => {
+        expect(() => new ApngDecoder(Buffer.from("test"))).toThrowErrorMatchingSnapshot();
+        expect(() => new ApngDecoder(animated.slice(0, 100))).toThrowErrorMatchingSnapshot();
+        expect(() => new ApngDecoder(animated, { limits: { maxWidth: 8 } })).toThrowErrorMatchingSnapshot();
+        expect(() => new ApngDecoder("test" as any)).toThrowErrorMatchingSnapshot();
+        expect(() => new ApngDecoder(animated, null)).toThrowErrorMatchingSnapshot();
+    });
+});
+
+describe("encodeApng", () => {
+    const frames = [
+        frame(0, 0, 0, 0, []),
+        frame(10, 12, 4, 3, [255, 0, 0, 255]),
+        frame(10, 12, 4, 3, [255, 0, 0, 255]),
+        frame(30, 20, 2, 12, [0, 0, 0, 0]),
+    ];
+
+    it("encodes only the regions which changed", async () => {
+        const buffer = await encodeApng([frames[0], { data: frames[1], delay: 250 }, frames[2], frames[3]], {
+            width: 32,
+            height: 32,
+            plays: 3,
+        });
+        const decoder = new ApngDecoder(buffer);
+        expect([decoder.width, decoder.height, decoder.frameCount, decoder.plays]).toEqual([32, 32, 4, 3]);
+        const rendered = [...decoder].map(({ region, delay, data }) => ({ region, delay, data: Buffer.from(data) }));
+        expect(rendered).toEqual([
+            { region: rect(0, 0, 32, 32), delay: 100, data: frames[0] },
+            { region: rect(10, 12, 4, 3), delay: 250, data: frames[1] },
+            { region: rect(0, 0, 1, 1), delay: 100, data: frames[2] },
+            { region: rect(10, 12, 22, 20), delay: 100, data: frames[3] },
+        ]);
+        // Decoders without support for APNG show the first frame.
+        expect(decode(buffer).data.equals(frames[0])).toBe(true);
+    });
+
+    it("encodes RGB frames", async () => {
+        const rgb = frames.map(data => Buffer.from(data.filter((_, index) => index % 4 !== 3)));
+        const buffer = await encodeApng(rgb, { width: 32, height: 32, delay: 40, compressionLevel: 1 });
+        expect(decode(buffer).colorType).toBe("rgb");
+        const rendered = [...new ApngDecoder(buffer)];
+        expect(rendered.map(({ delay }) => delay)).toEqual([40, 40, 40, 40]);
+        expect(rendered[3].data.equals(frame(30, 20, 2, 12, [0, 0, 0, 255]))).toBe(true);
+    });
+
+    it("compresses large frames in parallel", async () => {
+        const width = 600;
+        const height = 600;
+        const large = [0, 1, 2].map(step => {
+            const data = Buffer.alloc(width * height * 4, 255);
+            data.fill(step * 100, (100 * width + 50 * step) * 4, (500 * width) * 4);
+            return data;
+        });
+        const buffer = await encodeApng(large, { width, height, compressionLevel: 1, priority: "batch" });
+        const rendered = [...new ApngDecoder(buffer)].map(({ region, data }) => ({ region, data: Buffer.from(data) }));
+        expect(rendered.map(({ region }) => region)).toEqual([
+            rect(0, 0, 600, 600),
+            rect(0, 100, 600, 400),
+            rect(0, 100, 600, 400),
+        ]);
+        expect(rendered.map(({ data }) => data)).toEqual(large);
+    });
+
+    it("supports a callback", done => {
+        encodeApng(frames, { width: 32, height: 32 }, (error, buffer) => {
+            expect(error).toBeNull();
+            expect(new ApngDecoder(buffer).frameCount).toBe(4);
+            done();
+        });
+    });
+
+    it("rejects invalid frames and options", async () => {
+        const invalid: [any, any][] = [
+            [[], { width: 32, height: 32 }],
+            ["test", { width: 32, height: 32 }],
+            [frames, null],
+            [frames, { width: 0, height: 32 }],
+            [frames, { width: 32, height: 32.5 }],
+            [frames, { width: 32, height: 32, compressionLevel: 10 }],
+            [frames, { width: 32, height: 32, plays: -1 }],
+            [frames, { width: 32, height: 32, delay: 65536 }],
+            [[{ data: frames[0], delay: 1.5 }], { width: 32, height: 32 }],
+            [[frames[0], Buffer.alloc(10)], { width: 32, height: 32 }],
+            [[null], { width: 32, height: 32 }],
+            [frames, { width: 31, height: 32 }],
+            [frames, { width: 32, height: 32, priority: "urgent" }],
+        ];
+        for (const [input, options] of invalid) {
+            await expect(encodeApng(input, options)).rejects.toThrowErrorMatchingSnapshot();
+        }
+    });
+
+    it("can be aborted", async () => {
+        const signal = new TestSignal();
+        const aborted = encodeApng(frames, { width: 32, height: 32, signal });
+        signal.abort();
+        await expect(aborted).rejects.toHaveProperty("name", "AbortError");
+    });
+});
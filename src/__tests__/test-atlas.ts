@@ -0,0 +1,129 @@
+import { readFileSync } from "fs";
+import { buildAtlas, decode, encode, rect, Rect, Atlas } from "..";
+
+const names = [
+    "orange-rectangle.png",
+    "indexed-16px.png",
+    "grayscale-gradient-16px.png",
+    "grayscale-alpha-gradient-16px.png",
+    "red-blue-gradient-256px-interlaced.png",
+    "opaque-rectangle.png",
+];
+const sprites = names.map(name => readFileSync(`${__dirname}/fixtures/${name}`));
+
+function region(data: Buffer, width: number, [x, y, regionWidth, regionHeight]: Rect) {
+    const rows = [];
+    for (let row = y; row < y + regionHeight; ++row) {
+        rows.push(data.slice((row * width + x) * 4, (row * width + x + regionWidth) * 4));
+    }
+    return Buffer.concat(rows);
+}
+
+function overlaps([x1, y1, w1, h1]: Rect, [x2, y2, w2, h2]: Rect, padding: number) {
+    return x1 < x2 + w2 + padding && x2 < x1 + w1 + padding && y1 < y2 + h2 + padding && y2 < y1 + h1 + padding;
+}
+
+function expectSprites(atlas: Atlas, buffers: Buffer[], padding: number) {
+    const image = decode(atlas.buffer);
+    expect([image.width, image.height, image.colorType]).toEqual([atlas.width, atlas.height, "rgba"]);
+    atlas.frames.forEach((frame, index) => {
+        const sprite = decode(buffers[index], { output: "rgba8" });
+        expect([frame.width, frame.height]).toEqual([sprite.width, sprite.height]);
+        expect(frame.x).toBeGreaterThanOrEqual(padding);
+        expect(frame.y).toBeGreaterThanOrEqual(padding);
+        expect(frame.x + frame.width + padding).toBeLessThanOrEqual(atlas.width);
+        expect(frame.y + frame.height + padding).toBeLessThanOrEqual(atlas.height);
+        expect(region(image.data, atlas.width, frame).equals(sprite.data)).toBe(true);
+        atlas.frames.slice(0, index).forEach(other => expect(overlaps(frame, other, padding)).toBe(false));
+    });
+}
+
+describe("buildAtlas", () => {
+    it("packs the sprites using maxrects", async () => {
+        const atlas = await buildAtlas(sprites);
+        expect(atlas.frames).toHaveLength(sprites.length);
+        expectSprites(atlas, sprites, 0);
+    });
+
+    it("packs the sprites using shelves", async () => {
+        const atlas = await buildAtlas(sprites, { pack: "shelf", padding: 2 });
+        expectSprites(atlas, sprites, 2);
+    });
+
+    it("leaves the padding transparent", async () => {
+        const atlas = await buildAtlas([sprites[5], sprites[5]], { padding: 3 });
+        const image = decode(atlas.buffer);
+        expect(region(image.data, atlas.width, rect(0, 0, atlas.width, 3)).every(sample => sample === 0)).toBe(true);
+        expect(atlas.frames[0].x === 3 || atlas.frames[1].x === 3).toBe(true);
+    });
+
+    it("packs many sprites of mixed sizes", async () => {
+        const many: Buffer[] = [];
+        for (let index = 0; index < 40; ++index) {
+            const width = 4 + (index * 7) % 29;
+            const height = 4 + (index * 11) % 23;
+            const data = Buffer.alloc(width * height * 4, index * 6);
+            many.push(encode(data, { width, height, compressionLevel: 1 }));
+        }
+        const maxrects = await buildAtlas(many, { padding: 1 });
+        expectSprites(maxrects, many, 1);
+        const shelf = await buildAtlas(many, { pack: "shelf" });
+        expectSprites(shelf, many, 0);
+    });
+
+    it("decodes large amounts of sprites in parallel", async () => {
+        const gradients = new Array(20).fill(sprites[4]);
+        const atlas = await buildAtlas(gradients, { compressionLevel: 1, priority: "batch" });
+        expectSprites(atlas, gradients, 0);
+    });
+
+    it("supports a callback", done => {
+        buildAtlas(sprites.slice(0, 2), (error, atlas) => {
+            expect(error).toBeNull();
+            expectSprites(atlas, sprites, 0);
+            buildAtlas(sprites.slice(0, 2), { pack: "shelf" }, (secondError, secondAtlas) => {
+                expect(secondError).toBeNull();
+                expectSprites(secondAtlas, sprites, 0);
+                done();
+            });
+        });
+    });
+
+    it("rejects sprites which don't fit", async () => {
+        await expect(buildAtlas(sprites, { maxSize: 260 })).rejects.toThrowErrorMatchingSnapshot();
+        await expect(buildAtlas(sprites, { maxSize: 260, pack: "shelf" })).rejects.toThrowErrorMatchingSnapshot();
+        await expect(buildAtlas(sprites.slice(0, 2), { maxSize: 20 })).rejects.toThrowErrorMatchingSnapshot();
+    });
+
+    it("rejects invalid sprites", async () => {
+        const empty = Buffer.from(sprites[1]);
+        empty.writeUInt32BE(0, 16);
+        const truncated = sprites[1].slice(0, 40);
+        await expect(buildAtlas([])).rejects.toThrowErrorMatchingSnapshot();
+        await expect(buildAtlas("sprites" as any)).rejects.toThrowErrorMatchingSnapshot();
+        await expect(buildAtlas([sprites[0], Buffer.from("test")])).rejects.toThrowErrorMatchingSnapshot();
+        await expect(buildAtlas([sprites[0], "test" as any])).rejects.toThrowErrorMatchingSnapshot();
+        await expect(buildAtlas([empty])).rejects.toThrowErrorMatchingSnapshot();
+        await expect(buildAtlas([sprites[0], truncated])).rejects.toThrowErrorMatchingSnapshot();
+    });
+
+    it("applies the limits to every sprite", async () => {
+        await expect(buildAtlas(sprites, { limits: { maxWidth: 100 } })).rejects.toThrowErrorMatchingSnapshot();
+    });
+
+    it("rejects invalid options", async () => {
+        const invalid: any[] = [
+            null,
+            { padding: -1 },
+            { maxSize: 0 },
+            { maxSize: 1.5 },
+            { pack: "guillotine" },
+            { compressionLevel: 10 },
+            { limits: { maxChunks: 0 } },
+            { signal: "abort" },
+        ];
+        for (const options of invalid) {
+            await expect(buildAtlas(sprites, options)).rejects.toThrowErrorMatchingSnapshot();
+        }
+    });
+});
@@ -0,0 +1,215 @@
+import { readFileSync } from "fs";
+import {
+    readChunks,
+    rewriteChunks,
+    textChunk,
+    internationalTextChunk,
+    resolutionChunk,
+    timeChunk,
+    gammaChunk,
+    decode,
+    verify,
+} from "..";
+
+const orangeRectangle = readFileSync(`${__dirname}/fixtures/orange-rectangle.png`);
+const indexed = readFileSync(`${__dirname}/fixtures/indexed-16px.png`);
+// The orange rectangle with its `tIME` and `iTXt` chunks moved behind the image data.
+const trailing = Buffer.concat([
+    orangeRectangle.slice(0, 54),
+    orangeRectangle.slice(114, 158),
+    orangeRectangle.slice(54, 114),
+    orangeRectangle.slice(158),
+]);
+
+function chunkTypes(buffer: Buffer) {
+    return readChunks(buffer).map(({ type }) => type);
+}
+
+function imageData(buffer: Buffer) {
+    return readChunks(buffer).find(({ type }) => type === "IDAT").data;
+}
+
+describe("readChunks", () => {
+    it("reads all chunks", () => {
+        const chunks = readChunks(orangeRectangle);
+        expect(chunks.map(({ type, offset, data }) => [type, offset, data.length])).toEqual([
+            ["IHDR", 8, 13],
+            ["pHYs", 33, 9],
+            ["tIME", 54, 7],
+            ["iTXt", 73, 29],
+            ["IDAT", 114, 32],
+            ["IEND", 158, 0],
+        ]);
+        expect(chunks[3].data.toString("latin1")).toBe("Comment\0\0\0\0\0Created with GIMP");
+    });
+
+    it("throws an error when trying to read something which isn't a buffer", () => {
+        expect(() => readChunks("test" as any)).toThrowErrorMatchingSnapshot();
+    });
+
+    it("throws an error when reading something which isn't a PNG", () => {
+        const jpg = readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px.jpg`);
+        expect(() => readChunks(jpg)).toThrowErrorMatchingSnapshot();
+    });
+
+    it("throws an error when a chunk is truncated", () => {
+        expect(() => readChunks(orangeRectangle.slice(0, 100))).toThrowErrorMatchingSnapshot();
+    });
+
+    it("throws an error when the IEND chunk is missing", () => {
+        expect(() => readChunks(orangeRectangle.slice(0, 158))).toThrowErrorMatchingSnapshot();
+    });
+});
+
+describe("rewriteChunks", () => {
+    it("removes chunks", () => {
+        const rewritten = rewriteChunks(orangeRectangle, { remove: ["pHYs", "tIME", "iTXt"] });
+        expect(rewritten.length).toBe(89);
+        expect(chunkTypes(rewritten)).toEqual(["IHDR", "IDAT", "IEND"]);
+        expect(decode(rewritten).data).toEqual(decode(orangeRectangle).data);
+    });
+
+    it("adds chunks before the image data", () => {
+        const rewritten = rewriteChunks(orangeRectangle, { add: [textChunk("Title", "Orange")] });
+        expect(chunkTypes(rewritten)).toEqual(["IHDR", "pHYs", "tIME", "iTXt", "tEXt", "IDAT", "IEND"]);
+        expect(verify(rewritten)).toEqual({ valid: true });
+        expect(imageData(rewritten)).toEqual(imageData(orangeRectangle));
+    });
+
+    it("adds chunks which need to appear before the palette before the palette", () => {
+        const rewritten = rewriteChunks(indexed, { add: [gammaChunk(1 / 2.2), resolutionChunk(72)] });
+        expect(chunkTypes(rewritten)).toEqual(["IHDR", "gAMA", "PLTE", "tRNS", "pHYs", "IDAT", "IEND"]);
+        expect(verify(rewritten)).toEqual({ valid: true });
+        expect(decode(rewritten).gamma).toBeCloseTo(1 / 2.2, 4);
+    });
+
+    it("replaces chunks in place", () => {
+        const time = new Date(Date.UTC(2020, 0, 2, 3, 4, 5));
+        const rewritten = rewriteChunks(orangeRectangle, { replace: [resolutionChunk(300), timeChunk(time)] });
+        expect(chunkTypes(rewritten)).toEqual(["IHDR", "pHYs", "tIME", "iTXt", "IDAT", "IEND"]);
+        expect(verify(rewritten)).toEqual({ valid: true });
+        const image = decode(rewritten);
+        expect(image.pixelsPerMeterX).toBe(11811);
+        expect(image.pixelsPerMeterY).toBe(11811);
+        expect(image.time).toEqual(time);
+    });
+
+    it("replaces chunks after the image data in place", () => {
+        const time = new Date(Date.UTC(2020, 0, 2, 3, 4, 5));
+        const replace = [timeChunk(time), internationalTextChunk("Title", "Orange"), gammaChunk(1)];
+        const rewritten = rewriteChunks(trailing, { replace });
+        expect(chunkTypes(rewritten)).toEqual(["IHDR", "pHYs", "gAMA", "IDAT", "tIME", "iTXt", "IEND"]);
+        expect(verify(rewritten)).toEqual({ valid: true });
+        expect(readChunks(rewritten)[4].data.toString("hex")).toBe("07e40102030405");
+        expect(readChunks(rewritten)[5].data.toString("latin1")).toBe("Title\0\0\0\0\0Orange");
+    });
+
+    it("adds replaced chunks before the image data if all chunks of the type are removed", () => {
+        const rewritten = rewriteChunks(trailing, { remove: ["tIME"], replace: [timeChunk(new Date())] });
+        expect(chunkTypes(rewritten)).toEqual(["IHDR", "pHYs", "tIME", "IDAT", "iTXt", "IEND"]);
+    });
+
+    it("replaces all chunks of a type with a single chunk", () => {
+        const twice = rewriteChunks(orangeRectangle, { add: [textChunk("Title", "A"), textChunk("Author", "B")] });
+        const rewritten = rewriteChunks(twice, { replace: [textChunk("Title", "C")] });
+        const texts = readChunks(rewritten).filter(({ type }) => type === "tEXt");
+        expect(texts.map(({ data }) => data.toString("latin1"))).toEqual(["Title\0C"]);
+    });
+
+    it("replaces text chunks", () => {
+        const rewritten = rewriteChunks(orangeRectangle, { replace: [internationalTextChunk("Title", "Orange")] });
+        expect(chunkTypes(rewritten)).toEqual(["IHDR", "pHYs", "tIME", "iTXt", "IDAT", "IEND"]);
+        expect(readChunks(rewritten)[3].data.toString("latin1")).toBe("Title\0\0\0\0\0Orange");
+    });
+
+    it("adds replaced chunks which don't exist yet", () => {
+        const rewritten = rewriteChunks(orangeRectangle, { replace: [gammaChunk(1)] });
+        expect(chunkTypes(rewritten)).toEqual(["IHDR", "pHYs", "tIME", "iTXt", "gAMA", "IDAT", "IEND"]);
+    });
+
+    it("returns an identical copy without any changes", () => {
+        expect(rewriteChunks(orangeRectangle, {})).toEqual(orangeRectangle);
+    });
+
+    it("throws an error when trying to rewrite something which isn't a buffer", () => {
+        expect(() => rewriteChunks("test" as any, {})).toThrowErrorMatchingSnapshot();
+    });
+
+    it("throws an error if the options are not an object", () => {
+        expect(() => rewriteChunks(orangeRectangle, null)).toThrowErrorMatchingSnapshot();
+    });
+
+    it("throws an error if the chunk types to remove are not an array", () => {
+        expect(() => rewriteChunks(orangeRectangle, { remove: "tEXt" as any })).toThrowErrorMatchingSnapshot();
+    });
+
+    it("throws an error if the chunks are not an array", () => {
+        const add = textChunk("Title", "Text") as any;
+        expect(() => rewriteChunks(orangeRectangle, { add })).toThrowErrorMatchingSnapshot();
+    });
+
+    it("throws an error for invalid chunk types", () => {
+        expect(() => rewriteChunks(orangeRectangle, { remove: ["tEX"] })).toThrowErrorMatchingSnapshot();
+        expect(() => rewriteChunks(orangeRectangle, { remove: [1 as any] })).toThrowErrorMatchingSnapshot();
+    });
+
+    it("throws an error when touching critical chunks", () => {
+        expect(() => rewriteChunks(orangeRectangle, { remove: ["IDAT"] })).toThrowErrorMatchingSnapshot();
+    });
+
+    it("throws an error for chunks without a buffer", () => {
+        const add = [{ type: "tEXt", data: "text" as any }];
+        expect(() => rewriteChunks(orangeRectangle, { add })).toThrowErrorMatchingSnapshot();
+        expect(() => rewriteChunks(orangeRectangle, { add: [null] })).toThrowErrorMatchingSnapshot();
+        expect(() => rewriteChunks(orangeRectangle, { add: ["tEXt" as any] })).toThrowErrorMatchingSnapshot();
+    });
+
+    it("throws an error when rewriting something which isn't a PNG", () => {
+        const jpg = readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px.jpg`);
+        expect(() => rewriteChunks(jpg, {})).toThrowErrorMatchingSnapshot();
+    });
+});
+
+describe("chunk helpers", () => {
+    it("creates text chunks", () => {
+        expect(textChunk("Title", "Äpfel").data).toEqual(Buffer.from("Title\0Äpfel", "latin1"));
+        expect(internationalTextChunk("Title", "日本", "ja").data).toEqual(Buffer.concat([
+            Buffer.from("Title\0\0\0ja\0\0", "latin1"),
+            Buffer.from("日本", "utf8"),
+        ]));
+        expect(internationalTextChunk("Title", "Text").data.toString("latin1")).toBe("Title\0\0\0\0\0Text");
+    });
+
+    it("throws an error for invalid keywords", () => {
+        expect(() => textChunk("", "Text")).toThrowErrorMatchingSnapshot();
+        expect(() => textChunk("a".repeat(80), "Text")).toThrowErrorMatchingSnapshot();
+        expect(() => textChunk(undefined, "Text")).toThrowErrorMatchingSnapshot();
+    });
+
+    it("creates resolution chunks", () => {
+        expect(resolutionChunk(72).data.toString("hex")).toBe("00000b1300000b1301");
+    });
+
+    it("throws an error for invalid resolutions", () => {
+        expect(() => resolutionChunk(0)).toThrowErrorMatchingSnapshot();
+        expect(() => resolutionChunk("72" as any)).toThrowErrorMatchingSnapshot();
+    });
+
+    it("creates time chunks", () => {
+        expect(timeChunk(new Date(Date.UTC(2020, 11, 24, 18, 30, 59))).data.toString("hex")).toBe("07e40c18121e3b");
+    });
+
+    it("throws an error for invalid times", () => {
+        expect(() => timeChunk(new Date("invalid"))).toThrowErrorMatchingSnapshot();
+        expect(() => timeChunk(0 as any)).toThrowErrorMatchingSnapshot();
+    });
+
+    it("creates gamma chunks", () => {
+        expect(gammaChunk(1 / 2.2).data.readUInt32BE(0)).toBe(45455);
+    });
+
+    it("throws an error for invalid gammas", () => {
+        expect(() => gammaChunk(-1)).toThrowErrorMatchingSnapshot();
+        expect(() => gammaChunk(undefined)).toThrowErrorMatchingSnapshot();
+    });
+});
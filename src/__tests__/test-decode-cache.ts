@@ -0,0 +1,119 @@
+import { readFileSync } from "fs";
+import { DecodeCache, decode, readPngFile, readPngFileSync, colorRGB, PngImage, rect } from "..";
+
+describe("DecodeCache", () => {
+    // This fixtures is a 32w, 16h rectangle with RGB = (255, 128, 64) and no alpha channel.
+    const someOrangeRectanglePath = `${__dirname}/fixtures/orange-rectangle.png`;
+    const someOrangeRectangle = readFileSync(someOrangeRectanglePath);
+    const someGradientPath = `${__dirname}/fixtures/red-blue-gradient-256px.png`;
+    const someGradient = readFileSync(someGradientPath);
+
+    it("serves repeated decodes from the cache", () => {
+        const cache = new DecodeCache();
+        const first = cache.decode(someOrangeRectangle);
+        const second = cache.decode(Buffer.from(someOrangeRectangle));
+        expect(second).not.toBe(first);
+        expect(second.data.equals(first.data)).toBe(true);
+        expect(second.width).toBe(32);
+        expect(cache.stats).toEqual({ hits: 1, misses: 1, evictions: 0, entries: 1, bytes: 32 * 16 * 3 });
+    });
+
+    it("returns copies which can be modified independently", () => {
+        const cache = new DecodeCache();
+        cache.decode(someOrangeRectangle).fill(colorRGB(0, 0, 0));
+        const image = cache.decode(someOrangeRectangle);
+        image.fill(colorRGB(1, 2, 3));
+        expect(cache.decode(someOrangeRectangle).at(0, 0)).toEqual(colorRGB(255, 128, 64));
+    });
+
+    it("keeps the cached image intact when the pixels of a hit are modified", async () => {
+        const cache = new DecodeCache();
+        const original = cache.decode(someGradient).encode();
+        cache.decode(someGradient).data.fill(0);
+        cache.decode(someGradient).getRegion(rect(0, 0, 10, 10)).forEach(row => row.fill(0));
+        cache.decode(someGradient).crop(rect(0, 0, 10, 10));
+        const target = cache.decode(someGradient);
+        target.copyFrom(cache.decode(someOrangeRectangle));
+        expect(target.at(0, 0)).toEqual(colorRGB(255, 128, 64));
+        (await cache.readPngFile(someGradientPath)).data.fill(0);
+        expect(cache.decode(someGradient).encode()).toEqual(original);
+        expect((await cache.readPngFile(someGradientPath)).encode()).toEqual(original);
+        expect(cache.stats).toMatchObject({ hits: 6, misses: 3 });
+    });
+
+    it("distinguishes between decode options", () => {
+        const cache = new DecodeCache();
+        cache.decode(someOrangeRectangle);
+        const image = cache.decode(someOrangeRectangle, { output: "rgba8" });
+        expect(image.colorType).toBe("rgba");
+        expect(cache.stats.misses).toBe(2);
+    });
+
+    it("evicts the least recently used images", () => {
+        const cache = new DecodeCache({ maxBytes: 256 * 256 * 3 + 32 * 16 * 3 });
+        cache.decode(someOrangeRectangle);
+        cache.decode(someGradient);
+        // Use the orange rectangle, so the gradient is the least recently used image.
+        cache.decode(someOrangeRectangle);
+        cache.decode(someOrangeRectangle, { output: "rgb8" });
+        expect(cache.stats).toEqual({ hits: 1, misses: 3, evictions: 1, entries: 2, bytes: 2 * 32 * 16 * 3 });
+        cache.decode(someGradient);
+        expect(cache.stats.misses).toBe(4);
+    });
+
+    it("doesn't cache images larger than the budget", () => {
+        const cache = new DecodeCache({ maxBytes: 100 });
+        cache.decode(someOrangeRectangle);
+        expect(cache.stats.entries).toBe(0);
+    });
+
+    it("can be cleared", () => {
+        const cache = new DecodeCache();
+        cache.decode(someOrangeRectangle);
+        cache.clear();
+        expect(cache.stats.entries).toBe(0);
+        expect(cache.stats.bytes).toBe(0);
+        cache.decode(someOrangeRectangle);
+        expect(cache.stats.misses).toBe(2);
+    });
+
+    it("caches files by their path and modification time", async () => {
+        const cache = new DecodeCache();
+        const first = await cache.readPngFile(someOrangeRectanglePath);
+        const second = await cache.readPngFile(someOrangeRectanglePath);
+        const third = cache.readPngFileSync(someOrangeRectanglePath);
+        expect(first).toBeInstanceOf(PngImage);
+        expect(second.data.equals(first.data)).toBe(true);
+        expect(third.data.equals(first.data)).toBe(true);
+        expect(cache.stats).toMatchObject({ hits: 2, misses: 1, entries: 1 });
+    });
+
+    it("rejects when the file can't be read or decoded", async () => {
+        const cache = new DecodeCache();
+        await expect(cache.readPngFile(`${__dirname}/fixtures/does-not-exist.png`)).rejects.toThrow();
+        await expect(cache.readPngFile(`${__dirname}/fixtures/text-file.txt`)).rejects.toThrowErrorMatchingSnapshot();
+    });
+
+    it("is used by the decode functions with the `cache` option", async () => {
+        const cache = new DecodeCache();
+        decode(someOrangeRectangle, { cache });
+        decode(someOrangeRectangle, { cache });
+        readPngFileSync(someGradientPath, { cache });
+        await readPngFile(someGradientPath, { cache });
+        const image = await new Promise<PngImage>((resolve, reject) => {
+            readPngFile(someGradientPath, { cache }, (error, pngImage) => error ? reject(error) : resolve(pngImage));
+        });
+        expect(image.width).toBe(256);
+        await expect(new Promise((resolve, reject) => {
+            readPngFile(`${__dirname}/fixtures/text-file.txt`, { cache }, (error) => error ? reject(error) : resolve());
+        })).rejects.toThrow();
+        expect(cache.stats).toMatchObject({ hits: 3, misses: 3, entries: 2 });
+    });
+
+    it("throws an error with invalid input", () => {
+        const cache = new DecodeCache();
+        expect(() => cache.decode("not a buffer" as any)).toThrowErrorMatchingSnapshot();
+        expect(() => new DecodeCache(null)).toThrowErrorMatchingSnapshot();
+        expect(() => new DecodeCache({ maxBytes: -1 })).toThrowErrorMatchingSnapshot();
+    });
+});
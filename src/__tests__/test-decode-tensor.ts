@@ -0,0 +1,102 @@
+import { readFileSync } from "fs";
+import { decodeTensor, decodeTensorBatch } from "..";
+
+describe("decodeTensor", () => {
+    // This fixtures is a 32w, 16h rectangle with RGB = (255, 128, 64) and no alpha channel.
+    const someOrangeRectangle = readFileSync(`${__dirname}/fixtures/orange-rectangle.png`);
+    // The same rectangle, but interlaced.
+    const someInterlacedOrangeRectangle = readFileSync(`${__dirname}/fixtures/orange-rectangle-gamma-background.png`);
+    const someGradient = readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px.png`);
+
+    it("decodes an image into a normalized NCHW float32 tensor by default", () => {
+        const { data, shape, layout, dtype } = decodeTensor(someOrangeRectangle);
+        expect(data).toBeInstanceOf(Float32Array);
+        expect(shape).toEqual([1, 3, 16, 32]);
+        expect(layout).toBe("nchw");
+        expect(dtype).toBe("float32");
+        expect(data.length).toBe(3 * 16 * 32);
+        expect(data[0]).toBeCloseTo(1);
+        expect(data[16 * 32 - 1]).toBeCloseTo(1);
+        expect(data[16 * 32]).toBeCloseTo(128 / 255);
+        expect(data[2 * 16 * 32]).toBeCloseTo(64 / 255);
+    });
+
+    it("decodes an image into an NHWC uint8 tensor", () => {
+        const { data, shape } = decodeTensor(someOrangeRectangle, { layout: "nhwc", dtype: "uint8" });
+        expect(data).toBeInstanceOf(Uint8Array);
+        expect(shape).toEqual([1, 16, 32, 3]);
+        expect(Array.from(data.slice(0, 6))).toEqual([255, 128, 64, 255, 128, 64]);
+    });
+
+    it("decodes an image into an NCHW uint8 tensor", () => {
+        const { data } = decodeTensor(someOrangeRectangle, { dtype: "uint8" });
+        expect(data[0]).toBe(255);
+        expect(data[16 * 32]).toBe(128);
+        expect(data[2 * 16 * 32]).toBe(64);
+    });
+
+    it("normalizes the samples with mean and standard deviation", () => {
+        const { data } = decodeTensor(someOrangeRectangle, {
+            layout: "nhwc",
+            mean: [0.5, 0.5, 0],
+            std: [0.5, 0.25, 2],
+        });
+        expect(data[0]).toBeCloseTo(1);
+        expect(data[1]).toBeCloseTo((128 / 255 - 0.5) / 0.25);
+        expect(data[2]).toBeCloseTo(64 / 255 / 2);
+    });
+
+    it("converts the image to the requested amount of channels", () => {
+        const { data, shape } = decodeTensor(someOrangeRectangle, { channels: 4, layout: "nhwc", dtype: "uint8" });
+        expect(shape).toEqual([1, 16, 32, 4]);
+        expect(Array.from(data.slice(0, 4))).toEqual([255, 128, 64, 255]);
+        expect(decodeTensor(someOrangeRectangle, { channels: 1, dtype: "uint8" }).data[0]).toBe(150);
+    });
+
+    it("converts palette images with transparency to the requested amount of channels", () => {
+        const someIndexedImage = readFileSync(`${__dirname}/fixtures/indexed-16px.png`);
+        const { data, shape } = decodeTensor(someIndexedImage, { layout: "nhwc", dtype: "uint8" });
+        expect(shape).toEqual([1, 16, 16, 3]);
+        expect(Array.from(data.slice(0, 3))).toEqual([128, 255, 64]);
+        expect(Array.from(data.slice(15 * 16 * 3, 15 * 16 * 3 + 3))).toEqual([255, 128, 64]);
+        expect(decodeTensor(someIndexedImage, { channels: 1, dtype: "uint8" }).data[0]).toBe(214);
+    });
+
+    it("decodes a batch of images into a contiguous tensor", () => {
+        const { data, shape } = decodeTensorBatch([someOrangeRectangle, someInterlacedOrangeRectangle], {
+            layout: "nhwc",
+            dtype: "uint8",
+        });
+        expect(shape).toEqual([2, 16, 32, 3]);
+        expect(Array.from(data.slice(0, 3))).toEqual([255, 128, 64]);
+        expect(Array.from(data.slice(data.length - 3))).toEqual([255, 128, 64]);
+    });
+
+    it("throws an error if the images in a batch have different dimensions", () => {
+        expect(() => decodeTensorBatch([someOrangeRectangle, someGradient])).toThrowErrorMatchingSnapshot();
+    });
+
+    it("throws an error if an image could not be decoded", () => {
+        const someJpeg = readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px.jpg`);
+        expect(() => decodeTensor(someJpeg)).toThrowErrorMatchingSnapshot();
+    });
+
+    it("throws an error if the input is not a buffer", () => {
+        expect(() => decodeTensor("something" as any)).toThrowErrorMatchingSnapshot();
+    });
+
+    it("throws an error if the batch is empty", () => {
+        expect(() => decodeTensorBatch([])).toThrowErrorMatchingSnapshot();
+        expect(() => decodeTensorBatch("something" as any)).toThrowErrorMatchingSnapshot();
+    });
+
+    it("throws an error with invalid options", () => {
+        expect(() => decodeTensor(someOrangeRectangle, null)).toThrowErrorMatchingSnapshot();
+        expect(() => decodeTensor(someOrangeRectangle, { layout: "chw" as any })).toThrowErrorMatchingSnapshot();
+        expect(() => decodeTensor(someOrangeRectangle, { dtype: "float16" as any })).toThrowErrorMatchingSnapshot();
+        expect(() => decodeTensor(someOrangeRectangle, { channels: 2 as any })).toThrowErrorMatchingSnapshot();
+        expect(() => decodeTensor(someOrangeRectangle, { mean: [0] })).toThrowErrorMatchingSnapshot();
+        expect(() => decodeTensor(someOrangeRectangle, { std: "1" as any })).toThrowErrorMatchingSnapshot();
+        expect(() => decodeTensor(someOrangeRectangle, { std: [1, 0, 1] })).toThrowErrorMatchingSnapshot();
+    });
+});
@@ -1,5 +1,5 @@
-import { readFileSync } from "fs";
-import { decode, readPngFile, readPngFileSync } from "..";
+import { readFileSync, writeFileSync } from "fs";
+import { decode, encode, readPngFile, readPngFileSync } from "..";
 import { expectEveryPixel } from "./utils";
 
 describe("decode", () => {
@@ -27,12 +27,231 @@ describe("decode", () => {
     it("throws an error when trying to decode something which isn't a buffer", () => {
         expect(() => decode("something" as any)).toThrowErrorMatchingSnapshot();
     });
+
+    describe("with an output format", () => {
+        const someIndexedImage = readFileSync(`${__dirname}/fixtures/indexed-16px.png`);
+        const someOneBitIndexedImage = readFileSync(`${__dirname}/fixtures/indexed-background.png`);
+        const someGrayScaleAlphaImage = readFileSync(`${__dirname}/fixtures/grayscale-alpha-gradient-16px.png`);
+
+        it("keeps the image's format with `native`", () => {
+            const image = decode(someIndexedImage, { output: "native" });
+            expect(image.colorType).toBe("palette");
+            expect(image.at(0, 0)).toEqual([1]);
+        });
+
+        it("expands a palette image with transparency to `rgba8`", () => {
+            const image = decode(someIndexedImage, { output: "rgba8" });
+            expect(image.colorType).toBe("rgba");
+            expect(image.bitDepth).toBe(8);
+            expect(image.channels).toBe(4);
+            expect(image.rowBytes).toBe(16 * 4);
+            expect(image.at(0, 0)).toEqual([128, 255, 64, 255]);
+            expect(image.at(0, 15)).toEqual([255, 128, 64, 255]);
+        });
+
+        it("adds an opaque alpha channel to an RGB image with `rgba8`", () => {
+            const image = decode(someOrangeRectangle, { output: "rgba8" });
+            expect(image.data.length).toBe(32 * 16 * 4);
+            expectEveryPixel(image.data, [255, 128, 64, 255]);
+        });
+
+        it("expands a gray-scale image to `rgba8`", () => {
+            const image = decode(someGrayScaleAlphaImage, { output: "rgba8" });
+            expect(image.at(1, 0)).toEqual([238, 238, 238, 127]);
+        });
+
+        it("strips the alpha channel with `rgb8`", () => {
+            const image = decode(someOpaqueRectangle, { output: "rgb8" });
+            expect(image.colorType).toBe("rgb");
+            expectEveryPixel(image.data, [255, 128, 64]);
+        });
+
+        it("unpacks a 1 bit palette image with `rgb8`", () => {
+            const image = decode(someOneBitIndexedImage, { output: "rgb8" });
+            expect(image.colorType).toBe("rgb");
+            expect(image.bitDepth).toBe(8);
+            expect(image.data.length).toBe(16 * 8 * 3);
+        });
+
+        it("drops the transparency of a palette image with `rgb8`", () => {
+            const image = decode(someIndexedImage, { output: "rgb8" });
+            expect(image.colorType).toBe("rgb");
+            expect(image.channels).toBe(3);
+            expect(image.data.length).toBe(16 * 16 * 3);
+            expect(image.at(0, 0)).toEqual([128, 255, 64]);
+        });
+
+        it("drops the transparency of a palette image with `gray8`", () => {
+            const image = decode(someIndexedImage, { output: "gray8" });
+            expect(image.colorType).toBe("gray-scale");
+            expect(image.channels).toBe(1);
+            expect(image.data.length).toBe(16 * 16);
+            expect(image.at(0, 0)).toEqual([214]);
+        });
+
+        it("reduces an RGB image to its luminance with `gray8`", () => {
+            const image = decode(someOrangeRectangle, { output: "gray8" });
+            expect(image.colorType).toBe("gray-scale");
+            expect(image.data.length).toBe(32 * 16);
+            expect(image.at(0, 0)).toEqual([150]);
+        });
+
+        it("strips the alpha channel of a gray-scale image with `gray8`", () => {
+            const image = decode(someGrayScaleAlphaImage, { output: "gray8" });
+            expect(image.colorType).toBe("gray-scale");
+            expect(image.at(1, 0)).toEqual([238]);
+        });
+
+        it("throws an error with an unknown output format", () => {
+            expect(() => decode(someIndexedImage, { output: "cmyk" as any })).toThrowErrorMatchingSnapshot();
+        });
+
+        it("throws an error if the options are not an object", () => {
+            expect(() => decode(someIndexedImage, "rgba8" as any)).toThrowErrorMatchingSnapshot();
+        });
+    });
+});
+
+describe("decode with premultiplied alpha and linear light", () => {
+    const someOrangeRectangle = readFileSync(`${__dirname}/fixtures/orange-rectangle.png`);
+    // This fixture is a 32w, 16h rectangle with RGBA = (255, 128, 64, 127).
+    const someOpaqueRectangle = readFileSync(`${__dirname}/fixtures/opaque-rectangle.png`);
+
+    function expectCloseTo(actual: Buffer, expected: number[]) {
+        expected.forEach((value, index) => expect(Math.abs(actual[index] - value)).toBeLessThanOrEqual(2));
+    }
+
+    it("premultiplies the color samples with the alpha channel", () => {
+        const image = decode(someOpaqueRectangle, { premultiplied: true });
+        expect(image.premultiplied).toBe(true);
+        expectCloseTo(image.data, [127, 64, 32, 127]);
+    });
+
+    it("does not mark images without alpha channel as premultiplied", () => {
+        const image = decode(someOrangeRectangle, { premultiplied: true });
+        expect(image.premultiplied).toBe(false);
+        expectEveryPixel(image.data, [255, 128, 64]);
+    });
+
+    it("premultiplies images with another gamma than sRGB without converting them", () => {
+        const pixels = Buffer.from([255, 128, 64, 127, 200, 100, 50, 255]);
+        const image = decode(encode(pixels, { width: 2, height: 1, gamma: 1 / 1.8 }), { premultiplied: true });
+        expect(Array.from(image.data)).toEqual([127, 64, 32, 127, 200, 100, 50, 255]);
+        expect(image.gamma).toBeCloseTo(1 / 1.8, 4);
+        const encoded = decode(image.encode());
+        expectCloseTo(encoded.data, [255, 128, 64, 127, 200, 100, 50, 255]);
+        expect(encoded.gamma).toBeCloseTo(1 / 1.8, 4);
+        const opaque = encode(Buffer.from([200, 100, 50]), { width: 1, height: 1, gamma: 1 / 1.8 });
+        expect(Array.from(decode(opaque, { premultiplied: true }).data)).toEqual([200, 100, 50]);
+    });
+
+    it("reverts the premultiplication when encoding the image again", () => {
+        const image = decode(someOpaqueRectangle, { premultiplied: true });
+        expectCloseTo(decode(image.encode()).data, [255, 128, 64, 127]);
+    });
+
+    it("converts the samples into linear light", () => {
+        const image = decode(someOrangeRectangle, { linear: true });
+        expect(image.premultiplied).toBe(false);
+        expect(image.linear).toBe(true);
+        expect(decode(someOrangeRectangle).linear).toBe(false);
+        expectCloseTo(image.data, [255, 56, 12]);
+    });
+
+    it("encodes linear images with a gamma of 1", () => {
+        const image = decode(readFileSync(`${__dirname}/fixtures/orange-rectangle-gamma-background.png`), {
+            linear: true,
+        });
+        image.srgbIntent = "perceptual";
+        const encoded = decode(image.encode());
+        expect(encoded.gamma).toBe(1);
+        expect(encoded.srgbIntent).toBeUndefined();
+        expectCloseTo(encoded.data, [255, 56, 12]);
+        expectCloseTo(decode(image.encode(), { linear: true }).data, [255, 56, 12]);
+    });
+
+    it("uses the gamma specified in the image", () => {
+        const image = decode(readFileSync(`${__dirname}/fixtures/orange-rectangle-gamma-background.png`), {
+            linear: true,
+        });
+        expectCloseTo(image.data, [255, 56, 12]);
+    });
+
+    it("premultiplies linear samples", () => {
+        const image = decode(someOpaqueRectangle, { linear: true, premultiplied: true, output: "rgba8" });
+        expectCloseTo(image.data, [127, 28, 6, 127]);
+    });
+});
+
+describe("decode with a trust policy and limits", () => {
+    // This fixtures is a 32w, 16h rectangle with RGB = (255, 128, 64) and no alpha channel.
+    const someOrangeRectangle = readFileSync(`${__dirname}/fixtures/orange-rectangle.png`);
+
+    // Flips the CRC of the `IDAT` chunk and optionally the adler32 checksum at the end of the compressed data.
+    function corrupt(buffer: Buffer, adler32: boolean): Buffer {
+        const corrupted = Buffer.from(buffer);
+        const start = corrupted.indexOf("IDAT") + 4;
+        const end = start + corrupted.readUInt32BE(start - 8);
+        corrupted[end] ^= 0xff;
+        if (adler32) {
+            corrupted[end - 1] ^= 0xff;
+        }
+        return corrupted;
+    }
+
+    it("throws an error when decoding an image with a broken CRC", () => {
+        expect(() => decode(corrupt(someOrangeRectangle, false))).toThrowErrorMatchingSnapshot();
+    });
+
+    it("decodes an image with a broken CRC when trusted", () => {
+        expectEveryPixel(decode(corrupt(someOrangeRectangle, false), { trusted: true }).data, [255, 128, 64]);
+    });
+
+    it("decodes an image with a broken adler32 checksum when trusted", () => {
+        expectEveryPixel(decode(corrupt(someOrangeRectangle, true), { trusted: true }).data, [255, 128, 64]);
+    });
+
+    it("decodes an image within the limits", () => {
+        const limits = { maxWidth: 32, maxHeight: 16, maxChunks: 8, maxChunkBytes: 4096, maxDecodedBytes: 32 * 16 * 3 };
+        expectEveryPixel(decode(someOrangeRectangle, { limits }).data, [255, 128, 64]);
+    });
+
+    it("rejects an image exceeding the dimension limits", () => {
+        expect(() => decode(someOrangeRectangle, { limits: { maxHeight: 15 } })).toThrowErrorMatchingSnapshot();
+    });
+
+    it("rejects an image exceeding the decoded size limit", () => {
+        const limits = { maxDecodedBytes: 32 * 16 * 4 - 1 };
+        expect(() => decode(someOrangeRectangle, { limits, output: "rgba8" })).toThrowErrorMatchingSnapshot();
+    });
+
+    it("throws an error if the limits are not an object", () => {
+        expect(() => decode(someOrangeRectangle, { limits: 1024 as any })).toThrowErrorMatchingSnapshot();
+    });
+
+    it("throws an error with an invalid limit", () => {
+        expect(() => decode(someOrangeRectangle, { limits: { maxWidth: -1 } })).toThrowErrorMatchingSnapshot();
+    });
 });
 
 describe("readPngFileSync", () => {
     it("decodes a PNG file", () => {
         expectEveryPixel(readPngFileSync(`${__dirname}/fixtures/orange-rectangle.png`).data, [255, 128, 64]);
     });
+
+    it("decodes a PNG file with options", () => {
+        const { data } = readPngFileSync(`${__dirname}/fixtures/orange-rectangle.png`, { output: "rgba8" });
+        expectEveryPixel(data, [255, 128, 64, 255]);
+    });
+
+    it("throws an error when decoding failed", () => {
+        const path = `${__dirname}/fixtures/red-blue-gradient-256px.jpg`;
+        expect(() => readPngFileSync(path)).toThrowErrorMatchingSnapshot();
+    });
+
+    it("throws an error when reading failed", () => {
+        expect(() => readPngFileSync(`this-file/does/not/exist.png`)).toThrow();
+    });
 });
 
 describe("readPngFile", () => {
@@ -42,6 +261,11 @@ describe("readPngFile", () => {
             expectEveryPixel(decoded, [255, 128, 64]);
         });
 
+        it("decodes a PNG file with options", async () => {
+            const { data } = await readPngFile(`${__dirname}/fixtures/orange-rectangle.png`, { output: "rgba8" });
+            expectEveryPixel(data, [255, 128, 64, 255]);
+        });
+
         it("rejects with an error when decoding failed", async () => {
             return expect(readPngFile(`${__dirname}/fixtures/red-blue-gradient-256px.jpg`)).rejects.toMatchSnapshot();
         });
@@ -49,6 +273,19 @@ describe("readPngFile", () => {
         it("rejects with an error when reading failed", async () => {
             return expect(readPngFile(`this-file/does/not/exist.png`)).rejects.toBeTruthy();
         });
+
+        it("rejects truncated files with a decoding error", async () => {
+            const path = `${__dirname}/../../tmp-read-png-file-truncated.png`;
+            const encoded = readFileSync(`${__dirname}/fixtures/orange-rectangle.png`);
+            writeFileSync(path, encoded.slice(0, 130));
+            await expect(readPngFile(path)).rejects.toBeInstanceOf(TypeError);
+            expect(() => readPngFileSync(path)).toThrow("Unexpected end of PNG data.");
+        });
+
+        it("rejects with an error if the options are invalid", async () => {
+            const options = { output: "cmyk" as any };
+            return expect(readPngFile(`${__dirname}/fixtures/orange-rectangle.png`, options)).rejects.toMatchSnapshot();
+        });
     });
 
     describe("using the callback API", () => {
@@ -60,6 +297,14 @@ describe("readPngFile", () => {
             });
         });
 
+        it("decodes a PNG file with options", done => {
+            readPngFile(`${__dirname}/fixtures/orange-rectangle.png`, { output: "rgba8" }, (error, pngImg) => {
+                expect(error).toBeNull();
+                expectEveryPixel(pngImg.data, [255, 128, 64, 255]);
+                done();
+            });
+        });
+
         it("calls the callback with an error when decoding failed", done => {
             readPngFile(`${__dirname}/fixtures/red-blue-gradient-256px.jpg`, (error, pngImg) => {
                 expect(error).toMatchSnapshot();
@@ -0,0 +1,94 @@
+import { readFileSync } from "fs";
+import { diff, decode, PngImage, rect, colorRGB } from "..";
+
+describe("diff", () => {
+    // This fixtures is a 32w, 16h rectangle with RGB = (255, 128, 64) and no alpha channel.
+    const someOrangeRectangle = readFileSync(`${__dirname}/fixtures/orange-rectangle.png`);
+    const orange = () => decode(someOrangeRectangle);
+
+    it("finds no mismatches in identical images", () => {
+        expect(diff(orange(), orange())).toEqual({
+            mismatched: 0,
+            antialiased: 0,
+            bounds: undefined,
+            regions: [],
+            output: undefined,
+        });
+    });
+
+    it("finds no mismatches in identical images of different color types", () => {
+        const { mismatched } = diff(orange(), decode(someOrangeRectangle, { output: "rgba8" }));
+        expect(mismatched).toBe(0);
+    });
+
+    it("finds the mismatching pixels", () => {
+        const changed = orange();
+        changed.fill(colorRGB(0, 0, 0), rect(2, 3, 4, 5));
+        const { mismatched, bounds, regions } = diff(orange(), changed);
+        expect(mismatched).toBe(20);
+        expect(bounds).toEqual(rect(2, 3, 4, 5));
+        expect(regions).toEqual([rect(2, 3, 4, 5)]);
+    });
+
+    it("reports separate regions", () => {
+        const changed = orange();
+        changed.fill(colorRGB(0, 0, 0), rect(0, 0, 2, 2));
+        changed.fill(colorRGB(0, 0, 0), rect(10, 10, 3, 3));
+        changed.fill(colorRGB(0, 0, 0), rect(20, 11, 1, 1));
+        const { mismatched, bounds, regions } = diff(orange(), changed);
+        expect(mismatched).toBe(14);
+        expect(bounds).toEqual(rect(0, 0, 21, 13));
+        expect(regions).toEqual([rect(0, 0, 2, 2), rect(10, 10, 11, 3)]);
+    });
+
+    it("ignores differences below the threshold", () => {
+        const changed = orange();
+        changed.fill(colorRGB(250, 128, 64), rect(0, 0, 4, 4));
+        expect(diff(orange(), changed).mismatched).toBe(0);
+        expect(diff(orange(), changed, { threshold: 0 }).mismatched).toBe(16);
+    });
+
+    it("stops early after the maximum amount of mismatches", () => {
+        const changed = orange();
+        changed.fill(colorRGB(0, 0, 0));
+        const { mismatched } = diff(orange(), changed, { maxMismatches: 10 });
+        expect(mismatched).toBeGreaterThanOrEqual(10);
+        expect(mismatched).toBeLessThan(32 * 16);
+    });
+
+    it("detects anti-aliased pixels", () => {
+        const first = orange();
+        first.fill(colorRGB(0, 0, 0), rect(0, 0, 16, 16));
+        const second = orange();
+        second.fill(colorRGB(0, 0, 0), rect(0, 0, 16, 16));
+        second.fill(colorRGB(128, 64, 32), rect(16, 0, 1, 16));
+        expect(diff(first, second).mismatched).toBe(16);
+        const { mismatched, antialiased } = diff(first, second, { antialiasing: true });
+        expect(mismatched).toBe(0);
+        expect(antialiased).toBe(16);
+    });
+
+    it("draws a diff image", () => {
+        const changed = orange();
+        changed.fill(colorRGB(0, 0, 0), rect(1, 0, 1, 1));
+        const { output } = diff(orange(), changed, { output: true });
+        expect(output.length).toBe(32 * 16 * 4);
+        expect([...output.subarray(0, 8)]).toEqual([245, 245, 245, 255, 255, 0, 0, 255]);
+    });
+
+    it("throws an error with images of different dimensions", () => {
+        const cropped = orange();
+        cropped.crop(rect(0, 0, 16, 16));
+        expect(() => diff(orange(), cropped)).toThrowErrorMatchingSnapshot();
+    });
+
+    it("throws an error with something else than images", () => {
+        expect(() => diff(orange(), someOrangeRectangle as any)).toThrowErrorMatchingSnapshot();
+    });
+
+    it("throws an error with invalid options", () => {
+        expect(() => diff(orange(), orange(), null)).toThrowErrorMatchingSnapshot();
+        expect(() => diff(orange(), orange(), { threshold: 2 })).toThrowErrorMatchingSnapshot();
+        expect(() => diff(orange(), orange(), { maxMismatches: -1 })).toThrowErrorMatchingSnapshot();
+    });
+});
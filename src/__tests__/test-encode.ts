@@ -1,5 +1,6 @@
-import { encode, writePngFile, writePngFileSync } from "..";
-import { readFileSync } from "fs";
+import { encode, decode, writePngFile, writePngFileSync } from "..";
+import { readFileSync, readdirSync } from "fs";
+import { basename, dirname } from "path";
 
 const someGradient = Buffer.alloc(256 * 256 * 3);
 for (let x = 0; x < 256; ++x) {
@@ -18,6 +19,12 @@ for (let index = 0; index < someOrangeRectangle.length; index += 3) {
     someOrangeRectangle[index + 2] = 64;
 }
 
+// Checks that no temporary file of an atomic write to `path` was left behind.
+function expectNoTemporaryFile(path: string) {
+    const prefix = `${basename(path)}.tmp-`;
+    expect(readdirSync(dirname(path)).filter(name => name.startsWith(prefix))).toEqual([]);
+}
+
 const someOpaqueSquare = Buffer.alloc(16 * 16 * 4);
 for (let index = 0; index < someOpaqueSquare.length; index += 4) {
     someOpaqueSquare[index + 0] = 64;
@@ -52,6 +59,21 @@ describe("encode", () => {
         expect(encoded.toString("hex")).toMatchSnapshot();
     });
 
+    it("divides premultiplied samples by their alpha", () => {
+        // (64, 128, 64, 128) premultiplied with an alpha of 128 is (32, 64, 32, 128).
+        const premultiplied = Buffer.alloc(16 * 16 * 4);
+        for (let index = 0; index < premultiplied.length; index += 4) {
+            premultiplied.set([32, 64, 32, 128], index);
+        }
+        const encoded = encode(premultiplied, { width: 16, height: 16, premultiplied: true });
+        expect(Array.from(decode(encoded).data.slice(0, 4))).toEqual([64, 128, 64, 128]);
+    });
+
+    it("ignores the premultiplied option for images without alpha channel", () => {
+        const encoded = encode(someOrangeRectangle, { width: 16, height: 8, premultiplied: true });
+        expect(encoded).toEqual(encode(someOrangeRectangle, { width: 16, height: 8 }));
+    });
+
     it("throws an error when trying to encode something which isn't a buffer", () => {
         const options = {
             width: 16,
@@ -135,6 +157,19 @@ describe("writePngFileSync", () => {
         const fromDisk = readFileSync(path);
         expect(Array.from(fromDisk)).toEqual(Array.from(encoded));
     });
+
+    it("writes a PNG atomically and flushes it to disk", () => {
+        const encoded = encode(someOrangeRectangle, { width: 16, height: 8 });
+        const path = `${__dirname}/../../tmp-write-sync-atomic.png`;
+        writePngFileSync(path, someOrangeRectangle, { width: 16, height: 8, atomic: true, fsync: true });
+        expect(Array.from(readFileSync(path))).toEqual(Array.from(encoded));
+        expectNoTemporaryFile(path);
+    });
+
+    it("throws an error when writing failed", () => {
+        const options = { width: 16, height: 8, atomic: true };
+        expect(() => writePngFileSync(`this-file/does/not/exist.png`, someOrangeRectangle, options)).toThrow();
+    });
 });
 
 describe("writePngFile", () => {
@@ -148,6 +183,14 @@ describe("writePngFile", () => {
             expect(Array.from(fromDisk)).toEqual(Array.from(encoded));
         });
 
+        it("writes a PNG atomically and flushes it to disk", async () => {
+            const encoded = encode(someOrangeRectangle, { width: 16, height: 8 });
+            const path = `${__dirname}/../../tmp-write-promise-atomic.png`;
+            await writePngFile(path, someOrangeRectangle, { width: 16, height: 8, atomic: true, fsync: true });
+            expect(Array.from(readFileSync(path))).toEqual(Array.from(encoded));
+            expectNoTemporaryFile(path);
+        });
+
         it("rejects with an error when encoding failed", async () => {
             const options = { width: 16, height: 8 };
             const path = `${__dirname}/../../tmp-write-promise-error-encoding.png`;
@@ -0,0 +1,99 @@
+import { readFileSync } from "fs";
+import { EncoderSession, PngImage, decode, readChunks, rect, xy, colorRGB, colorRGBA } from "..";
+
+const fixtures = `${__dirname}/fixtures`;
+const gradient = readFileSync(`${fixtures}/red-blue-gradient-256px.png`);
+
+// Returns the types of all chunks apart from the image data.
+function chunkTypes(buffer: Buffer) {
+    return readChunks(buffer).map(({ type }) => type).filter(type => type !== "IDAT");
+}
+
+describe("EncoderSession", () => {
+    it("encodes the image like `PngImage.encode`", () => {
+        const image = new PngImage(gradient);
+        image.texts = [{ keyword: "Title", text: "Canvas" }];
+        image.gamma = 0.45455;
+        const session = new EncoderSession(image);
+        const buffer = session.encode();
+        expect(session.encodedBands).toBe(4);
+        expect(decode(buffer).data.equals(image.data)).toBe(true);
+        expect(chunkTypes(buffer)).toEqual(chunkTypes(image.encode()));
+        expect(decode(buffer)).toMatchObject({ texts: image.texts, gamma: image.gamma });
+    });
+
+    it("only compresses the bands which changed", () => {
+        const image = new PngImage(gradient);
+        const session = new EncoderSession(image);
+        const first = session.encode();
+        expect(session.encode().equals(first)).toBe(true);
+        expect(session.encodedBands).toBe(0);
+        image.fill(colorRGB(0, 255, 0), rect(10, 70, 5, 5));
+        const second = session.encode();
+        expect(session.encodedBands).toBe(1);
+        expect(decode(second).data.equals(image.data)).toBe(true);
+        image.copyFrom(new PngImage(gradient), xy(0, 100), rect(0, 0, 32, 60));
+        image.set(colorRGB(255, 255, 255), xy(255, 255));
+        const third = session.encode();
+        expect(session.encodedBands).toBe(3);
+        expect(decode(third).data.equals(image.data)).toBe(true);
+    });
+
+    it("starts over when the image is resized", () => {
+        const image = new PngImage(gradient);
+        const session = new EncoderSession(image, { bandHeight: 16 });
+        session.encode();
+        image.crop(rect(20, 20, 100, 100));
+        const buffer = session.encode();
+        expect(session.encodedBands).toBe(7);
+        expect(decode(buffer)).toMatchObject({ width: 100, height: 100 });
+        expect(decode(buffer).data.equals(image.data)).toBe(true);
+    });
+
+    it("compresses changes made to the data once they are invalidated", () => {
+        const image = new PngImage(gradient);
+        const session = new EncoderSession(image);
+        session.invalidate();
+        session.encode();
+        image.data.fill(0, 0, image.rowBytes * 2);
+        expect(decode(session.encode()).data.equals(image.data)).toBe(false);
+        session.invalidate(rect(0, 0, 256, 2));
+        expect(decode(session.encode()).data.equals(image.data)).toBe(true);
+        expect(session.encodedBands).toBe(1);
+        session.invalidate();
+        session.encode();
+        expect(session.encodedBands).toBe(4);
+    });
+
+    it("supports premultiplied images with alpha", () => {
+        const image = new PngImage(readFileSync(`${fixtures}/opaque-rectangle.png`), { premultiplied: true });
+        const session = new EncoderSession(image, { bandHeight: 1, compressionLevel: 0 });
+        image.fill(colorRGBA(100, 50, 25, 128), rect(2, 2, 4, 4));
+        const buffer = session.encode();
+        expect(session.encodedBands).toBe(image.height);
+        expect(decode(buffer).data.equals(decode(image.encode()).data)).toBe(true);
+        expect(buffer.length).toBeGreaterThan(image.data.length);
+    });
+
+    it("uses the compression level and the band height", () => {
+        const image = new PngImage(gradient);
+        const small = new EncoderSession(image, { compressionLevel: 9, bandHeight: 256 }).encode();
+        const large = new EncoderSession(image, { compressionLevel: 1, bandHeight: 1 }).encode();
+        expect(small.length).toBeLessThan(large.length);
+        expect(decode(large).data.equals(decode(small).data)).toBe(true);
+    });
+
+    it("rejects invalid images and options", () => {
+        const image = new PngImage(gradient);
+        expect(() => new EncoderSession(gradient as any)).toThrowErrorMatchingSnapshot();
+        expect(() => new EncoderSession(image, null)).toThrowErrorMatchingSnapshot();
+        expect(() => new EncoderSession(image, { compressionLevel: 10 } as any)).toThrowErrorMatchingSnapshot();
+        expect(() => new EncoderSession(image, { bandHeight: 0 })).toThrowErrorMatchingSnapshot();
+        expect(() => new EncoderSession(image, { bandHeight: 1.5 })).toThrowErrorMatchingSnapshot();
+        const gray = new PngImage(readFileSync(`${fixtures}/grayscale-gradient-16px.png`));
+        expect(() => new EncoderSession(gray).encode()).toThrowErrorMatchingSnapshot();
+        const session = new EncoderSession(image);
+        image.data = Buffer.alloc(10);
+        expect(() => session.encode()).toThrowErrorMatchingSnapshot();
+    });
+});
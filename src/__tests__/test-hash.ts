@@ -0,0 +1,95 @@
+import { readFileSync } from "fs";
+import { pixelHash, perceptualHash, hashDistance, decode, encode, rect, xy, colorRGB } from "..";
+
+describe("hashing", () => {
+    // This fixtures is a 32w, 16h rectangle with RGB = (255, 128, 64) and no alpha channel.
+    const someOrangeRectangle = readFileSync(`${__dirname}/fixtures/orange-rectangle.png`);
+    // The same rectangle, but interlaced and with additional chunks.
+    const someInterlacedOrangeRectangle = readFileSync(`${__dirname}/fixtures/orange-rectangle-gamma-background.png`);
+    const someGradient = readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px.png`);
+    const someInterlacedGradient = readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px-interlaced.png`);
+
+    describe("pixelHash", () => {
+        it("returns a 64 bit hash", () => {
+            expect(pixelHash(someOrangeRectangle)).toMatch(/^[0-9a-f]{16}$/);
+        });
+
+        it("returns the same hash for identical pixels encoded differently", () => {
+            expect(pixelHash(someInterlacedOrangeRectangle)).toBe(pixelHash(someOrangeRectangle));
+            expect(pixelHash(someInterlacedGradient)).toBe(pixelHash(someGradient));
+            const reencoded = encode(decode(someOrangeRectangle, { output: "rgba8" }).data, {
+                width: 32,
+                height: 16,
+                compressionLevel: 1,
+            });
+            expect(pixelHash(reencoded)).toBe(pixelHash(someOrangeRectangle));
+        });
+
+        it("returns different hashes for different pixels", () => {
+            const image = decode(someOrangeRectangle);
+            image.set(colorRGB(255, 128, 65), xy(31, 15));
+            expect(pixelHash(image.encode())).not.toBe(pixelHash(someOrangeRectangle));
+        });
+
+        it("returns different hashes for different dimensions", () => {
+            const image = decode(someOrangeRectangle);
+            // Also uniformly orange and of the same amount of pixels, but 16w, 32h.
+            image.resizeCanvas({ dimensions: xy(16, 32), clip: rect(0, 0, 16, 16), fillColor: colorRGB(255, 128, 64) });
+            expect(pixelHash(image.encode())).not.toBe(pixelHash(someOrangeRectangle));
+        });
+
+        it("throws an error with invalid input", () => {
+            expect(() => pixelHash("not a buffer" as any)).toThrowErrorMatchingSnapshot();
+            const jpg = readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px.jpg`);
+            expect(() => pixelHash(jpg)).toThrowErrorMatchingSnapshot();
+        });
+    });
+
+    describe("perceptualHash", () => {
+        it("computes the difference hash", () => {
+            expect(perceptualHash(someOrangeRectangle, "dhash")).toBe("0000000000000000");
+            // The gradient gets darker from left to right.
+            expect(perceptualHash(someGradient, "dhash")).toBe("ffffffffffffffff");
+        });
+
+        it("computes the perceptual hash", () => {
+            // Only the constant frequency is set for a uniform image.
+            expect(perceptualHash(someOrangeRectangle)).toBe("8000000000000000");
+            expect(perceptualHash(someInterlacedGradient)).toBe(perceptualHash(someGradient));
+        });
+
+        it("hashes the colors of palette images with transparency", () => {
+            const someIndexedImage = readFileSync(`${__dirname}/fixtures/indexed-16px.png`);
+            const { data, width, height } = decode(someIndexedImage, { output: "rgb8" });
+            const rgb = encode(data, { width, height });
+            expect(perceptualHash(someIndexedImage)).toBe(perceptualHash(rgb));
+            expect(perceptualHash(someIndexedImage, "dhash")).toBe(perceptualHash(rgb, "dhash"));
+        });
+
+        it("computes similar hashes for similar images", () => {
+            const image = decode(someGradient);
+            image.fill(colorRGB(0, 0, 0), rect(100, 100, 4, 4));
+            const changed = image.encode();
+            const gradientHash = perceptualHash(someGradient, "dhash");
+            expect(hashDistance(perceptualHash(changed, "dhash"), gradientHash)).toBeLessThan(10);
+            expect(hashDistance(perceptualHash(someOrangeRectangle, "dhash"), gradientHash)).toBe(64);
+        });
+
+        it("throws an error with invalid input", () => {
+            expect(() => perceptualHash("not a buffer" as any)).toThrowErrorMatchingSnapshot();
+            expect(() => perceptualHash(someGradient, "ahash" as any)).toThrowErrorMatchingSnapshot();
+        });
+    });
+
+    describe("hashDistance", () => {
+        it("counts the differing bits", () => {
+            expect(hashDistance("0000000000000000", "ffffffffffffffff")).toBe(64);
+            expect(hashDistance("00000000000000f0", "0000000000000010")).toBe(3);
+            expect(hashDistance("0123456789abcdef", "0123456789abcdef")).toBe(0);
+        });
+
+        it("throws an error with invalid hashes", () => {
+            expect(() => hashDistance("xyz", "0000000000000000")).toThrowErrorMatchingSnapshot();
+        });
+    });
+});
@@ -0,0 +1,206 @@
+import { readFileSync } from "fs";
+import { randomBytes } from "crypto";
+import { encode, decode, readChunks, colorRGB, writePngFileSync, readPngFileSync } from "..";
+
+const someOrangeRectangle = Buffer.alloc(16 * 8 * 3);
+for (let index = 0; index < someOrangeRectangle.length; index += 3) {
+    someOrangeRectangle[index + 0] = 255;
+    someOrangeRectangle[index + 1] = 128;
+    someOrangeRectangle[index + 2] = 64;
+}
+
+const size = { width: 16, height: 8 };
+
+// A minimal RGB profile with a D50 illuminant and a single tag. The content of the tag is random, as libpng
+// refuses to read `iCCP` chunks which are compressed into less than 92 bytes.
+function someIccProfile() {
+    const data = Buffer.alloc(208);
+    data.writeUInt32BE(208, 0);
+    data.write("mntrRGB XYZ ", 12, "latin1");
+    data.write("acsp", 36, "latin1");
+    data.writeInt32BE(0xf6d6, 68);
+    data.writeInt32BE(0x10000, 72);
+    data.writeInt32BE(0xd32d, 76);
+    data.writeUInt32BE(1, 128);
+    data.write("test", 132, "latin1");
+    data.writeUInt32BE(144, 136);
+    data.writeUInt32BE(64, 140);
+    randomBytes(64).copy(data, 144);
+    return data;
+}
+
+function textChunkTypes(buffer: Buffer) {
+    return readChunks(buffer).map(({ type }) => type).filter(type => /^(tEXt|zTXt|iTXt)$/.test(type));
+}
+
+describe("encoding metadata", () => {
+    it("writes the metadata into ancillary chunks", () => {
+        const time = new Date(Date.UTC(2020, 11, 24, 18, 30, 59));
+        const encoded = encode(someOrangeRectangle, {
+            ...size,
+            gamma: 1 / 2.2,
+            time,
+            backgroundColor: [255, 255, 255],
+            pixelsPerMeterX: 2835,
+            pixelsPerMeterY: 5670,
+            offsetX: 3,
+            offsetY: -4,
+            srgbIntent: "relative",
+        });
+        const image = decode(encoded);
+        expect(image.gamma).toBeCloseTo(1 / 2.2, 4);
+        expect(image.time).toEqual(time);
+        expect(image.backgroundColor).toEqual([255, 255, 255]);
+        expect(image.pixelsPerMeterX).toBe(2835);
+        expect(image.pixelsPerMeterY).toBe(5670);
+        expect(image.offsetX).toBe(3);
+        expect(image.offsetY).toBe(-4);
+        expect(image.srgbIntent).toBe("relative");
+        expect(image.iccProfile).toBeUndefined();
+        expect(image.data).toEqual(someOrangeRectangle);
+    });
+
+    it("uses the same resolution for both axes if only one is specified", () => {
+        expect(decode(encode(someOrangeRectangle, { ...size, pixelsPerMeterX: 100 })).pixelsPerMeterY).toBe(100);
+        expect(decode(encode(someOrangeRectangle, { ...size, pixelsPerMeterY: 100 })).pixelsPerMeterX).toBe(100);
+    });
+
+    it("defaults a missing offset to 0", () => {
+        const image = decode(encode(someOrangeRectangle, { ...size, offsetY: 5 }));
+        expect([image.offsetX, image.offsetY]).toEqual([0, 5]);
+        const other = decode(encode(someOrangeRectangle, { ...size, offsetX: 5 }));
+        expect([other.offsetX, other.offsetY]).toEqual([5, 0]);
+        expect(other.metadata).toEqual(expect.objectContaining({ offsetX: 5, offsetY: 0 }));
+    });
+
+    it("writes texts into the matching chunks", () => {
+        const texts = [
+            { keyword: "Title", text: "Äpfel" },
+            { keyword: "Description", text: "Oranges", compressed: true },
+            { keyword: "Title", text: "日本", language: "ja" },
+            { keyword: "Author", text: "東京", compressed: true },
+        ];
+        const encoded = encode(someOrangeRectangle, { ...size, texts });
+        expect(textChunkTypes(encoded)).toEqual(["tEXt", "zTXt", "iTXt", "iTXt"]);
+        expect(decode(encoded).texts).toEqual([
+            { keyword: "Title", text: "Äpfel", compressed: false },
+            { keyword: "Description", text: "Oranges", compressed: true },
+            { keyword: "Title", text: "日本", language: "ja", compressed: false },
+            { keyword: "Author", text: "東京", language: "", compressed: true },
+        ]);
+    });
+
+    it("writes an ICC profile", () => {
+        const iccProfile = { name: "Test profile", data: someIccProfile() };
+        const image = decode(encode(someOrangeRectangle, { ...size, iccProfile, srgbIntent: "perceptual" }));
+        expect(image.iccProfile).toEqual(iccProfile);
+        // libpng writes either the ICC profile or the sRGB chunk.
+        expect(image.srgbIntent).toBeUndefined();
+    });
+
+    it("writes the metadata into files", () => {
+        const path = `${__dirname}/../../tmp-metadata-write-sync.png`;
+        writePngFileSync(path, someOrangeRectangle, { ...size, texts: [{ keyword: "Title", text: "Orange" }] });
+        expect(readPngFileSync(path).texts).toEqual([{ keyword: "Title", text: "Orange", compressed: false }]);
+    });
+
+    it("throws an error for invalid metadata", () => {
+        const invalid: any[] = [
+            { gamma: 0 },
+            { gamma: "1" },
+            { time: new Date("invalid") },
+            { time: 0 },
+            { backgroundColor: [255, 255] },
+            { backgroundColor: [256, 0, 0] },
+            { backgroundColor: "white" },
+            { pixelsPerMeterX: 0 },
+            { pixelsPerMeterX: 1, pixelsPerMeterY: 1.5 },
+            { offsetX: 0.5 },
+            { texts: "text" },
+            { texts: [null] },
+            { texts: [{ keyword: "Title" }] },
+            { texts: [{ keyword: "", text: "Text" }] },
+            { texts: [{ keyword: "日本", text: "Text" }] },
+            { texts: [{ keyword: "Title", text: "Text", language: 1 }] },
+            { srgbIntent: "colorimetric" },
+            { iccProfile: null },
+            { iccProfile: { name: "Test", data: "profile" } },
+            { iccProfile: { data: someIccProfile() } },
+        ];
+        invalid.forEach(metadata => {
+            expect(() => encode(someOrangeRectangle, { ...size, ...metadata })).toThrowErrorMatchingSnapshot();
+        });
+    });
+
+    it("throws an error for ICC profiles rejected by libpng", () => {
+        const iccProfile = { name: "Test", data: Buffer.alloc(16) };
+        expect(() => encode(someOrangeRectangle, { ...size, iccProfile })).toThrow("too short");
+    });
+});
+
+describe("PngImage metadata", () => {
+    const orangeRectangle = readFileSync(`${__dirname}/fixtures/orange-rectangle.png`);
+    const withBackground = readFileSync(`${__dirname}/fixtures/orange-rectangle-gamma-background.png`);
+
+    it("reads texts", () => {
+        expect(decode(orangeRectangle).texts).toEqual([
+            { keyword: "Comment", text: "Created with GIMP", language: "", compressed: false },
+        ]);
+        expect(decode(readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px.png`)).texts).toEqual([]);
+    });
+
+    it("collects the metadata of the image", () => {
+        const { metadata } = decode(withBackground);
+        expect(metadata).toEqual({
+            gamma: expect.any(Number),
+            time: new Date(Date.UTC(2018, 2, 26, 5, 31, 42)),
+            backgroundColor: [255, 255, 255],
+            pixelsPerMeterX: 2835,
+            pixelsPerMeterY: 2835,
+            texts: [{ keyword: "Comment", text: "Created with GIMP", language: "", compressed: false }],
+            srgbIntent: undefined,
+            iccProfile: undefined,
+        });
+        expect(metadata.gamma).toBeCloseTo(0.45455, 5);
+    });
+
+    it("omits background colors which can't be encoded", () => {
+        const image = decode(withBackground);
+        image.backgroundColor = colorRGB(65535, 0, 0);
+        expect(image.metadata.backgroundColor).toBeUndefined();
+        const indexed = decode(readFileSync(`${__dirname}/fixtures/indexed-background.png`));
+        expect(indexed.backgroundColor).toBeDefined();
+        expect(indexed.metadata.backgroundColor).toBeUndefined();
+    });
+
+    it("keeps the metadata when encoding", () => {
+        const image = decode(withBackground);
+        image.offsetY = 7;
+        const reencoded = decode(image.encode());
+        expect(reencoded.metadata).toEqual(image.metadata);
+        expect(reencoded.offsetY).toBe(7);
+        expect(reencoded.time).toEqual(image.time);
+        expect(readChunks(image.encode()).map(({ type }) => type))
+            .toEqual(["IHDR", "gAMA", "bKGD", "oFFs", "pHYs", "tIME", "iTXt", "IDAT", "IEND"]);
+    });
+
+    it("keeps the ICC profile and the sRGB intent when encoding", () => {
+        const iccProfile = { name: "Test profile", data: someIccProfile() };
+        const withProfile = decode(encode(someOrangeRectangle, { ...size, iccProfile }));
+        expect(decode(withProfile.encode()).iccProfile).toEqual(iccProfile);
+        const srgb = decode(encode(someOrangeRectangle, { ...size, srgbIntent: "saturation" }));
+        expect(decode(srgb.encode()).srgbIntent).toBe("saturation");
+    });
+
+    it("copies the texts and the ICC profile when cloning", () => {
+        const iccProfile = { name: "Test profile", data: someIccProfile() };
+        const texts = [{ keyword: "Title", text: "Orange" }];
+        const image = decode(encode(someOrangeRectangle, { ...size, iccProfile, texts }));
+        const copy = image.clone();
+        copy.texts[0].text = "Apple";
+        copy.iccProfile.data[0] = 1;
+        expect(image.texts[0].text).toBe("Orange");
+        expect(image.iccProfile).toEqual(iccProfile);
+        expect(decode(orangeRectangle).clone().iccProfile).toBeUndefined();
+    });
+});
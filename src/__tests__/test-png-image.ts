@@ -12,7 +12,10 @@ import {
     colorRGB,
     colorRGBA,
     colorGrayScale,
+    colorPalette,
 } from "../colors";
+import { encode } from "../encode";
+import { readChunks } from "../chunks";
 import { expectRedBlueGradient, expectEveryPixel } from "./utils";
 
 describe("PngImage", () => {
@@ -219,6 +222,34 @@ describe("PngImage", () => {
                 expect(fromDisk.toString("hex")).toMatchSnapshot();
             });
 
+            it("writes a PNG file using a callback", done => {
+                const path = `${__dirname}/../../tmp-png-image-write-callback.png`;
+                somePngImage.write(path, error => {
+                    expect(error).toBeNull();
+                    expect(readFileSync(path)).toEqual(somePngImage.encode());
+                    done();
+                });
+            });
+
+            it("writes a PNG file atomically using a callback", done => {
+                const path = `${__dirname}/../../tmp-png-image-write-atomic.png`;
+                somePngImage.write(path, { atomic: true }, error => {
+                    expect(error).toBeNull();
+                    expect(readFileSync(path)).toEqual(somePngImage.encode());
+                    done();
+                });
+            });
+
+            it("writes the pixels as of the call while the image is edited", async () => {
+                const path = `${__dirname}/../../tmp-png-image-write-edited.png`;
+                const image = somePngImage.clone();
+                const encoded = image.encode();
+                const written = image.write(path);
+                image.fill(colorRGB(0, 0, 255));
+                await written;
+                expect(readFileSync(path)).toEqual(encoded);
+            });
+
             it("throws an error when trying to write a non-RGB/RGBA image synchroneously", () => {
                 expect(() => someGrayScalePngImage.writeSync("some/path")).toThrowErrorMatchingSnapshot();
             });
@@ -232,6 +263,12 @@ describe("PngImage", () => {
                 expect(fromDisk.toString("hex")).toMatchSnapshot();
             });
 
+            it("writes a PNG file atomically", () => {
+                const path = `${__dirname}/../../tmp-png-image-write-sync-atomic.png`;
+                somePngImage.writeSync(path, { atomic: true, fsync: true });
+                expect(readFileSync(path)).toEqual(somePngImage.encode());
+            });
+
             it("throws an error when trying to write a non-RGB/RGBA image", () => {
                 expect(() => someGrayScalePngImage.write("some/path")).toThrowErrorMatchingSnapshot();
             });
@@ -248,6 +285,139 @@ describe("PngImage", () => {
         }
     });
 
+    describe("mipmaps", () => {
+        const gradient = new PngImage(readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px.png`));
+
+        // Averages blocks of 2x2 pixels of an opaque image with an even size.
+        function reduce({ data, width, height, channels }: PngImage) {
+            const reduced = Buffer.alloc(data.length / 4);
+            for (let index = 0; index < reduced.length; ++index) {
+                const channel = index % channels;
+                const pixel = (index - channel) / channels;
+                const x = 2 * (pixel % (width / 2));
+                const y = 2 * Math.floor(pixel / (width / 2));
+                const at = (column: number, row: number) => data[(row * width + column) * channels + channel];
+                reduced[index] = (at(x, y) + at(x + 1, y) + at(x, y + 1) + at(x + 1, y + 1) + 2) >> 2;
+            }
+            return reduced;
+        }
+
+        it("creates every level from the previous one", async () => {
+            const levels = await gradient.mipmaps();
+            expect(levels.map(({ width, height }) => [width, height])).toEqual(
+                [256, 128, 64, 32, 16, 8, 4, 2, 1].map(size => [size, size]),
+            );
+            expect(levels[0].data).toEqual(gradient.data);
+            expect(levels[0].data).not.toBe(gradient.data);
+            levels.slice(1).forEach((level, index) => {
+                expect([level.colorType, level.rowBytes]).toEqual([ColorType.RGB, level.width * 3]);
+                expect(level.data.equals(reduce(levels[index]))).toBe(true);
+            });
+            // The levels share one buffer.
+            expect(levels[1].data.buffer).toBe(levels[8].data.buffer);
+        });
+
+        it("builds the levels from the pixels as of the call while the image is edited", async () => {
+            const image = gradient.clone();
+            const original = Buffer.from(image.data);
+            const created = image.mipmaps();
+            image.fill(colorRGB(0, 0, 255));
+            const levels = await created;
+            expect(levels[0].data.equals(original)).toBe(true);
+            expect(levels[1].data.equals(reduce(levels[0]))).toBe(true);
+        });
+
+        it("covers every pixel of images with odd sizes", async () => {
+            const data = Buffer.alloc(5 * 3 * 4, 255);
+            // A transparent red pixel doesn't tint the level, the transparent pixel in the last column is included.
+            data.writeUInt32BE(0xff000000, 0);
+            data.writeUInt32BE(0x00000000, 4 * 4);
+            const image = new PngImage(encode(data, { width: 5, height: 3 }));
+            const [, level, last] = await image.mipmaps();
+            expect([level.width, level.height, last.width, last.height]).toEqual([2, 1, 1, 1]);
+            expect(Array.from(level.data)).toEqual([255, 255, 255, 213, 255, 255, 255, 227]);
+            expect(Array.from(last.data)).toEqual([255, 255, 255, 220]);
+        });
+
+        it("averages in linear light using the gamma filter", async () => {
+            const checkerboard = Buffer.from([0, 0, 0, 255, 255, 255, 255, 255, 255, 0, 0, 0]);
+            const image = new PngImage(encode(checkerboard, { width: 2, height: 2 }));
+            expect(Array.from((await image.mipmaps())[1].data)).toEqual([128, 128, 128]);
+            expect(Array.from((await image.mipmaps({ filter: "gamma" }))[1].data)).toEqual([188, 188, 188]);
+            const gamma = new PngImage(encode(checkerboard, { width: 2, height: 2, gamma: 0.5 }));
+            expect(Array.from((await gamma.mipmaps({ filter: "gamma" }))[1].data)).toEqual([180, 180, 180]);
+        });
+
+        it("doesn't linearize images which have been decoded into linear light again", async () => {
+            const checkerboard = Buffer.from([0, 0, 0, 255, 255, 255, 255, 255, 255, 0, 0, 0]);
+            const image = new PngImage(encode(checkerboard, { width: 2, height: 2 }), { linear: true });
+            const levels = await image.mipmaps({ filter: "gamma" });
+            expect(Array.from(levels[1].data)).toEqual([128, 128, 128]);
+            expect(levels[1].linear).toBe(true);
+            const buffers = await image.mipmaps({ encode: true, filter: "gamma" });
+            expect(new PngImage(buffers[1]).gamma).toBe(1);
+        });
+
+        it("supports gray-scale images", async () => {
+            const gray = new PngImage(readFileSync(`${__dirname}/fixtures/grayscale-gradient-16px.png`));
+            const levels = await gray.mipmaps({ priority: "batch" });
+            expect(levels).toHaveLength(5);
+            expect(levels[1].data.equals(reduce(gray))).toBe(true);
+            const grayAlpha = new PngImage(readFileSync(`${__dirname}/fixtures/grayscale-alpha-gradient-16px.png`));
+            expect((await grayAlpha.mipmaps({ filter: "gamma" }))[4].data).toHaveLength(2);
+        });
+
+        it("encodes every level", async () => {
+            const levels = await gradient.mipmaps();
+            const buffers = await gradient.mipmaps({ encode: true, compressionLevel: 1 });
+            expect(buffers).toHaveLength(9);
+            buffers.forEach((buffer, index) => expect(new PngImage(buffer).data).toEqual(levels[index].data));
+        });
+
+        it("keeps the color metadata of encoded levels", async () => {
+            const image = new PngImage(readFileSync(`${__dirname}/fixtures/orange-rectangle-gamma-background.png`));
+            const buffers = await image.mipmaps({ encode: true });
+            expect(readChunks(buffers[3]).map(({ type }) => type)).toContain("gAMA");
+            expect(new PngImage(buffers[3]).gamma).toBe(image.gamma);
+        });
+
+        it("supports a callback", done => {
+            gradient.mipmaps((error, levels) => {
+                expect(error).toBeNull();
+                expect(levels).toHaveLength(9);
+                gradient.mipmaps({ encode: true, filter: "gamma" }, (secondError, buffers) => {
+                    expect(secondError).toBeNull();
+                    expect(buffers.every(buffer => Buffer.isBuffer(buffer))).toBe(true);
+                    done();
+                });
+            });
+        });
+
+        it("rejects unsupported images", async () => {
+            const palette = new PngImage(readFileSync(`${__dirname}/fixtures/indexed-16px.png`));
+            await expect(palette.mipmaps()).rejects.toThrowErrorMatchingSnapshot();
+            const gray = new PngImage(readFileSync(`${__dirname}/fixtures/grayscale-gradient-16px.png`));
+            await expect(gray.mipmaps({ encode: true })).rejects.toThrowErrorMatchingSnapshot();
+        });
+
+        it("rejects invalid options", async () => {
+            const invalid: any[] = [
+                null,
+                { filter: "lanczos" },
+                { compressionLevel: 10 },
+                { priority: "urgent" },
+            ];
+            for (const options of invalid) {
+                await expect(gradient.mipmaps(options)).rejects.toThrowErrorMatchingSnapshot();
+            }
+        });
+
+        it("can be aborted", async () => {
+            const signal = { aborted: true, addEventListener: () => undefined, removeEventListener: () => undefined };
+            await expect(gradient.mipmaps({ signal })).rejects.toHaveProperty("name", "AbortError");
+        });
+    });
+
     describe("copyFrom", () => {
         const sourcePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/orange-rectangle.png`));
         const targetPngImage = new PngImage(readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px.png`));
@@ -262,9 +432,9 @@ describe("PngImage", () => {
             expect(() => targetPngImage.copyFrom(sourcePngImage, xy(-1, 0))).toThrowErrorMatchingSnapshot();
         });
 
-        it("throws an error if the color types don't match", () => {
-            const grayScalePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/grayscale-gradient-16px.png`));
-            expect(() => targetPngImage.copyFrom(grayScalePngImage)).toThrowErrorMatchingSnapshot();
+        it("throws an error when copying a non-palette image into a palette image", () => {
+            const palettePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/indexed-16px.png`));
+            expect(() => palettePngImage.copyFrom(sourcePngImage)).toThrowErrorMatchingSnapshot();
         });
 
         it("throws an error if the source rectangle exceeds the image's dimensions", () => {
@@ -286,6 +456,52 @@ describe("PngImage", () => {
             expect(targetPngImage.at(18, 24)).toEqual([255, 128, 64]);
             expect(targetPngImage.at(19, 25)).toEqual([255 - 19, 0, 19]);
         });
+
+        it("copies from an offset inside the source image", () => {
+            const gradientPngImage = new PngImage(readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px.png`));
+            const otherPngImage = new PngImage(readFileSync(`${__dirname}/fixtures/orange-rectangle.png`));
+            otherPngImage.copyFrom(gradientPngImage, xy(0, 0), rect(100, 50, 4, 4));
+            expect(otherPngImage.at(0, 0)).toEqual([155, 0, 100]);
+            expect(otherPngImage.at(3, 3)).toEqual([152, 0, 103]);
+            expect(otherPngImage.at(4, 4)).toEqual([255, 128, 64]);
+        });
+
+        it("converts a palette image with transparency into an RGBA image", () => {
+            const palettePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/indexed-16px.png`));
+            const rgbaPngImage = new PngImage(readFileSync(`${__dirname}/fixtures/opaque-rectangle.png`));
+            rgbaPngImage.copyFrom(palettePngImage, xy(4, 2), rect(0, 2, 4, 8));
+            expect(rgbaPngImage.at(4, 2)).toEqual([128, 255, 64, 255]);
+            expect(rgbaPngImage.at(7, 4)).toEqual([64, 128, 255, 255]);
+            expect(rgbaPngImage.at(5, 9)).toEqual([255, 64, 128, 255]);
+            expect(rgbaPngImage.at(8, 2)).toEqual([255, 128, 64, 127]);
+        });
+
+        it("converts a gray-scale image into an RGB image", () => {
+            const grayScalePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/grayscale-gradient-16px.png`));
+            const rgbPngImage = new PngImage(readFileSync(`${__dirname}/fixtures/orange-rectangle.png`));
+            rgbPngImage.copyFrom(grayScalePngImage);
+            expect(rgbPngImage.at(0, 0)).toEqual([255, 255, 255]);
+            expect(rgbPngImage.at(1, 5)).toEqual([238, 238, 238]);
+            expect(rgbPngImage.at(16, 0)).toEqual([255, 128, 64]);
+        });
+
+        it("converts an RGBA image into a gray-scale-alpha image", () => {
+            const rgbaPngImage = new PngImage(readFileSync(`${__dirname}/fixtures/opaque-rectangle.png`));
+            const grayScaleAlphaPngImage = new PngImage(
+                readFileSync(`${__dirname}/fixtures/grayscale-alpha-gradient-16px.png`),
+            );
+            grayScaleAlphaPngImage.copyFrom(rgbaPngImage, xy(0, 0), rect(0, 0, 2, 2));
+            expect(grayScaleAlphaPngImage.at(1, 1)).toEqual([150, 127]);
+            expect(grayScaleAlphaPngImage.at(2, 2)).toEqual([221, 127]);
+        });
+
+        it("copies a palette image into another palette image", () => {
+            const palettePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/indexed-16px.png`));
+            const otherPalettePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/indexed-16px.png`));
+            otherPalettePngImage.copyFrom(palettePngImage, xy(0, 0), rect(0, 12, 2, 2));
+            expect(otherPalettePngImage.at(0, 0)).toEqual([4]);
+            expect(otherPalettePngImage.at(2, 0)).toEqual([1]);
+        });
     });
 
     describe("resizing the canvas", () => {
@@ -380,6 +596,66 @@ describe("PngImage", () => {
         });
     });
 
+    describe("changedRows", () => {
+        const gradient = readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px.png`);
+
+        it("returns all rows until changes are recorded", () => {
+            const image = new PngImage(gradient);
+            image.fill(colorRGB(0, 0, 0), rect(0, 0, 1, 1));
+            expect(image.changedRows()).toEqual({ revision: 0, ranges: [[0, 256]] });
+            expect(image.changedRows(0)).toEqual({ revision: 0, ranges: [] });
+        });
+
+        it("records the rows changed by the image's methods", () => {
+            const image = new PngImage(gradient);
+            const { revision } = image.changedRows();
+            image.fill(colorRGB(0, 0, 0), rect(10, 10, 5, 5));
+            image.set(colorRGB(0, 0, 0), xy(0, 15));
+            image.copyFrom(image.clone(), xy(0, 100), rect(0, 0, 10, 20));
+            expect(image.changedRows(revision)).toEqual({ revision: 3, ranges: [[10, 16], [100, 120]] });
+            image.fill(colorRGB(0, 0, 0), rect(0, 200, 1, 1));
+            expect(image.changedRows(3)).toEqual({ revision: 4, ranges: [[200, 201]] });
+            image.crop(rect(0, 0, 50, 50));
+            expect(image.changedRows(4)).toEqual({ revision: 5, ranges: [[0, 50]] });
+        });
+
+        it("doesn't share recording changes with clones", () => {
+            const image = new PngImage(gradient);
+            image.changedRows();
+            const clone = image.clone();
+            clone.fill(colorRGB(0, 0, 0), rect(0, 0, 1, 1));
+            expect(image.changedRows(0).ranges).toEqual([]);
+            expect(clone.changedRows(0).ranges).toEqual([[0, 256]]);
+        });
+
+        it("resizes the canvas without recording changes", () => {
+            const image = new PngImage(gradient);
+            image.crop(rect(0, 0, 50, 50));
+            expect(image.changedRows()).toEqual({ revision: 0, ranges: [[0, 50]] });
+        });
+    });
+
+    describe("lazyClone", () => {
+        const gradient = readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px.png`);
+
+        it("creates copies which can be read and modified independently", () => {
+            const image = new PngImage(gradient);
+            const [red, green, blue] = image.at(10, 10) as number[];
+            const first = image.lazyClone();
+            const second = first.lazyClone();
+            expect(second.at(10, 10)).toEqual(colorRGB(red, green, blue));
+            expect(second.encode()).toEqual(image.encode());
+            first.fill(colorRGB(0, 0, 0), rect(10, 10, 1, 1));
+            second.data[(10 * 256 + 10) * 3] = 1;
+            image.getRow(10)[10 * 3 + 1] = 2;
+            expect([image.at(10, 10), first.at(10, 10), second.at(10, 10)]).toEqual([
+                colorRGB(red, 2, blue),
+                colorRGB(0, 0, 0),
+                colorRGB(1, green, blue),
+            ]);
+        });
+    });
+
     describe("with an unknown color type", () => {
         const somePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/orange-rectangle.png`));
         somePngImage.colorType = ColorType.UNKNOWN;
@@ -392,6 +668,16 @@ describe("PngImage", () => {
             expect(somePngImage.bytesPerPixel).toBeUndefined();
         });
 
+        it("updates `bytesPerPixel` once the color type or bit depth is changed", () => {
+            const image = somePngImage.clone();
+            image.colorType = ColorType.RGBA;
+            expect(image.bytesPerPixel).toBe(4);
+            expect(image.toIndex(1, 1)).toBe(33 * 4);
+            image.bitDepth = 16;
+            expect(image.bytesPerPixel).toBe(8);
+            expect(image.toXY(33 * 8)).toEqual(xy(1, 1));
+        });
+
         it("returns `undefined` for `backgroundColor`", () => {
             expect(somePngImage.backgroundColor).toBeUndefined();
         });
@@ -477,6 +763,244 @@ describe("PngImage", () => {
             }
         });
     });
+
+    describe("bulk pixel access", () => {
+        describe("getRow", () => {
+            it("returns a view of the row", () => {
+                const somePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px.png`));
+                const row = somePngImage.getRow(3);
+                expect(row.length).toBe(256 * 3);
+                expect([...row.subarray(30, 33)]).toEqual([245, 0, 10]);
+                row[0] = 17;
+                expect(somePngImage.data[3 * 256 * 3]).toBe(17);
+            });
+
+            it("uses the new row length after cropping", () => {
+                const somePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px.png`));
+                somePngImage.crop(rect(10, 10, 20, 20));
+                const row = somePngImage.getRow(19);
+                expect(row.length).toBe(20 * 3);
+                expect([...row.subarray(57, 60)]).toEqual([226, 0, 29]);
+            });
+
+            it("throws an error for rows out of range", () => {
+                const somePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/orange-rectangle.png`));
+                expect(() => somePngImage.getRow(16)).toThrowErrorMatchingSnapshot();
+                expect(() => somePngImage.getRow(-1)).toThrowErrorMatchingSnapshot();
+            });
+        });
+
+        describe("getRegion", () => {
+            it("returns views of the rows of the region", () => {
+                const somePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px.png`));
+                const rows = somePngImage.getRegion(rect(100, 50, 2, 3));
+                expect(rows.length).toBe(3);
+                rows.forEach(row => expect([...row]).toEqual([155, 0, 100, 154, 0, 101]));
+                rows[2][0] = 17;
+                expect(somePngImage.at(100, 52)).toEqual(colorRGB(17, 0, 100));
+            });
+
+            it("throws an error for images with less than 8 bit per sample", () => {
+                const somePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/indexed-background.png`));
+                expect(() => somePngImage.getRegion(rect(0, 0, 2, 2))).toThrowErrorMatchingSnapshot();
+            });
+
+            it("throws an error for regions out of range", () => {
+                const somePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/orange-rectangle.png`));
+                expect(() => somePngImage.getRegion(rect(30, 0, 3, 2))).toThrowErrorMatchingSnapshot();
+            });
+        });
+
+        describe("samples", () => {
+            it("returns a view for 8 bit images", () => {
+                const somePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/orange-rectangle.png`));
+                const samples = somePngImage.samples();
+                expect(samples).toBeInstanceOf(Uint8Array);
+                expect(samples.buffer).toBe(somePngImage.data.buffer);
+                expect([...samples.subarray(0, 3)]).toEqual([255, 128, 64]);
+            });
+
+            it("returns samples in host byte order for 16 bit images", () => {
+                const somePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px.png`));
+                somePngImage.bitDepth = 16;
+                const samples = somePngImage.samples();
+                expect(samples).toBeInstanceOf(Uint16Array);
+                expect(samples.length).toBe(somePngImage.data.length / 2);
+                // The first bytes (255, 0, 0, 254) are read as the big-endian samples 0xff00 and 0x00fe.
+                expect(samples[0]).toBe(0xff00);
+                expect(samples[1]).toBe(0x00fe);
+            });
+        });
+
+        describe("readRGBA", () => {
+            it("converts the whole image", () => {
+                const somePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/orange-rectangle.png`));
+                const rgba = somePngImage.readRGBA();
+                expect(rgba.length).toBe(32 * 16 * 4);
+                for (let i = 0; i < rgba.length; i += 4) {
+                    expect([...rgba.subarray(i, i + 4)]).toEqual([255, 128, 64, 255]);
+                }
+            });
+
+            it("resolves palettes including their alpha values", () => {
+                const somePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/indexed-16px.png`));
+                const rgba = somePngImage.readRGBA(rect(0, 3, 1, 2));
+                expect([...rgba]).toEqual([128, 255, 64, 255, 64, 128, 255, 255]);
+            });
+
+            it("writes into a provided buffer", () => {
+                const somePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px.png`));
+                const target = new Uint8Array(12);
+                expect(somePngImage.readRGBA(rect(10, 0, 3, 1), target)).toBe(target);
+                expect([...target]).toEqual([245, 0, 10, 255, 244, 0, 11, 255, 243, 0, 12, 255]);
+            });
+
+            it("throws an error if the target is too small", () => {
+                const somePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/orange-rectangle.png`));
+                const target = new Uint8Array(15);
+                expect(() => somePngImage.readRGBA(rect(0, 0, 2, 2), target)).toThrowErrorMatchingSnapshot();
+            });
+
+            it("throws an error for areas out of range", () => {
+                const somePngImage = new PngImage(readFileSync(`${__dirname}/fixtures/orange-rectangle.png`));
+                expect(() => somePngImage.readRGBA(rect(0, 0, 0, 2))).toThrowErrorMatchingSnapshot();
+            });
+        });
+    });
+    describe("analysis", () => {
+        const orange = () => new PngImage(readFileSync(`${__dirname}/fixtures/orange-rectangle.png`));
+        const indexed = () => new PngImage(readFileSync(`${__dirname}/fixtures/indexed-16px.png`));
+        const gradient = () => new PngImage(readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px.png`));
+        const gray = () => new PngImage(readFileSync(`${__dirname}/fixtures/grayscale-gradient-16px.png`));
+        const grayAlpha = () => new PngImage(readFileSync(`${__dirname}/fixtures/grayscale-alpha-gradient-16px.png`));
+        const oneBit = () => new PngImage(readFileSync(`${__dirname}/fixtures/indexed-background.png`));
+
+        describe("histogram", () => {
+            it("counts the samples of every channel", () => {
+                const [red, green, blue] = orange().histogram();
+                expect(red.length).toBe(256);
+                expect(red[255]).toBe(32 * 16);
+                expect(green[128]).toBe(32 * 16);
+                expect(blue[64]).toBe(32 * 16);
+                expect(blue.reduce((sum, count) => sum + count, 0)).toBe(32 * 16);
+            });
+
+            it("counts the samples of an area", () => {
+                const [red] = gradient().histogram(rect(10, 20, 2, 5));
+                expect(red[245]).toBe(5);
+                expect(red[244]).toBe(5);
+                expect(red.reduce((sum, count) => sum + count, 0)).toBe(10);
+            });
+
+            it("counts the indices of palette images", () => {
+                const histogram = indexed().histogram();
+                expect(histogram.length).toBe(1);
+                expect([...histogram[0].subarray(0, 6)]).toEqual([0, 64, 64, 64, 64, 0]);
+            });
+
+            it("uses one bin per possible value for images with less than 8 bit per sample", () => {
+                const [indices] = oneBit().histogram();
+                expect([...indices]).toEqual([128, 0]);
+            });
+        });
+
+        describe("stats", () => {
+            it("computes the statistics of every channel", () => {
+                expect(orange().stats()).toEqual({ min: [255, 128, 64], max: [255, 128, 64], mean: [255, 128, 64] });
+                expect(gray().stats()).toEqual({ min: [0], max: [255], mean: [127.5] });
+            });
+
+            it("computes the statistics of an area", () => {
+                expect(gradient().stats(rect(10, 0, 3, 4))).toEqual({
+                    min: [243, 0, 10],
+                    max: [245, 0, 12],
+                    mean: [244, 0, 11],
+                });
+            });
+
+            it("computes the statistics of the colors of palette images", () => {
+                expect(indexed().stats()).toEqual({
+                    min: [64, 64, 64, 255],
+                    max: [255, 255, 255, 255],
+                    mean: [175.5, 143.75, 127.75, 255],
+                });
+                expect(oneBit().stats()).toEqual({
+                    min: [73, 73, 73, 255],
+                    max: [73, 73, 73, 255],
+                    mean: [73, 73, 73, 255],
+                });
+            });
+
+            it("throws an error for areas out of range", () => {
+                expect(() => orange().stats(rect(0, 10, 4, 7))).toThrowErrorMatchingSnapshot();
+            });
+        });
+
+        describe("isOpaque", () => {
+            it("detects opaque images", () => {
+                expect(orange().isOpaque()).toBe(true);
+                expect(gray().isOpaque()).toBe(true);
+                // The transparent palette entry is never used.
+                expect(indexed().isOpaque()).toBe(true);
+            });
+
+            it("detects transparent images", () => {
+                expect(grayAlpha().isOpaque()).toBe(false);
+                expect(new PngImage(readFileSync(`${__dirname}/fixtures/opaque-rectangle.png`)).isOpaque()).toBe(false);
+                const somePngImage = indexed();
+                somePngImage.fill(colorPalette(0), rect(4, 4, 1, 1));
+                expect(somePngImage.isOpaque()).toBe(false);
+            });
+        });
+
+        describe("isGrayscale", () => {
+            it("detects gray images", () => {
+                expect(gray().isGrayscale()).toBe(true);
+                expect(grayAlpha().isGrayscale()).toBe(true);
+                expect(oneBit().isGrayscale()).toBe(true);
+                const somePngImage = orange();
+                somePngImage.fill(colorRGB(17, 17, 17));
+                expect(somePngImage.isGrayscale()).toBe(true);
+            });
+
+            it("detects colored images", () => {
+                expect(orange().isGrayscale()).toBe(false);
+                expect(gradient().isGrayscale()).toBe(false);
+                expect(indexed().isGrayscale()).toBe(false);
+            });
+        });
+
+        describe("trimBounds", () => {
+            it("finds the content inside of a border of the color of the top left pixel", () => {
+                const somePngImage = orange();
+                somePngImage.resizeCanvas({ dimensions: xy(40, 30), offset: xy(3, 5), fillColor: colorRGB(0, 0, 0) });
+                expect(somePngImage.trimBounds()).toEqual(rect(3, 5, 32, 16));
+            });
+
+            it("uses the specified background color and tolerance", () => {
+                expect(gradient().trimBounds(colorRGB(255, 0, 0))).toEqual(rect(1, 0, 255, 256));
+                expect(gradient().trimBounds(colorRGB(255, 0, 0), 10)).toEqual(rect(11, 0, 245, 256));
+            });
+
+            it("compares the colors of palette entries", () => {
+                expect(indexed().trimBounds()).toEqual(rect(0, 4, 16, 12));
+                expect(indexed().trimBounds(colorPalette(4), 255)).toBeUndefined();
+            });
+
+            it("returns `undefined` for images consisting only of background", () => {
+                expect(orange().trimBounds()).toBeUndefined();
+                expect(oneBit().trimBounds()).toBeUndefined();
+            });
+
+            it("throws an error with an invalid color type", () => {
+                expect(() => orange().trimBounds(colorRGBA(0, 0, 0, 0))).toThrowErrorMatchingSnapshot();
+            });
+
+            it("throws an error with an invalid tolerance", () => {
+                expect(() => orange().trimBounds(undefined, -1)).toThrowErrorMatchingSnapshot();
+            });
+        });
+    });
 });
 
 describe("convertNativeBackgroundColor", () => {
@@ -0,0 +1,98 @@
+import { readFileSync } from "fs";
+import { ProgressiveDecoder, ProgressiveHeader, ProgressivePass, PngImage, DecodeOptions, decode } from "..";
+
+const fixtures = `${__dirname}/fixtures`;
+const gradient = readFileSync(`${fixtures}/red-blue-gradient-256px.png`);
+const interlaced = readFileSync(`${fixtures}/red-blue-gradient-256px-interlaced.png`);
+
+interface Decoded {
+    headers: ProgressiveHeader[];
+    passes: ProgressivePass[];
+    image: PngImage;
+}
+
+// Writes the buffer into a new decoder in chunks of the given size, collecting all events.
+function decodeInChunks(buffer: Buffer, chunkSize: number, options?: DecodeOptions) {
+    return new Promise<Decoded>((resolve, reject) => {
+        const decoder = new ProgressiveDecoder(options);
+        const headers: ProgressiveHeader[] = [];
+        const passes: ProgressivePass[] = [];
+        decoder.on("header", header => headers.push(header));
+        decoder.on("pass", pass => passes.push(pass));
+        decoder.on("image", image => resolve({ headers, passes, image }));
+        decoder.on("error", reject);
+        for (let offset = 0; offset < buffer.length; offset += chunkSize) {
+            decoder.write(buffer.slice(offset, offset + chunkSize));
+        }
+        decoder.end();
+    });
+}
+
+// Replicates every pixel at the top left corner of a block over the whole block.
+function blocky(data: Buffer, width: number, channels: number, blockWidth: number, blockHeight: number) {
+    const result = Buffer.alloc(data.length);
+    const height = data.length / width / channels;
+    for (let y = 0; y < height; ++y) {
+        for (let x = 0; x < width; ++x) {
+            const source = ((y - y % blockHeight) * width + x - x % blockWidth) * channels;
+            data.copy(result, (y * width + x) * channels, source, source + channels);
+        }
+    }
+    return result;
+}
+
+describe("ProgressiveDecoder", () => {
+    it("emits a preview after every pass of an interlaced image", async () => {
+        const { headers, passes, image } = await decodeInChunks(interlaced, 100, { output: "rgba8" });
+        expect(headers).toEqual([{ width: 256, height: 256, channels: 4, bitDepth: 8, interlaced: true }]);
+        expect(passes.map(({ pass }) => pass)).toEqual([1, 2, 3, 4, 5, 6]);
+        const full = decode(interlaced, { output: "rgba8" }).data;
+        expect(image.data.equals(full)).toBe(true);
+        expect(passes[0]).toMatchObject({ width: 256, height: 256, channels: 4 });
+        expect(passes[0].data.equals(blocky(full, 256, 4, 8, 8))).toBe(true);
+        expect(passes[1].data.equals(blocky(full, 256, 4, 4, 8))).toBe(true);
+        expect(passes[3].data.equals(blocky(full, 256, 4, 2, 4))).toBe(true);
+        expect(passes[5].data.equals(blocky(full, 256, 4, 1, 2))).toBe(true);
+    });
+
+    it("uses the output format for the previews", async () => {
+        const { headers, passes, image } = await decodeInChunks(interlaced, 4096, { output: "gray8" });
+        expect(headers[0].channels).toBe(1);
+        expect(passes).toHaveLength(6);
+        expect(passes[2].data.length).toBe(256 * 256);
+        expect(image.colorType).toBe("gray");
+        expect(image.data.equals(decode(interlaced, { output: "gray8" }).data)).toBe(true);
+    });
+
+    it("decodes images which are not interlaced without previews", async () => {
+        const { headers, passes, image } = await decodeInChunks(gradient, 1);
+        expect(headers).toEqual([{ width: 256, height: 256, channels: 3, bitDepth: 8, interlaced: false }]);
+        expect(passes).toHaveLength(0);
+        expect(image.data.equals(decode(gradient).data)).toBe(true);
+        expect(image.interlaceType).toBe("none");
+    });
+
+    it("keeps the image after it has finished", done => {
+        const decoder = new ProgressiveDecoder();
+        expect(decoder.image).toBeUndefined();
+        decoder.on("finish", () => {
+            expect(decoder.header.interlaced).toBe(true);
+            expect(decoder.image.interlaceType).toBe("adam7");
+            expect(decoder.image.width).toBe(256);
+            done();
+        });
+        decoder.end(interlaced);
+    });
+
+    it("emits an error for invalid input", async () => {
+        await expect(decodeInChunks(Buffer.from("this is not a png"), 4)).rejects.toThrowErrorMatchingSnapshot();
+        await expect(decodeInChunks(interlaced.slice(0, 400), 100)).rejects.toThrowErrorMatchingSnapshot();
+        await expect(decodeInChunks(gradient, 100, { limits: { maxWidth: 100 } })).rejects
+            .toThrowErrorMatchingSnapshot();
+    });
+
+    it("rejects invalid options", () => {
+        expect(() => new ProgressiveDecoder({ output: "rgb16" } as any)).toThrowErrorMatchingSnapshot();
+        expect(() => new ProgressiveDecoder(null)).toThrowErrorMatchingSnapshot();
+    });
+});
@@ -0,0 +1,199 @@
+import { EventEmitter } from "events";
+import { existsSync, mkdirSync, readFileSync, readdirSync } from "fs";
+import { generatePyramid, decode, encode, AbortSignalLike } from "..";
+
+const fixtures = `${__dirname}/fixtures`;
+const orangeRectangle = readFileSync(`${fixtures}/orange-rectangle.png`);
+const gradient = readFileSync(`${fixtures}/red-blue-gradient-256px.png`);
+const indexed = readFileSync(`${fixtures}/indexed-16px.png`);
+const interlaced = readFileSync(`${fixtures}/red-blue-gradient-256px-interlaced.png`);
+
+function outputPath(name: string) {
+    return `${__dirname}/../../tmp-pyramid-${name}`;
+}
+
+// Copies a region of tightly packed pixels.
+function region(data: Buffer, width: number, channels: number, x: number, y: number, size: number) {
+    const rows = [];
+    for (let row = y; row < y + size; ++row) {
+        rows.push(data.slice((row * width + x) * channels, (row * width + x + size) * channels));
+    }
+    return Buffer.concat(rows);
+}
+
+// Averages blocks of 2x2 pixels of an opaque image with an even size.
+function reduce(data: Buffer, width: number, height: number, channels: number) {
+    const reduced = Buffer.alloc(data.length / 4);
+    for (let y = 0; y < height / 2; ++y) {
+        for (let x = 0; x < width / 2; ++x) {
+            for (let channel = 0; channel < channels; ++channel) {
+                const at = (column: number, row: number) => data[(row * width + column) * channels + channel];
+                const sum = at(2 * x, 2 * y) + at(2 * x + 1, 2 * y) + at(2 * x, 2 * y + 1) + at(2 * x + 1, 2 * y + 1);
+                reduced[(y * width / 2 + x) * channels + channel] = (sum + 2) >> 2;
+            }
+        }
+    }
+    return reduced;
+}
+
+class TestSignal implements AbortSignalLike {
+    public aborted = false;
+    private emitter = new EventEmitter();
+
+    public addEventListener(type: "abort", listener: () => void) {
+        this.emitter.on(type, listener);
+    }
+
+    public removeEventListener(type: "abort", listener: () => void) {
+        this.emitter.removeListener(type, listener);
+    }
+
+    public abort() {
+        this.aborted = true;
+        this.emitter.emit("abort");
+    }
+}
+
+describe("generatePyramid", () => {
+    it("writes the tiles of all levels", async () => {
+        const path = outputPath("gradient");
+        const pyramid = await generatePyramid(gradient, path, { tileSize: 16 });
+        expect(pyramid).toEqual({ width: 256, height: 256, levels: 9, tiles: 345, tileSize: 16, format: "dzi" });
+        expect(readdirSync(`${path}_files/8`)).toHaveLength(256);
+        expect(readdirSync(`${path}_files/4`)).toEqual(["0_0.png"]);
+        const full = decode(gradient, { output: "rgb8" }).data;
+        const tile = decode(readFileSync(`${path}_files/8/3_5.png`));
+        expect([tile.width, tile.height, tile.colorType]).toEqual([16, 16, "rgb"]);
+        expect(tile.data.equals(region(full, 256, 3, 48, 80, 16))).toBe(true);
+        const reduced = decode(readFileSync(`${path}_files/7/7_2.png`)).data;
+        expect(reduced.equals(region(reduce(full, 256, 256, 3), 128, 3, 112, 32, 16))).toBe(true);
+        const coarsest = decode(readFileSync(`${path}_files/0/0_0.png`));
+        expect([coarsest.width, coarsest.height]).toEqual([1, 1]);
+    });
+
+    it("writes the Deep Zoom descriptor", async () => {
+        const path = outputPath("descriptor");
+        await generatePyramid(orangeRectangle, path, { tileSize: 16 });
+        expect(readFileSync(`${path}.dzi`, "utf8")).toMatchSnapshot();
+    });
+
+    it("writes smaller tiles at the edges", async () => {
+        const path = outputPath("edges");
+        const pyramid = await generatePyramid(orangeRectangle, path, { tileSize: 24 });
+        expect(pyramid.tiles).toBe(7);
+        const edge = decode(readFileSync(`${path}_files/5/1_0.png`));
+        expect([edge.width, edge.height]).toEqual([8, 16]);
+        const full = decode(orangeRectangle, { output: "rgb8" }).data;
+        expect(edge.data.equals(Buffer.concat(
+            Array.from({ length: 16 }, (_, row) => full.slice((row * 32 + 24) * 3, (row * 32 + 32) * 3)),
+        ))).toBe(true);
+    });
+
+    it("keeps the transparency", async () => {
+        const path = outputPath("indexed");
+        const pyramid = await generatePyramid(indexed, path, { tileSize: 8, compressionLevel: 1 });
+        expect(pyramid.levels).toBe(5);
+        const tile = decode(readFileSync(`${path}_files/4/1_1.png`));
+        expect(tile.colorType).toBe("rgba");
+        expect(tile.data.equals(region(decode(indexed, { output: "rgba8" }).data, 16, 4, 8, 8, 8))).toBe(true);
+    });
+
+    it("uses the zxy structure", async () => {
+        const path = outputPath("zxy");
+        const pyramid = await generatePyramid(gradient, path, { tileSize: 128, format: "zxy" });
+        expect(pyramid).toEqual({ width: 256, height: 256, levels: 9, tiles: 12, tileSize: 128, format: "zxy" });
+        expect(readdirSync(`${path}/8`)).toEqual(["0", "1"]);
+        expect(readdirSync(`${path}/8/1`)).toEqual(["0.png", "1.png"]);
+        expect(existsSync(`${path}.dzi`)).toBe(false);
+        const full = decode(gradient, { output: "rgb8" }).data;
+        expect(decode(readFileSync(`${path}/8/1/0.png`)).data.equals(region(full, 256, 3, 128, 0, 128))).toBe(true);
+    });
+
+    it("reads the image from a file", async () => {
+        const path = outputPath("file");
+        const pyramid = await generatePyramid(`${fixtures}/red-blue-gradient-256px.png`, path, { trusted: true });
+        expect(pyramid).toEqual({ width: 256, height: 256, levels: 9, tiles: 9, tileSize: 256, format: "dzi" });
+        expect(decode(readFileSync(`${path}_files/8/0_0.png`)).data).toEqual(decode(gradient).data);
+    });
+
+    it("encodes the tiles of large bands in parallel", async () => {
+        const width = 6000;
+        const height = 300;
+        const data = Buffer.alloc(width * height * 4);
+        for (let index = 0; index < data.length; ++index) {
+            data[index] = index % 4 === 3 ? 255 : (index * 7) % 251;
+        }
+        const path = outputPath("parallel");
+        const pyramid = await generatePyramid(encode(data, { width, height, compressionLevel: 1 }), path, {
+            compressionLevel: 1,
+            priority: "batch",
+        });
+        expect([pyramid.levels, pyramid.tiles]).toEqual([14, 24 * 2 + 12 + 6 + 3 + 2 + 9]);
+        const tile = decode(readFileSync(`${path}_files/13/23_1.png`));
+        expect([tile.width, tile.height]).toEqual([6000 - 23 * 256, 300 - 256]);
+        expect(tile.data.equals(Buffer.concat(Array.from({ length: 44 }, (_, row) => {
+            const offset = ((256 + row) * width + 23 * 256) * 4;
+            return data.slice(offset, offset + tile.width * 4);
+        })))).toBe(true);
+    });
+
+    it("supports a callback", done => {
+        const path = outputPath("callback");
+        generatePyramid(orangeRectangle, path, (error, pyramid) => {
+            expect(error).toBeNull();
+            expect(pyramid.levels).toBe(6);
+            generatePyramid(orangeRectangle, path, { format: "zxy" }, (secondError, secondPyramid) => {
+                expect(secondError).toBeNull();
+                expect(secondPyramid.format).toBe("zxy");
+                done();
+            });
+        });
+    });
+
+    it("rejects invalid input", async () => {
+        const path = outputPath("invalid");
+        await expect(generatePyramid(Buffer.from("test"), path)).rejects.toThrowErrorMatchingSnapshot();
+        await expect(generatePyramid(gradient.slice(0, 120), path)).rejects.toThrowErrorMatchingSnapshot();
+        await expect(generatePyramid(interlaced, path)).rejects.toThrowErrorMatchingSnapshot();
+        await expect(generatePyramid(123 as any, path)).rejects.toThrowErrorMatchingSnapshot();
+        await expect(generatePyramid(gradient, path, { limits: { maxWidth: 100 } })).rejects
+            .toThrowErrorMatchingSnapshot();
+    });
+
+    it("rejects with an error when reading or writing failed", async () => {
+        const missing = generatePyramid("this-file/does/not/exist.png", outputPath("missing"));
+        await expect(missing).rejects.toThrowErrorMatchingSnapshot();
+        const unwritable = generatePyramid(gradient, "this-directory/does/not/exist");
+        await expect(unwritable).rejects.toThrowErrorMatchingSnapshot();
+        const path = outputPath("unwritable-descriptor");
+        if (!existsSync(`${path}.dzi`)) {
+            mkdirSync(`${path}.dzi`);
+        }
+        await expect(generatePyramid(orangeRectangle, path)).rejects.toHaveProperty("code", "EISDIR");
+    });
+
+    it("rejects invalid options", async () => {
+        const invalid: any[] = [
+            null,
+            { tileSize: 1 },
+            { tileSize: 16.5 },
+            { tileSize: 65537 },
+            { format: "tms" },
+            { compressionLevel: 10 },
+            { limits: { maxChunks: 0 } },
+            { priority: "urgent" },
+        ];
+        for (const options of invalid) {
+            await expect(generatePyramid(gradient, outputPath("options"), options)).rejects
+                .toThrowErrorMatchingSnapshot();
+        }
+        await expect(generatePyramid(gradient, "")).rejects.toThrowErrorMatchingSnapshot();
+    });
+
+    it("can be aborted", async () => {
+        const signal = new TestSignal();
+        const aborted = generatePyramid(gradient, outputPath("aborted"), { signal });
+        signal.abort();
+        await expect(aborted).rejects.toHaveProperty("name", "AbortError");
+    });
+});
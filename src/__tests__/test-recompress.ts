@@ -0,0 +1,147 @@
+import { EventEmitter } from "events";
+import { readFileSync } from "fs";
+import { inflateSync } from "zlib";
+import { recompress, readChunks, decode, AbortSignalLike } from "..";
+
+const orangeRectangle = readFileSync(`${__dirname}/fixtures/orange-rectangle.png`);
+const gradient = readFileSync(`${__dirname}/fixtures/red-blue-gradient-256px.png`);
+
+function chunkTypes(buffer: Buffer) {
+    return readChunks(buffer).map(({ type }) => type);
+}
+
+function ancillaryChunks(buffer: Buffer) {
+    return readChunks(buffer)
+        .filter(({ type }) => type !== "IDAT")
+        .map(({ type, data }) => ({ type, data }));
+}
+
+// The filter type is the first byte of every inflated row.
+function rowFilters(buffer: Buffer, rowBytes: number) {
+    const imageData = Buffer.concat(readChunks(buffer).filter(({ type }) => type === "IDAT").map(({ data }) => data));
+    const rows = inflateSync(imageData);
+    const filters = new Set<number>();
+    for (let offset = 0; offset < rows.length; offset += rowBytes + 1) {
+        filters.add(rows[offset]);
+    }
+    return [...filters];
+}
+
+class TestSignal implements AbortSignalLike {
+    public aborted = false;
+    private emitter = new EventEmitter();
+
+    public addEventListener(type: "abort", listener: () => void) {
+        this.emitter.on(type, listener);
+    }
+
+    public removeEventListener(type: "abort", listener: () => void) {
+        this.emitter.removeListener(type, listener);
+    }
+
+    public abort() {
+        this.aborted = true;
+        this.emitter.emit("abort");
+    }
+}
+
+describe("recompress", () => {
+    [
+        "orange-rectangle.png",
+        "orange-rectangle-gamma-background.png",
+        "indexed-16px.png",
+        "indexed-background.png",
+        "grayscale-alpha-gradient-16px.png",
+        "red-blue-gradient-256px-interlaced.png",
+    ].forEach(name => {
+        it(`keeps the pixels and all other chunks of ${name}`, async () => {
+            const input = readFileSync(`${__dirname}/fixtures/${name}`);
+            const output = await recompress(input, { compressionLevel: 1 });
+            expect(ancillaryChunks(output)).toEqual(ancillaryChunks(input));
+            const original = decode(input);
+            const recompressed = decode(output);
+            expect(recompressed.data).toEqual(original.data);
+            expect(recompressed.interlaceType).toBe(original.interlaceType);
+        });
+    });
+
+    it("applies the compression level", async () => {
+        const stored = await recompress(gradient, { compressionLevel: 0 });
+        const compressed = await recompress(stored);
+        expect(stored.length).toBeGreaterThan(256 * 256 * 3);
+        expect(compressed.length).toBeLessThan(stored.length);
+        expect(decode(compressed).data).toEqual(decode(gradient).data);
+    });
+
+    it("applies the filter", async () => {
+        expect(rowFilters(await recompress(gradient, { filter: "none" }), 256 * 3)).toEqual([0]);
+        expect(rowFilters(await recompress(gradient, { filter: "up" }), 256 * 3)).toEqual([2]);
+        expect(rowFilters(await recompress(gradient, { filter: "paeth" }), 256 * 3)).toEqual([4]);
+        const adaptive = await recompress(gradient, { filter: "adaptive", strategy: "rle" });
+        expect(decode(adaptive).data).toEqual(decode(gradient).data);
+    });
+
+    it("applies the strategy", async () => {
+        for (const strategy of ["default", "filtered", "huffman", "rle", "fixed"]) {
+            const output = await recompress(gradient, { strategy: strategy as any, filter: "sub" });
+            expect(decode(output).data).toEqual(decode(gradient).data);
+        }
+    });
+
+    it("strips the metadata", async () => {
+        const output = await recompress(orangeRectangle, { stripMetadata: true });
+        expect(chunkTypes(output)).toEqual(["IHDR", "pHYs", "IDAT", "IEND"]);
+        expect(decode(output).data).toEqual(decode(orangeRectangle).data);
+    });
+
+    it("supports a callback", done => {
+        recompress(orangeRectangle, (error, output) => {
+            expect(error).toBeNull();
+            expect(decode(output).data).toEqual(decode(orangeRectangle).data);
+            recompress(orangeRectangle, { priority: "batch" }, (secondError, secondOutput) => {
+                expect(secondError).toBeNull();
+                expect(secondOutput).toEqual(output);
+                done();
+            });
+        });
+    });
+
+    it("rejects invalid input", async () => {
+        await expect(recompress(Buffer.from("test"))).rejects.toThrowErrorMatchingSnapshot();
+        await expect(recompress(orangeRectangle.slice(0, 120))).rejects.toThrowErrorMatchingSnapshot();
+        await expect(recompress("test" as any)).rejects.toThrowErrorMatchingSnapshot();
+    });
+
+    it("applies the limits", async () => {
+        await expect(recompress(gradient, { limits: { maxWidth: 100 } })).rejects.toThrowErrorMatchingSnapshot();
+    });
+
+    it("rejects invalid options", async () => {
+        const invalid: any[] = [
+            null,
+            { compressionLevel: 10 },
+            { compressionLevel: 1.5 },
+            { filter: "average-ish" },
+            { strategy: "fast" },
+            { limits: { maxWidth: -1 } },
+            { priority: "urgent" },
+        ];
+        for (const options of invalid) {
+            await expect(recompress(orangeRectangle, options)).rejects.toThrowErrorMatchingSnapshot();
+        }
+    });
+
+    it("calls the callback with invalid options", done => {
+        recompress(orangeRectangle, { compressionLevel: -1 } as any, error => {
+            expect(error.message).toMatchSnapshot();
+            done();
+        });
+    });
+
+    it("can be aborted", async () => {
+        const signal = new TestSignal();
+        const aborted = recompress(gradient, { signal });
+        signal.abort();
+        await expect(aborted).rejects.toHaveProperty("name", "AbortError");
+    });
+});
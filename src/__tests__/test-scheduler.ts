@@ -0,0 +1,159 @@
+import { EventEmitter } from "events";
+import { cpus } from "os";
+import { randomBytes } from "crypto";
+import { readdirSync } from "fs";
+import { basename, dirname } from "path";
+import { AbortSignalLike, configureScheduler, readPngFile, schedulerStats, writePngFile } from "..";
+
+// A minimal `AbortSignal`, as `AbortController` isn't available in all supported versions of Node.
+class TestSignal implements AbortSignalLike {
+    public aborted = false;
+    private emitter = new EventEmitter();
+
+    public addEventListener(type: "abort", listener: () => void) {
+        this.emitter.on(type, listener);
+    }
+
+    public removeEventListener(type: "abort", listener: () => void) {
+        this.emitter.removeListener(type, listener);
+    }
+
+    public get listeners() {
+        return this.emitter.listenerCount("abort");
+    }
+
+    public abort() {
+        this.aborted = true;
+        this.emitter.emit("abort");
+    }
+}
+
+// Random pixels don't compress, so encoding them with the best compression keeps the pool busy for a while.
+const width = 2048;
+const height = 2048;
+const noise = randomBytes(width * height * 4);
+
+// Occupies a thread of the pool by encoding noise.
+function encodeNoise(name: string, signal?: AbortSignalLike) {
+    return writePngFile(`${__dirname}/../../tmp-scheduler-${name}.png`, noise, {
+        width,
+        height,
+        compressionLevel: 9,
+        atomic: true,
+        signal,
+    });
+}
+
+const path = `${__dirname}/fixtures/orange-rectangle.png`;
+
+describe("scheduler", () => {
+    afterAll(() => configureScheduler({ threads: cpus().length }));
+
+    describe("configureScheduler", () => {
+        it("changes the amount of threads", () => {
+            configureScheduler({ threads: 2 });
+            expect(schedulerStats().threads).toBe(2);
+        });
+
+        it("keeps the amount of threads if none is specified", () => {
+            configureScheduler({ threads: 3 });
+            configureScheduler({});
+            expect(schedulerStats().threads).toBe(3);
+        });
+
+        it("throws if the options are not an object", () => {
+            expect(() => configureScheduler(null)).toThrowErrorMatchingSnapshot();
+        });
+
+        it("throws if the amount of threads is not a positive integer", () => {
+            expect(() => configureScheduler({ threads: 0 })).toThrowErrorMatchingSnapshot();
+            expect(() => configureScheduler({ threads: 1.5 })).toThrowErrorMatchingSnapshot();
+        });
+    });
+
+    describe("schedulerStats", () => {
+        it("counts the jobs of each lane", async () => {
+            const before = schedulerStats();
+            await readPngFile(path, { priority: "batch" });
+            await readPngFile(path);
+            const after = schedulerStats();
+            expect(after.batch.completed).toBe(before.batch.completed + 1);
+            expect(after.interactive.completed).toBe(before.interactive.completed + 1);
+            expect(after.batch.queued).toBe(0);
+            expect(after.batch.running).toBe(0);
+            expect(after.batch.maxWaitTime).toBeGreaterThanOrEqual(after.batch.averageWaitTime);
+            expect(after.batch.averageRunTime).toBeGreaterThan(0);
+        });
+    });
+
+    describe("priorities", () => {
+        beforeEach(() => configureScheduler({ threads: 1 }));
+
+        it("starts interactive jobs before batch jobs", async () => {
+            const order: string[] = [];
+            const busy = encodeNoise("busy");
+            const batch = readPngFile(path, { priority: "batch" }).then(() => order.push("batch"));
+            const interactive = readPngFile(path, { priority: "interactive" }).then(() => order.push("interactive"));
+            await Promise.all([busy, batch, interactive]);
+            expect(order).toEqual(["interactive", "batch"]);
+        });
+
+        it("rejects an unknown priority", async () => {
+            await expect(readPngFile(path, { priority: "urgent" as any })).rejects.toThrowErrorMatchingSnapshot();
+        });
+    });
+
+    describe("aborting", () => {
+        beforeEach(() => configureScheduler({ threads: 1 }));
+
+        it("aborts a queued job", async () => {
+            const signal = new TestSignal();
+            const busy = encodeNoise("queued");
+            const aborted = readPngFile(path, { signal });
+            const before = schedulerStats();
+            signal.abort();
+            await expect(aborted).rejects.toHaveProperty("name", "AbortError");
+            // The job was dropped without waiting for the busy thread.
+            expect(schedulerStats().interactive.running).toBe(1);
+            expect(schedulerStats().interactive.aborted).toBe(before.interactive.aborted + 1);
+            await busy;
+        });
+
+        it("aborts a running job at the next row", async () => {
+            const signal = new TestSignal();
+            const target = `${__dirname}/../../tmp-scheduler-running.png`;
+            const running = encodeNoise("running", signal);
+            setTimeout(() => signal.abort(), 20);
+            await expect(running).rejects.toHaveProperty("name", "AbortError");
+            const prefix = `${basename(target)}.tmp-`;
+            expect(readdirSync(dirname(target)).filter(name => name.startsWith(prefix))).toEqual([]);
+        });
+
+        it("doesn't schedule a job with an aborted signal", async () => {
+            const signal = new TestSignal();
+            signal.abort();
+            const before = schedulerStats();
+            await expect(readPngFile(path, { signal })).rejects.toThrowErrorMatchingSnapshot();
+            expect(schedulerStats().interactive.completed).toBe(before.interactive.completed);
+        });
+
+        it("stops listening to the signal once the job is done", async () => {
+            const signal = new TestSignal();
+            const { width: imageWidth } = await readPngFile(path, { signal });
+            expect(imageWidth).toBe(32);
+            expect(signal.listeners).toBe(0);
+        });
+
+        it("passes errors through if the job wasn't aborted", async () => {
+            const signal = new TestSignal();
+            const jpg = `${__dirname}/fixtures/red-blue-gradient-256px.jpg`;
+            await expect(readPngFile(jpg, { signal })).rejects.toThrowErrorMatchingSnapshot();
+        });
+
+        it("rejects something which isn't a signal", async () => {
+            await expect(readPngFile(path, { signal: "abort" as any })).rejects.toThrowErrorMatchingSnapshot();
+            await expect(readPngFile(path, { signal: null })).rejects.toThrowErrorMatchingSnapshot();
+            await expect(readPngFile(path, { signal: {} as any })).rejects.toThrowErrorMatchingSnapshot();
+        });
+    });
+});
@@ -0,0 +1,127 @@
+import { readFileSync, writeFileSync } from "fs";
+import { verify, verifyFile } from "..";
+
+describe("verify", () => {
+    // This fixtures is a 32w, 16h rectangle with RGB = (255, 128, 64) and no alpha channel.
+    // Its `IDAT` chunk starts at offset 114 and its `IEND` chunk at offset 158.
+    const someOrangeRectangle = readFileSync(`${__dirname}/fixtures/orange-rectangle.png`);
+    // The same rectangle, but interlaced and with additional chunks. Its `gAMA` chunk starts at offset 33.
+    const someInterlacedOrangeRectangle = readFileSync(`${__dirname}/fixtures/orange-rectangle-gamma-background.png`);
+
+    // Flips the last byte of the data or the CRC of the first chunk of the specified type.
+    function corrupt(buffer: Buffer, type: string, crc: boolean): Buffer {
+        const corrupted = Buffer.from(buffer);
+        const start = corrupted.indexOf(type) + 4;
+        const end = start + corrupted.readUInt32BE(start - 8);
+        corrupted[crc ? end : end - 1] ^= 0xff;
+        return corrupted;
+    }
+
+    it("accepts a valid image", () => {
+        expect(verify(someOrangeRectangle)).toEqual({ valid: true });
+    });
+
+    it("accepts a valid interlaced image", () => {
+        expect(verify(someInterlacedOrangeRectangle)).toEqual({ valid: true });
+    });
+
+    it("detects a broken CRC of the image data", () => {
+        expect(verify(corrupt(someOrangeRectangle, "IDAT", true))).toEqual({
+            valid: false,
+            chunk: "IDAT",
+            offset: 114,
+            reason: "CRC error",
+        });
+    });
+
+    it("detects a broken checksum of the compressed image data", () => {
+        expect(verify(corrupt(someOrangeRectangle, "IDAT", false))).toEqual({
+            valid: false,
+            chunk: "IDAT",
+            offset: 114,
+            reason: "incorrect data check",
+        });
+    });
+
+    it("detects a broken CRC of an ancillary chunk", () => {
+        expect(verify(corrupt(someInterlacedOrangeRectangle, "gAMA", true))).toEqual({
+            valid: false,
+            chunk: "gAMA",
+            offset: 33,
+            reason: "CRC error",
+        });
+    });
+
+    it("detects truncated image data", () => {
+        expect(verify(someOrangeRectangle.slice(0, 130))).toEqual({
+            valid: false,
+            chunk: "IDAT",
+            offset: 114,
+            reason: "Unexpected end of PNG data.",
+        });
+    });
+
+    it("detects a missing `IEND` chunk", () => {
+        expect(verify(someOrangeRectangle.slice(0, 158))).toEqual({
+            valid: false,
+            offset: 158,
+            reason: "Unexpected end of PNG data.",
+        });
+    });
+
+    it("detects an invalid signature", () => {
+        expect(verify(Buffer.from("Not a PNG image."))).toEqual({
+            valid: false,
+            offset: 0,
+            reason: "Invalid PNG signature.",
+        });
+    });
+
+    it("throws an error when trying to verify something which isn't a buffer", () => {
+        expect(() => verify("something" as any)).toThrowErrorMatchingSnapshot();
+    });
+});
+
+describe("verifyFile", () => {
+    const someFile = `${__dirname}/fixtures/orange-rectangle.png`;
+
+    describe("using the Promise API", () => {
+        it("verifies a PNG file", async () => {
+            expect(await verifyFile(someFile)).toEqual({ valid: true });
+        });
+
+        it("reports invalid files like `verify`", async () => {
+            const path = `${__dirname}/../../tmp-verify-file-corrupt.png`;
+            const corrupted = readFileSync(someFile);
+            corrupted[corrupted.length - 20] ^= 0xff;
+            writeFileSync(path, corrupted);
+            const result = await verifyFile(path);
+            expect(result).toMatchObject({ valid: false, chunk: "IDAT" });
+            expect(result).toEqual(verify(corrupted));
+            writeFileSync(path, corrupted.slice(0, 130));
+            expect(await verifyFile(path)).toEqual(verify(corrupted.slice(0, 130)));
+        });
+
+        it("rejects with an error when reading failed", () => {
+            return expect(verifyFile(`this-file/does/not/exist.png`)).rejects.toBeTruthy();
+        });
+    });
+
+    describe("using the callback API", () => {
+        it("verifies a PNG file", done => {
+            verifyFile(someFile, (error, result) => {
+                expect(error).toBeNull();
+                expect(result).toEqual({ valid: true });
+                done();
+            });
+        });
+
+        it("calls the callback with an error when reading failed", done => {
+            verifyFile(`this-file/does/not/exist.png`, (error, result) => {
+                expect(error).toBeTruthy();
+                expect(result).toBeUndefined();
+                done();
+            });
+        });
+    });
+});
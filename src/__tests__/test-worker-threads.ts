@@ -0,0 +1,77 @@
+import { readFileSync } from "fs";
+import { qualifiedName } from "../../scripts/file-name";
+import { decode, encode } from "..";
+
+// Node 10 only provides worker threads behind the `--experimental-worker` flag.
+const { Worker } = (() => {
+    try {
+        return require("worker_threads"); // tslint:disable-line
+    } catch (err) {
+        return {};
+    }
+})();
+const describeWithWorkers = Worker ? describe : describe.skip;
+
+// Workers can't load the TypeScript sources, so they use the native addon directly. Each worker decodes
+// a buffer and a file, normalizing them to RGBA, and encodes the images again.
+const workerSource = `
+const { parentPort, workerData } = require("worker_threads");
+const { __native_PngImage, __native_encode, __native_readPngFile } = require(workerData.addon);
+const encoded = [];
+for (let i = 0; i < workerData.iterations; ++i) {
+    const image = new __native_PngImage(Buffer.from(workerData.input), { output: "rgba8" });
+    encoded.push(__native_encode(image.data, image.width, image.height, true, 6, false));
+}
+__native_readPngFile(workerData.path, { output: "rgba8" }, false, (error, image) => {
+    encoded.push(__native_encode(image.data, image.width, image.height, true, 6, false));
+    parentPort.postMessage(encoded);
+});
+`;
+
+// Starts a worker and resolves with the images it encoded once it exited.
+function runWorker(path: string, iterations: number): Promise<Uint8Array[]> {
+    return new Promise((resolve, reject) => {
+        const input = readFileSync(path);
+        const worker = new Worker(workerSource, {
+            eval: true,
+            workerData: { addon: qualifiedName, input, path, iterations },
+        });
+        let result: Uint8Array[];
+        worker.on("message", (message: Uint8Array[]) => result = message);
+        worker.on("error", reject);
+        worker.on("exit", (code: number) => {
+            if (code !== 0) {
+                reject(new Error(`Worker exited with ${code}.`));
+                return;
+            }
+            resolve(result);
+        });
+    });
+}
+
+describeWithWorkers("worker threads", () => {
+    const paths = [
+        `${__dirname}/fixtures/orange-rectangle.png`,
+        `${__dirname}/fixtures/indexed-16px.png`,
+        `${__dirname}/fixtures/red-blue-gradient-256px.png`,
+        `${__dirname}/fixtures/red-blue-gradient-256px-interlaced.png`,
+    ];
+
+    function expected(path: string): Buffer {
+        const { data, width, height } = decode(readFileSync(path), { output: "rgba8" });
+        return encode(data, { width, height, compressionLevel: 6 });
+    }
+
+    it("decodes and encodes concurrently in multiple workers", async () => {
+        const results = await Promise.all(paths.map(path => runWorker(path, 8)));
+        results.forEach((encoded, index) => {
+            expect(encoded).toHaveLength(9);
+            encoded.forEach(image => expect(Buffer.from(image)).toEqual(expected(paths[index])));
+        });
+    });
+
+    it("can load the addon again after the workers exited", async () => {
+        const [encoded] = await Promise.all([runWorker(paths[0], 1), runWorker(paths[1], 1)]);
+        expect(Buffer.from(encoded[0])).toEqual(expected(paths[0]));
+    });
+});
@@ -0,0 +1,249 @@
+import { DecodeLimits, validateDecodeOptions } from "./decode-options";
+import { __native_ApngDecoder, __native_encodeApng } from "./native";
+import { Rect, rect } from "./rect";
+import { JobOptions, scheduleJob } from "./scheduler";
+
+export interface DecodeApngOptions {
+    /**
+     * Skip verifying the CRCs and the adler32 checksums of the frames.
+     *
+     * @see DecodeOptions.trusted
+     */
+    trusted?: boolean;
+    /**
+     * Limits rejecting input which would take too many resources to decode. The size limits apply to the canvas.
+     *
+     * @see DecodeLimits
+     */
+    limits?: DecodeLimits;
+}
+
+/**
+ * A frame of an animated image, as rendered by `ApngDecoder`.
+ */
+export interface ApngFrame {
+    /**
+     * The index of the frame, starting at `0`.
+     */
+    index: number;
+    /**
+     * The area of the canvas the frame was rendered into.
+     */
+    region: Rect;
+    /**
+     * How long the frame is shown in milliseconds.
+     */
+    delay: number;
+    /**
+     * The canvas with the frame composited onto it, as 8 bit RGBA. The same buffer is used for every frame.
+     */
+    data: Buffer;
+}
+
+/**
+ * Decodes the frames of an animated PNG (APNG) one after another, compositing each frame onto a canvas
+ * as specified by its dispose and blend operations. Images without animation have a single frame.
+ * The default image is skipped if it is not part of the animation.
+ */
+export class ApngDecoder {
+    /**
+     * The width of the canvas in pixels.
+     */
+    public readonly width: number;
+    /**
+     * The height of the canvas in pixels.
+     */
+    public readonly height: number;
+    /**
+     * The amount of frames in the animation.
+     */
+    public readonly frameCount: number;
+    /**
+     * How often the animation should be played, with `0` meaning forever.
+     */
+    public readonly plays: number;
+    /**
+     * The 8 bit RGBA canvas every frame is rendered onto. Modifying it changes the following frames.
+     */
+    public readonly canvas: Buffer;
+
+    private native: any;
+
+    /**
+     * The header and the structure of all chunks are checked right away, the frames are only decoded
+     * while iterating them.
+     *
+     * @param buffer The buffer of encoded APNG data. It is copied, so it may be modified afterwards.
+     * @param options Options used when decoding the frames.
+     */
+    constructor(buffer: Buffer, options?: DecodeApngOptions) {
+        if (!Buffer.isBuffer(buffer)) {
+            throw new Error("Error decoding APNG. Input is not a buffer.");
+        }
+        validateDecodeOptions(options);
+        const { trusted, limits } = options || {} as DecodeApngOptions;
+        this.native = new __native_ApngDecoder(buffer, { trusted, limits });
+        const { width, height, frameCount, plays } = this.native;
+        this.width = width;
+        this.height = height;
+        this.frameCount = frameCount;
+        this.plays = plays;
+        this.canvas = Buffer.alloc(width * height * 4);
+    }
+
+    /**
+     * Renders the frames one by one. Every iteration starts over with the first frame on a cleared canvas.
+     * Only a single frame is decoded at once, the next one is decoded when the iterator is advanced.
+     */
+    public *frames(): IterableIterator<ApngFrame> {
+        this.native.rewind();
+        while (true) {
+            const frame = this.native.next(this.canvas);
+            if (!frame) {
+                return;
+            }
+            const { index, x, y, width, height, delayNumerator, delayDenominator } = frame;
+            // A denominator of `0` is to be treated as `100`, meaning the numerator is in hundredths of a second.
+            const delay = delayNumerator * 1000 / (delayDenominator || 100);
+            yield { index, region: rect(x, y, width, height), delay, data: this.canvas };
+        }
+    }
+
+    public [Symbol.iterator]() {
+        return this.frames();
+    }
+}
+
+/**
+ * A frame to encode along with how long it is shown.
+ */
+export interface ApngInputFrame {
+    /**
+     * The raw 8 bit RGB or RGBA pixels of the frame.
+     */
+    data: Buffer;
+    /**
+     * How long the frame is shown in milliseconds. Defaults to the delay of the options.
+     */
+    delay?: number;
+}
+
+export interface EncodeApngOptions extends JobOptions {
+    /**
+     * The width of the frames in pixels.
+     */
+    width: number;
+    /**
+     * The height of the frames in pixels.
+     */
+    height: number;
+    /**
+     * How long every frame is shown in milliseconds, an integer between `0` and `65535`. Defaults to `100`.
+     */
+    delay?: number;
+    /**
+     * How often the animation is played. Defaults to `0`, which plays it forever.
+     */
+    plays?: number;
+    /**
+     * level of compression to use 0 - no compression, 1 - fastest, 9 - best size. Defaults to `9`.
+     */
+    compressionLevel?: 0 | 1 | 2 | 3 | 4 | 5 | 6 | 7 | 8 | 9;
+}
+
+export type EncodeApngCallback = (error: Error, buffer?: Buffer) => void;
+
+function isValidDelay(delay: number) {
+    return Number.isInteger(delay) && delay >= 0 && delay <= 65535;
+}
+
+/**
+ * Checks the frames and the options and starts the native job. Calls the callback with an error if they are invalid.
+ */
+function encodeFrames(frames: (Buffer | ApngInputFrame)[], options: EncodeApngOptions, callback: EncodeApngCallback) {
+    let buffers: Buffer[];
+    let delays: number[];
+    let alpha: boolean;
+    try {
+        if (!Array.isArray(frames) || frames.length === 0) {
+            throw new Error("Error encoding APNG. Frames need to be a non-empty array.");
+        }
+        if (typeof options !== "object" || options === null) {
+            throw new Error("Error encoding APNG. Options need to be an object.");
+        }
+        const { width, height, delay = 100, plays = 0, compressionLevel = 9 } = options;
+        if (!Number.isInteger(width) || !Number.isInteger(height) || width <= 0 || height <= 0) {
+            throw new Error("Error encoding APNG. Width and height need to be positive integers.");
+        }
+        if (!Number.isInteger(compressionLevel) || compressionLevel < 0 || compressionLevel > 9) {
+            throw new Error("Error encoding APNG. CompressionLevel needs to be an integer between 0 and 9.");
+        }
+        if (!Number.isInteger(plays) || plays < 0 || plays > 0x7fffffff) {
+            throw new Error("Error encoding APNG. Plays needs to be a non-negative integer.");
+        }
+        buffers = frames.map(frame => Buffer.isBuffer(frame) ? frame : frame && frame.data);
+        const frameDelay = (frame: Buffer | ApngInputFrame) =>
+            Buffer.isBuffer(frame) || !frame || frame.delay === undefined ? delay : frame.delay;
+        delays = frames.map(frameDelay);
+        if (!delays.every(isValidDelay)) {
+            throw new Error("Error encoding APNG. Delays need to be integers between 0 and 65535.");
+        }
+        const size = width * height;
+        const validSize = (buffer: Buffer) => Buffer.isBuffer(buffer) && buffer.length === buffers[0].length;
+        if (!buffers.every(validSize) || (buffers[0].length !== size * 3 && buffers[0].length !== size * 4)) {
+            throw new Error("Error encoding APNG. All frames need to be RGB or RGBA buffers of the specified size.");
+        }
+        alpha = buffers[0].length === size * 4;
+    } catch (validationError) {
+        process.nextTick(callback, validationError);
+        return;
+    }
+    const { width, height, plays = 0, compressionLevel = 9 } = options;
+    const start = (batch: boolean, done: EncodeApngCallback) => {
+        return __native_encodeApng(buffers, delays, width, height, alpha, plays, compressionLevel, batch, done);
+    };
+    scheduleJob(options, start, callback);
+}
+
+export function encodeApng(
+    frames: (Buffer | ApngInputFrame)[],
+    options: EncodeApngOptions,
+    callback: EncodeApngCallback,
+): void;
+export function encodeApng(frames: (Buffer | ApngInputFrame)[], options: EncodeApngOptions): Promise<Buffer>;
+/**
+ * Encode frames of raw pixel data as animated PNG (APNG) on a thread of the scheduler's pool.
+ * Every frame after the first one only stores the smallest rectangle containing all pixels which changed since
+ * the previous frame, so the size of the result and the time spent compressing it grow with what actually changes.
+ * The frames are compressed concurrently. The first frame is also the default image shown by decoders without
+ * support for APNG. The buffers must not be modified until the animation is encoded.
+ *
+ * @param frames The frames as buffers or objects with a buffer and their own delay. All frames need to have
+ *               the same size and the same amount of channels.
+ * @param options Options used to encode the animation and to schedule the job.
+ * @param callback An optional callback to use instead of a returned Promise. Will be called with
+ *                 an error as the first argument or `null` if everything went well, and the encoded
+ *                 animation as a second argument if no error occured.
+ * @return A Promise if no callback was provided and `undefined` otherwise.
+ */
+export function encodeApng(
+    frames: (Buffer | ApngInputFrame)[],
+    options: EncodeApngOptions,
+    callback?: EncodeApngCallback,
+): Promise<Buffer> | void {
+    // Check if the user provided a `callback`.
+    if (typeof callback === "function") {
+        encodeFrames(frames, options, callback);
+        return;
+    }
+    // If the user didn't provide a callback, return a Promise which will resolve with the animation.
+    return new Promise<Buffer>((resolve, reject) => {
+        encodeFrames(frames, options, (error, buffer) => {
+            if (error) {
+                reject(error);
+                return;
+            }
+            resolve(buffer);
+        });
+    });
+}
@@ -0,0 +1,336 @@
+import { DecodeLimits, validateDecodeOptions } from "./decode-options";
+import { __native_buildAtlas } from "./native";
+import { Rect, rect } from "./rect";
+import { JobOptions, scheduleJob } from "./scheduler";
+
+/**
+ * The algorithm placing the sprites in the atlas.
+ *
+ *  * `"maxrects"` Keeps track of all free rectangles and puts every sprite as far to the top left as possible.
+ *    Produces the smallest atlases, especially for sprites of mixed sizes.
+ *  * `"shelf"` Fills rows of sprites sorted by height. Faster, but wastes space if the sizes vary a lot.
+ */
+export type PackingAlgorithm = "maxrects" | "shelf";
+
+export interface BuildAtlasOptions extends JobOptions {
+    /**
+     * The amount of transparent pixels between the sprites and around the border of the atlas. Defaults to `0`.
+     */
+    padding?: number;
+    /**
+     * The maximum width and height of the atlas. Defaults to `4096`.
+     */
+    maxSize?: number;
+    /**
+     * The algorithm placing the sprites. Defaults to `"maxrects"`.
+     *
+     * @see PackingAlgorithm
+     */
+    pack?: PackingAlgorithm;
+    /**
+     * level of compression to use 0 - no compression, 1 - fastest, 9 - best size. Defaults to `9`.
+     */
+    compressionLevel?: 0 | 1 | 2 | 3 | 4 | 5 | 6 | 7 | 8 | 9;
+    /**
+     * Skip verifying the CRCs and the adler32 checksum of the sprites.
+     *
+     * @see DecodeOptions.trusted
+     */
+    trusted?: boolean;
+    /**
+     * Limits applied to every sprite. `maxDecodedBytes` is ignored, as the sprites are decoded into the atlas.
+     *
+     * @see DecodeLimits
+     */
+    limits?: DecodeLimits;
+}
+
+/**
+ * A sprite atlas as built by `buildAtlas`.
+ */
+export interface Atlas {
+    /**
+     * The encoded atlas, an 8 bit RGBA PNG image.
+     */
+    buffer: Buffer;
+    /**
+     * The width of the atlas in pixels.
+     */
+    width: number;
+    /**
+     * The height of the atlas in pixels.
+     */
+    height: number;
+    /**
+     * The area of every sprite in the atlas, in the order the sprites were given.
+     */
+    frames: Rect[];
+}
+
+export type BuildAtlasCallback = (error: Error, atlas?: Atlas) => void;
+
+interface Size {
+    width: number;
+    height: number;
+}
+
+interface Placement {
+    x: number;
+    y: number;
+}
+
+interface FreeRect extends Placement, Size {}
+
+/**
+ * Reads the size of a sprite from its `IHDR` chunk, which always directly follows the signature.
+ */
+function spriteSize(buffer: Buffer, index: number): Size {
+    const signature = [0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a];
+    if (
+        !Buffer.isBuffer(buffer) ||
+        buffer.length < 24 ||
+        !signature.every((byte, offset) => buffer[offset] === byte) ||
+        buffer.toString("latin1", 12, 16) !== "IHDR"
+    ) {
+        throw new Error(`Error building atlas. Sprite ${index} is not a PNG image.`);
+    }
+    const width = buffer.readUInt32BE(16);
+    const height = buffer.readUInt32BE(20);
+    if (width === 0 || height === 0) {
+        throw new Error(`Error building atlas. Sprite ${index} is empty.`);
+    }
+    return { width, height };
+}
+
+/**
+ * Places the sprites in rows, starting a new row whenever a sprite doesn't fit into the current one.
+ * Returns `undefined` if the sprites don't fit.
+ */
+function packShelves(sizes: Size[], order: number[], binWidth: number, binHeight: number): Placement[] {
+    const placements: Placement[] = [];
+    let x = 0;
+    let y = 0;
+    let shelfHeight = 0;
+    for (const index of order) {
+        const { width, height } = sizes[index];
+        if (x + width > binWidth) {
+            y += shelfHeight;
+            x = 0;
+            shelfHeight = 0;
+        }
+        if (y + height > binHeight) {
+            return;
+        }
+        placements[index] = { x, y };
+        x += width;
+        shelfHeight = Math.max(shelfHeight, height);
+    }
+    return placements;
+}
+
+function contains(outer: FreeRect, inner: FreeRect) {
+    return inner.x >= outer.x && inner.y >= outer.y &&
+        inner.x + inner.width <= outer.x + outer.width && inner.y + inner.height <= outer.y + outer.height;
+}
+
+/**
+ * Splits all free rectangles overlapping the used rectangle into the up to four maximal rectangles around it.
+ */
+function splitFreeRects(free: FreeRect[], used: FreeRect): FreeRect[] {
+    const kept: FreeRect[] = [];
+    const pieces: FreeRect[] = [];
+    for (const rectangle of free) {
+        const overlaps = used.x < rectangle.x + rectangle.width && used.x + used.width > rectangle.x &&
+            used.y < rectangle.y + rectangle.height && used.y + used.height > rectangle.y;
+        if (!overlaps) {
+            kept.push(rectangle);
+            continue;
+        }
+        const right = rectangle.x + rectangle.width;
+        const bottom = rectangle.y + rectangle.height;
+        if (used.x > rectangle.x) {
+            pieces.push({ ...rectangle, width: used.x - rectangle.x });
+        }
+        if (used.x + used.width < right) {
+            pieces.push({ ...rectangle, x: used.x + used.width, width: right - used.x - used.width });
+        }
+        if (used.y > rectangle.y) {
+            pieces.push({ ...rectangle, height: used.y - rectangle.y });
+        }
+        if (used.y + used.height < bottom) {
+            pieces.push({ ...rectangle, y: used.y + used.height, height: bottom - used.y - used.height });
+        }
+    }
+    // The kept rectangles didn't contain each other before, so only the new pieces can be redundant:
+    // If they repeat an earlier piece or are contained in another rectangle.
+    const isRepeated = (piece: FreeRect, index: number) => {
+        return pieces.findIndex(other => contains(other, piece) && contains(piece, other)) !== index;
+    };
+    const isContained = (piece: FreeRect) => {
+        return kept.some(other => contains(other, piece)) ||
+            pieces.some(other => contains(other, piece) && !contains(piece, other));
+    };
+    return kept.concat(pieces.filter((piece, index) => !isRepeated(piece, index) && !isContained(piece)));
+}
+
+/**
+ * Places every sprite in the free rectangle in which its bottom edge ends up highest, then leftmost
+ * (MaxRects with the bottom-left rule). Returns `undefined` if the sprites don't fit.
+ */
+function packMaxRects(sizes: Size[], order: number[], binWidth: number, binHeight: number): Placement[] {
+    const placements: Placement[] = [];
+    let free: FreeRect[] = [{ x: 0, y: 0, width: binWidth, height: binHeight }];
+    for (const index of order) {
+        const { width, height } = sizes[index];
+        let best: FreeRect;
+        for (const rectangle of free) {
+            if (rectangle.width < width || rectangle.height < height) {
+                continue;
+            }
+            if (!best || rectangle.y < best.y || (rectangle.y === best.y && rectangle.x < best.x)) {
+                best = rectangle;
+            }
+        }
+        if (!best) {
+            return;
+        }
+        placements[index] = { x: best.x, y: best.y };
+        free = splitFreeRects(free, { x: best.x, y: best.y, width, height });
+    }
+    return placements;
+}
+
+/**
+ * Computes the slot of every sprite. Tries several widths of the atlas and picks the packing with the smallest area.
+ */
+function packSprites(sprites: Size[], padding: number, maxSize: number, pack: PackingAlgorithm) {
+    // Every sprite occupies the padding to its right and below it, the padding to the top and left of the atlas
+    // is added afterwards.
+    const sizes = sprites.map(({ width, height }) => ({ width: width + padding, height: height + padding }));
+    const area = sizes.reduce((sum, { width, height }) => sum + width * height, 0);
+    const widest = Math.max(...sizes.map(({ width }) => width));
+    const bin = maxSize - padding;
+    // Larger sprites first, which leaves the gaps to the smaller ones.
+    const order = sizes.map((_, index) => index);
+    if (pack === "shelf") {
+        order.sort((a, b) => sizes[b].height - sizes[a].height || sizes[b].width - sizes[a].width);
+    } else {
+        order.sort((a, b) => {
+            return Math.max(sizes[b].width, sizes[b].height) - Math.max(sizes[a].width, sizes[a].height) ||
+                sizes[b].width * sizes[b].height - sizes[a].width * sizes[a].height;
+        });
+    }
+    const packer = pack === "shelf" ? packShelves : packMaxRects;
+    const minWidth = Math.max(widest, Math.ceil(Math.sqrt(area)));
+    let best: { placements: Placement[], width: number, height: number };
+    for (let step = 0; step <= 4; ++step) {
+        const binWidth = Math.min(bin, Math.ceil(minWidth * (1 + step / 4)));
+        const placements = binWidth >= widest ? packer(sizes, order, binWidth, bin) : undefined;
+        if (!placements) {
+            continue;
+        }
+        const width = Math.max(...placements.map(({ x }, index) => x + sizes[index].width)) + padding;
+        const height = Math.max(...placements.map(({ y }, index) => y + sizes[index].height)) + padding;
+        if (!best || width * height < best.width * best.height) {
+            best = { placements, width, height };
+        }
+    }
+    if (!best) {
+        throw new Error(`Error building atlas. The sprites don't fit into an atlas of ${maxSize}x${maxSize} pixels.`);
+    }
+    const frames = best.placements.map(({ x, y }, index) => {
+        return rect(x + padding, y + padding, sprites[index].width, sprites[index].height);
+    });
+    return { frames, width: best.width, height: best.height };
+}
+
+/**
+ * Checks the options, packs the sprites and starts the native job.
+ * Calls the callback with an error if the options are invalid or the sprites don't fit.
+ */
+function buildAtlasFromBuffers(buffers: Buffer[], options: BuildAtlasOptions, callback: BuildAtlasCallback) {
+    let packing: { frames: Rect[], width: number, height: number };
+    try {
+        if (!Array.isArray(buffers) || buffers.length === 0) {
+            throw new Error("Error building atlas. Sprites need to be a non-empty array of buffers.");
+        }
+        if (typeof options !== "object" || options === null) {
+            throw new Error("Error building atlas. Options need to be an object.");
+        }
+        const { padding = 0, maxSize = 4096, pack = "maxrects", compressionLevel = 9 } = options;
+        if (!Number.isInteger(padding) || padding < 0) {
+            throw new Error("Error building atlas. Padding needs to be a non-negative integer.");
+        }
+        if (!Number.isInteger(maxSize) || maxSize < 1 || maxSize > 1000000) {
+            throw new Error("Error building atlas. The maximum size needs to be an integer between 1 and 1000000.");
+        }
+        if (pack !== "maxrects" && pack !== "shelf") {
+            throw new Error("Error building atlas. Packing needs to be either \"maxrects\" or \"shelf\".");
+        }
+        if (!Number.isInteger(compressionLevel) || compressionLevel < 0 || compressionLevel > 9) {
+            throw new Error("Error building atlas. CompressionLevel needs to be an integer between 0 and 9.");
+        }
+        validateDecodeOptions({ trusted: options.trusted, limits: options.limits });
+        packing = packSprites(buffers.map(spriteSize), padding, maxSize, pack);
+    } catch (validationError) {
+        process.nextTick(callback, validationError);
+        return;
+    }
+    const { frames, width, height } = packing;
+    const { compressionLevel = 9, trusted, limits } = options;
+    const slots: number[] = [];
+    frames.forEach(frame => slots.push(...frame));
+    const start = (batch: boolean, done: (error: Error, buffer?: Buffer) => void) => {
+        // The copy of the array keeps the sprites alive while the job runs, even if the caller modifies it.
+        const sprites = [...buffers];
+        return __native_buildAtlas(sprites, slots, width, height, { trusted, limits }, compressionLevel, batch, done);
+    };
+    scheduleJob(options, start, (error: Error, buffer?: Buffer) => {
+        if (error) {
+            callback(error);
+            return;
+        }
+        callback(null, { buffer, width, height, frames });
+    });
+}
+
+export function buildAtlas(buffers: Buffer[], callback: BuildAtlasCallback): void;
+export function buildAtlas(buffers: Buffer[], options: BuildAtlasOptions, callback: BuildAtlasCallback): void;
+export function buildAtlas(buffers: Buffer[], options?: BuildAtlasOptions): Promise<Atlas>;
+/**
+ * Build a sprite atlas from many encoded PNG images. The sprites are packed using the sizes from their headers,
+ * then decoded in parallel straight into their slots of the atlas and the atlas is encoded, all in one job
+ * on the scheduler's pool. No intermediate image is created per sprite.
+ * The sprites are converted to 8 bit RGBA. The buffers must not be modified until the atlas was built.
+ *
+ * @param buffers The encoded sprites.
+ * @param options Optional options controlling the packing, the compression and how the job is scheduled.
+ * @param callback An optional callback to use instead of a returned Promise. Will be called with
+ *                 an error as the first argument or `null` if everything went well, and the atlas
+ *                 as a second argument if no error occured.
+ * @return A Promise if no callback was provided and `undefined` otherwise.
+ */
+export function buildAtlas(
+    buffers: Buffer[],
+    optionsOrCallback?: BuildAtlasOptions | BuildAtlasCallback,
+    maybeCallback?: BuildAtlasCallback,
+): Promise<Atlas> | void {
+    const options = typeof optionsOrCallback === "function" || optionsOrCallback === undefined ?
+        {} : optionsOrCallback;
+    const callback = typeof optionsOrCallback === "function" ? optionsOrCallback : maybeCallback;
+    // Check if the user provided a `callback`.
+    if (typeof callback === "function") {
+        buildAtlasFromBuffers(buffers, options, callback);
+        return;
+    }
+    // If the user didn't provide a callback, return a Promise which will resolve with the atlas.
+    return new Promise<Atlas>((resolve, reject) => {
+        buildAtlasFromBuffers(buffers, options, (error, atlas) => {
+            if (error) {
+                reject(error);
+                return;
+            }
+            resolve(atlas);
+        });
+    });
+}
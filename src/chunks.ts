@@ -0,0 +1,201 @@
+import { __native_readChunks, __native_rewriteChunks } from "./native";
+
+/**
+ * A chunk of an encoded PNG image.
+ */
+export interface Chunk {
+    /**
+     * The four letter type of the chunk, such as `"IHDR"` or `"tEXt"`.
+     */
+    type: string;
+    /**
+     * The data of the chunk, without its length, type and CRC.
+     */
+    data: Buffer;
+    /**
+     * The offset of the chunk inside the encoded image. Only set for chunks returned by `readChunks`.
+     */
+    offset?: number;
+}
+
+export interface RewriteChunksOptions {
+    /**
+     * The types of the chunks to remove, such as `["tEXt", "zTXt", "iTXt", "tIME"]` to strip the metadata.
+     */
+    remove?: string[];
+    /**
+     * Chunks replacing all existing chunks of the same type. The first existing chunk is replaced in place
+     * and all others are removed. If no chunk of the type exists, the chunk is added.
+     */
+    replace?: Chunk[];
+    /**
+     * Chunks to add. Chunks which need to appear before the palette are added before `PLTE`,
+     * all others right before the image data.
+     */
+    add?: Chunk[];
+}
+
+/**
+ * Split an encoded PNG image into its chunks, without decoding it. The data of each chunk is a slice of
+ * `buffer` and not a copy. The CRCs are not checked, use `verify` to check them.
+ *
+ * @param buffer The buffer of encoded PNG data.
+ *
+ * @return All chunks up to and including `IEND`, in the order they appear in the image.
+ */
+export function readChunks(buffer: Buffer): Chunk[] {
+    if (!Buffer.isBuffer(buffer)) {
+        throw new Error("Error reading chunks. Input is not a buffer.");
+    }
+    // The native side only locates the chunks. Their data starts after the length and the type.
+    return __native_readChunks(buffer).map(({ type, offset, length }: any) => ({
+        type,
+        data: buffer.slice(offset + 8, offset + 8 + length),
+        offset,
+    }));
+}
+
+/**
+ * Checks that only ancillary chunks are touched. Critical chunks describe the image data and can't be
+ * changed without decoding it.
+ */
+function validateChunkType(type: string) {
+    if (typeof type !== "string" || !/^[A-Za-z]{4}$/.test(type)) {
+        throw new Error("Error rewriting chunks. Chunk types need to consist of four letters.");
+    }
+    if (type[0] === type[0].toUpperCase()) {
+        throw new Error("Error rewriting chunks. Only ancillary chunks can be removed, replaced or added.");
+    }
+}
+
+function validateChunks(chunks: Chunk[]) {
+    if (!Array.isArray(chunks)) {
+        throw new Error("Error rewriting chunks. Chunks need to be an array.");
+    }
+    chunks.forEach(chunk => {
+        if (typeof chunk !== "object" || chunk === null || !Buffer.isBuffer(chunk.data)) {
+            throw new Error("Error rewriting chunks. Chunk data needs to be a buffer.");
+        }
+        validateChunkType(chunk.type);
+    });
+}
+
+/**
+ * Remove, replace and add ancillary chunks of an encoded PNG image without decoding it. All chunks which are
+ * not touched, including the image data, are copied as they are and only the CRCs of new chunks are computed.
+ *
+ * @param buffer The buffer of encoded PNG data.
+ * @param options The chunks to remove, replace and add.
+ *
+ * @return A new buffer with the rewritten image.
+ */
+export function rewriteChunks(buffer: Buffer, options: RewriteChunksOptions): Buffer {
+    if (!Buffer.isBuffer(buffer)) {
+        throw new Error("Error rewriting chunks. Input is not a buffer.");
+    }
+    if (typeof options !== "object" || options === null) {
+        throw new Error("Error rewriting chunks. Options need to be an object.");
+    }
+    const { remove = [], replace = [], add = [] } = options;
+    if (!Array.isArray(remove)) {
+        throw new Error("Error rewriting chunks. Chunk types need to be an array.");
+    }
+    remove.forEach(validateChunkType);
+    validateChunks(replace);
+    validateChunks(add);
+    return __native_rewriteChunks(buffer, remove, replace, add);
+}
+
+/**
+ * Encodes a keyword of a text chunk. Keywords are Latin-1 text of 1 to 79 characters.
+ */
+function keywordBuffer(keyword: string): Buffer {
+    if (typeof keyword !== "string" || keyword.length < 1 || keyword.length > 79) {
+        throw new Error("Keyword needs to be between 1 and 79 characters long.");
+    }
+    return Buffer.from(keyword, "latin1");
+}
+
+/**
+ * Create a `tEXt` chunk with Latin-1 text.
+ *
+ * @param keyword The keyword, for example `"Title"`, `"Author"` or `"Description"`.
+ * @param text The text.
+ */
+export function textChunk(keyword: string, text: string): Chunk {
+    const data = Buffer.concat([keywordBuffer(keyword), Buffer.from([0]), Buffer.from(text, "latin1")]);
+    return { type: "tEXt", data };
+}
+
+/**
+ * Create an uncompressed `iTXt` chunk with UTF-8 text.
+ *
+ * @param keyword The keyword, for example `"Title"`, `"Author"` or `"Description"`.
+ * @param text The text.
+ * @param language An optional language tag, such as `"en"`.
+ */
+export function internationalTextChunk(keyword: string, text: string, language = ""): Chunk {
+    return {
+        type: "iTXt",
+        data: Buffer.concat([
+            keywordBuffer(keyword),
+            // Null separator, compression flag and compression method.
+            Buffer.from([0, 0, 0]),
+            Buffer.from(language, "latin1"),
+            // Null separators after the language and the (empty) translated keyword.
+            Buffer.from([0, 0]),
+            Buffer.from(text, "utf8"),
+        ]),
+    };
+}
+
+/**
+ * Create a `pHYs` chunk specifying the resolution of the image.
+ *
+ * @param dpi The resolution in dots per inch, used for both axes.
+ */
+export function resolutionChunk(dpi: number): Chunk {
+    if (typeof dpi !== "number" || !(dpi > 0)) {
+        throw new Error("Resolution needs to be a positive number.");
+    }
+    // PNG stores the resolution in pixels per meter.
+    const pixelsPerMeter = Math.round(dpi / 0.0254);
+    const data = Buffer.alloc(9);
+    data.writeUInt32BE(pixelsPerMeter, 0);
+    data.writeUInt32BE(pixelsPerMeter, 4);
+    data.writeUInt8(1, 8);
+    return { type: "pHYs", data };
+}
+
+/**
+ * Create a `tIME` chunk specifying when the image was last modified.
+ *
+ * @param time The time of the last modification.
+ */
+export function timeChunk(time: Date): Chunk {
+    if (!(time instanceof Date) || isNaN(time.getTime())) {
+        throw new Error("Time needs to be a valid date.");
+    }
+    const data = Buffer.alloc(7);
+    data.writeUInt16BE(time.getUTCFullYear(), 0);
+    data.writeUInt8(time.getUTCMonth() + 1, 2);
+    data.writeUInt8(time.getUTCDate(), 3);
+    data.writeUInt8(time.getUTCHours(), 4);
+    data.writeUInt8(time.getUTCMinutes(), 5);
+    data.writeUInt8(time.getUTCSeconds(), 6);
+    return { type: "tIME", data };
+}
+
+/**
+ * Create a `gAMA` chunk specifying the gamma the image was encoded with.
+ *
+ * @param gamma The gamma, for example `1 / 2.2`.
+ */
+export function gammaChunk(gamma: number): Chunk {
+    if (typeof gamma !== "number" || !(gamma > 0)) {
+        throw new Error("Gamma needs to be a positive number.");
+    }
+    const data = Buffer.alloc(4);
+    data.writeUInt32BE(Math.round(gamma * 100000), 0);
+    return { type: "gAMA", data };
+}
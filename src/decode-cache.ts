@@ -0,0 +1,221 @@
+import { stat, statSync, Stats } from "fs";
+import { __native_bufferHash } from "./native";
+import { PngImage } from "./png-image";
+import { DecodeOptions, validateDecodeOptions } from "./decode-options";
+import { decodeFile, decodeFileSync } from "./decode";
+
+export interface DecodeCacheOptions {
+    /**
+     * The maximum amount of bytes of decoded pixel data to keep. When exceeded, the least recently used
+     * images are evicted. Images larger than this are never cached. Defaults to 64 MiB.
+     */
+    maxBytes?: number;
+}
+
+/**
+ * Statistics about the usage of a `DecodeCache`.
+ */
+export interface DecodeCacheStats {
+    /**
+     * How often an image could be served from the cache.
+     */
+    hits: number;
+    /**
+     * How often an image had to be decoded.
+     */
+    misses: number;
+    /**
+     * How many images were removed from the cache to stay within the budget.
+     */
+    evictions: number;
+    /**
+     * The amount of images currently in the cache.
+     */
+    entries: number;
+    /**
+     * The amount of bytes of decoded pixel data currently in the cache.
+     */
+    bytes: number;
+}
+
+/**
+ * Caches decoded images in memory, keyed by a hash of the encoded data or by a file's path and modification time.
+ * Useful if the same images are decoded over and over again. Cached images are never handed out directly:
+ * Every hit returns a copy of the decoded image, so modifying it doesn't affect the cache. The copy shares
+ * the pixels with the cache until its `data` is accessed or it is modified, so hits which are only read through
+ * the image's methods, encoded or copied from don't copy any pixels (see `PngImage.lazyClone`).
+ * Hits for files are served without reading or decoding the file.
+ *
+ * A cache can be passed to `decode`, `readPngFile` and `readPngFileSync` using the `cache` option.
+ */
+export class DecodeCache {
+    private maxBytes: number;
+    // Maps keys to images. A `Map` iterates in insertion order, so the first entry is the least recently used one.
+    private entries = new Map<string, PngImage>();
+    private bytes = 0;
+    private hits = 0;
+    private misses = 0;
+    private evictions = 0;
+
+    constructor(options: DecodeCacheOptions = {}) {
+        if (typeof options !== "object" || options === null) {
+            throw new Error("Options need to be an object.");
+        }
+        const { maxBytes = 64 * 1024 * 1024 } = options;
+        if (!Number.isInteger(maxBytes) || maxBytes < 0) {
+            throw new Error("Maximum amount of bytes needs to be a non-negative integer.");
+        }
+        this.maxBytes = maxBytes;
+    }
+
+    /**
+     * Statistics about the usage of this cache.
+     */
+    public get stats(): DecodeCacheStats {
+        const { hits, misses, evictions, bytes } = this;
+        return { hits, misses, evictions, bytes, entries: this.entries.size };
+    }
+
+    /**
+     * Decode a buffer, or return a copy of the image decoded earlier from a buffer with the same content and options.
+     *
+     * @see decode
+     */
+    public decode(buffer: Buffer, options?: DecodeOptions): PngImage {
+        if (!Buffer.isBuffer(buffer)) {
+            throw new Error("Error decoding PNG. Input is not a buffer.");
+        }
+        validateDecodeOptions(options);
+        const key = `buffer:${__native_bufferHash(buffer)}:${buffer.length}:${optionsKey(options)}`;
+        return this.lookup(key, () => new PngImage(buffer, options));
+    }
+
+    /**
+     * Read and decode a PNG file, or return a copy of the image decoded earlier from the same file
+     * if it was not modified since.
+     *
+     * @see readPngFile
+     */
+    public readPngFile(path: string, options?: DecodeOptions): Promise<PngImage> {
+        return new Promise((resolve, reject) => {
+            stat(path, (statError: Error, stats: Stats) => {
+                if (statError) {
+                    reject(statError);
+                    return;
+                }
+                const key = fileKey(path, stats, options);
+                const cached = this.get(key);
+                if (cached) {
+                    resolve(cached);
+                    return;
+                }
+                decodeFile(path, options, (error: Error, pngImage?: PngImage) => {
+                    if (error) {
+                        reject(error);
+                        return;
+                    }
+                    resolve(this.set(key, pngImage) ? pngImage.lazyClone() : pngImage);
+                });
+            });
+        });
+    }
+
+    /**
+     * Read and decode a PNG file synchroneously, or return a copy of the image decoded earlier from the same file
+     * if it was not modified since.
+     *
+     * @see readPngFileSync
+     */
+    public readPngFileSync(path: string, options?: DecodeOptions): PngImage {
+        const key = fileKey(path, statSync(path), options);
+        return this.lookup(key, () => decodeFileSync(path, options));
+    }
+
+    /**
+     * Remove all images from the cache. The statistics are kept.
+     */
+    public clear() {
+        this.entries.clear();
+        this.bytes = 0;
+    }
+
+    /**
+     * Returns a copy of the cached image for the key, or calls `decode` and caches its result on a miss.
+     * The copies share their pixels with the cache until they are modified.
+     */
+    private lookup(key: string, decode: () => PngImage): PngImage {
+        const cached = this.get(key);
+        if (cached) {
+            return cached;
+        }
+        const image = decode();
+        return this.set(key, image) ? image.lazyClone() : image;
+    }
+
+    /**
+     * Returns a copy of the cached image for the key and marks it as recently used, or counts a miss.
+     */
+    private get(key: string): PngImage {
+        const image = this.entries.get(key);
+        if (!image) {
+            this.misses++;
+            return;
+        }
+        this.hits++;
+        this.entries.delete(key);
+        this.entries.set(key, image);
+        return image.lazyClone();
+    }
+
+    /**
+     * Adds an image to the cache and evicts the least recently used images until the budget is met.
+     * Returns `false` if the image is too large to be cached.
+     */
+    private set(key: string, image: PngImage): boolean {
+        const size = imageSize(image);
+        if (size > this.maxBytes) {
+            return false;
+        }
+        const existing = this.entries.get(key);
+        if (existing) {
+            this.entries.delete(key);
+            this.bytes -= imageSize(existing);
+        }
+        this.entries.set(key, image);
+        this.bytes += size;
+        for (const [oldestKey, oldest] of this.entries) {
+            if (this.bytes <= this.maxBytes) {
+                break;
+            }
+            this.entries.delete(oldestKey);
+            this.bytes -= imageSize(oldest);
+            this.evictions++;
+        }
+        return true;
+    }
+}
+
+/**
+ * Returns the amount of bytes of pixel data of a cached image. Accessing its `data` would copy the shared pixels.
+ */
+function imageSize(image: PngImage): number {
+    return image.rowBytes * image.height;
+}
+
+/**
+ * Returns the part of a cache key describing the decode options which influence the decoded image or whether
+ * it is decoded at all.
+ */
+function optionsKey(options: DecodeOptions = {}): string {
+    const { output = "native", premultiplied = false, linear = false, trusted = false, limits = {} } = options;
+    const { maxWidth, maxHeight, maxChunks, maxChunkBytes, maxDecodedBytes } = limits;
+    const limitsKey = `${maxWidth}:${maxHeight}:${maxChunks}:${maxChunkBytes}:${maxDecodedBytes}`;
+    return `${output}:${Boolean(premultiplied)}:${Boolean(linear)}:${Boolean(trusted)}:${limitsKey}`;
+}
+
+/**
+ * Returns the cache key for a file, which changes whenever the file is modified.
+ */
+function fileKey(path: string, stats: Stats, options: DecodeOptions): string {
+    return `file:${stats.dev}:${stats.ino}:${stats.size}:${stats.mtime.getTime()}:${path}:${optionsKey(options)}`;
+}
@@ -0,0 +1,118 @@
+import { DecodeCache } from "./decode-cache";
+
+/**
+ * The pixel format into which an image is normalized while decoding.
+ *
+ *  * `"native"` Keep the image's own color type and bit depth (default).
+ *  * `"rgba8"` 8 bit RGBA. Palettes and `tRNS` chunks are expanded, an opaque alpha channel is added if necessary.
+ *  * `"rgb8"` 8 bit RGB. Palettes are expanded, alpha channels are stripped.
+ *  * `"gray8"` 8 bit gray-scale. Colors are reduced to their luminance, alpha channels are stripped.
+ */
+export type DecodeOutput = "native" | "rgba8" | "rgb8" | "gray8";
+
+/**
+ * Limits rejecting images which would take too many resources to decode, such as decompression bombs
+ * in user uploads. All limits are optional and need to be positive integers.
+ */
+export interface DecodeLimits {
+    /**
+     * The maximum width of the image in pixels. Checked when reading the header, before any image data
+     * is inflated. Defaults to libpng's limit of `1000000`.
+     */
+    maxWidth?: number;
+    /**
+     * The maximum height of the image in pixels. Checked when reading the header, before any image data
+     * is inflated. Defaults to libpng's limit of `1000000`.
+     */
+    maxHeight?: number;
+    /**
+     * The maximum amount of ancillary chunks such as text chunks or unknown chunks which are stored while
+     * decoding. Defaults to libpng's limit of `1000`.
+     */
+    maxChunks?: number;
+    /**
+     * The maximum amount of bytes which may be allocated for a single chunk, including inflated text chunks.
+     * Defaults to libpng's limit of `8000000`.
+     */
+    maxChunkBytes?: number;
+    /**
+     * The maximum size of the decoded image in bytes, after the output format has been applied.
+     * Checked before the memory for the image is allocated. Unlimited by default.
+     */
+    maxDecodedBytes?: number;
+}
+
+export interface DecodeOptions {
+    /**
+     * The pixel format to normalize the image into. The transformation is applied by libpng while
+     * reading the rows, so no additional pass over the decoded image is necessary.
+     *
+     * @see DecodeOutput
+     */
+    output?: DecodeOutput;
+    /**
+     * Multiply the color samples with the alpha channel, as expected by most GPU compositors.
+     * Unless `linear` is specified as well, the samples are premultiplied in their gamma encoded space.
+     * Images decoded this way are divided by their alpha again when encoded.
+     */
+    premultiplied?: boolean;
+    /**
+     * Convert the color samples into linear light. The image's gamma (`gAMA` chunk) is used, images without
+     * gamma information are assumed to be sRGB encoded. Alpha is left untouched unless `premultiplied`
+     * is specified as well, in which case the linear samples are premultiplied.
+     * Consider keeping 16 bit samples when linearizing to avoid banding.
+     */
+    linear?: boolean;
+    /**
+     * Skip verifying the CRCs of all chunks and the adler32 checksum of the compressed image data.
+     * Only use this for input which has already been verified, such as assets shipped with the application.
+     * Corrupted images will be decoded into corrupted pixels instead of raising an error.
+     */
+    trusted?: boolean;
+    /**
+     * Limits rejecting images which would take too many resources to decode. Use this for untrusted input.
+     *
+     * @see DecodeLimits
+     */
+    limits?: DecodeLimits;
+    /**
+     * A cache to look the decoded image up in, and to store it in after decoding.
+     * Only supported by `decode`, `readPngFile` and `readPngFileSync`.
+     *
+     * @see DecodeCache
+     */
+    cache?: DecodeCache;
+}
+
+const decodeOutputs = ["native", "rgba8", "rgb8", "gray8"];
+
+const decodeLimits = ["maxWidth", "maxHeight", "maxChunks", "maxChunkBytes", "maxDecodedBytes"];
+
+/**
+ * Checks the decode options for validity. Will throw an error if they are invalid.
+ *
+ * @param options The options to check.
+ */
+export function validateDecodeOptions(options: DecodeOptions) {
+    if (typeof options === "undefined") { return; }
+    if (typeof options !== "object" || options === null) {
+        throw new Error("Error decoding PNG. Options need to be an object.");
+    }
+    const { output } = options;
+    if (typeof output !== "undefined" && decodeOutputs.indexOf(output) === -1) {
+        throw new Error("Error decoding PNG. Unsupported output format.");
+    }
+    const { limits } = options;
+    if (typeof limits === "undefined") { return; }
+    if (typeof limits !== "object" || limits === null) {
+        throw new Error("Error decoding PNG. Limits need to be an object.");
+    }
+    decodeLimits.forEach(name => {
+        const limit = (limits as any)[name];
+        if (typeof limit === "undefined") { return; }
+        const maximum = name === "maxDecodedBytes" ? Number.MAX_SAFE_INTEGER : 0x7fffffff;
+        if (!Number.isInteger(limit) || limit <= 0 || limit > maximum) {
+            throw new Error(`Error decoding PNG. The ${name} limit needs to be a positive integer.`);
+        }
+    });
+}
@@ -0,0 +1,129 @@
+import { __native_decodeTensor } from "./native";
+
+/**
+ * The memory layout of a tensor.
+ *
+ *  * `"nchw"` One contiguous plane per channel (batch, channels, height, width).
+ *  * `"nhwc"` Interleaved channels per pixel (batch, height, width, channels).
+ */
+export type TensorLayout = "nchw" | "nhwc";
+
+/**
+ * The data type of the samples of a tensor.
+ *
+ *  * `"float32"` Samples are normalized to `[0, 1]`, then `mean` is subtracted and the result is divided by `std`.
+ *  * `"uint8"` Samples are stored as they are. `mean` and `std` are ignored.
+ */
+export type TensorDataType = "float32" | "uint8";
+
+export interface DecodeTensorOptions {
+    /**
+     * The memory layout of the tensor. Defaults to `"nchw"`.
+     */
+    layout?: TensorLayout;
+    /**
+     * The data type of the samples. Defaults to `"float32"`.
+     */
+    dtype?: TensorDataType;
+    /**
+     * The amount of channels: `1` for gray-scale, `3` for RGB and `4` for RGBA. Images are converted
+     * while decoding. Defaults to `3`.
+     */
+    channels?: 1 | 3 | 4;
+    /**
+     * The mean to subtract from the normalized samples, per channel. Defaults to `0` for every channel.
+     */
+    mean?: number[];
+    /**
+     * The standard deviation to divide the normalized samples by, per channel. Defaults to `1` for every channel.
+     */
+    std?: number[];
+}
+
+/**
+ * A decoded batch of images.
+ */
+export interface Tensor {
+    /**
+     * The samples of all images in one contiguous array.
+     */
+    data: Float32Array | Uint8Array;
+    /**
+     * The dimensions of the tensor in the order of its layout, for example `[batch, channels, height, width]`
+     * for `"nchw"`.
+     */
+    shape: number[];
+    /**
+     * The memory layout of the tensor.
+     */
+    layout: TensorLayout;
+    /**
+     * The data type of the samples.
+     */
+    dtype: TensorDataType;
+}
+
+/**
+ * Decode multiple PNG images of the same dimensions into a single contiguous tensor, as used as input for
+ * machine learning models. Each row is converted into the target layout and data type right after libpng
+ * decoded it, so no intermediate image is created.
+ *
+ * @param buffers The buffers of encoded PNG data to decode. All images need to have the same dimensions.
+ * @param options Options describing the layout, data type and normalization of the tensor.
+ *
+ * @return The decoded tensor.
+ */
+export function decodeTensorBatch(buffers: Buffer[], options: DecodeTensorOptions = {}): Tensor {
+    if (!Array.isArray(buffers) || buffers.length === 0) {
+        throw new Error("Error decoding PNG. Input needs to be a non-empty array of buffers.");
+    }
+    if (buffers.some(buffer => !Buffer.isBuffer(buffer))) {
+        throw new Error("Error decoding PNG. Input is not a buffer.");
+    }
+    if (typeof options !== "object" || options === null) {
+        throw new Error("Error decoding PNG. Options need to be an object.");
+    }
+    const { layout = "nchw", dtype = "float32", channels = 3 } = options;
+    const { mean = new Array(channels).fill(0), std = new Array(channels).fill(1) } = options;
+    if (layout !== "nchw" && layout !== "nhwc") {
+        throw new Error("Error decoding PNG. Unsupported tensor layout.");
+    }
+    if (dtype !== "float32" && dtype !== "uint8") {
+        throw new Error("Error decoding PNG. Unsupported tensor data type.");
+    }
+    if (channels !== 1 && channels !== 3 && channels !== 4) {
+        throw new Error("Error decoding PNG. Channels need to be 1, 3 or 4.");
+    }
+    if (!Array.isArray(mean) || mean.length !== channels || !Array.isArray(std) || std.length !== channels) {
+        throw new Error("Error decoding PNG. Mean and standard deviation need to be specified for every channel.");
+    }
+    if (std.some(value => value === 0)) {
+        throw new Error("Error decoding PNG. Standard deviation must not be zero.");
+    }
+    const floating = dtype === "float32";
+    const { data, width, height } = __native_decodeTensor(buffers, layout === "nchw", floating, channels, mean, std);
+    const count = buffers.length;
+    return {
+        data: floating
+            ? new Float32Array(data.buffer, data.byteOffset, data.length / 4)
+            : new Uint8Array(data.buffer, data.byteOffset, data.length),
+        shape: layout === "nchw" ? [count, channels, height, width] : [count, height, width, channels],
+        layout,
+        dtype,
+    };
+}
+
+/**
+ * Decode a PNG image into a tensor, as used as input for machine learning models.
+ * The tensor has a batch dimension of `1`.
+ *
+ * @see decodeTensorBatch
+ *
+ * @param buffer The buffer of encoded PNG data to decode.
+ * @param options Options describing the layout, data type and normalization of the tensor.
+ *
+ * @return The decoded tensor.
+ */
+export function decodeTensor(buffer: Buffer, options?: DecodeTensorOptions): Tensor {
+    return decodeTensorBatch([buffer], options);
+}
@@ -1,84 +1,129 @@
-import { readFile, readFileSync } from "fs";
-import { PngImage } from "./png-image";
+import { PngImage, wrapNativePngImage } from "./png-image";
+import { DecodeOptions, validateDecodeOptions } from "./decode-options";
+import { __native_readPngFile, __native_readPngFileSync } from "./native";
+import { JobOptions, scheduleJob } from "./scheduler";
 
 /**
  * Decode a buffer of encoded PNG data into a `PngImage` offering access to the raw image data.
  *
  * @param buffer The buffer to convert.
+ * @param options Options used when decoding, such as the pixel format to normalize the image into.
  *
  * @return the decoded PNG as a `PngImage` instance.
  */
-export function decode(buffer: Buffer): PngImage {
-    return new PngImage(buffer);
+export function decode(buffer: Buffer, options?: DecodeOptions): PngImage {
+    if (options && options.cache) {
+        return options.cache.decode(buffer, options);
+    }
+    return new PngImage(buffer, options);
 }
 
 export type ReadPngFileCallback = (error: Error, pngImage?: PngImage) => void;
 
+export type ReadPngFileOptions = DecodeOptions & JobOptions;
+
 export function readPngFile(path: string, callback: ReadPngFileCallback): void;
-export function readPngFile(path: string): Promise<PngImage>;
+export function readPngFile(path: string, options: ReadPngFileOptions, callback: ReadPngFileCallback): void;
+export function readPngFile(path: string, options?: ReadPngFileOptions): Promise<PngImage>;
 /**
  * Invoke `readPngFile` to asynchroneously read a png file into a decoded image.
  * For convenience, both Node.js callbacks and Promises are supported.
- * If no callback is provided as a second argument, a Promise is returned which will resolve
+ * If no callback is provided as the last argument, a Promise is returned which will resolve
  * with the decoded image.
  *
  * @param path The path to the file to decode.
+ * @param options Optional options used when decoding the image and scheduling the job.
  * @param callback An optional callback to use instead of a returned Promise. Will be called with
  *                 an error as the first argument or `null` if everything went well, and the decoded
  *                 image as a second argument if no error occured.
  * @return A Promise if no callback was provided and `undefined` otherwise.
  */
-export function readPngFile(path: string, callback?: ReadPngFileCallback) {
+export function readPngFile(
+    path: string,
+    optionsOrCallback?: ReadPngFileOptions | ReadPngFileCallback,
+    maybeCallback?: ReadPngFileCallback,
+) {
+    const options = typeof optionsOrCallback === "function" ? undefined : optionsOrCallback;
+    const callback = typeof optionsOrCallback === "function" ? optionsOrCallback : maybeCallback;
+    // Cache hits are served without reading the file.
+    if (options && options.cache) {
+        const promise = options.cache.readPngFile(path, options);
+        if (typeof callback !== "function") {
+            return promise;
+        }
+        promise.then(pngImage => callback(null, pngImage), error => callback(error));
+        return;
+    }
     // Check if the user provided a `callback`.
     if (typeof callback === "function") {
-        readFile(path, (readError: Error, data: Buffer) => {
-            // Call the callback with an error if an error occured.
-            if (readError) {
-                callback(readError);
-                return;
-            }
-            // Try to decode the PNG image. Catch any errors that might occur.
-            let pngImage: PngImage;
-            try {
-                pngImage = new PngImage(data);
-            } catch (decodeError) {
-                callback(decodeError);
-                return;
-            }
-            // If no error occured, call the callback with the decoded image.
-            callback(null, pngImage);
-        });
+        decodeFile(path, options, callback);
         return;
     }
     // If the user didn't provide a callback, return a Promise which will resolve with the decoded image.
     return new Promise<PngImage>((resolve, reject) => {
-        return readFile(path, (readError: Error, data: Buffer) => {
-            // Reject if an error occured during read.
-            if (readError) {
-                reject(readError);
-                return;
-            }
-            // Try to decode the PNG image. Catch any errors that might occur.
-            let pngImage: PngImage;
-            try {
-                pngImage = new PngImage(data);
-            } catch (decodeError) {
-                reject(decodeError);
+        decodeFile(path, options, (error: Error, pngImage?: PngImage) => {
+            if (error) {
+                reject(error);
                 return;
             }
-            // If no error occured, resolve the Promise with the decoded image.
             resolve(pngImage);
         });
     });
 }
 
+/**
+ * Decodes a file on a thread of the scheduler's pool. The file is fed to libpng through a small fixed size buffer,
+ * so it is never read into memory as a whole and the main thread is only busy wrapping the result.
+ * A file which is truncated while it is decoded is reported as invalid PNG data.
+ *
+ * @param path The path to the file to decode.
+ * @param options Optional options used when decoding the image and scheduling the job.
+ * @param callback Will be called with an error, or `null` and the decoded image.
+ */
+export function decodeFile(path: string, options: ReadPngFileOptions, callback: ReadPngFileCallback) {
+    try {
+        validateDecodeOptions(options);
+    } catch (validationError) {
+        process.nextTick(callback, validationError);
+        return;
+    }
+    const start = (batch: boolean, done: (error: Error, nativePng?: any) => void) => {
+        return __native_readPngFile(path, options, batch, done);
+    };
+    scheduleJob(options, start, (error: Error, nativePng?: any) => {
+        if (error) {
+            callback(error);
+            return;
+        }
+        callback(null, wrapNativePngImage(nativePng, options));
+    });
+}
+
+/**
+ * Decodes a file synchroneously. The file is fed to libpng through a small fixed size buffer,
+ * so it is never read into memory as a whole.
+ *
+ * @param path The path to the file to decode.
+ * @param options Optional options used when decoding the image.
+ *
+ * @return The decoded image.
+ */
+export function decodeFileSync(path: string, options?: DecodeOptions): PngImage {
+    validateDecodeOptions(options);
+    return wrapNativePngImage(__native_readPngFileSync(path, options), options);
+}
+
 /**
  * Decode a PNG file synchroneously.
  *
  * @param path The path to the file to decode.
+ * @param options Optional options used when decoding the image.
  *
  * @return The decoded image.
  */
-export function readPngFileSync(path: string): PngImage {
-    return new PngImage(readFileSync(path));
+export function readPngFileSync(path: string, options?: DecodeOptions): PngImage {
+    if (options && options.cache) {
+        return options.cache.readPngFileSync(path, options);
+    }
+    return decodeFileSync(path, options);
 }
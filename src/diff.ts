@@ -0,0 +1,122 @@
+import { __native_diff } from "./native";
+import { PngImage, paletteTable } from "./png-image";
+import { Rect, rect } from "./rect";
+
+export interface DiffOptions {
+    /**
+     * The perceived color difference between `0` and `1` above which two pixels are considered different.
+     * Smaller values make the comparison more sensitive. Defaults to `0.1`.
+     */
+    threshold?: number;
+    /**
+     * Set to `true` to detect anti-aliased pixels and not count them as mismatches. Useful for comparing
+     * screenshots rendered on different machines. Defaults to `false`.
+     */
+    antialiasing?: boolean;
+    /**
+     * Set to `true` to draw a diff image. Defaults to `false`.
+     */
+    output?: boolean;
+    /**
+     * Stop comparing once this many mismatching pixels were found. Useful to check whether two images differ
+     * at all. Defaults to `0`, which compares every pixel.
+     */
+    maxMismatches?: number;
+}
+
+export interface DiffResult {
+    /**
+     * The amount of mismatching pixels. When `maxMismatches` was specified and reached, this is at least
+     * `maxMismatches` but doesn't cover the whole image.
+     */
+    mismatched: number;
+    /**
+     * The amount of differing pixels which were detected as anti-aliasing and not counted as mismatches.
+     */
+    antialiased: number;
+    /**
+     * The bounding box of all mismatching pixels or `undefined` if the images match.
+     */
+    bounds: Rect;
+    /**
+     * The bounding boxes of all groups of consecutive rows containing mismatching pixels, from top to bottom.
+     */
+    regions: Rect[];
+    /**
+     * The diff image as raw 8 bit RGBA data, if requested using the `output` option. Matching pixels are drawn
+     * as a faded gray scale version of the first image, mismatches in red and anti-aliased pixels in yellow.
+     * Can be encoded using `encode`.
+     */
+    output?: Buffer;
+}
+
+/**
+ * Compares two images of the same dimensions pixel by pixel using the perceived color difference,
+ * for example for visual regression testing. The images may have different color types and bit depths.
+ * Rows with identical data are skipped without looking at their pixels and large images are compared
+ * on multiple threads.
+ *
+ * @param first The first image to compare.
+ * @param second The second image to compare.
+ * @param options Options for the comparison.
+ *
+ * @return The amount and locations of the mismatching pixels.
+ */
+export function diff(first: PngImage, second: PngImage, options: DiffOptions = {}): DiffResult {
+    if (!(first instanceof PngImage) || !(second instanceof PngImage)) {
+        throw new Error("Can only compare instances of PngImage.");
+    }
+    if (typeof options !== "object" || options === null) {
+        throw new Error("Options need to be an object.");
+    }
+    const { threshold = 0.1, antialiasing = false, output = false, maxMismatches = 0 } = options;
+    if (first.width !== second.width || first.height !== second.height) {
+        throw new Error("Images need to have the same dimensions.");
+    }
+    if (typeof threshold !== "number" || threshold < 0 || threshold > 1) {
+        throw new Error("Threshold needs to be a number between 0 and 1.");
+    }
+    if (!Number.isInteger(maxMismatches) || maxMismatches < 0) {
+        throw new Error("Maximum amount of mismatches needs to be a non-negative integer.");
+    }
+    const result = __native_diff(
+        first.data,
+        first.colorType,
+        first.bitDepth,
+        paletteTable(first.palette, first.paletteAlpha),
+        second.data,
+        second.colorType,
+        second.bitDepth,
+        paletteTable(second.palette, second.paletteAlpha),
+        first.width,
+        first.height,
+        threshold,
+        antialiasing,
+        output,
+        maxMismatches,
+    );
+    const regions: Rect[] = result.regions.map(([x, y, width, height]: number[]) => rect(x, y, width, height));
+    return {
+        mismatched: result.mismatched,
+        antialiased: result.antialiased,
+        bounds: boundingBox(regions),
+        regions,
+        output: result.output,
+    };
+}
+
+/**
+ * Computes the smallest rectangle containing all of the given rectangles.
+ *
+ * @return The bounding box or `undefined` if no rectangles were provided.
+ */
+function boundingBox(rects: Rect[]): Rect {
+    if (rects.length === 0) {
+        return;
+    }
+    const left = rects.reduce((result, { x }) => Math.min(result, x), Infinity);
+    const right = rects.reduce((result, { x, width }) => Math.max(result, x + width), 0);
+    const top = rects[0].y;
+    const bottom = rects[rects.length - 1].y + rects[rects.length - 1].height;
+    return rect(left, top, right - left, bottom - top);
+}
@@ -1,7 +1,13 @@
-import { writeFile, writeFileSync } from "fs";
-import { __native_encode } from "./native";
+import { __native_encode, __native_writePngFile, __native_writePngFileSync } from "./native";
+import { JobOptions, scheduleJob } from "./scheduler";
+import { ImageMetadata, nativeMetadata } from "./metadata";
 
-export interface EncodeOptions {
+/**
+ * Options for encoding an image. The metadata is written into ancillary chunks in the same pass as the image.
+ *
+ * @see ImageMetadata
+ */
+export interface EncodeOptions extends ImageMetadata {
     /**
      * The width of the image to be encoded in pixels.
      */
@@ -14,27 +20,40 @@ export interface EncodeOptions {
      * level of compression to use 0 - no compression, 1 - fastest, 9 - best size.
      */
     compressionLevel?: 0 | 1 | 2 | 3 | 4 | 5 | 6 | 7 | 8 | 9;
+    /**
+     * Set to `true` if the color samples of the buffer are premultiplied with the alpha channel.
+     * They will be divided by their alpha while encoding, as PNG stores straight alpha.
+     * Ignored for images without an alpha channel.
+     */
+    premultiplied?: boolean;
+}
+
+export interface WriteOptions {
+    /**
+     * Flush the file to disk before the write is reported to be complete. Defaults to `false`.
+     */
+    fsync?: boolean;
+    /**
+     * Write into a temporary file next to the target first, which replaces the target once it is complete.
+     * Readers will never see a partially written file. Defaults to `false`.
+     */
+    atomic?: boolean;
 }
 
+export interface WritePngFileOptions extends EncodeOptions, WriteOptions, JobOptions {}
+
 /**
- * Encode a buffer of raw RGB or RGBA image data into PNG format.
- * Only RGB and RGBA color formats are supported. This function will automatically calculate whether an
- * alpha channel is present by calculating the amount of bytes per pixel from the length of the buffer
- * and the provided `width` and `height`. Only 8bit colors are supported.
- *
- * @param buffer The buffer of raw pixel data to encode.
- * @param options Options used to encode the image.
- *
- * @return the encoded PNG as a new buffer.
+ * Checks the buffer and the options and derives the arguments for the native encoder from them.
+ * Will throw an error if they are invalid.
  */
-export function encode(buffer: Buffer, options: EncodeOptions): Buffer {
+function encodeArguments(buffer: Buffer, options: EncodeOptions): any[] {
     if (!Buffer.isBuffer(buffer)) {
         throw new Error("Input is not a buffer.");
     }
     if (typeof options !== "object" || options === null) {
         throw new Error("Options need to be an object.");
     }
-    let { width, height, compressionLevel = 9 } = options;
+    let { width, height, compressionLevel = 9, premultiplied = false } = options;
     if (typeof width !== "number" || typeof height !== "number") {
         throw new Error("Error encoding PNG. Width and height need to be specified.");
     }
@@ -52,7 +71,22 @@ export function encode(buffer: Buffer, options: EncodeOptions): Buffer {
         throw new Error("Error encoding PNG. Unsupported color type.");
     }
     const alpha = bytesPerPixel === 4;
-    return __native_encode(buffer, width, height, alpha, compressionLevel);
+    return [buffer, width, height, alpha, compressionLevel, premultiplied, nativeMetadata(options)];
+}
+
+/**
+ * Encode a buffer of raw RGB or RGBA image data into PNG format.
+ * Only RGB and RGBA color formats are supported. This function will automatically calculate whether an
+ * alpha channel is present by calculating the amount of bytes per pixel from the length of the buffer
+ * and the provided `width` and `height`. Only 8bit colors are supported.
+ *
+ * @param buffer The buffer of raw pixel data to encode.
+ * @param options Options used to encode the image.
+ *
+ * @return the encoded PNG as a new buffer.
+ */
+export function encode(buffer: Buffer, options: EncodeOptions): Buffer {
+    return __native_encode(...encodeArguments(buffer, options));
 }
 
 export type WritePngFileCallback = (error: Error) => void;
@@ -60,19 +94,22 @@ export type WritePngFileCallback = (error: Error) => void;
 export function writePngFile(
     path: string,
     buffer: Buffer,
-    options: EncodeOptions,
+    options: WritePngFileOptions,
     callback: WritePngFileCallback,
 ): void;
-export function writePngFile(path: string, buffer: Buffer, options: EncodeOptions): Promise<void>;
+export function writePngFile(path: string, buffer: Buffer, options: WritePngFileOptions): Promise<void>;
 /**
  * Invoke `writePngFile` to asynchroneously write a raw buffer of pixel data as an encoded PNG image.
  * For convenience, both Node.js callbacks and Promises are supported.
  * If no callback is provided as a second argument, a Promise is returned which will resolve
  * once the file is written.
+ * The image is encoded on a thread of the scheduler's pool and written to the file while it is encoded,
+ * so the encoded image is never kept in memory as a whole. The buffer must not be modified until the
+ * file is written.
  *
  * @param path The path the file should be written to.
  * @param buffer The buffer of raw pixel data which should be encoded and written to disk.
- * @param options Options used to encode the image.
+ * @param options Options used to encode and write the image.
  * @param callback An optional callback to use instead of a returned Promise. Will be called with
  *                 an error as the first argument or `null` if everything went well.
  * @return A Promise if no callback was provided and `undefined` otherwise.
@@ -80,56 +117,56 @@ export function writePngFile(path: string, buffer: Buffer, options: EncodeOption
 export function writePngFile(
     path: string,
     buffer: Buffer,
-    options: EncodeOptions,
+    options: WritePngFileOptions,
     callback?: WritePngFileCallback,
 ): Promise<void> {
-    // Checlkif the user provided a `callback`.
+    // Check if the user provided a `callback`.
     if (typeof callback === "function") {
-        // Encode the buffer and call the `callback` with an error if an error occured.
-        let encoded: Buffer;
-        try {
-            encoded = encode(buffer, options);
-        } catch (encodeError) {
-            callback(encodeError);
-            return;
-        }
-        // Write the file and hand over the callback. This way it will be called with `null` or an error
-        // if an error occured.
-        writeFile(path, encoded, callback);
+        encodeToFile(path, buffer, options, callback);
         return;
     }
     // If the user didn't provide a callback, return a Promise which will resolve once the file is written,
     // or reject with an error if an error occured.
     return new Promise<void>((resolve, reject) => {
-        // Encode the buffer and reject the Promise if an error occured.
-        let encoded: Buffer;
-        try {
-            encoded = encode(buffer, options);
-        } catch (encodeError) {
-            reject(encodeError);
-            return;
-        }
-        // Write the file and make the Promise resolve or reject depending on whether an error occured when writing.
-        writeFile(path, encoded, error => {
+        encodeToFile(path, buffer, options, error => {
             if (error) {
                 reject(error);
                 return;
             }
             resolve();
         });
-        return;
     });
 }
 
 /**
- * Encode and write a PNG file synchroneously.
+ * Encodes the image on a thread of the scheduler's pool straight into the file.
+ * Calls the callback with an error if the options are invalid or encoding or writing failed.
+ */
+function encodeToFile(path: string, buffer: Buffer, options: WritePngFileOptions, callback: WritePngFileCallback) {
+    let args: any[];
+    try {
+        args = encodeArguments(buffer, options);
+    } catch (encodeError) {
+        callback(encodeError);
+        return;
+    }
+    const { fsync = false, atomic = false } = options;
+    const start = (batch: boolean, done: WritePngFileCallback) => {
+        return __native_writePngFile(path, fsync, atomic, ...args, batch, done);
+    };
+    scheduleJob(options, start, callback);
+}
+
+/**
+ * Encode and write a PNG file synchroneously. The image is written to the file while it is encoded,
+ * so the encoded image is never kept in memory as a whole.
  *
  * @param path The path the file should be written to.
  * @param buffer The buffer of raw pixel data which should be encoded and written to disk.
- * @param options Options used to encode the image.
- *
- * @return The decoded image.
+ * @param options Options used to encode and write the image.
  */
-export function writePngFileSync(path: string, buffer: Buffer, options: EncodeOptions): void {
-    writeFileSync(path, encode(buffer, options));
+export function writePngFileSync(path: string, buffer: Buffer, options: WritePngFileOptions): void {
+    const args = encodeArguments(buffer, options);
+    const { fsync = false, atomic = false } = options;
+    __native_writePngFileSync(path, fsync, atomic, ...args);
 }
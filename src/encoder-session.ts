@@ -0,0 +1,113 @@
+import { ColorType } from "./color-type";
+import { nativeMetadata } from "./metadata";
+import { __native_EncoderSession } from "./native";
+import { PngImage } from "./png-image";
+import { Rect } from "./rect";
+
+export interface EncoderSessionOptions {
+    /**
+     * level of compression to use 0 - no compression, 1 - fastest, 9 - best size. Defaults to `6`.
+     */
+    compressionLevel?: 0 | 1 | 2 | 3 | 4 | 5 | 6 | 7 | 8 | 9;
+    /**
+     * The amount of rows compressed together. Small bands make small changes cheaper to encode,
+     * large bands compress better. Defaults to `64`.
+     */
+    bandHeight?: number;
+}
+
+/**
+ * Encodes an image over and over again while it is being edited. The image data is compressed in bands of rows
+ * which are kept between encodes, and only the bands containing rows changed by the image's `fill`, `set`,
+ * `copyFrom`, `crop` or `resizeCanvas` are filtered and compressed again. The bands are spliced into one valid
+ * PNG, which decodes to the same pixels as `PngImage.encode` would produce.
+ */
+export class EncoderSession {
+    /**
+     * The image encoded by this session.
+     */
+    public readonly image: PngImage;
+    /**
+     * The compression level used for all bands.
+     */
+    public readonly compressionLevel: number;
+    /**
+     * The amount of rows compressed together.
+     */
+    public readonly bandHeight: number;
+    /**
+     * The amount of bands compressed by the last call to `encode`.
+     */
+    public encodedBands = 0;
+
+    private native: any;
+    // The revision of the image as of the last call to `encode`.
+    private revision: number;
+    // The dimensions and the format the native session was created for. A new one is needed if they change.
+    private layout: string;
+
+    /**
+     * @param image The image to encode. Only RGB and RGBA images with 8 bit per sample can be encoded.
+     * @param options Options controlling how the image is compressed.
+     */
+    constructor(image: PngImage, options: EncoderSessionOptions = {}) {
+        if (!(image instanceof PngImage)) {
+            throw new Error("Error creating encoder session. Image needs to be a PngImage.");
+        }
+        if (typeof options !== "object" || options === null) {
+            throw new Error("Error creating encoder session. Options need to be an object.");
+        }
+        const { compressionLevel = 6, bandHeight = 64 } = options;
+        if (!Number.isInteger(compressionLevel) || compressionLevel < 0 || compressionLevel > 9) {
+            throw new Error("Error creating encoder session. CompressionLevel needs to be an integer between 0 and 9.");
+        }
+        if (!Number.isInteger(bandHeight) || bandHeight < 1) {
+            throw new Error("Error creating encoder session. BandHeight needs to be a positive integer.");
+        }
+        this.image = image;
+        this.compressionLevel = compressionLevel;
+        this.bandHeight = bandHeight;
+    }
+
+    /**
+     * Marks rows as changed which have been modified without the image's methods, such as by writing to `data`.
+     *
+     * @param area The area which changed. Can be omitted if the whole image changed.
+     */
+    public invalidate(area?: Rect) {
+        if (!this.native) {
+            return;
+        }
+        const first = typeof area === "undefined" ? 0 : area.y;
+        const end = typeof area === "undefined" ? this.image.height : area.y + area.height;
+        this.native.invalidate(Math.max(0, first), Math.max(0, end));
+    }
+
+    /**
+     * Encodes the image in its current state, keeping its metadata. The first call compresses all bands,
+     * subsequent calls only those which changed since the previous call.
+     *
+     * @return The encoded PNG as a new buffer.
+     */
+    public encode(): Buffer {
+        const { image } = this;
+        const { width, height, colorType, premultiplied } = image;
+        if (colorType !== ColorType.RGB && colorType !== ColorType.RGBA) {
+            throw new Error("Can only encode images with RGB or RGBA color type.");
+        }
+        const alpha = colorType === ColorType.RGBA;
+        const layout = [width, height, alpha, premultiplied].join();
+        const changes = image.changedRows(this.layout === layout ? this.revision : undefined);
+        if (this.layout !== layout) {
+            this.native = new __native_EncoderSession(width, height, alpha, this.compressionLevel, this.bandHeight);
+            this.layout = layout;
+        }
+        for (const [first, end] of changes.ranges) {
+            this.native.invalidate(first, end);
+        }
+        this.revision = changes.revision;
+        const { data, encodedBands } = this.native.encode(image.data, premultiplied, nativeMetadata(image.metadata));
+        this.encodedBands = encodedBands;
+        return data;
+    }
+}
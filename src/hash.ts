@@ -0,0 +1,70 @@
+import { __native_pixelHash, __native_perceptualHash } from "./native";
+
+/**
+ * The algorithm used for computing a perceptual hash.
+ *
+ *  * `"dhash"` The difference hash compares the brightness of neighbouring areas. Very fast.
+ *  * `"phash"` The perceptual hash compares the low frequencies of the image. More robust against changes
+ *    in brightness, contrast and small edits.
+ */
+export type PerceptualHashAlgorithm = "dhash" | "phash";
+
+/**
+ * Computes a hash of the pixels of a PNG image without keeping the decoded image in memory.
+ * Two images have the same hash if their pixels are identical, even if they were encoded
+ * differently, for example using another compression level, filter, interlacing or color type.
+ * The hash is a 64 bit xxHash of the pixels in RGBA format (16 bit per sample for 16 bit images,
+ * 8 bit otherwise) and the image's dimensions. It is not suitable for cryptographic purposes.
+ *
+ * @param buffer The buffer of encoded PNG data.
+ *
+ * @return The hash as 16 hexadecimal digits.
+ */
+export function pixelHash(buffer: Buffer): string {
+    if (!Buffer.isBuffer(buffer)) {
+        throw new Error("Error hashing PNG. Input is not a buffer.");
+    }
+    return __native_pixelHash(buffer);
+}
+
+/**
+ * Computes a perceptual hash of a PNG image. Similar images have similar hashes, which can be compared
+ * using `hashDistance`. The image is reduced to a small gray scale grid while it is decoded.
+ *
+ * @param buffer The buffer of encoded PNG data.
+ * @param algorithm The algorithm to use. Defaults to `"phash"`.
+ *
+ * @return The hash as 16 hexadecimal digits.
+ */
+export function perceptualHash(buffer: Buffer, algorithm: PerceptualHashAlgorithm = "phash"): string {
+    if (!Buffer.isBuffer(buffer)) {
+        throw new Error("Error hashing PNG. Input is not a buffer.");
+    }
+    if (algorithm !== "dhash" && algorithm !== "phash") {
+        throw new Error("Error hashing PNG. Unsupported hash algorithm.");
+    }
+    return __native_perceptualHash(buffer, algorithm);
+}
+
+/**
+ * Counts the bits in which two hashes as returned by `perceptualHash` differ (hamming distance).
+ * Images with a distance of up to about 10 are usually considered similar.
+ *
+ * @param first The first hash.
+ * @param second The second hash.
+ *
+ * @return The amount of differing bits between `0` and `64`.
+ */
+export function hashDistance(first: string, second: string): number {
+    if (!/^[0-9a-f]{16}$/.test(first) || !/^[0-9a-f]{16}$/.test(second)) {
+        throw new Error("Hashes need to consist of 16 hexadecimal digits.");
+    }
+    let distance = 0;
+    for (let index = 0; index < 16; ++index) {
+        let bits = parseInt(first[index], 16) ^ parseInt(second[index], 16);
+        for (; bits !== 0; bits &= bits - 1) {
+            ++distance;
+        }
+    }
+    return distance;
+}
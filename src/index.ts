@@ -1,7 +1,31 @@
 /* istanbul ignore file */
-export { readPngFile, readPngFileSync, decode } from "./decode";
-export { writePngFile, writePngFileSync, encode } from "./encode";
-export { PngImage } from "./png-image";
+export { readPngFile, readPngFileSync, decode, ReadPngFileOptions } from "./decode";
+export { DecodeLimits, DecodeOptions, DecodeOutput } from "./decode-options";
+export * from "./decode-cache";
+export * from "./decode-tensor";
+export { writePngFile, writePngFileSync, encode, EncodeOptions, WriteOptions, WritePngFileOptions } from "./encode";
+export { PngImage, ChangedRows, ImageStats, MipmapFilter, MipmapOptions, MipmapsCallback } from "./png-image";
+export { IccProfile, ImageMetadata, SrgbIntent, TextEntry } from "./metadata";
+export * from "./diff";
+export * from "./hash";
+export * from "./verify";
+export * from "./chunks";
+export * from "./recompress";
+export * from "./atlas";
+export * from "./pyramid";
+export * from "./progressive";
+export * from "./apng";
+export * from "./encoder-session";
+export {
+    configureScheduler,
+    schedulerStats,
+    AbortSignalLike,
+    JobOptions,
+    JobPriority,
+    LaneStats,
+    SchedulerOptions,
+    SchedulerStats,
+} from "./scheduler";
 export { isPng } from "./is-png";
 export * from "./colors";
 export * from "./rect";
@@ -0,0 +1,228 @@
+/**
+ * The rendering intent stored in an `sRGB` chunk.
+ *
+ *  * `"perceptual"` For images preferring good adaptation to the output device gamut, such as photographs.
+ *  * `"relative"` Relative colorimetric, for images requiring color appearance matching, such as logos.
+ *  * `"saturation"` For images preferring preservation of saturation, such as charts.
+ *  * `"absolute"` Absolute colorimetric, for images requiring preservation of absolute colorimetry, such as proofs.
+ */
+export type SrgbIntent = "perceptual" | "relative" | "saturation" | "absolute";
+
+const srgbIntents: SrgbIntent[] = ["perceptual", "relative", "saturation", "absolute"];
+
+/**
+ * A text chunk of an image.
+ */
+export interface TextEntry {
+    /**
+     * The keyword of the text, for example `"Title"`, `"Author"` or `"Description"`. Latin-1, 1 to 79 characters.
+     */
+    keyword: string;
+    /**
+     * The text.
+     */
+    text: string;
+    /**
+     * The language tag of the text, such as `"en"`. Only present for `iTXt` chunks.
+     * Texts with a language or with characters outside of Latin-1 are written as UTF-8 `iTXt` chunks,
+     * all others as Latin-1 `tEXt` or `zTXt` chunks.
+     */
+    language?: string;
+    /**
+     * Whether the text is compressed. Compressed texts are written as `zTXt` or compressed `iTXt` chunks.
+     * Defaults to `false` when encoding.
+     */
+    compressed?: boolean;
+}
+
+/**
+ * An ICC profile embedded into an image using an `iCCP` chunk.
+ */
+export interface IccProfile {
+    /**
+     * The name of the profile. Latin-1, 1 to 79 characters.
+     */
+    name: string;
+    /**
+     * The uncompressed profile.
+     */
+    data: Buffer;
+}
+
+/**
+ * Ancillary information about an image, written into chunks along with the image data.
+ */
+export interface ImageMetadata {
+    /**
+     * The gamma the image was encoded with, written as `gAMA` chunk. For example `1 / 2.2`.
+     */
+    gamma?: number;
+    /**
+     * The time of the last modification, written as `tIME` chunk in UTC.
+     */
+    time?: Date;
+    /**
+     * The background color to present the image on, written as `bKGD` chunk.
+     */
+    backgroundColor?: [number, number, number];
+    /**
+     * The horizontal resolution in pixels per meter, written as `pHYs` chunk.
+     * Defaults to `pixelsPerMeterY` if only that is specified.
+     */
+    pixelsPerMeterX?: number;
+    /**
+     * The vertical resolution in pixels per meter, written as `pHYs` chunk.
+     * Defaults to `pixelsPerMeterX` if only that is specified.
+     */
+    pixelsPerMeterY?: number;
+    /**
+     * The horizontal offset of the image in pixels, written as `oFFs` chunk. Defaults to `0`
+     * if only `offsetY` is specified.
+     */
+    offsetX?: number;
+    /**
+     * The vertical offset of the image in pixels, written as `oFFs` chunk. Defaults to `0`
+     * if only `offsetX` is specified.
+     */
+    offsetY?: number;
+    /**
+     * Text chunks, written in the given order.
+     *
+     * @see TextEntry
+     */
+    texts?: TextEntry[];
+    /**
+     * Marks the image as sRGB encoded using an `sRGB` chunk with the given rendering intent.
+     * If `iccProfile` is specified as well, libpng only writes the ICC profile.
+     */
+    srgbIntent?: SrgbIntent;
+    /**
+     * An ICC profile describing the color space of the image, written as compressed `iCCP` chunk.
+     * libpng checks the header of the profile and refuses to encode invalid profiles.
+     */
+    iccProfile?: IccProfile;
+}
+
+/**
+ * Converts the rendering intent from the libpng bindings into its name.
+ *
+ * @param nativeIntent The intent as returned by the bindings.
+ *
+ * @return The name of the intent or `undefined` if the image has no `sRGB` chunk.
+ */
+export function convertNativeSrgbIntent(nativeIntent: number): SrgbIntent {
+    return srgbIntents[nativeIntent];
+}
+
+/**
+ * Encodes a keyword as expected by libpng. Keywords are Latin-1 text of 1 to 79 characters.
+ */
+function keywordBuffer(keyword: string): Buffer {
+    if (typeof keyword !== "string" || !/^[\u0001-\u00ff]{1,79}$/.test(keyword)) {
+        throw new Error("Error encoding PNG. Keywords need to consist of 1 to 79 Latin-1 characters.");
+    }
+    return Buffer.from(keyword, "latin1");
+}
+
+function isInteger(value: number, min: number, max: number) {
+    return Number.isInteger(value) && value >= min && value <= max;
+}
+
+function nativeTexts(texts: TextEntry[]) {
+    if (!Array.isArray(texts)) {
+        throw new Error("Error encoding PNG. Texts need to be an array.");
+    }
+    return texts.map(entry => {
+        if (typeof entry !== "object" || entry === null || typeof entry.text !== "string") {
+            throw new Error("Error encoding PNG. Texts need to consist of a keyword and a text.");
+        }
+        const { keyword, text, language, compressed = false } = entry;
+        if (language !== undefined && typeof language !== "string") {
+            throw new Error("Error encoding PNG. The language of a text needs to be a string.");
+        }
+        // Latin-1 texts without a language fit into the simpler `tEXt` and `zTXt` chunks.
+        const international = language !== undefined || /[^\u0000-\u00ff]/.test(text);
+        return {
+            keyword: keywordBuffer(keyword),
+            text: Buffer.from(text, international ? "utf8" : "latin1"),
+            language: international ? Buffer.from(language || "", "latin1") : undefined,
+            compressed: Boolean(compressed),
+        };
+    });
+}
+
+/**
+ * Checks the metadata and converts it into the form expected by the native encoder.
+ * Will throw an error if the metadata is invalid.
+ *
+ * @param metadata The metadata to write along with the image.
+ *
+ * @return The metadata for the native encoder.
+ */
+export function nativeMetadata(metadata: ImageMetadata): any {
+    const { gamma, time, backgroundColor, pixelsPerMeterX, pixelsPerMeterY, offsetX, offsetY } = metadata;
+    const { texts, srgbIntent, iccProfile } = metadata;
+    const result: any = {};
+    if (gamma !== undefined) {
+        if (typeof gamma !== "number" || !(gamma > 0)) {
+            throw new Error("Error encoding PNG. Gamma needs to be a positive number.");
+        }
+        result.gamma = gamma;
+    }
+    if (time !== undefined) {
+        if (!(time instanceof Date) || isNaN(time.getTime())) {
+            throw new Error("Error encoding PNG. Time needs to be a valid date.");
+        }
+        result.time = [
+            time.getUTCFullYear(),
+            time.getUTCMonth() + 1,
+            time.getUTCDate(),
+            time.getUTCHours(),
+            time.getUTCMinutes(),
+            time.getUTCSeconds(),
+        ];
+    }
+    if (backgroundColor !== undefined) {
+        if (!Array.isArray(backgroundColor) || backgroundColor.length !== 3 ||
+            !backgroundColor.every(value => isInteger(value, 0, 255))) {
+            throw new Error("Error encoding PNG. Background color needs to be an RGB color.");
+        }
+        result.background = [...backgroundColor];
+    }
+    if (pixelsPerMeterX !== undefined || pixelsPerMeterY !== undefined) {
+        const physical = [
+            pixelsPerMeterX === undefined ? pixelsPerMeterY : pixelsPerMeterX,
+            pixelsPerMeterY === undefined ? pixelsPerMeterX : pixelsPerMeterY,
+        ];
+        if (!physical.every(value => isInteger(value, 1, 0x7fffffff))) {
+            throw new Error("Error encoding PNG. Pixels per meter need to be positive integers.");
+        }
+        result.physical = physical;
+    }
+    if (offsetX !== undefined || offsetY !== undefined) {
+        const offset = [offsetX || 0, offsetY || 0];
+        if (!offset.every(value => isInteger(value, -0x7fffffff, 0x7fffffff))) {
+            throw new Error("Error encoding PNG. Offsets need to be integers.");
+        }
+        result.offset = offset;
+    }
+    if (texts !== undefined) {
+        result.texts = nativeTexts(texts);
+    }
+    if (srgbIntent !== undefined) {
+        if (!srgbIntents.includes(srgbIntent)) {
+            throw new Error(
+                "Error encoding PNG. sRGB intent needs to be one of \"perceptual\", \"relative\", " +
+                "\"saturation\" or \"absolute\".",
+            );
+        }
+        result.srgbIntent = srgbIntents.indexOf(srgbIntent);
+    }
+    if (iccProfile !== undefined) {
+        if (typeof iccProfile !== "object" || iccProfile === null || !Buffer.isBuffer(iccProfile.data)) {
+            throw new Error("Error encoding PNG. ICC profile needs to consist of a name and a buffer.");
+        }
+        result.iccProfile = { name: keywordBuffer(iccProfile.name), data: iccProfile.data };
+    }
+    return result;
+}
@@ -15,4 +15,33 @@ export const {
     __native_resize,
     __native_copy,
     __native_fill,
+    __native_decodeTensor,
+    __native_histogram,
+    __native_stats,
+    __native_isOpaque,
+    __native_isGrayscale,
+    __native_trimBounds,
+    __native_diff,
+    __native_pixelHash,
+    __native_perceptualHash,
+    __native_bufferHash,
+    __native_verify,
+    __native_verifyFile,
+    __native_readPngFile,
+    __native_readPngFileSync,
+    __native_writePngFile,
+    __native_writePngFileSync,
+    __native_abortJob,
+    __native_configureScheduler,
+    __native_schedulerStats,
+    __native_readChunks,
+    __native_rewriteChunks,
+    __native_recompress,
+    __native_buildAtlas,
+    __native_generatePyramid,
+    __native_mipmaps,
+    __native_ProgressiveDecoder,
+    __native_ApngDecoder,
+    __native_encodeApng,
+    __native_EncoderSession,
 } = require(qualifiedName); // tslint:disable-line
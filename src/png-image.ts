@@ -1,4 +1,5 @@
-import { encode, writePngFile, writePngFileSync, WritePngFileCallback } from "./encode";
+import { endianness } from "os";
+import { encode, writePngFile, writePngFileSync, WritePngFileCallback, WriteOptions } from "./encode";
 import {
     colorRGB,
     ColorRGB,
@@ -20,7 +21,21 @@ import {
 import { xy, XY } from "./xy";
 import { Rect, rect } from "./rect";
 import { ColorType } from "./color-type";
-import { __native_PngImage, __native_resize, __native_copy, __native_fill } from "./native";
+import { DecodeOptions, validateDecodeOptions } from "./decode-options";
+import { JobOptions, scheduleJob } from "./scheduler";
+import { convertNativeSrgbIntent, IccProfile, ImageMetadata, nativeMetadata, SrgbIntent, TextEntry } from "./metadata";
+import {
+    __native_PngImage,
+    __native_resize,
+    __native_copy,
+    __native_fill,
+    __native_histogram,
+    __native_stats,
+    __native_isOpaque,
+    __native_isGrayscale,
+    __native_trimBounds,
+    __native_mipmaps,
+} from "./native";
 
 /**
  * The interlace type from libpng.
@@ -66,6 +81,72 @@ export interface ResizeCanvasArguments {
     readonly fillColor?: ColorAny;
 }
 
+/**
+ * Statistics about the samples of an image as returned by `PngImage.stats`.
+ * Every array contains one entry per channel. Values are in the range of the image's bit depth.
+ */
+export interface ImageStats {
+    /**
+     * The smallest value of each channel.
+     */
+    min: number[];
+    /**
+     * The largest value of each channel.
+     */
+    max: number[];
+    /**
+     * The average value of each channel.
+     */
+    mean: number[];
+}
+
+/**
+ * The rows of an image which changed since a revision, as returned by `PngImage.changedRows`.
+ */
+export interface ChangedRows {
+    /**
+     * The current revision of the image, to hand to the next call.
+     */
+    revision: number;
+    /**
+     * The changed rows as `[first, end]` pairs of the first row and the row after the last one, in ascending order.
+     */
+    ranges: [number, number][];
+}
+
+/**
+ * How the pixels of a mipmap level are averaged into the next level.
+ *
+ *  * `"box"` Averages blocks of 2x2 pixels.
+ *  * `"gamma"` Averages blocks of 2x2 pixels in linear light, using the image's gamma or sRGB if it has none.
+ *    Images which have been decoded into linear light are averaged as they are.
+ *    Keeps the brightness of fine, high contrast details, but is slower.
+ */
+export type MipmapFilter = "box" | "gamma";
+
+/**
+ * Options for `PngImage.mipmaps`.
+ */
+export interface MipmapOptions extends JobOptions {
+    /**
+     * The filter to reduce the levels with. Defaults to `"box"`.
+     *
+     * @see MipmapFilter
+     */
+    filter?: MipmapFilter;
+    /**
+     * Encode all levels into PNG buffers instead of returning images. Only supported for RGB and RGBA images.
+     * Defaults to `false`.
+     */
+    encode?: boolean;
+    /**
+     * level of compression to use when encoding 0 - no compression, 1 - fastest, 9 - best size. Defaults to `6`.
+     */
+    compressionLevel?: 0 | 1 | 2 | 3 | 4 | 5 | 6 | 7 | 8 | 9;
+}
+
+export type MipmapsCallback<T> = (error: Error, levels?: T[]) => void;
+
 /**
  * Converts the native time from the libpng bindings into a javascript `Date` object.
  *
@@ -125,52 +206,112 @@ function convertNativePalette(nativePalette: any): Palette {
     }, new Map<number, ColorRGB>());
 }
 
+/**
+ * Flattens a palette and the alpha values of its entries into a buffer of RGBA entries (4 bytes each)
+ * as expected by the native bindings. Entries without an alpha value are opaque.
+ *
+ * @param palette The palette of the image.
+ * @param paletteAlpha The alpha values of the palette entries as stored in the `tRNS` chunk.
+ *
+ * @return A buffer with one RGBA entry per palette index or `undefined` if no palette was provided.
+ */
+export function paletteTable(palette: Palette, paletteAlpha: number[] = []): Buffer {
+    if (!palette) { return; }
+    const table = Buffer.alloc(palette.size * 4);
+    palette.forEach(([red, green, blue], index) => {
+        table[index * 4] = red;
+        table[index * 4 + 1] = green;
+        table[index * 4 + 2] = blue;
+        table[index * 4 + 3] = index < paletteAlpha.length ? paletteAlpha[index] : 255;
+    });
+    return table;
+}
+
+/**
+ * Copies the properties of an image decoded by the native addon onto a `PngImage`.
+ */
+function assignNativePngImage(pngImage: PngImage, nativePng: any, options?: DecodeOptions) {
+    pngImage.bitDepth = nativePng.bitDepth;
+    pngImage.channels = nativePng.channels;
+    pngImage.colorType = nativePng.colorType;
+    pngImage.height = nativePng.height;
+    pngImage.width = nativePng.width;
+    pngImage.interlaceType = nativePng.interlaceType;
+    pngImage.rowBytes = nativePng.rowBytes;
+    pngImage.offsetX = nativePng.offsetX;
+    pngImage.offsetY = nativePng.offsetY;
+    pngImage.pixelsPerMeterX = nativePng.pixelsPerMeterX;
+    pngImage.pixelsPerMeterY = nativePng.pixelsPerMeterY;
+    pngImage.data = nativePng.data;
+    pngImage.palette = convertNativePalette(nativePng.palette);
+    pngImage.paletteAlpha = nativePng.paletteAlpha;
+    pngImage.gamma = nativePng.gamma;
+    pngImage.time = convertNativeTime(nativePng.time);
+    pngImage.backgroundColor = convertNativeBackgroundColor(nativePng.backgroundColor, pngImage.colorType);
+    pngImage.texts = nativePng.texts;
+    pngImage.srgbIntent = convertNativeSrgbIntent(nativePng.srgbIntent);
+    pngImage.iccProfile = nativePng.iccProfile;
+    pngImage.premultiplied = Boolean(options && options.premultiplied) && pngImage.alpha;
+    pngImage.linear = Boolean(options && options.linear);
+}
+
+/**
+ * Wraps an image which has already been decoded by the native addon, for example straight from a file.
+ *
+ * @param nativePng The image as returned by the native addon.
+ * @param options The options used when decoding the image.
+ *
+ * @return The wrapped image.
+ */
+export function wrapNativePngImage(nativePng: any, options?: DecodeOptions): PngImage {
+    const pngImage: PngImage = Object.create(PngImage.prototype);
+    assignNativePngImage(pngImage, nativePng, options);
+    return pngImage;
+}
+
+/**
+ * Returns the amount of bytes per pixel of images with the given color type and bit depth.
+ */
+function bytesPerPixel(colorType: ColorType, bitDepth: number): number {
+    const bytesPerColor = Math.ceil(bitDepth / 8);
+    switch (colorType) {
+        case ColorType.GRAY_SCALE_ALPHA:
+            return 2 * bytesPerColor;
+        case ColorType.RGBA:
+            return 4 * bytesPerColor;
+        case ColorType.GRAY_SCALE:
+        case ColorType.PALETTE:
+            return 1 * bytesPerColor;
+        case ColorType.RGB:
+            return 3 * bytesPerColor;
+        default:
+            return undefined;
+    }
+}
+
 /**
  * Decodes and wraps a PNG image. Will call the native bindings under the hood and provides
  * a high-level access to read- and write operations on the image.
  */
 export class PngImage {
-    constructor(buffer: Buffer) {
+    /**
+     * @param buffer The buffer of encoded PNG data to decode.
+     * @param options Options used when decoding, such as the pixel format to normalize the image into.
+     */
+    constructor(buffer: Buffer, options?: DecodeOptions) {
         if (!Buffer.isBuffer(buffer)) {
             throw new Error("Error decoding PNG. Input is not a buffer.");
         }
-        const nativePng = new __native_PngImage(buffer);
-        this.bitDepth = nativePng.bitDepth;
-        this.channels = nativePng.channels;
-        this.colorType = nativePng.colorType;
-        this.height = nativePng.height;
-        this.width = nativePng.width;
-        this.interlaceType = nativePng.interlaceType;
-        this.rowBytes = nativePng.rowBytes;
-        this.offsetX = nativePng.offsetX;
-        this.offsetY = nativePng.offsetY;
-        this.pixelsPerMeterX = nativePng.pixelsPerMeterX;
-        this.pixelsPerMeterY = nativePng.pixelsPerMeterY;
-        this.data = nativePng.data;
-        this.palette = convertNativePalette(nativePng.palette);
-        this.gamma = nativePng.gamma;
-        this.time = convertNativeTime(nativePng.time);
-        this.backgroundColor = convertNativeBackgroundColor(nativePng.backgroundColor, this.colorType);
+        validateDecodeOptions(options);
+        assignNativePngImage(this, new __native_PngImage(buffer, options), options);
     }
 
-    /**
-     * The bit depth of the image.
-     * Gathered from `png_get_bit_depth`.
-     */
-    public bitDepth: number;
-
     /**
      * The amount of channels of the image.
      * Gathered from `png_get_channels`.
      */
     public channels: number;
 
-    /**
-     * The color type of the image as a string.
-     * Gathered from `png_get_color_type`.
-     */
-    public colorType: ColorType;
-
     /**
      * The width of the image.
      * Gathered from `png_get_image_height`.
@@ -218,11 +359,6 @@ export class PngImage {
      */
     public pixelsPerMeterY: number;
 
-    /**
-     * The buffer containing the data of the decoded image.
-     */
-    public data: Buffer;
-
     /**
      * Returns the last modification time as returned by `png_get_tIME`.
      */
@@ -240,12 +376,114 @@ export class PngImage {
      */
     public palette: Palette;
 
+    /**
+     * The alpha values of the palette entries if the color type is `ColorType.PALETTE` and
+     * the image contains a `tRNS` chunk. Entries without an alpha value are opaque.
+     * Gathered from `png_get_tRNS`.
+     */
+    public paletteAlpha: number[];
+
     /**
      * The gamma value of the image.
      * Gathered from `png_get_gAMA`.
      */
     public gamma: number;
 
+    /**
+     * The text chunks of the image which appear before the image data, in the order they appear in the image.
+     * Gathered from `png_get_text`.
+     */
+    public texts: TextEntry[];
+
+    /**
+     * The rendering intent if the image is marked as sRGB encoded.
+     * Gathered from `png_get_sRGB`.
+     */
+    public srgbIntent: SrgbIntent;
+
+    /**
+     * The embedded ICC profile of the image.
+     * Gathered from `png_get_iCCP`.
+     */
+    public iccProfile: IccProfile;
+
+    /**
+     * Will be `true` if the color samples of this image are premultiplied with the alpha channel.
+     * Such images are divided by their alpha again when encoded.
+     */
+    public premultiplied: boolean;
+
+    /**
+     * Will be `true` if the color samples of this image have been converted into linear light when decoding.
+     * Such images are encoded with a gamma of `1` and without their sRGB intent and ICC profile.
+     */
+    public linear: boolean;
+
+    /**
+     * Counts the changes made by the methods of this image, once `changedRows` has been called.
+     */
+    private revision: number;
+    /**
+     * The revision of the last change of every row, once `changedRows` has been called.
+     */
+    private rowRevisions: Uint32Array;
+    /**
+     * The pixels of the image, shared with other images created by `lazyClone` if `sharesPixels` is set.
+     */
+    private pixels: Buffer;
+    private sharesPixels: boolean;
+    /**
+     * The format of the pixels. `pixelBytes` is derived from the other two whenever either one changes,
+     * so that accessing pixels doesn't need to derive it again.
+     */
+    private pixelBitDepth: number;
+    private pixelColorType: ColorType;
+    private pixelBytes: number;
+
+    /**
+     * The bit depth of the image.
+     * Gathered from `png_get_bit_depth`.
+     */
+    public get bitDepth(): number {
+        return this.pixelBitDepth;
+    }
+
+    public set bitDepth(bitDepth: number) {
+        this.pixelBitDepth = bitDepth;
+        this.pixelBytes = bytesPerPixel(this.pixelColorType, bitDepth);
+    }
+
+    /**
+     * The color type of the image as a string.
+     * Gathered from `png_get_color_type`.
+     */
+    public get colorType(): ColorType {
+        return this.pixelColorType;
+    }
+
+    public set colorType(colorType: ColorType) {
+        this.pixelColorType = colorType;
+        this.pixelBytes = bytesPerPixel(colorType, this.pixelBitDepth);
+    }
+
+    /**
+     * The buffer containing the data of the decoded image.
+     * Images created by `lazyClone` share their pixels until this is accessed or the image is modified
+     * for the first time, at which point the pixels are copied once.
+     */
+    public get data(): Buffer {
+        if (this.sharesPixels) {
+            this.pixels = Buffer.from(this.pixels);
+            this.sharesPixels = false;
+        }
+        return this.pixels;
+    }
+
+    public set data(data: Buffer) {
+        this.pixels = data;
+        this.sharesPixels = false;
+    }
+
     /**
      * Will be `true` if the image's color type has an alpha channel and `false` otherwise.
      */
@@ -263,34 +501,21 @@ export class PngImage {
      * Returns the amount of bytes per pixel (depending on the color type) for the image.
      */
     public get bytesPerPixel(): number {
-        const bytesPerColor = Math.ceil(this.bitDepth / 8);
-        switch (this.colorType) {
-            case ColorType.GRAY_SCALE_ALPHA:
-                return 2 * bytesPerColor;
-            case ColorType.RGBA:
-                return 4 * bytesPerColor;
-            case ColorType.GRAY_SCALE:
-            case ColorType.PALETTE:
-                return 1 * bytesPerColor;
-            case ColorType.RGB:
-                return 3 * bytesPerColor;
-            default:
-                return undefined;
-        }
+        return this.pixelBytes;
     }
 
     /**
      * Convert a set of coordinates to index in the buffer.
      */
     public toIndex(x: number, y: number) {
-        return (x + y * this.width) * this.bytesPerPixel;
+        return (x + y * this.width) * this.pixelBytes;
     }
 
     /**
      * Convert an index in the buffer to a set of coordinates.
      */
     public toXY(index: number): XY {
-        const colorIndex = index / this.bytesPerPixel;
+        const colorIndex = index / this.pixelBytes;
         const x = Math.floor(colorIndex % this.width);
         const y = Math.floor(colorIndex / this.width);
         return xy(x, y);
@@ -306,10 +531,10 @@ export class PngImage {
      */
     public at(x: number, y: number): ColorAny  {
         const index = this.toIndex(x, y);
-        if (index > this.data.length || index < 0) {
+        const data = this.pixels;
+        if (index > data.length || index < 0) {
             throw new Error("Index out of range when reading pixel from image.");
         }
-        const { data } = this;
         switch (this.colorType) {
             case ColorType.GRAY_SCALE:
                 return colorGrayScale(data[index]);
@@ -340,6 +565,246 @@ export class PngImage {
         return convertToRGBA(this.at(x, y), this.palette);
     }
 
+    /**
+     * Creates a copy of this image which can be modified independently.
+     *
+     * @return The copy of this image.
+     */
+    public clone(): PngImage {
+        return this.withData(Buffer.from(this.pixels), this.width, this.height);
+    }
+
+    /**
+     * Creates a copy of this image which can be modified independently, like `clone`, but doesn't copy the pixels
+     * right away. Both images share them until either one accesses `data` or is modified, which copies them once.
+     * Cheap for images which are mostly read, encoded or copied from.
+     *
+     * @return The copy of this image.
+     */
+    public lazyClone(): PngImage {
+        const copy = this.withData(this.pixels, this.width, this.height);
+        this.sharesPixels = copy.sharesPixels = true;
+        return copy;
+    }
+
+    /**
+     * Creates a copy of this image's properties and metadata with other pixels.
+     */
+    private withData(data: Buffer, width: number, height: number): PngImage {
+        const copy: PngImage = Object.create(PngImage.prototype);
+        Object.assign(copy, this);
+        copy.data = data;
+        copy.width = width;
+        copy.height = height;
+        copy.rowBytes = Math.ceil(width * this.channels * this.bitDepth / 8);
+        copy.rowRevisions = undefined;
+        copy.palette = this.palette && new Map(this.palette);
+        copy.paletteAlpha = this.paletteAlpha && [...this.paletteAlpha];
+        copy.time = this.time && new Date(this.time.getTime());
+        copy.texts = this.texts.map(entry => ({ ...entry }));
+        copy.iccProfile = this.iccProfile && { ...this.iccProfile, data: Buffer.from(this.iccProfile.data) };
+        return copy;
+    }
+
+    /**
+     * Returns a view of the samples of this image without copying them. The view is a `Uint8Array`
+     * for images with up to 8 bit per sample. Samples of less than 8 bit are packed.
+     * libpng stores 16 bit samples in big-endian byte order, so for 16 bit images a `Uint16Array` with
+     * the samples converted into the byte order of the host is returned instead. This is a copy.
+     *
+     * @return The samples of this image in row-major order.
+     */
+    public samples(): Uint8Array | Uint16Array {
+        const { data } = this;
+        if (this.bitDepth !== 16) {
+            return new Uint8Array(data.buffer, data.byteOffset, data.length);
+        }
+        const copy = Buffer.alloc(data.length);
+        data.copy(copy);
+        /* istanbul ignore else */
+        if (endianness() === "LE") {
+            copy.swap16();
+        }
+        return new Uint16Array(copy.buffer, copy.byteOffset, copy.length / 2);
+    }
+
+    /**
+     * Returns a view of one row of this image's data without copying it.
+     * Modifying the view modifies the image.
+     *
+     * @param y The index of the row.
+     *
+     * @return A view of the row's bytes.
+     */
+    public getRow(y: number): Buffer {
+        if (!Number.isInteger(y) || y < 0 || y >= this.height) {
+            throw new Error("Row is out of range for this image.");
+        }
+        return this.data.subarray(y * this.rowBytes, (y + 1) * this.rowBytes);
+    }
+
+    /**
+     * Returns views of the rows of a rectangular region of this image without copying them.
+     * Modifying the views modifies the image. Only supported for images with at least 8 bit per sample.
+     *
+     * @param area The region of the image.
+     *
+     * @return One view per row of the region, each covering the bytes of `area.width` pixels.
+     */
+    public getRegion(area: Rect): Buffer[] {
+        if (this.bitDepth < 8) {
+            throw new Error("Regions can only be accessed on images with at least 8 bit per sample.");
+        }
+        this.checkArea(area);
+        const { pixelBytes, rowBytes } = this;
+        const rows = new Array<Buffer>(area.height);
+        for (let y = 0; y < area.height; ++y) {
+            const start = (area.y + y) * rowBytes + area.x * pixelBytes;
+            rows[y] = this.data.subarray(start, start + area.width * pixelBytes);
+        }
+        return rows;
+    }
+
+    /**
+     * Converts a region of this image into 8 bit RGBA in a single native pass, no matter which color type
+     * and bit depth this image has. Palettes are resolved including the alpha values of their entries.
+     *
+     * @param area The region of the image to convert. Can be omitted to convert the whole image.
+     * @param target An optional buffer of at least `4 * area.width * area.height` bytes to write into.
+     *               Can be used to avoid allocating a new buffer for each call.
+     *
+     * @return The buffer the RGBA samples were written to, row by row.
+     */
+    public readRGBA(area?: Rect, target?: Uint8Array): Uint8Array {
+        const safeArea = typeof area === "undefined" ? rect(0, 0, this.width, this.height) : area;
+        this.checkArea(safeArea);
+        const length = safeArea.width * safeArea.height * 4;
+        const safeTarget = typeof target === "undefined" ? Buffer.allocUnsafe(length) : target;
+        if (!(safeTarget instanceof Uint8Array) || safeTarget.length < length) {
+            throw new Error("Target buffer is too small for the provided area.");
+        }
+        __native_copy(
+            this.pixels,
+            safeTarget,
+            this.width,
+            this.height,
+            safeArea.width,
+            safeArea.height,
+            ...safeArea,
+            0,
+            0,
+            this.colorType,
+            this.bitDepth,
+            ColorType.RGBA,
+            8,
+            paletteTable(this.palette, this.paletteAlpha),
+        );
+        return safeTarget;
+    }
+
+    /**
+     * Counts how often each sample value occurs, separately for every channel.
+     * Images with up to 8 bit per sample have `2 ^ bitDepth` bins per channel. Samples of 16 bit images
+     * are binned by their high byte into 256 bins. For palette images the indices are counted.
+     *
+     * @param area The region of the image to count. Can be omitted to count the whole image.
+     *
+     * @return One histogram per channel.
+     */
+    public histogram(area?: Rect): Uint32Array[] {
+        const buffers: Buffer[] = __native_histogram(...this.analysisArguments(area));
+        return buffers.map(buffer => new Uint32Array(buffer.buffer, buffer.byteOffset, buffer.length / 4));
+    }
+
+    /**
+     * Computes the minimum, maximum and average of every channel in a single pass.
+     * For palette images the statistics of the rgba colors the pixels refer to are computed.
+     *
+     * @param area The region of the image to compute the statistics of. Can be omitted to use the whole image.
+     *
+     * @return The statistics of each channel.
+     */
+    public stats(area?: Rect): ImageStats {
+        return __native_stats(...this.analysisArguments(area));
+    }
+
+    /**
+     * Checks whether every pixel of this image is fully opaque. Images without alpha channel are always opaque.
+     * Palette images are opaque if none of the used palette entries is transparent.
+     *
+     * @return `true` if no pixel is (partially) transparent.
+     */
+    public isOpaque(): boolean {
+        return __native_isOpaque(...this.analysisArguments());
+    }
+
+    /**
+     * Checks whether every pixel of this image is gray, meaning that its red, green and blue values are equal.
+     * Gray scale images are always gray.
+     *
+     * @return `true` if no pixel has a color.
+     */
+    public isGrayscale(): boolean {
+        return __native_isGrayscale(...this.analysisArguments());
+    }
+
+    /**
+     * Computes the smallest rectangle containing all pixels which are not of the background color.
+     * Can be passed to `PngImage.crop` to remove a uniform border, for example around screenshots.
+     *
+     * @param color The background color in the image's color format. Defaults to the color of the top left pixel.
+     * @param tolerance The maximum difference per sample for a pixel to still count as background.
+     *                  For palette images the difference is measured between the rgba colors of the entries.
+     *
+     * @return The bounding box of all non-background pixels or `undefined` if the image only consists of background.
+     */
+    public trimBounds(color?: ColorAny, tolerance = 0): Rect {
+        if (typeof color !== "undefined" && !colorTypeToColorChecker(this.colorType)(color)) {
+            throw new Error("Background color must be of same color type as image.");
+        }
+        if (!Number.isInteger(tolerance) || tolerance < 0) {
+            throw new Error("Tolerance must be a non-negative integer.");
+        }
+        const bounds: number[] = __native_trimBounds(...this.analysisArguments(), color, tolerance);
+        if (typeof bounds === "undefined") {
+            return;
+        }
+        const [x, y, width, height] = bounds;
+        return rect(x, y, width, height);
+    }
+
+    /**
+     * Returns the arguments shared by all native analysis functions.
+     */
+    private analysisArguments(area?: Rect): any[] {
+        const safeArea = typeof area === "undefined" ? rect(0, 0, this.width, this.height) : area;
+        this.checkArea(safeArea);
+        return [
+            this.pixels,
+            this.width,
+            this.height,
+            this.colorType,
+            this.bitDepth,
+            ...safeArea,
+            paletteTable(this.palette, this.paletteAlpha),
+        ];
+    }
+
+    /**
+     * Throws an error if the given area is not completely inside this image.
+     */
+    private checkArea(area: Rect) {
+        const notInside = area.x < 0 ||
+            area.y < 0 ||
+            area.width < 1 ||
+            area.height < 1 ||
+            area.x + area.width > this.width ||
+            area.y + area.height > this.height;
+        if (notInside) {
+            throw new Error("Provided area is out of range for this image.");
+        }
+    }
+
     /**
      * A convenience wrapper around `resizeCanvas`. Crops the image to a specified sub-rectangle.
      * Modifies this image and the underlying buffer.
@@ -386,7 +851,7 @@ export class PngImage {
             throw new Error("Invalid offset.");
         }
         const newBuffer = __native_resize(
-            this.data,
+            this.pixels,
             this.width,
             this.height,
             ...safeDimensions,
@@ -398,12 +863,21 @@ export class PngImage {
         this.data = newBuffer;
         this.width = safeDimensions.x;
         this.height = safeDimensions.y;
+        this.rowBytes = Math.ceil(this.width * this.channels * this.bitDepth / 8);
+        // Every row might have moved, so all of them changed.
+        if (this.rowRevisions) {
+            this.rowRevisions = new Uint32Array(this.height).fill(++this.revision);
+        }
     }
 
     /**
      * Copies the specified rectangle from the other image (or the whole other image if rectangle is omitted)
      * into this image at the current offset (or to the top left if the offset is omitted).
      * Modifies this image and the underlying buffer.
+     * If the other image has a different color type or bit depth, its pixels are converted into this image's
+     * format while copying. Palette entries are resolved including their alpha values. Alpha channels are copied,
+     * not blended, and dropped if this image has none. Images of any other color type can not be copied into a
+     * palette image.
      *
      * @param other The other image which should be copied into this image.
      * @param offset The target position in this image to which the other image should be copied.
@@ -418,8 +892,8 @@ export class PngImage {
         if (safeOffset.x < 0 || safeOffset.y < 0) {
             throw new Error("Invalid offset.");
         }
-        if (other.colorType !== this.colorType) {
-            throw new Error("Cannot copy from image with different color type.");
+        if (this.colorType === ColorType.PALETTE && other.colorType !== ColorType.PALETTE) {
+            throw new Error("Cannot copy from image with different color type into palette image.");
         }
         if (safeSource.x + safeSource.width > other.width || safeSource.y + safeSource.height > other.height) {
             throw new Error("Provided source rectangle is out of range for source image.");
@@ -428,7 +902,7 @@ export class PngImage {
             throw new Error("Provided source rectangle and offset are out of range for this image.");
         }
         __native_copy(
-            other.data,
+            other.pixels,
             this.data,
             other.width,
             other.height,
@@ -436,7 +910,13 @@ export class PngImage {
             this.height,
             ...safeSource,
             ...safeOffset,
+            other.colorType,
+            other.bitDepth,
+            this.colorType,
+            this.bitDepth,
+            paletteTable(other.palette, other.paletteAlpha),
         );
+        this.markChanged(safeOffset.y, safeSource.height);
     }
 
     /**
@@ -462,6 +942,7 @@ export class PngImage {
             throw new Error("Provided area is out of range for this image.");
         }
         __native_fill(this.data, this.width, this.height, ...safeArea, color, this.bitDepth);
+        this.markChanged(safeArea.y, safeArea.height);
     }
 
     /**
@@ -476,46 +957,255 @@ export class PngImage {
     }
 
     /**
-     * Will encode this image to a PNG buffer.
+     * Returns the rows modified by `fill`, `set`, `copyFrom`, `crop` or `resizeCanvas` since `revision`, along with
+     * the current revision to hand to the next call. Changes are only recorded once this has been called, so the
+     * first call and calls without a revision return all rows. Writing to `data` directly is not recorded.
+     *
+     * @param revision The revision returned by a previous call.
+     *
+     * @return The current revision and the ranges of changed rows.
+     */
+    public changedRows(revision?: number): ChangedRows {
+        if (!this.rowRevisions) {
+            this.revision = 0;
+            this.rowRevisions = new Uint32Array(this.height);
+            return { revision: 0, ranges: [[0, this.height]] };
+        }
+        if (typeof revision === "undefined") {
+            return { revision: this.revision, ranges: [[0, this.height]] };
+        }
+        const ranges: [number, number][] = [];
+        for (let y = 0; y < this.height; ++y) {
+            if (this.rowRevisions[y] <= revision) {
+                continue;
+            }
+            const last = ranges[ranges.length - 1];
+            if (last && last[1] === y) {
+                last[1] = y + 1;
+            } else {
+                ranges.push([y, y + 1]);
+            }
+        }
+        return { revision: this.revision, ranges };
+    }
+
+    /**
+     * Records that `height` rows starting at row `y` changed, if changes are recorded.
+     */
+    private markChanged(y: number, height: number) {
+        if (this.rowRevisions) {
+            this.rowRevisions.fill(++this.revision, y, y + height);
+        }
+    }
+
+    /**
+     * The metadata of this image which is written along with it when it is encoded, so that
+     * decoding and encoding an image keeps its gamma, time, background color, resolution, offsets,
+     * texts, sRGB intent and ICC profile.
+     * Background colors of 16 bit images are dropped, as images are always encoded with 8 bit.
+     * Images decoded into linear light get a gamma of `1` instead, as the samples no longer match
+     * the image's gamma, sRGB intent or ICC profile.
+     */
+    public get metadata(): ImageMetadata {
+        const { gamma, texts, srgbIntent, iccProfile, pixelsPerMeterX, pixelsPerMeterY, offsetX, offsetY } = this;
+        const metadata: ImageMetadata = this.linear ? { gamma: 1, texts } : { gamma, texts, srgbIntent, iccProfile };
+        // `time` holds the fields of the `tIME` chunk in local time, but the chunk is written in UTC.
+        if (this.time) {
+            const { time } = this;
+            metadata.time = new Date(Date.UTC(
+                time.getFullYear(),
+                time.getMonth(),
+                time.getDate(),
+                time.getHours(),
+                time.getMinutes(),
+                time.getSeconds(),
+            ));
+        }
+        // libpng reports a resolution and offsets of `0` if the image has no `pHYs` or `oFFs` chunk.
+        if (pixelsPerMeterX > 0) {
+            Object.assign(metadata, { pixelsPerMeterX, pixelsPerMeterY });
+        }
+        if (offsetX !== 0 || offsetY !== 0) {
+            Object.assign(metadata, { offsetX, offsetY });
+        }
+        const background = this.backgroundColor;
+        if (background && background.length === 3 && background.every(value => value <= 255)) {
+            metadata.backgroundColor = [...background] as [number, number, number];
+        }
+        return metadata;
+    }
+
+    /**
+     * Will encode this image to a PNG buffer, keeping its metadata.
+     *
+     * @see metadata
      */
     public encode(): Buffer {
-        const { alpha, width, height } = this;
+        const { width, height } = this;
         if (this.colorType !== ColorType.RGB && this.colorType !== ColorType.RGBA) {
             throw new Error("Can only encode images with RGB or RGBA color type.");
         }
-        return encode(this.data, { width, height });
+        return encode(this.pixels, { ...this.metadata, width, height, premultiplied: this.premultiplied });
+    }
+
+    public mipmaps(options: MipmapOptions & { encode: true }, callback: MipmapsCallback<Buffer>): void;
+    public mipmaps(options: MipmapOptions & { encode: true }): Promise<Buffer[]>;
+    public mipmaps(callback: MipmapsCallback<PngImage>): void;
+    public mipmaps(options: MipmapOptions, callback: MipmapsCallback<PngImage>): void;
+    public mipmaps(options?: MipmapOptions): Promise<PngImage[]>;
+    /**
+     * Creates the mipmap chain of this image: Every level is half the size of the previous one, rounded down,
+     * until a single pixel is left. The first level is a copy of this image as of the call, so the image may be
+     * modified right away without affecting the levels.
+     * All levels are computed in one job on the scheduler's pool, each from the previous level, so the image is
+     * only read once. The levels share one buffer. If `encode` is set, all levels are encoded concurrently and
+     * PNG buffers are returned instead, keeping the image's gamma, sRGB intent and ICC profile as in `metadata`.
+     * Only images with 8 bit per sample and without palette are supported. Colors are weighted by their alpha
+     * unless the image is premultiplied.
+     *
+     * @param options Optional options controlling the filter, the encoding and how the job is scheduled.
+     * @param callback An optional callback to use instead of the Promise API.
+     *
+     * @return A Promise which resolves with the levels or `undefined` if a callback was specified.
+     */
+    public mipmaps(
+        optionsOrCallback?: MipmapOptions | MipmapsCallback<any>,
+        maybeCallback?: MipmapsCallback<any>,
+    ): Promise<any[]> | void {
+        const options = typeof optionsOrCallback === "function" || optionsOrCallback === undefined ?
+            {} : optionsOrCallback;
+        const callback = typeof optionsOrCallback === "function" ? optionsOrCallback : maybeCallback;
+        if (typeof callback === "function") {
+            this.createMipmaps(options, callback);
+            return;
+        }
+        return new Promise<any[]>((resolve, reject) => {
+            this.createMipmaps(options, (error, levels) => {
+                if (error) {
+                    reject(error);
+                    return;
+                }
+                resolve(levels);
+            });
+        });
+    }
+
+    /**
+     * Checks the options and starts the native job. Calls the callback with an error if the options are invalid.
+     */
+    private createMipmaps(options: MipmapOptions, callback: MipmapsCallback<any>) {
+        const { width, height, channels, premultiplied, gamma, linear } = this;
+        let metadata: any;
+        try {
+            if (typeof options !== "object" || options === null) {
+                throw new Error("Error creating mipmaps. Options need to be an object.");
+            }
+            const { filter = "box", encode: encodeLevels = false, compressionLevel = 6 } = options;
+            if (filter !== "box" && filter !== "gamma") {
+                throw new Error("Error creating mipmaps. Filter needs to be either \"box\" or \"gamma\".");
+            }
+            if (!Number.isInteger(compressionLevel) || compressionLevel < 0 || compressionLevel > 9) {
+                throw new Error("Error creating mipmaps. CompressionLevel needs to be an integer between 0 and 9.");
+            }
+            if (this.bitDepth !== 8 || this.colorType === ColorType.PALETTE) {
+                throw new Error("Error creating mipmaps. Only 8 bit images without palette are supported.");
+            }
+            if (encodeLevels && this.colorType !== ColorType.RGB && this.colorType !== ColorType.RGBA) {
+                throw new Error("Can only encode images with RGB or RGBA color type.");
+            }
+            const { gamma: levelGamma, srgbIntent, iccProfile } = this.metadata;
+            metadata = nativeMetadata({ gamma: levelGamma, srgbIntent, iccProfile });
+        } catch (validationError) {
+            process.nextTick(callback, validationError);
+            return;
+        }
+        const { filter = "box", encode: encodeLevels = false, compressionLevel = 6 } = options;
+        // The pool reads the pixels while the image may still be modified, so the levels are built from a copy.
+        const source = this.clone();
+        const start = (batch: boolean, done: (error: Error, result?: any) => void) => __native_mipmaps(
+            source.data,
+            width,
+            height,
+            channels,
+            premultiplied,
+            gamma,
+            // The samples of linear images can be averaged as they are.
+            filter === "gamma" && !linear,
+            encodeLevels,
+            compressionLevel,
+            metadata,
+            batch,
+            done,
+        );
+        scheduleJob(options, start, (error: Error, result?: any) => {
+            if (error) {
+                callback(error);
+                return;
+            }
+            if (encodeLevels) {
+                callback(null, result);
+                return;
+            }
+            const { data, sizes } = result;
+            const levels = [source];
+            let offset = 0;
+            for (let index = 0; index < sizes.length; index += 2) {
+                const [levelWidth, levelHeight] = [sizes[index], sizes[index + 1]];
+                const size = levelWidth * levelHeight * channels;
+                levels.push(source.withData(data.subarray(offset, offset + size), levelWidth, levelHeight));
+                offset += size;
+            }
+            callback(null, levels);
+        });
     }
 
+    public write(path: string, callback: WritePngFileCallback): void;
+    public write(path: string, options: WriteOptions & JobOptions, callback: WritePngFileCallback): void;
+    public write(path: string, options?: WriteOptions & JobOptions): Promise<void>;
     /**
-     * Will encode this image and write it to the file at the specified path.
+     * Will encode this image and write it to the file at the specified path, keeping its metadata.
+     * The pixels are copied before the image is encoded on the scheduler's pool, so the image may be modified
+     * right away without affecting the file.
      *
      * @param path Path to the file to which the encoded PNG should be written.
+     * @param options Optional options controlling how the file is written and how the job is scheduled.
      * @param callback An optional callback to use instead of the Promise API.
      *
      * @see writePngFile
      *
      * @return A Promise which resolves once the file is written or `undefined` if a callback was specified.
      */
-    public write(path: string, callback?: WritePngFileCallback): Promise<void> | void {
-        const { alpha, width, height } = this;
+    public write(
+        path: string,
+        optionsOrCallback?: (WriteOptions & JobOptions) | WritePngFileCallback,
+        maybeCallback?: WritePngFileCallback,
+    ): Promise<void> | void {
+        const { width, height } = this;
         if (this.colorType !== ColorType.RGB && this.colorType !== ColorType.RGBA) {
             throw new Error("Can only encode images with RGB or RGBA color type.");
         }
-        return writePngFile(path, this.data, { width, height }, callback);
+        const options = typeof optionsOrCallback === "function" ? {} : optionsOrCallback;
+        const callback = typeof optionsOrCallback === "function" ? optionsOrCallback : maybeCallback;
+        const { premultiplied } = this;
+        const { metadata } = this;
+        const data = Buffer.from(this.pixels);
+        return writePngFile(path, data, { ...options, ...metadata, width, height, premultiplied }, callback);
     }
 
     /**
-     * Will encode this image and write it to the file at the specified path synchroneously.
+     * Will encode this image and write it to the file at the specified path synchroneously, keeping its metadata.
      *
      * @param path Path to the file to which the encoded PNG should be written.
+     * @param options Optional options controlling how the file is written.
      *
      * @see writePngFileSync
      */
-    public writeSync(path: string): void {
-        const { alpha, width, height } = this;
+    public writeSync(path: string, options?: WriteOptions): void {
+        const { width, height } = this;
         if (this.colorType !== ColorType.RGB && this.colorType !== ColorType.RGBA) {
             throw new Error("Can only encode images with RGB or RGBA color type.");
         }
-        return writePngFileSync(path, this.data, { width, height });
+        const { metadata, premultiplied } = this;
+        return writePngFileSync(path, this.pixels, { ...options, ...metadata, width, height, premultiplied });
     }
 }
@@ -0,0 +1,106 @@
+import { Writable } from "stream";
+import { PngImage, wrapNativePngImage } from "./png-image";
+import { DecodeOptions, validateDecodeOptions } from "./decode-options";
+import { __native_ProgressiveDecoder } from "./native";
+
+/**
+ * The header of an image decoded by a `ProgressiveDecoder`, describing the image after the
+ * output format has been applied.
+ */
+export interface ProgressiveHeader {
+    width: number;
+    height: number;
+    channels: number;
+    bitDepth: number;
+    /**
+     * Whether the image is interlaced using Adam7, so `"pass"` events will be emitted.
+     */
+    interlaced: boolean;
+}
+
+/**
+ * A preview of an interlaced image after some of its seven Adam7 passes have been decoded.
+ */
+export interface ProgressivePass extends ProgressiveHeader {
+    /**
+     * The amount of passes decoded so far, between `1` and `6`. The 1st pass contains every 64th pixel,
+     * each further pass doubles the amount of pixels. Passes which are empty for very small images
+     * are skipped.
+     */
+    pass: number;
+    /**
+     * The whole image in the same layout as the final image's `data`. Every pixel decoded so far is
+     * replicated over the pixels of the later passes, so the preview can be displayed as it is.
+     */
+    data: Buffer;
+}
+
+/**
+ * A writable stream decoding a PNG image from chunks of data as they arrive, for example from
+ * an upload or an HTTP response.
+ *
+ * Emits the following events in addition to the ones of every writable stream:
+ *
+ *  * `"header"` with a `ProgressiveHeader` once the header of the image has been read.
+ *  * `"pass"` with a `ProgressivePass` whenever an Adam7 pass of an interlaced image has been decoded,
+ *    except for the last pass which completes the image.
+ *  * `"image"` with the decoded `PngImage` once the stream has been ended. It is also available
+ *    as `image` afterwards.
+ *
+ * Input which is not a valid PNG image or ends before the image is complete is reported as
+ * an `"error"` event.
+ */
+export class ProgressiveDecoder extends Writable {
+    /**
+     * The decoded image, once the stream has finished.
+     */
+    public image?: PngImage;
+
+    /**
+     * The header of the image, once it has been read.
+     */
+    public header?: ProgressiveHeader;
+
+    private options: DecodeOptions;
+    private native: any;
+
+    /**
+     * @param options Options used when decoding, such as the pixel format to normalize the image into.
+     *                The previews use the same pixel format as the final image.
+     */
+    constructor(options?: DecodeOptions) {
+        super();
+        validateDecodeOptions(options);
+        this.options = options;
+        this.native = new __native_ProgressiveDecoder(options);
+    }
+
+    public _write(chunk: Buffer, encoding: string, callback: (error?: Error) => void) {
+        let passes: { pass: number, data: Buffer }[];
+        try {
+            passes = this.native.push(chunk);
+        } catch (error) {
+            callback(error);
+            return;
+        }
+        if (!this.header) {
+            this.header = this.native.header();
+            if (this.header) {
+                this.emit("header", this.header);
+            }
+        }
+        passes.forEach(({ pass, data }) => this.emit("pass", { ...this.header, pass, data }));
+        callback();
+    }
+
+    public _final(callback: (error?: Error) => void) {
+        try {
+            this.image = wrapNativePngImage(this.native.finish(), this.options);
+        } catch (error) {
+            callback(error);
+            return;
+        }
+        this.emit("image", this.image);
+        callback();
+    }
+}
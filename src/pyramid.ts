@@ -0,0 +1,195 @@
+import { writeFile } from "fs";
+import { DecodeLimits, validateDecodeOptions } from "./decode-options";
+import { __native_generatePyramid } from "./native";
+import { JobOptions, scheduleJob } from "./scheduler";
+
+/**
+ * The directory structure of a pyramid.
+ *
+ *  * `"dzi"` Deep Zoom: A `<path>.dzi` descriptor and the tiles in `<path>_files/<level>/<column>_<row>.png`.
+ *  * `"zxy"` The tiles in `<path>/<level>/<column>/<row>.png`, as used by most map viewers.
+ *
+ * Level `0` is a single pixel and the highest level is the full resolution in both structures.
+ */
+export type PyramidFormat = "dzi" | "zxy";
+
+export interface GeneratePyramidOptions extends JobOptions {
+    /**
+     * The width and height of the tiles. Tiles in the last column and row are smaller. Defaults to `256`.
+     */
+    tileSize?: number;
+    /**
+     * The directory structure to write the tiles in. Defaults to `"dzi"`.
+     *
+     * @see PyramidFormat
+     */
+    format?: PyramidFormat;
+    /**
+     * level of compression to use 0 - no compression, 1 - fastest, 9 - best size. Defaults to `6`, as a pyramid
+     * consists of many tiles.
+     */
+    compressionLevel?: 0 | 1 | 2 | 3 | 4 | 5 | 6 | 7 | 8 | 9;
+    /**
+     * Skip verifying the CRCs and the adler32 checksum of the input.
+     *
+     * @see DecodeOptions.trusted
+     */
+    trusted?: boolean;
+    /**
+     * Limits rejecting input which would take too many resources to decode. `maxDecodedBytes` is ignored,
+     * as the image is never decoded as a whole.
+     *
+     * @see DecodeLimits
+     */
+    limits?: DecodeLimits;
+}
+
+/**
+ * Describes a pyramid generated by `generatePyramid`.
+ */
+export interface Pyramid {
+    /**
+     * The width of the image in pixels.
+     */
+    width: number;
+    /**
+     * The height of the image in pixels.
+     */
+    height: number;
+    /**
+     * The amount of levels. The full resolution is level `levels - 1`.
+     */
+    levels: number;
+    /**
+     * The amount of tiles written, across all levels.
+     */
+    tiles: number;
+    tileSize: number;
+    format: PyramidFormat;
+}
+
+export type GeneratePyramidCallback = (error: Error, pyramid?: Pyramid) => void;
+
+/**
+ * Creates the descriptor of a Deep Zoom image.
+ */
+function dziDescriptor({ width, height, tileSize }: Pyramid) {
+    return `<?xml version="1.0" encoding="UTF-8"?>\n` +
+        `<Image xmlns="http://schemas.microsoft.com/deepzoom/2008" Format="png" Overlap="0" TileSize="${tileSize}">\n` +
+        `    <Size Width="${width}" Height="${height}"/>\n` +
+        `</Image>\n`;
+}
+
+/**
+ * Checks the options and starts the native job. Writes the descriptor once the tiles are written.
+ * Calls the callback with an error if the options are invalid.
+ */
+function generatePyramidTiles(
+    input: Buffer | string,
+    path: string,
+    options: GeneratePyramidOptions,
+    callback: GeneratePyramidCallback,
+) {
+    try {
+        if (!Buffer.isBuffer(input) && typeof input !== "string") {
+            throw new Error("Error generating pyramid. Input needs to be a buffer or a path.");
+        }
+        if (typeof path !== "string" || path.length === 0) {
+            throw new Error("Error generating pyramid. Path needs to be a non-empty string.");
+        }
+        if (typeof options !== "object" || options === null) {
+            throw new Error("Error generating pyramid. Options need to be an object.");
+        }
+        const { tileSize = 256, format = "dzi", compressionLevel = 6 } = options;
+        if (!Number.isInteger(tileSize) || tileSize < 2 || tileSize > 65536) {
+            throw new Error("Error generating pyramid. Tile size needs to be an integer between 2 and 65536.");
+        }
+        if (format !== "dzi" && format !== "zxy") {
+            throw new Error("Error generating pyramid. Format needs to be either \"dzi\" or \"zxy\".");
+        }
+        if (!Number.isInteger(compressionLevel) || compressionLevel < 0 || compressionLevel > 9) {
+            throw new Error("Error generating pyramid. CompressionLevel needs to be an integer between 0 and 9.");
+        }
+        validateDecodeOptions({ trusted: options.trusted, limits: options.limits });
+    } catch (validationError) {
+        process.nextTick(callback, validationError);
+        return;
+    }
+    const { tileSize = 256, format = "dzi", compressionLevel = 6, trusted, limits } = options;
+    const start = (batch: boolean, done: (error: Error, result?: any) => void) => {
+        const zxy = format === "zxy";
+        return __native_generatePyramid(input, path, zxy, tileSize, compressionLevel, { trusted, limits }, batch, done);
+    };
+    scheduleJob(options, start, (error: Error, result?: any) => {
+        if (error) {
+            callback(error);
+            return;
+        }
+        const pyramid: Pyramid = { ...result, tileSize, format };
+        if (format === "zxy") {
+            callback(null, pyramid);
+            return;
+        }
+        writeFile(`${path}.dzi`, dziDescriptor(pyramid), writeError => {
+            if (writeError) {
+                callback(writeError);
+                return;
+            }
+            callback(null, pyramid);
+        });
+    });
+}
+
+export function generatePyramid(input: Buffer | string, path: string, callback: GeneratePyramidCallback): void;
+export function generatePyramid(
+    input: Buffer | string,
+    path: string,
+    options: GeneratePyramidOptions,
+    callback: GeneratePyramidCallback,
+): void;
+export function generatePyramid(
+    input: Buffer | string,
+    path: string,
+    options?: GeneratePyramidOptions,
+): Promise<Pyramid>;
+/**
+ * Generate a pyramid of tiles for zoomable views of large images, such as scans.
+ * The image is decoded row by row on a thread of the scheduler's pool. The tiles of the full resolution are written
+ * as soon as a band of `tileSize` rows is complete, while the rows are reduced into the coarser levels on the fly.
+ * So only one band of rows per level is kept in memory instead of the whole image, and the tiles of a band are
+ * encoded in parallel. Interlaced images can't be processed this way and are rejected.
+ * The tiles are 8 bit RGB, or RGBA if the image has transparency. The parent directory of `path` needs to exist.
+ *
+ * @param input The buffer of encoded PNG data, or the path to a PNG file, which is read in small chunks.
+ * @param path The path to write the pyramid to, without extension.
+ * @param options Optional options controlling the tiles and how the job is scheduled.
+ * @param callback An optional callback to use instead of a returned Promise. Will be called with
+ *                 an error as the first argument or `null` if everything went well, and a description
+ *                 of the pyramid as a second argument if no error occured.
+ * @return A Promise if no callback was provided and `undefined` otherwise.
+ */
+export function generatePyramid(
+    input: Buffer | string,
+    path: string,
+    optionsOrCallback?: GeneratePyramidOptions | GeneratePyramidCallback,
+    maybeCallback?: GeneratePyramidCallback,
+): Promise<Pyramid> | void {
+    const options = typeof optionsOrCallback === "function" || optionsOrCallback === undefined ?
+        {} : optionsOrCallback;
+    const callback = typeof optionsOrCallback === "function" ? optionsOrCallback : maybeCallback;
+    // Check if the user provided a `callback`.
+    if (typeof callback === "function") {
+        generatePyramidTiles(input, path, options, callback);
+        return;
+    }
+    // If the user didn't provide a callback, return a Promise which will resolve with the description of the pyramid.
+    return new Promise<Pyramid>((resolve, reject) => {
+        generatePyramidTiles(input, path, options, (error, pyramid) => {
+            if (error) {
+                reject(error);
+                return;
+            }
+            resolve(pyramid);
+        });
+    });
+}
@@ -0,0 +1,138 @@
+import { DecodeLimits, validateDecodeOptions } from "./decode-options";
+import { __native_recompress } from "./native";
+import { JobOptions, scheduleJob } from "./scheduler";
+
+/**
+ * The filter applied to the rows before they are compressed.
+ * `"adaptive"` picks the filter producing the smallest output for every row.
+ */
+export type FilterType = "none" | "sub" | "up" | "average" | "paeth" | "adaptive";
+
+/**
+ * The zlib strategy used to compress the filtered rows.
+ */
+export type CompressionStrategy = "default" | "filtered" | "huffman" | "rle" | "fixed";
+
+const filterTypes = ["none", "sub", "up", "average", "paeth", "adaptive"];
+
+const compressionStrategies = ["default", "filtered", "huffman", "rle", "fixed"];
+
+export interface RecompressOptions extends JobOptions {
+    /**
+     * level of compression to use 0 - no compression, 1 - fastest, 9 - best size. Defaults to `9`.
+     */
+    compressionLevel?: 0 | 1 | 2 | 3 | 4 | 5 | 6 | 7 | 8 | 9;
+    /**
+     * The filter to use. Defaults to libpng's choice, which is `"adaptive"` for images with at least
+     * 8 bit per sample and `"none"` for palette images and images with less than 8 bit per sample.
+     */
+    filter?: FilterType;
+    /**
+     * The zlib strategy to use. Defaults to libpng's choice, which is `"filtered"` for filtered images.
+     */
+    strategy?: CompressionStrategy;
+    /**
+     * Drop text chunks, the modification time and all chunks unknown to libpng. Chunks describing how the image
+     * is displayed, such as `gAMA`, `iCCP` or `pHYs`, are always kept. Defaults to `false`.
+     */
+    stripMetadata?: boolean;
+    /**
+     * Skip verifying the CRCs and the adler32 checksum of the input.
+     *
+     * @see DecodeOptions.trusted
+     */
+    trusted?: boolean;
+    /**
+     * Limits rejecting input which would take too many resources to decode. `maxDecodedBytes` is ignored,
+     * as the image is never decoded as a whole.
+     *
+     * @see DecodeLimits
+     */
+    limits?: DecodeLimits;
+}
+
+export type RecompressCallback = (error: Error, buffer?: Buffer) => void;
+
+/**
+ * Checks the options and starts the native job. Calls the callback with an error if the options are invalid.
+ */
+function recompressBuffer(buffer: Buffer, options: RecompressOptions, callback: RecompressCallback) {
+    try {
+        if (!Buffer.isBuffer(buffer)) {
+            throw new Error("Error recompressing PNG. Input is not a buffer.");
+        }
+        if (typeof options !== "object" || options === null) {
+            throw new Error("Error recompressing PNG. Options need to be an object.");
+        }
+        const { compressionLevel = 9, filter, strategy } = options;
+        if (!Number.isInteger(compressionLevel) || compressionLevel < 0 || compressionLevel > 9) {
+            throw new Error("Error recompressing PNG. CompressionLevel needs to be an integer between 0 and 9.");
+        }
+        if (filter !== undefined && filterTypes.indexOf(filter) === -1) {
+            throw new Error("Error recompressing PNG. Unsupported filter.");
+        }
+        if (strategy !== undefined && compressionStrategies.indexOf(strategy) === -1) {
+            throw new Error("Error recompressing PNG. Unsupported compression strategy.");
+        }
+        validateDecodeOptions({ trusted: options.trusted, limits: options.limits });
+    } catch (validationError) {
+        process.nextTick(callback, validationError);
+        return;
+    }
+    const { compressionLevel = 9, filter, strategy, stripMetadata = false, trusted, limits } = options;
+    const start = (batch: boolean, done: RecompressCallback) => {
+        return __native_recompress(
+            buffer,
+            { trusted, limits },
+            compressionLevel,
+            filter,
+            strategy,
+            stripMetadata,
+            batch,
+            done,
+        );
+    };
+    scheduleJob(options, start, callback);
+}
+
+export function recompress(buffer: Buffer, callback: RecompressCallback): void;
+export function recompress(buffer: Buffer, options: RecompressOptions, callback: RecompressCallback): void;
+export function recompress(buffer: Buffer, options?: RecompressOptions): Promise<Buffer>;
+/**
+ * Compress an encoded PNG image again with different settings, for example to optimize assets.
+ * The image is decoded and encoded on a thread of the scheduler's pool, handing every row from libpng's decoder
+ * straight to its encoder. Only a single row is kept in memory and the pixels never reach JavaScript.
+ * Color type, bit depth, interlacing, the palette and all ancillary chunks are kept as they are,
+ * so the result is lossless. The buffer must not be modified until the image is recompressed.
+ *
+ * @param buffer The buffer of encoded PNG data.
+ * @param options Optional options controlling the compression and how the job is scheduled.
+ * @param callback An optional callback to use instead of a returned Promise. Will be called with
+ *                 an error as the first argument or `null` if everything went well, and the recompressed
+ *                 image as a second argument if no error occured.
+ * @return A Promise if no callback was provided and `undefined` otherwise.
+ */
+export function recompress(
+    buffer: Buffer,
+    optionsOrCallback?: RecompressOptions | RecompressCallback,
+    maybeCallback?: RecompressCallback,
+): Promise<Buffer> | void {
+    const options = typeof optionsOrCallback === "function" || optionsOrCallback === undefined ?
+        {} : optionsOrCallback;
+    const callback = typeof optionsOrCallback === "function" ? optionsOrCallback : maybeCallback;
+    // Check if the user provided a `callback`.
+    if (typeof callback === "function") {
+        recompressBuffer(buffer, options, callback);
+        return;
+    }
+    // If the user didn't provide a callback, return a Promise which will resolve with the recompressed image.
+    return new Promise<Buffer>((resolve, reject) => {
+        recompressBuffer(buffer, options, (error, recompressed) => {
+            if (error) {
+                reject(error);
+                return;
+            }
+            resolve(recompressed);
+        });
+    });
+}
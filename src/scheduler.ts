@@ -0,0 +1,185 @@
+import { __native_abortJob, __native_configureScheduler, __native_schedulerStats } from "./native";
+
+/**
+ * The lane a job is queued in.
+ *
+ *  * `"interactive"` Jobs someone is waiting for, such as images requested by a client. Always started first.
+ *  * `"batch"` Background jobs. They never occupy the last thread of the pool, so interactive jobs can always start.
+ */
+export type JobPriority = "interactive" | "batch";
+
+/**
+ * The subset of an `AbortSignal` used to abort jobs. Any `AbortSignal` from an `AbortController` can be used.
+ */
+export interface AbortSignalLike {
+    readonly aborted: boolean;
+    addEventListener(type: "abort", listener: () => void): void;
+    removeEventListener(type: "abort", listener: () => void): void;
+}
+
+/**
+ * Options controlling how an asynchroneous job is scheduled on the library's thread pool.
+ */
+export interface JobOptions {
+    /**
+     * The lane to queue the job in. Defaults to `"interactive"`.
+     */
+    priority?: JobPriority;
+    /**
+     * Aborts the job when the signal is aborted. Queued jobs are removed from the queue and jobs which are
+     * already running stop at the next row. The job fails with an error named `"AbortError"`.
+     */
+    signal?: AbortSignalLike;
+}
+
+export interface SchedulerOptions {
+    /**
+     * The amount of threads decoding and encoding images. Defaults to the amount of CPU cores.
+     */
+    threads?: number;
+}
+
+/**
+ * Statistics about one lane of the scheduler. All times are in milliseconds.
+ */
+export interface LaneStats {
+    /**
+     * The amount of jobs waiting to be started.
+     */
+    queued: number;
+    /**
+     * The amount of jobs currently running.
+     */
+    running: number;
+    /**
+     * The amount of jobs which finished, successful or not.
+     */
+    completed: number;
+    /**
+     * The amount of jobs which were aborted.
+     */
+    aborted: number;
+    /**
+     * The average time jobs waited in the queue before they were started.
+     */
+    averageWaitTime: number;
+    /**
+     * The longest time a job waited in the queue before it was started.
+     */
+    maxWaitTime: number;
+    /**
+     * The average time it took to run a job.
+     */
+    averageRunTime: number;
+}
+
+/**
+ * Statistics about the scheduler since the process started.
+ */
+export interface SchedulerStats {
+    /**
+     * The configured amount of threads.
+     */
+    threads: number;
+    interactive: LaneStats;
+    batch: LaneStats;
+}
+
+/**
+ * Configure the thread pool which runs `readPngFile`, `writePngFile`, `PngImage.write`, `PngImage.mipmaps`,
+ * `recompress`, `buildAtlas` and `generatePyramid`.
+ * The pool is separate from libuv's threadpool, so a burst of images doesn't delay file system and network operations.
+ * It is shared by all worker threads.
+ *
+ * @param options The options for the pool.
+ */
+export function configureScheduler(options: SchedulerOptions) {
+    if (typeof options !== "object" || options === null) {
+        throw new Error("Options need to be an object.");
+    }
+    const { threads } = options;
+    if (threads !== undefined && (!Number.isInteger(threads) || threads < 1)) {
+        throw new Error("The amount of threads needs to be a positive integer.");
+    }
+    __native_configureScheduler(threads);
+}
+
+/**
+ * Converts the native counters of a lane.
+ */
+function laneStats(native: any): LaneStats {
+    const { queued, running, completed, aborted, totalWaitTime, maxWaitTime, totalRunTime } = native;
+    // Avoid dividing by zero before the first job was started.
+    const started = Math.max(1, completed + aborted);
+    return {
+        queued,
+        running,
+        completed,
+        aborted,
+        averageWaitTime: totalWaitTime / started,
+        maxWaitTime,
+        averageRunTime: totalRunTime / started,
+    };
+}
+
+/**
+ * Statistics about the queues and latencies of the thread pool.
+ */
+export function schedulerStats(): SchedulerStats {
+    const { threads, interactive, batch } = __native_schedulerStats();
+    return { threads, interactive: laneStats(interactive), batch: laneStats(batch) };
+}
+
+/**
+ * The error jobs fail with when they have been aborted.
+ */
+function abortError(): Error {
+    const error = new Error("The operation was aborted.");
+    error.name = "AbortError";
+    return error;
+}
+
+/**
+ * Schedules a native job, handling the priority and the abort signal of `options`.
+ *
+ * @param options The job options as provided by the user.
+ * @param start Starts the native job with whether to use the batch lane and the callback. Returns the job's id.
+ * @param callback Called with the result of the job, or an error if the options are invalid or the job was aborted.
+ */
+export function scheduleJob(
+    options: JobOptions,
+    start: (batch: boolean, callback: (error: Error, result?: any) => void) => number,
+    callback: (error: Error, result?: any) => void,
+) {
+    const { priority = "interactive", signal } = options || {} as JobOptions;
+    if (priority !== "interactive" && priority !== "batch") {
+        process.nextTick(callback, new Error("Priority needs to be either \"interactive\" or \"batch\"."));
+        return;
+    }
+    const validSignal = typeof signal === "object" && signal !== null && typeof signal.addEventListener === "function";
+    if (signal !== undefined && !validSignal) {
+        process.nextTick(callback, new Error("Signal needs to be an AbortSignal."));
+        return;
+    }
+    if (signal && signal.aborted) {
+        process.nextTick(callback, abortError());
+        return;
+    }
+    let id: number;
+    const abort = () => __native_abortJob(id);
+    id = start(priority === "batch", (error, result) => {
+        if (!signal) {
+            callback(error, result);
+            return;
+        }
+        signal.removeEventListener("abort", abort);
+        if (signal.aborted) {
+            callback(abortError());
+            return;
+        }
+        callback(error, result);
+    });
+    if (signal) {
+        signal.addEventListener("abort", abort);
+    }
+}
@@ -0,0 +1,83 @@
+import { __native_verify, __native_verifyFile } from "./native";
+import { scheduleJob } from "./scheduler";
+
+/**
+ * The result of verifying a PNG image.
+ */
+export interface VerifyResult {
+    /**
+     * `true` if the image is fully valid.
+     */
+    valid: boolean;
+    /**
+     * The type of the first invalid chunk, such as `"IDAT"`. Not present for valid images or if the error
+     * occured outside of a chunk, for example in the signature.
+     */
+    chunk?: string;
+    /**
+     * The offset in bytes of the first invalid chunk's header inside the encoded data. Not present for valid images.
+     */
+    offset?: number;
+    /**
+     * A description of the problem as reported by libpng. Not present for valid images.
+     */
+    reason?: string;
+}
+
+/**
+ * Checks whether a PNG image is fully valid: The CRCs of all chunks and the checksum of the compressed image data
+ * are verified and the image data is inflated to check that it contains exactly the expected amount of rows.
+ * The decoded rows are discarded right away, so only a single row is kept in memory, regardless of the size
+ * of the image. Data after the `IEND` chunk is ignored.
+ *
+ * @param buffer The buffer of encoded PNG data to verify.
+ *
+ * @return The result of the verification, describing the first problem found if the image is invalid.
+ */
+export function verify(buffer: Buffer): VerifyResult {
+    if (!Buffer.isBuffer(buffer)) {
+        throw new Error("Error verifying PNG. Input is not a buffer.");
+    }
+    return __native_verify(buffer);
+}
+
+export type VerifyFileCallback = (error: Error, result?: VerifyResult) => void;
+
+export function verifyFile(path: string, callback: VerifyFileCallback): void;
+export function verifyFile(path: string): Promise<VerifyResult>;
+/**
+ * Invoke `verifyFile` to asynchroneously read and verify a PNG file.
+ * For convenience, both Node.js callbacks and Promises are supported.
+ * If no callback is provided, a Promise is returned which will resolve with the result of the verification.
+ * Only errors reading the file are reported as errors, invalid images are described by the result.
+ * The file is verified on a thread of the scheduler's pool while it is read through a small fixed size buffer,
+ * so the memory used doesn't depend on the size of the file.
+ *
+ * @see verify
+ *
+ * @param path The path to the file to verify.
+ * @param callback An optional callback to use instead of a returned Promise. Will be called with
+ *                 an error as the first argument or `null` if the file could be read, and the result
+ *                 of the verification as a second argument.
+ * @return A Promise if no callback was provided and `undefined` otherwise.
+ */
+export function verifyFile(path: string, callback?: VerifyFileCallback) {
+    const start = (batch: boolean, done: (error: Error, result?: VerifyResult) => void) => {
+        return __native_verifyFile(path, batch, done);
+    };
+    // Check if the user provided a `callback`.
+    if (typeof callback === "function") {
+        scheduleJob({}, start, callback);
+        return;
+    }
+    // If the user didn't provide a callback, return a Promise which will resolve with the result.
+    return new Promise<VerifyResult>((resolve, reject) => {
+        scheduleJob({}, start, (error: Error, result?: VerifyResult) => {
+            if (error) {
+                reject(error);
+                return;
+            }
+            resolve(result);
+        });
+    });
+}